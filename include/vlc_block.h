@@ -289,6 +289,8 @@ static inline block_t *block_ChainGather( block_t *p_list )
  * Fifos of blocks.
  ****************************************************************************
  * - block_FifoNew : create and init a new fifo
+ * - block_FifoNewExt : create and init a new fifo with flags
+ *      (BLOCK_FIFO_SPSC: lock-free fifo for one writer and one reader thread)
  * - block_FifoRelease : destroy a fifo and free all blocks in it.
  * - block_FifoPace : wait for a fifo to drain to a specified number of packets or total data size
  * - block_FifoEmpty : free all blocks in a fifo
@@ -298,13 +300,18 @@ static inline block_t *block_ChainGather( block_t *p_list )
  *      needed), be carefull, you can use it ONLY if you are sure to be the
  *      only one getting data from the fifo.
  * - block_FifoCount : how many packets are waiting in the fifo
+ * - block_FifoSize : how many bytes are waiting in the fifo
  * - block_FifoWake : wake ups a thread with block_FifoGet() = NULL
  *   (this is used to wakeup a thread when there is no data to queue)
  *
  * block_FifoGet and block_FifoShow are cancellation points.
  ****************************************************************************/
 
+/** The fifo has a single writer thread and a single reader thread */
+#define BLOCK_FIFO_SPSC 0x1
+
 VLC_API block_fifo_t * block_FifoNew( void ) VLC_USED;
+VLC_API block_fifo_t * block_FifoNewExt( int i_flags ) VLC_USED;
 VLC_API void block_FifoRelease( block_fifo_t * );
 VLC_API void block_FifoPace( block_fifo_t *fifo, size_t max_depth, size_t max_size );
 VLC_API void block_FifoEmpty( block_fifo_t * );
@@ -312,7 +319,7 @@ VLC_API size_t block_FifoPut( block_fifo_t *, block_t * );
 VLC_API void block_FifoWake( block_fifo_t * );
 VLC_API block_t * block_FifoGet( block_fifo_t * ) VLC_USED;
 VLC_API block_t * block_FifoShow( block_fifo_t * );
-size_t block_FifoSize( const block_fifo_t *p_fifo ) VLC_USED;
+VLC_API size_t block_FifoSize( const block_fifo_t *p_fifo ) VLC_USED;
 VLC_API size_t block_FifoCount( const block_fifo_t *p_fifo ) VLC_USED;
 
 #endif /* VLC_BLOCK_H */
@@ -252,6 +252,40 @@ VLC_API int filter_Blend( filter_t *, picture_t *p_dst, int i_dst_x, int i_dst_y
  */
 VLC_API void filter_DeleteBlend( filter_t * );
 
+/**
+ * Slice threading
+ *
+ * The work of a row separable video filter can be split in horizontal bands,
+ * processed in parallel by worker threads shared by all the filters.
+ *
+ * pf_slice is called once for each of the i_slices bands, possibly
+ * concurrently, with the index of the band. filter_SliceLines() gives the
+ * lines of a plane belonging to a band. filter_Slice() returns once all the
+ * bands are processed.
+ */
+typedef void (*filter_slice_t)( filter_t *, void *p_data,
+                                unsigned i_slice, unsigned i_slices );
+
+VLC_API void filter_Slice( filter_t *, filter_slice_t pf_slice, void *p_data );
+
+/**
+ * It gives the lines [*pi_start, *pi_end[ of a plane of i_lines lines
+ * belonging to a band.
+ *
+ * The band limits are multiples of i_align (use 2 for filters which process
+ * 4:2:0 luma lines by pairs).
+ */
+static inline void filter_SliceLines( int i_lines, int i_align,
+                                      unsigned i_slice, unsigned i_slices,
+                                      int *pi_start, int *pi_end )
+{
+    const int i_units = (i_lines + i_align - 1) / i_align;
+
+    *pi_start = i_units * (int)i_slice / (int)i_slices * i_align;
+    *pi_end   = __MIN( i_units * (int)(i_slice + 1) / (int)i_slices * i_align,
+                       i_lines );
+}
+
 /**
  * Create a picture_t *(*)( filter_t *, picture_t * ) compatible wrapper
  * using a void (*)( filter_t *, picture_t *, picture_t * ) function
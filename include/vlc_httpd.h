@@ -128,7 +128,9 @@ VLC_API void httpd_RedirectDelete( httpd_redirect_t * );
 VLC_API httpd_stream_t * httpd_StreamNew( httpd_host_t *, const char *psz_url, const char *psz_mime, const char *psz_user, const char *psz_password, const vlc_acl_t *p_acl ) VLC_USED;
 VLC_API void httpd_StreamDelete( httpd_stream_t * );
 VLC_API int httpd_StreamHeader( httpd_stream_t *, uint8_t *p_data, int i_data );
-VLC_API int httpd_StreamSend( httpd_stream_t *, uint8_t *p_data, int i_data );
+/* New clients start at the last block flagged with BLOCK_FLAG_TYPE_I */
+VLC_API int httpd_StreamSend( httpd_stream_t *, const block_t *p_block );
+VLC_API void httpd_StreamSetBufferSize( httpd_stream_t *, size_t i_size );
 
 
 /* Msg functions facilities */
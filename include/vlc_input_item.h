@@ -293,6 +293,11 @@ struct input_stats_t
     int64_t i_decoded_audio;
     int64_t i_decoded_video;
 
+    /* Time spent by the video decoders, in microseconds */
+    int64_t i_packetize_time;
+    int64_t i_decode_time;
+    int64_t i_display_time;
+
     /* Vout */
     int64_t i_displayed_pictures;
     int64_t i_lost_pictures;
@@ -305,6 +310,15 @@ struct input_stats_t
     /* Aout */
     int64_t i_played_abuffers;
     int64_t i_lost_abuffers;
+
+    /* Block pool (process-wide) */
+    int64_t i_block_pool_hits;
+    int64_t i_block_pool_misses;
+
+    /* Picture pools (process-wide) */
+    int64_t i_picture_pool_gets;
+    int64_t i_picture_pool_starved;
+    int64_t i_picture_pool_peak;
 };
 
 #endif
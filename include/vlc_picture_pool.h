@@ -34,8 +34,11 @@
 /**
  * Picture pool handle
  *
- * XXX it is not thread safe, all pool manipulations and picture_Release
- * must be properly locked if needed.
+ * picture_pool_Get takes free pictures in constant time, and picture_Release
+ * returns them to the pool in constant time without locking, so pictures
+ * may be released by another thread than the one getting them.
+ * XXX the other pool manipulations, including concurrent picture_pool_Get
+ * calls, are not thread safe and must be properly locked if needed.
  */
 typedef struct picture_pool_t picture_pool_t;
 
@@ -111,6 +111,10 @@ enum stream_query_e
 
     /* XXX only data read through stream_Read/Block will be recorded */
     STREAM_SET_RECORD_STATE,     /**< arg1=bool, arg2=const char *psz_ext (if arg1 is true)  res=can fail */
+
+    /* Measures of the underlying access */
+    STREAM_GET_READ_RATE,       /**< arg1= uint64_t * (bytes per second) res=can fail */
+    STREAM_GET_READ_LATENCY,    /**< arg1= mtime_t *  res=can fail */
 };
 
 VLC_API int stream_Read( stream_t *s, void *p_read, int i_read );
@@ -53,6 +53,9 @@
 #   include <sys/vfs.h>
 #   include <linux/magic.h>
 #endif
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 
 #if defined( WIN32 )
 #   include <io.h>
@@ -74,6 +77,13 @@
 #include <vlc_fs.h>
 #include <vlc_url.h>
 
+/* Asynchronous reads */
+#define FILE_ASYNC_MAX     16
+#define FILE_ASYNC_THREADS 4
+#define FILE_ASYNC_BLOCK   (256 * 1024)
+/* How often a wait for a read checks whether the access was killed */
+#define FILE_ASYNC_POLL    (CLOCK_FREQ / 10)
+
 struct access_sys_t
 {
     unsigned int i_nb_reads;
@@ -82,8 +92,35 @@ struct access_sys_t
 
     /* */
     bool b_pace_control;
+
+    /* Memory mapping */
+    size_t page_mask;
+
+    /* Read ahead threads */
+    struct
+    {
+        vlc_thread_t threads[FILE_ASYNC_THREADS];
+        unsigned     i_threads;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait;
+
+        struct
+        {
+            block_t *p_block;
+            bool     b_done;
+        } slots[FILE_ASYNC_MAX];
+        unsigned     i_depth;    /* Reads kept in flight */
+        unsigned     i_head;     /* Next slot to return */
+        unsigned     i_used;     /* Slots issued since the head */
+        uint64_t     i_next;     /* Offset of the next read to issue */
+        unsigned     i_gen;      /* Incremented by seeks */
+        bool         b_exit;
+    } async;
 };
 
+/* Size of the memory mapped windows */
+#define FILE_MMAP_WINDOW (1 << 20)
+
 #if !defined (WIN32) && !defined (__OS2__)
 static bool IsRemote (int fd)
 {
@@ -140,6 +177,98 @@ static bool IsRemote (const char *path)
 # define posix_fadvise(fd, off, len, adv)
 #endif
 
+#ifdef HAVE_PREAD
+static block_t *FileBlockAsync (access_t *);
+static void *FileAsyncThread (void *);
+static void FileAsyncStop (access_t *);
+
+/* Reads ahead with a few threads, so that the latency of network file
+ * systems is paid once for several reads */
+static int FileAsyncStart (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    p_sys->async.i_depth = var_InheritInteger (p_access, "file-readahead");
+    if (p_sys->async.i_depth == 0)
+        return VLC_EGENERIC;
+    if (p_sys->async.i_depth > FILE_ASYNC_MAX)
+        p_sys->async.i_depth = FILE_ASYNC_MAX;
+
+    vlc_mutex_init (&p_sys->async.lock);
+    vlc_cond_init (&p_sys->async.wait);
+    for (unsigned i = 0; i < FILE_ASYNC_MAX; i++)
+    {
+        p_sys->async.slots[i].p_block = NULL;
+        p_sys->async.slots[i].b_done = false;
+    }
+    p_sys->async.i_head = 0;
+    p_sys->async.i_used = 0;
+    p_sys->async.i_next = 0;
+    p_sys->async.i_gen = 0;
+    p_sys->async.b_exit = false;
+    p_sys->async.i_threads = 0;
+
+    unsigned i_threads = __MIN (p_sys->async.i_depth, FILE_ASYNC_THREADS);
+    while (p_sys->async.i_threads < i_threads
+        && !vlc_clone (&p_sys->async.threads[p_sys->async.i_threads],
+                       FileAsyncThread, p_access, VLC_THREAD_PRIORITY_INPUT))
+        p_sys->async.i_threads++;
+
+    if (p_sys->async.i_threads == 0)
+    {
+        FileAsyncStop (p_access);
+        return VLC_EGENERIC;
+    }
+    msg_Dbg (p_access, "reading ahead %u blocks with %u threads",
+             p_sys->async.i_depth, p_sys->async.i_threads);
+    return VLC_SUCCESS;
+}
+
+static void FileAsyncStop (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    vlc_mutex_lock (&p_sys->async.lock);
+    p_sys->async.b_exit = true;
+    vlc_cond_broadcast (&p_sys->async.wait);
+    vlc_mutex_unlock (&p_sys->async.lock);
+
+    for (unsigned i = 0; i < p_sys->async.i_threads; i++)
+        vlc_join (p_sys->async.threads[i], NULL);
+
+    for (unsigned i = 0; i < FILE_ASYNC_MAX; i++)
+        if (p_sys->async.slots[i].p_block != NULL)
+            block_Release (p_sys->async.slots[i].p_block);
+    vlc_cond_destroy (&p_sys->async.wait);
+    vlc_mutex_destroy (&p_sys->async.lock);
+}
+#endif
+
+#ifdef HAVE_MMAP
+static block_t *FileBlock (access_t *);
+
+/* Not all file systems support mmap(): try to map the first page */
+static bool CanMmap (access_t *p_access, int fd, const struct stat *st)
+{
+    if (!S_ISREG (st->st_mode) || st->st_size <= 0)
+        return false;
+    if (!var_InheritBool (p_access, "file-mmap"))
+        return false;
+    /* Truncating a remote file from another host would crash us (SIGBUS) */
+    if (IsRemote (fd, p_access->psz_filepath))
+        return false;
+
+    void *addr = mmap (NULL, 1, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        msg_Dbg (p_access, "memory mapping not supported (%m)");
+        return false;
+    }
+    munmap (addr, 1);
+    return true;
+}
+#endif
+
 /*****************************************************************************
  * FileOpen: open the file
  *****************************************************************************/
@@ -231,6 +360,18 @@ int FileOpen( vlc_object_t *p_this )
     p_sys->i_nb_reads = 0;
     p_sys->fd = fd;
     p_sys->b_pace_control = true;
+    p_sys->page_mask = 0;
+    p_sys->async.i_depth = 0;
+
+#ifdef HAVE_MMAP
+    if (CanMmap (p_access, fd, &st))
+    {
+        msg_Dbg (p_access, "using memory mapping");
+        p_access->pf_read = NULL;
+        p_access->pf_block = FileBlock;
+        p_sys->page_mask = sysconf (_SC_PAGESIZE) - 1;
+    }
+#endif
 
     if (S_ISREG (st.st_mode))
         p_access->info.i_size = st.st_size;
@@ -240,6 +381,16 @@ int FileOpen( vlc_object_t *p_this )
         p_sys->b_pace_control = strcasecmp (p_access->psz_access, "stream");
     }
 
+#ifdef HAVE_PREAD
+    if (p_access->pf_read != NULL && p_access->pf_seek != NoSeek
+     && IsRemote (fd, p_access->psz_filepath)
+     && FileAsyncStart (p_access) == VLC_SUCCESS)
+    {
+        p_access->pf_read = NULL;
+        p_access->pf_block = FileBlockAsync;
+    }
+#endif
+
     if (p_access->pf_seek != NoSeek)
     {
         /* Demuxers will need the beginning of the file for probing. */
@@ -271,7 +422,7 @@ void FileClose (vlc_object_t * p_this)
 {
     access_t     *p_access = (access_t*)p_this;
 
-    if (p_access->pf_read == NULL)
+    if (p_access->pf_block == DirBlock)
     {
         DirClose (p_this);
         return;
@@ -279,6 +430,10 @@ void FileClose (vlc_object_t * p_this)
 
     access_sys_t *p_sys = p_access->p_sys;
 
+#ifdef HAVE_PREAD
+    if (p_access->pf_block == FileBlockAsync)
+        FileAsyncStop (p_access);
+#endif
     close (p_sys->fd);
     free (p_sys);
 }
@@ -342,6 +497,235 @@ ssize_t FileRead( access_t *p_access, uint8_t *p_buffer, size_t i_len )
     return i_ret;
 }
 
+#ifdef HAVE_MMAP
+/*****************************************************************************
+ * Block: memory map the next window of a regular file
+ *****************************************************************************/
+static block_t *FileBlock (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t i_pos = p_access->info.i_pos;
+
+    /* Never map past the end, the file may have been truncated */
+    struct stat st;
+    if ((fstat (p_sys->fd, &st) == 0)
+     && (p_access->info.i_size != (uint64_t)st.st_size))
+    {
+        p_access->info.i_size = st.st_size;
+        p_access->info.i_update |= INPUT_UPDATE_SIZE;
+    }
+
+    if (i_pos >= p_access->info.i_size)
+    {
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+
+    /* Map from the page of the current position up to the next window
+     * boundary, so that sequential reads use aligned windows */
+    uint64_t i_offset = i_pos & ~(uint64_t)p_sys->page_mask;
+    uint64_t i_end = (i_pos / FILE_MMAP_WINDOW + 1) * FILE_MMAP_WINDOW;
+    if (i_end > p_access->info.i_size)
+        i_end = p_access->info.i_size;
+    size_t i_length = i_end - i_offset;
+
+    /* PROT_WRITE and MAP_PRIVATE, so that the block can be modified down
+     * the chain, without touching the file nor needing write permission */
+    void *addr = mmap (NULL, i_length, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+                       p_sys->fd, i_offset);
+    if (addr == MAP_FAILED)
+    {
+        msg_Err (p_access, "memory mapping failed (%m)");
+        dialog_Fatal (p_access, _("File reading failed"),
+                      _("VLC could not read the file (%m)."));
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+#ifdef HAVE_POSIX_MADVISE
+    posix_madvise (addr, i_length, POSIX_MADV_SEQUENTIAL);
+    posix_madvise (addr, i_length, POSIX_MADV_WILLNEED);
+#endif
+    /* Start reading the next window from the disk */
+    posix_fadvise (p_sys->fd, i_end, FILE_MMAP_WINDOW, POSIX_FADV_WILLNEED);
+
+    block_t *p_block = block_mmap_Alloc (addr, i_length);
+    if (p_block == NULL)
+        return NULL;
+
+    p_block->p_buffer += i_pos - i_offset;
+    p_block->i_buffer -= i_pos - i_offset;
+    p_access->info.i_pos += p_block->i_buffer;
+    return p_block;
+}
+#endif
+#ifdef HAVE_PREAD
+/*****************************************************************************
+ * Asynchronous reads: the threads fill the slots in order of offset,
+ * FileBlockAsync() returns them in the same order.
+ *****************************************************************************/
+static void *FileAsyncThread (void *data)
+{
+    access_t *p_access = data;
+    access_sys_t *p_sys = p_access->p_sys;
+    int canc = vlc_savecancel ();
+
+    vlc_mutex_lock (&p_sys->async.lock);
+    for (;;)
+    {
+        while (!p_sys->async.b_exit
+            && p_sys->async.i_used >= p_sys->async.i_depth)
+            vlc_cond_wait (&p_sys->async.wait, &p_sys->async.lock);
+        if (p_sys->async.b_exit)
+            break;
+
+        /* Issue the next read */
+        const unsigned i_slot = (p_sys->async.i_head + p_sys->async.i_used)
+                                % p_sys->async.i_depth;
+        const unsigned i_gen = p_sys->async.i_gen;
+        const uint64_t i_offset = p_sys->async.i_next;
+
+        p_sys->async.i_next += FILE_ASYNC_BLOCK;
+        p_sys->async.i_used++;
+        vlc_mutex_unlock (&p_sys->async.lock);
+
+        block_t *p_block = block_Alloc (FILE_ASYNC_BLOCK);
+        size_t i_read = 0;
+        bool b_error = p_block == NULL;
+
+        /* Only a short read at the end may leave a hole */
+        while (!b_error && i_read < FILE_ASYNC_BLOCK)
+        {
+            ssize_t i_ret = pread (p_sys->fd, p_block->p_buffer + i_read,
+                                   FILE_ASYNC_BLOCK - i_read,
+                                   i_offset + i_read);
+            if (i_ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                msg_Err (p_access, "failed to read (%m)");
+                b_error = true;
+            }
+            else if (i_ret == 0)
+                break;
+            else
+                i_read += i_ret;
+        }
+
+        if (p_block != NULL && (b_error || i_read == 0))
+        {
+            block_Release (p_block);
+            p_block = NULL;
+        }
+        else if (p_block != NULL)
+            p_block->i_buffer = i_read;
+
+        vlc_mutex_lock (&p_sys->async.lock);
+        if (i_gen == p_sys->async.i_gen)
+        {
+            /* A NULL block marks the end of the file */
+            p_sys->async.slots[i_slot].p_block = p_block;
+            p_sys->async.slots[i_slot].b_done = true;
+            vlc_cond_broadcast (&p_sys->async.wait);
+        }
+        else if (p_block != NULL)
+            block_Release (p_block); /* Seeked meanwhile */
+    }
+    vlc_mutex_unlock (&p_sys->async.lock);
+    vlc_restorecancel (canc);
+    return NULL;
+}
+
+/* Drops the reads ahead, and restarts them from the block of i_pos */
+static void FileAsyncReset (access_sys_t *p_sys, uint64_t i_pos)
+{
+    vlc_mutex_lock (&p_sys->async.lock);
+    for (unsigned i = 0; i < p_sys->async.i_depth; i++)
+    {
+        if (p_sys->async.slots[i].p_block != NULL)
+            block_Release (p_sys->async.slots[i].p_block);
+        p_sys->async.slots[i].p_block = NULL;
+        p_sys->async.slots[i].b_done = false;
+    }
+    p_sys->async.i_head = 0;
+    p_sys->async.i_used = 0;
+    p_sys->async.i_next = i_pos - i_pos % FILE_ASYNC_BLOCK;
+    p_sys->async.i_gen++;
+    vlc_cond_broadcast (&p_sys->async.wait);
+    vlc_mutex_unlock (&p_sys->async.lock);
+}
+
+static block_t *FileBlockAsync (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    vlc_mutex_lock (&p_sys->async.lock);
+    const unsigned i_head = p_sys->async.i_head;
+    /* Killing the access does not signal the condition: check it
+     * periodically, in case a read is stalled (network file system) */
+    while (!p_sys->async.slots[i_head].b_done && !p_sys->async.b_exit
+        && vlc_object_alive (p_access))
+        vlc_cond_timedwait (&p_sys->async.wait, &p_sys->async.lock,
+                            mdate () + FILE_ASYNC_POLL);
+    const bool b_exit = p_sys->async.b_exit || !vlc_object_alive (p_access);
+
+    block_t *p_block = NULL;
+    if (p_sys->async.slots[i_head].b_done)
+    {
+        p_block = p_sys->async.slots[i_head].p_block;
+        p_sys->async.slots[i_head].p_block = NULL;
+        p_sys->async.slots[i_head].b_done = false;
+        p_sys->async.i_head = (i_head + 1) % p_sys->async.i_depth;
+        p_sys->async.i_used--;
+        vlc_cond_broadcast (&p_sys->async.wait);
+    }
+    vlc_mutex_unlock (&p_sys->async.lock);
+
+    if (p_block == NULL)
+    {
+        if (b_exit)
+            return NULL;
+        /* The file may grow: the next reads must start from here again */
+        FileAsyncReset (p_sys, p_access->info.i_pos);
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+
+    const bool b_short = p_block->i_buffer < FILE_ASYNC_BLOCK;
+
+    /* Skip what precedes the position within the first block */
+    uint64_t i_skip = p_access->info.i_pos % FILE_ASYNC_BLOCK;
+    if (i_skip >= p_block->i_buffer)
+        i_skip = p_block->i_buffer;
+    p_block->p_buffer += i_skip;
+    p_block->i_buffer -= i_skip;
+    p_access->info.i_pos += p_block->i_buffer;
+
+    if (b_short)
+    {
+        /* The file may grow: the next reads start from this block again */
+        FileAsyncReset (p_sys, p_access->info.i_pos);
+        if (p_block->i_buffer == 0)
+        {   /* Nothing was added since the last block */
+            block_Release (p_block);
+            p_access->info.b_eof = true;
+            return NULL;
+        }
+    }
+
+    if (p_access->info.i_size && !(++p_sys->i_nb_reads % INPUT_FSTAT_NB_READS))
+    {
+        struct stat st;
+
+        if ((fstat (p_sys->fd, &st) == 0)
+         && (p_access->info.i_size != (uint64_t)st.st_size))
+        {
+            p_access->info.i_size = st.st_size;
+            p_access->info.i_update |= INPUT_UPDATE_SIZE;
+        }
+    }
+    return p_block;
+}
+#endif
 
 /*****************************************************************************
  * Seek: seek to a specific location in a file
@@ -351,6 +735,14 @@ int FileSeek (access_t *p_access, uint64_t i_pos)
     p_access->info.i_pos = i_pos;
     p_access->info.b_eof = false;
 
+#ifdef HAVE_PREAD
+    if (p_access->pf_block == FileBlockAsync)
+    {
+        FileAsyncReset (p_access->p_sys, i_pos);
+        return VLC_SUCCESS;
+    }
+#endif
+
     lseek (p_access->p_sys->fd, i_pos, SEEK_SET);
     return VLC_SUCCESS;
 }
@@ -48,6 +48,17 @@ static const char *const psz_recursive_list_text[] = {
         "This is useful if you add directories that contain playlist files " \
         "for instance. Use a comma-separated list of extensions." )
 
+#define MMAP_TEXT N_("Use memory mapping")
+#define MMAP_LONGTEXT N_( \
+        "Read local files through memory mapping rather than by copying, " \
+        "where the file system supports it. VLC crashes if a mapped file " \
+        "is truncated while it is being played." )
+
+#define READAHEAD_TEXT N_("Asynchronous reads")
+#define READAHEAD_LONGTEXT N_( \
+        "Number of reads kept in flight ahead of the demuxer, for files on " \
+        "network file systems. 0 reads synchronously." )
+
 vlc_module_begin ()
     set_description( N_("File input") )
     set_shortname( N_("File") )
@@ -57,6 +68,10 @@ vlc_module_begin ()
     set_capability( "access", 50 )
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
+    add_bool( "file-mmap", false, MMAP_TEXT, MMAP_LONGTEXT, true )
+    add_integer( "file-readahead", 4, READAHEAD_TEXT, READAHEAD_LONGTEXT,
+                 true )
+        change_integer_range( 0, 16 )
 
     add_submodule()
     set_section( N_("Directory" ), NULL )
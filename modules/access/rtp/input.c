@@ -31,9 +31,13 @@
 
 #include <limits.h>
 #include <unistd.h>
+#include <errno.h>
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_RECVMMSG
+# include <sys/time.h>
+#endif
 
 #include "rtp.h"
 #ifdef HAVE_SRTP
@@ -94,6 +98,146 @@ static int rtp_timeout (mtime_t deadline)
     return t;
 }
 
+#ifdef HAVE_RECVMMSG
+#define RTP_BATCH 32
+
+/**
+ * Receive ring: the datagrams queued on the socket are received in
+ * preallocated blocks with a single system call.
+ */
+typedef struct
+{
+    block_t *ring[RTP_BATCH];
+    struct mmsghdr msgv[RTP_BATCH];
+    struct iovec iov[RTP_BATCH];
+    char control[RTP_BATCH][CMSG_SPACE(sizeof (struct timeval))];
+} rtp_batch_t;
+
+static void rtp_batch_release (void *data)
+{
+    rtp_batch_t *batch = data;
+
+    for (unsigned i = 0; i < RTP_BATCH; i++)
+        if (batch->ring[i] != NULL)
+            block_Release (batch->ring[i]);
+    free (batch);
+}
+
+/**
+ * Converts the kernel reception time stamp to the mdate() clock.
+ */
+static mtime_t rtp_recv_time (struct msghdr *msg, const struct timeval *now,
+                              mtime_t mnow)
+{
+#ifdef SO_TIMESTAMP
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR (msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMP)
+            continue;
+
+        struct timeval tv;
+        memcpy (&tv, CMSG_DATA (cmsg), sizeof (tv));
+
+        mtime_t age = (now->tv_sec - tv.tv_sec) * CLOCK_FREQ
+                    + (now->tv_usec - tv.tv_usec);
+        if (age >= 0 && age < 10 * CLOCK_FREQ)
+            return mnow - age;
+    }
+#else
+    (void) msg; (void) now;
+#endif
+    return mnow;
+}
+
+/**
+ * Receives and processes all the datagrams queued on the RTP socket.
+ * The first datagram is received in a buffer large enough for any datagram,
+ * the others in buffers of the largest size seen so far.
+ * @return false if the socket failed
+ */
+static bool rtp_recv_batch (demux_t *demux, rtp_batch_t *batch, int fd)
+{
+    demux_sys_t *sys = demux->p_sys;
+    unsigned count;
+
+    for (count = 0; count < RTP_BATCH; count++)
+    {
+        block_t *block = batch->ring[count];
+        size_t size = (count == 0) ? 0xffff : sys->mru;
+
+        if (block != NULL && block->i_buffer < size)
+        {
+            block_Release (block);
+            block = NULL;
+        }
+        if (block == NULL)
+        {
+            block = block_Alloc (size);
+            if (unlikely(block == NULL))
+                break;
+            batch->ring[count] = block;
+        }
+
+        struct mmsghdr *mmsg = batch->msgv + count;
+
+        batch->iov[count].iov_base = block->p_buffer;
+        batch->iov[count].iov_len = block->i_buffer;
+        memset (mmsg, 0, sizeof (*mmsg));
+        mmsg->msg_hdr.msg_iov = batch->iov + count;
+        mmsg->msg_hdr.msg_iovlen = 1;
+        mmsg->msg_hdr.msg_control = batch->control[count];
+        mmsg->msg_hdr.msg_controllen = sizeof (batch->control[count]);
+    }
+
+    if (unlikely(count == 0))
+        return false; /* we are totallly screwed */
+
+    int n = recvmmsg (fd, batch->msgv, count, MSG_DONTWAIT, NULL);
+    if (n == -1)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            msg_Warn (demux, "RTP network error: %m");
+        return true;
+    }
+
+    struct timeval now;
+    gettimeofday (&now, NULL);
+    mtime_t mnow = mdate ();
+
+    for (int i = 0; i < n; i++)
+    {
+        struct mmsghdr *mmsg = batch->msgv + i;
+
+        if (mmsg->msg_hdr.msg_flags & MSG_TRUNC)
+        {
+            msg_Warn (demux, "packet truncated (MRU was %zu)", sys->mru);
+            sys->mru = 0xffff;
+            continue;
+        }
+
+        block_t *block = batch->ring[i];
+        if (i == 0 && mmsg->msg_len <= sys->mru)
+        {   /* keep the large block for the next batch */
+            block = block_Alloc (mmsg->msg_len);
+            if (unlikely(block == NULL))
+                continue;
+            memcpy (block->p_buffer, batch->ring[0]->p_buffer, mmsg->msg_len);
+        }
+        else
+        {
+            batch->ring[i] = NULL;
+            if (mmsg->msg_len > sys->mru)
+                sys->mru = mmsg->msg_len;
+        }
+        block->i_buffer = mmsg->msg_len;
+        block->i_pts = rtp_recv_time (&mmsg->msg_hdr, &now, mnow);
+        rtp_process (demux, block);
+    }
+    return true;
+}
+#endif
+
 /**
  * RTP/RTCP session thread for datagram sockets
  */
@@ -108,6 +252,16 @@ void *rtp_dgram_thread (void *opaque)
     ufd[0].fd = rtp_fd;
     ufd[0].events = POLLIN;
 
+#ifdef HAVE_RECVMMSG
+    rtp_batch_t *batch = calloc (1, sizeof (*batch));
+    if (unlikely(batch == NULL))
+        return NULL;
+# ifdef SO_TIMESTAMP
+    setsockopt (rtp_fd, SOL_SOCKET, SO_TIMESTAMP, &(int){ 1 }, sizeof (int));
+# endif
+    vlc_cleanup_push (rtp_batch_release, batch);
+#endif
+
     for (;;)
     {
         int n = poll (ufd, 1, rtp_timeout (deadline));
@@ -124,6 +278,10 @@ void *rtp_dgram_thread (void *opaque)
             if (unlikely(ufd[0].revents & POLLHUP))
                 break; /* RTP socket dead (DCCP only) */
 
+#ifdef HAVE_RECVMMSG
+            if (!rtp_recv_batch (demux, batch, rtp_fd))
+                break;
+#else
             block_t *block = block_Alloc (0xffff); /* TODO: p_sys->mru */
             if (unlikely(block == NULL))
                 break; /* we are totallly screwed */
@@ -139,6 +297,7 @@ void *rtp_dgram_thread (void *opaque)
                 msg_Warn (demux, "RTP network error: %m");
                 block_Release (block);
             }
+#endif
         }
 
     dequeue:
@@ -146,6 +305,9 @@ void *rtp_dgram_thread (void *opaque)
             deadline = VLC_TS_INVALID;
         vlc_restorecancel (canc);
     }
+#ifdef HAVE_RECVMMSG
+    vlc_cleanup_run ();
+#endif
     return NULL;
 }
 
@@ -258,6 +258,7 @@ static int Open (vlc_object_t *obj)
 #endif
     p_sys->fd           = fd;
     p_sys->rtcp_fd      = rtcp_fd;
+    p_sys->mru          = 1500;
     p_sys->max_src      = var_CreateGetInteger (obj, "rtp-max-src");
     p_sys->timeout      = var_CreateGetInteger (obj, "rtp-timeout")
                         * CLOCK_FREQ;
@@ -68,6 +68,7 @@ struct demux_sys_t
     int           fd;
     int           rtcp_fd;
     vlc_thread_t  thread;
+    size_t        mru; /**< Largest datagram received so far */
 
     mtime_t       timeout;
     uint16_t      max_dropout; /**< Max packet forward misordering */
@@ -258,6 +258,8 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
 
     mtime_t        now = mdate ();
     rtp_source_t  *src  = NULL;
+    /* Reception time, from the kernel if the input provided it */
+    const mtime_t  rx   = (block->i_pts > VLC_TS_INVALID) ? block->i_pts : now;
     const uint16_t seq  = rtp_seq (block);
     const uint32_t ssrc = GetDWBE (block->p_buffer + 8);
 
@@ -313,14 +315,14 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
              * It is independent of RTP sequence. */
             uint32_t freq = pt->frequency;
             int64_t ts = rtp_timestamp (block);
-            int64_t d = ((now - src->last_rx) * freq) / CLOCK_FREQ;
+            int64_t d = ((rx - src->last_rx) * freq) / CLOCK_FREQ;
             d        -=    ts - src->last_ts;
             if (d < 0) d = -d;
             src->jitter += ((d - src->jitter) + 8) >> 4;
         }
     }
-    src->last_rx = now;
-    block->i_pts = now; /* store reception time until dequeued */
+    src->last_rx = rx;
+    block->i_pts = rx; /* store reception time until dequeued */
     src->last_ts = rtp_timestamp (block);
 
     /* Check sequence number */
@@ -41,7 +41,17 @@
 #include <vlc_access.h>
 #include <vlc_network.h>
 
+#include <errno.h>
+#ifdef HAVE_RECVMMSG
+# include <sys/time.h>
+#endif
+
 #define MTU 65535
+/* Datagrams taken from the socket at once */
+#define UDP_BATCH 64
+/* Initial receive buffer size (grown if datagrams are larger). The first
+ * datagram of a batch is always received in a MTU-sized buffer. */
+#define UDP_MRU 1500
 
 /*****************************************************************************
  * Module descriptor
@@ -69,6 +79,19 @@ vlc_module_end ()
 static block_t *BlockUDP( access_t * );
 static int Control( access_t *, int, va_list );
 
+struct access_sys_t
+{
+    int fd;
+#ifdef HAVE_RECVMMSG
+    size_t mru;
+    uint8_t *p_wait; /* MTU-sized buffer for the first datagram of a wait */
+    block_t *ring[UDP_BATCH];
+    struct mmsghdr msgv[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+    char control[UDP_BATCH][CMSG_SPACE(sizeof (struct timeval))];
+#endif
+};
+
 /*****************************************************************************
  * Open: open the socket
  *****************************************************************************/
@@ -128,15 +151,39 @@ static int Open( vlc_object_t *p_this )
     msg_Dbg( p_access, "opening server=%s:%d local=%s:%d",
              psz_server_addr, i_server_port, psz_bind_addr, i_bind_port );
 
+    access_sys_t *p_sys = calloc( 1, sizeof( *p_sys ) );
+    if( unlikely(p_sys == NULL) )
+    {
+        free( psz_name );
+        return VLC_ENOMEM;
+    }
+
     fd = net_OpenDgram( p_access, psz_bind_addr, i_bind_port,
                         psz_server_addr, i_server_port, IPPROTO_UDP );
     free (psz_name);
     if( fd == -1 )
     {
         msg_Err( p_access, "cannot open socket" );
+        free( p_sys );
         return VLC_EGENERIC;
     }
-    p_access->p_sys = (void *)(intptr_t)fd;
+    p_sys->fd = fd;
+
+#ifdef HAVE_RECVMMSG
+    p_sys->mru = UDP_MRU;
+    p_sys->p_wait = malloc( MTU );
+    if( unlikely(p_sys->p_wait == NULL) )
+    {
+        net_Close( fd );
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+# ifdef SO_TIMESTAMP
+    /* Kernel reception time stamps, for jitter measurements */
+    setsockopt( fd, SOL_SOCKET, SO_TIMESTAMP, &(int){ 1 }, sizeof (int) );
+# endif
+#endif
+    p_access->p_sys = p_sys;
 
     return VLC_SUCCESS;
 }
@@ -147,8 +194,16 @@ static int Open( vlc_object_t *p_this )
 static void Close( vlc_object_t *p_this )
 {
     access_t     *p_access = (access_t*)p_this;
+    access_sys_t *p_sys = p_access->p_sys;
 
-    net_Close( (intptr_t)p_access->p_sys );
+    net_Close( p_sys->fd );
+#ifdef HAVE_RECVMMSG
+    for( unsigned i = 0; i < UDP_BATCH; i++ )
+        if( p_sys->ring[i] != NULL )
+            block_Release( p_sys->ring[i] );
+    free( p_sys->p_wait );
+#endif
+    free( p_sys );
 }
 
 /*****************************************************************************
@@ -193,6 +248,130 @@ static int Control( access_t *p_access, int i_query, va_list args )
     return VLC_SUCCESS;
 }
 
+#ifdef HAVE_RECVMMSG
+/*****************************************************************************
+ * RecvTime: reception time of a datagram, on the mdate() clock
+ *****************************************************************************/
+static mtime_t RecvTime( struct msghdr *msg, const struct timeval *now,
+                         mtime_t i_now )
+{
+#ifdef SO_TIMESTAMP
+    for( struct cmsghdr *cmsg = CMSG_FIRSTHDR( msg ); cmsg != NULL;
+         cmsg = CMSG_NXTHDR( msg, cmsg ) )
+    {
+        if( cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMP )
+            continue;
+
+        struct timeval tv;
+        memcpy( &tv, CMSG_DATA( cmsg ), sizeof( tv ) );
+
+        /* The kernel time stamps on the wall clock */
+        mtime_t i_age = (now->tv_sec - tv.tv_sec) * CLOCK_FREQ
+                      + (now->tv_usec - tv.tv_usec);
+        if( i_age >= 0 && i_age < 10 * CLOCK_FREQ )
+            return i_now - i_age;
+    }
+#else
+    VLC_UNUSED(msg); VLC_UNUSED(now);
+#endif
+    return i_now;
+}
+
+/*****************************************************************************
+ * BatchUDP: takes all the datagrams already queued on the socket
+ *****************************************************************************
+ * The datagrams are received in a ring of preallocated blocks with a single
+ * system call, and returned as a chain. Each block has its reception time in
+ * i_pts.
+ *****************************************************************************/
+static block_t *BatchUDP( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    unsigned i_count;
+
+    for( i_count = 0; i_count < UDP_BATCH; i_count++ )
+    {
+        block_t *p_block = p_sys->ring[i_count];
+        size_t i_size = i_count == 0 ? MTU : p_sys->mru;
+
+        if( p_block != NULL && p_block->i_buffer < i_size )
+        {   /* allocated before the MRU was increased */
+            block_Release( p_block );
+            p_block = NULL;
+        }
+        if( p_block == NULL )
+        {
+            p_block = block_Alloc( i_size );
+            if( unlikely(p_block == NULL) )
+                break;
+            p_sys->ring[i_count] = p_block;
+        }
+
+        struct mmsghdr *mmsg = &p_sys->msgv[i_count];
+
+        p_sys->iov[i_count].iov_base = p_block->p_buffer;
+        p_sys->iov[i_count].iov_len = p_block->i_buffer;
+        memset( mmsg, 0, sizeof( *mmsg ) );
+        mmsg->msg_hdr.msg_iov = &p_sys->iov[i_count];
+        mmsg->msg_hdr.msg_iovlen = 1;
+        mmsg->msg_hdr.msg_control = p_sys->control[i_count];
+        mmsg->msg_hdr.msg_controllen = sizeof( p_sys->control[i_count] );
+    }
+
+    if( i_count == 0 )
+        return NULL;
+
+    int n = recvmmsg( p_sys->fd, p_sys->msgv, i_count, MSG_DONTWAIT, NULL );
+    if( n <= 0 )
+    {
+        if( n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+            msg_Err( p_access, "receive error: %m" );
+        return NULL;
+    }
+
+    struct timeval now;
+    gettimeofday( &now, NULL );
+    mtime_t i_now = mdate();
+
+    block_t *p_chain = NULL, **pp_last = &p_chain;
+
+    for( int i = 0; i < n; i++ )
+    {
+        struct mmsghdr *mmsg = &p_sys->msgv[i];
+
+        if( mmsg->msg_hdr.msg_flags & MSG_TRUNC )
+        {
+            msg_Warn( p_access, "packet truncated (MRU was %zu)", p_sys->mru );
+            p_sys->mru = MTU;
+            continue;
+        }
+
+        block_t *p_block = p_sys->ring[i];
+
+        if( i == 0 && mmsg->msg_len <= p_sys->mru )
+        {   /* Keep the large block for the next batch */
+            p_block = block_Alloc( mmsg->msg_len );
+            if( unlikely(p_block == NULL) )
+                continue;
+            memcpy( p_block->p_buffer, p_sys->ring[0]->p_buffer,
+                    mmsg->msg_len );
+        }
+        else
+        {
+            p_sys->ring[i] = NULL;
+            if( mmsg->msg_len > p_sys->mru )
+                p_sys->mru = mmsg->msg_len;
+        }
+
+        p_block->i_buffer = mmsg->msg_len;
+        p_block->i_pts = RecvTime( &mmsg->msg_hdr, &now, i_now );
+        *pp_last = p_block;
+        pp_last = &p_block->p_next;
+    }
+    return p_chain;
+}
+#endif
+
 /*****************************************************************************
  * BlockUDP:
  *****************************************************************************/
@@ -205,9 +384,31 @@ static block_t *BlockUDP( access_t *p_access )
     if( p_access->info.b_eof )
         return NULL;
 
+#ifdef HAVE_RECVMMSG
+    /* Under load, there is no need to wait */
+    p_block = BatchUDP( p_access );
+    if( p_block != NULL )
+        return p_block;
+
+    /* Otherwise wait for a datagram, then take whatever followed it */
+    len = net_Read( p_access, p_sys->fd, NULL, p_sys->p_wait, MTU, false );
+    if( len < 0 )
+        return NULL;
+
+    if( (size_t)len > p_sys->mru )
+        p_sys->mru = len;
+
+    p_block = block_Alloc( len );
+    if( unlikely(p_block == NULL) )
+        return NULL;
+    memcpy( p_block->p_buffer, p_sys->p_wait, len );
+    p_block->i_pts = mdate();
+    p_block->p_next = BatchUDP( p_access );
+    return p_block;
+#else
     /* Read data */
     p_block = block_New( p_access, MTU );
-    len = net_Read( p_access, (intptr_t)p_sys, NULL,
+    len = net_Read( p_access, p_sys->fd, NULL,
                     p_block->p_buffer, MTU, false );
     if( len < 0 )
     {
@@ -216,4 +417,5 @@ static block_t *BlockUDP( access_t *p_access )
     }
 
     return block_Realloc( p_block, 0, len );
+#endif
 }
@@ -67,6 +67,9 @@ static void Close( vlc_object_t * );
                             "of replacing it.")
 #define SYNC_TEXT N_("Synchronous writing")
 #define SYNC_LONGTEXT N_( "Open the file with synchronous writing.")
+#define ASYNC_TEXT N_("Asynchronous writing")
+#define ASYNC_LONGTEXT N_( "Write the file from a separate thread, so that " \
+                           "the stream output does not wait for the disk.")
 
 vlc_module_begin ()
     set_description( N_("File stream output") )
@@ -81,6 +84,8 @@ vlc_module_begin ()
     add_bool( SOUT_CFG_PREFIX "sync", false, SYNC_TEXT,SYNC_LONGTEXT,
               false )
 #endif
+    add_bool( SOUT_CFG_PREFIX "async", false, ASYNC_TEXT, ASYNC_LONGTEXT,
+              true )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -93,10 +98,34 @@ static const char *const ppsz_sout_options[] = {
 #ifdef O_SYNC
     "sync",
 #endif
+    "async",
     NULL
 };
 
+/* Maximum amount of queued data with asynchronous writing */
+#define FILE_ASYNC_MAX (32 * 1024 * 1024)
+
+struct sout_access_out_sys_t
+{
+    int          fd;
+
+    /* Asynchronous writing */
+    bool         b_async;
+    vlc_thread_t thread;
+    vlc_mutex_t  lock;
+    vlc_cond_t   wait;
+    block_t      *p_first;
+    block_t      **pp_last;
+    size_t       i_queued;
+    bool         b_writing;
+    bool         b_error;
+    bool         b_exit;
+};
+
 static ssize_t Write( sout_access_out_t *, block_t * );
+static ssize_t WriteAsync( sout_access_out_t *, block_t * );
+static void *Thread( void * );
+static void Flush( sout_access_out_t * );
 static int Seek ( sout_access_out_t *, off_t  );
 static ssize_t Read ( sout_access_out_t *, block_t * );
 static int Control( sout_access_out_t *, int, va_list );
@@ -171,11 +200,39 @@ static int Open( vlc_object_t *p_this )
         }
     }
 
-    p_access->pf_write = Write;
+    sout_access_out_sys_t *p_sys = malloc( sizeof(*p_sys) );
+    if( unlikely(p_sys == NULL) )
+    {
+        close( fd );
+        return VLC_ENOMEM;
+    }
+    p_sys->fd = fd;
+    p_sys->b_async = var_GetBool( p_access, SOUT_CFG_PREFIX "async" );
+    if( p_sys->b_async )
+    {
+        vlc_mutex_init( &p_sys->lock );
+        vlc_cond_init( &p_sys->wait );
+        p_sys->p_first = NULL;
+        p_sys->pp_last = &p_sys->p_first;
+        p_sys->i_queued = 0;
+        p_sys->b_writing = false;
+        p_sys->b_error = false;
+        p_sys->b_exit = false;
+
+        if( vlc_clone( &p_sys->thread, Thread, p_access,
+                       VLC_THREAD_PRIORITY_OUTPUT ) )
+        {
+            vlc_cond_destroy( &p_sys->wait );
+            vlc_mutex_destroy( &p_sys->lock );
+            p_sys->b_async = false;
+        }
+    }
+
+    p_access->pf_write = p_sys->b_async ? WriteAsync : Write;
     p_access->pf_read  = Read;
     p_access->pf_seek  = Seek;
     p_access->pf_control = Control;
-    p_access->p_sys    = (void *)(intptr_t)fd;
+    p_access->p_sys    = p_sys;
 
     msg_Dbg( p_access, "file access output opened (%s)", p_access->psz_path );
     if (append)
@@ -190,8 +247,22 @@ static int Open( vlc_object_t *p_this )
 static void Close( vlc_object_t * p_this )
 {
     sout_access_out_t *p_access = (sout_access_out_t*)p_this;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
 
-    close( (intptr_t)p_access->p_sys );
+    if( p_sys->b_async )
+    {
+        /* The thread writes what is queued before leaving */
+        vlc_mutex_lock( &p_sys->lock );
+        p_sys->b_exit = true;
+        vlc_cond_broadcast( &p_sys->wait );
+        vlc_mutex_unlock( &p_sys->lock );
+
+        vlc_join( p_sys->thread, NULL );
+        vlc_cond_destroy( &p_sys->wait );
+        vlc_mutex_destroy( &p_sys->lock );
+    }
+    close( p_sys->fd );
+    free( p_sys );
 
     msg_Dbg( p_access, "file access output closed" );
 }
@@ -220,8 +291,9 @@ static ssize_t Read( sout_access_out_t *p_access, block_t *p_buffer )
 {
     ssize_t val;
 
+    Flush( p_access );
     do
-        val = read( (intptr_t)p_access->p_sys, p_buffer->p_buffer,
+        val = read( p_access->p_sys->fd, p_buffer->p_buffer,
                     p_buffer->i_buffer );
     while (val == -1 && errno == EINTR);
     return val;
@@ -230,14 +302,13 @@ static ssize_t Read( sout_access_out_t *p_access, block_t *p_buffer )
 /*****************************************************************************
  * Write: standard write on a file descriptor.
  *****************************************************************************/
-static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
+static ssize_t WriteFd( int fd, block_t *p_buffer )
 {
     size_t i_write = 0;
 
     while( p_buffer )
     {
-        ssize_t val = write ((intptr_t)p_access->p_sys,
-                             p_buffer->p_buffer, p_buffer->i_buffer);
+        ssize_t val = write (fd, p_buffer->p_buffer, p_buffer->i_buffer);
         if (val == -1)
         {
             if (errno == EINTR)
@@ -262,10 +333,110 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
     return i_write;
 }
 
+static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    return WriteFd( p_access->p_sys->fd, p_buffer );
+}
+
+/* Do not buffer without limit if the disk cannot keep up. The lock is held.
+ * This is a cancellation point, kept out of WriteAsync() so that none of its
+ * variables are live across the cleanup handler. */
+static void WaitQueue( sout_access_out_sys_t *p_sys )
+{
+    mutex_cleanup_push( &p_sys->lock );
+    while( p_sys->i_queued > FILE_ASYNC_MAX && !p_sys->b_error )
+        vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+    vlc_cleanup_pop( );
+}
+
+/*****************************************************************************
+ * WriteAsync: queue the blocks for the writing thread
+ *****************************************************************************/
+static ssize_t WriteAsync( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    size_t i_size;
+
+    block_ChainProperties( p_buffer, NULL, &i_size, NULL );
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( p_sys->b_error )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        block_ChainRelease( p_buffer );
+        return -1;
+    }
+
+    *p_sys->pp_last = p_buffer;
+    while( p_buffer->p_next != NULL )
+        p_buffer = p_buffer->p_next;
+    p_sys->pp_last = &p_buffer->p_next;
+    p_sys->i_queued += i_size;
+    vlc_cond_broadcast( &p_sys->wait );
+
+    WaitQueue( p_sys );
+    vlc_mutex_unlock( &p_sys->lock );
+    return i_size;
+}
+
+static void *Thread( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    int canc = vlc_savecancel( );
+
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        while( p_sys->p_first == NULL && !p_sys->b_exit )
+            vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+        if( p_sys->p_first == NULL )
+            break;
+
+        block_t *p_chain = p_sys->p_first;
+        size_t i_size;
+
+        block_ChainProperties( p_chain, NULL, &i_size, NULL );
+        p_sys->p_first = NULL;
+        p_sys->pp_last = &p_sys->p_first;
+        p_sys->b_writing = true;
+        vlc_mutex_unlock( &p_sys->lock );
+
+        ssize_t i_ret = WriteFd( p_sys->fd, p_chain );
+        if( i_ret < 0 )
+            msg_Err( p_access, "cannot write: %m" );
+
+        vlc_mutex_lock( &p_sys->lock );
+        p_sys->i_queued -= i_size;
+        p_sys->b_writing = false;
+        if( i_ret < 0 )
+            p_sys->b_error = true;
+        vlc_cond_broadcast( &p_sys->wait );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+/* Waits until the queued blocks are written */
+static void Flush( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( !p_sys->b_async )
+        return;
+
+    vlc_mutex_lock( &p_sys->lock );
+    while( p_sys->p_first != NULL || p_sys->b_writing )
+        vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+    vlc_mutex_unlock( &p_sys->lock );
+}
+
 /*****************************************************************************
  * Seek: seek to a specific location in a file
  *****************************************************************************/
 static int Seek( sout_access_out_t *p_access, off_t i_pos )
 {
-    return lseek( (intptr_t)p_access->p_sys, i_pos, SEEK_SET );
+    Flush( p_access );
+    return lseek( p_access->p_sys->fd, i_pos, SEEK_SET );
 }
@@ -35,6 +35,7 @@
 #include <vlc_sout.h>
 #include <vlc_block.h>
 
+#include <limits.h>
 
 #include <vlc_input.h>
 #include <vlc_playlist.h>
@@ -68,6 +69,11 @@ static void Close( vlc_object_t * );
 #define MIME_TEXT N_("Mime")
 #define MIME_LONGTEXT N_("MIME returned by the server (autodetected " \
                         "if not specified)." )
+#define BUFFER_TEXT N_("Buffer size")
+#define BUFFER_LONGTEXT N_("Amount of the most recent data (in bytes) kept " \
+                          "for the clients. New clients start at the last " \
+                          "key frame in the buffer, so it should hold at " \
+                          "least a whole group of pictures." )
 #define BONJOUR_TEXT N_( "Advertise with Bonjour")
 #define BONJOUR_LONGTEXT N_( "Advertise the stream with the Bonjour protocol." )
 
@@ -85,6 +91,9 @@ vlc_module_begin ()
                   PASS_TEXT, PASS_LONGTEXT, true )
     add_string( SOUT_CFG_PREFIX "mime", "",
                 MIME_TEXT, MIME_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "buffer", 5000000,
+                 BUFFER_TEXT, BUFFER_LONGTEXT, true )
+        change_integer_range( 65536, INT_MAX )
 #if 0 //def HAVE_AVAHI_CLIENT
     add_bool( SOUT_CFG_PREFIX "bonjour", false,
               BONJOUR_TEXT, BONJOUR_LONGTEXT, true);
@@ -97,7 +106,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "user", "pwd", "mime", NULL
+    "user", "pwd", "mime", "buffer", NULL
 };
 
 static ssize_t Write( sout_access_out_t *, block_t * );
@@ -225,6 +234,8 @@ static int Open( vlc_object_t *p_this )
         free( p_sys );
         return VLC_EGENERIC;
     }
+    httpd_StreamSetBufferSize( p_sys->p_httpd_stream,
+                               var_GetInteger( p_access, SOUT_CFG_PREFIX "buffer" ) );
 
 #if 0 //def HAVE_AVAHI_CLIENT
     if( var_InheritBool(p_this, SOUT_CFG_PREFIX "bonjour") )
@@ -353,9 +364,8 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
         }
 
         i_len += p_buffer->i_buffer;
-        /* send data */
-        i_err = httpd_StreamSend( p_sys->p_httpd_stream, p_buffer->p_buffer,
-                                  p_buffer->i_buffer );
+        /* send data (the muxer flags random access points) */
+        i_err = httpd_StreamSend( p_sys->p_httpd_stream, p_buffer );
 
         p_next = p_buffer->p_next;
         block_Release( p_buffer );
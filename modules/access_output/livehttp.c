@@ -44,6 +44,7 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_charset.h>
+#include <vlc_httpd.h>
 
 #ifndef O_LARGEFILE
 #   define O_LARGEFILE 0
@@ -53,6 +54,13 @@
 
 #define MAX_RENAME_RETRIES        10
 
+/* Segments kept in memory when the number of segments is not limited */
+#define MEMORY_NUMSEGS            5
+
+/* Completed segments whose partial segments stay listed in the index,
+ * that is about three target durations */
+#define PARTS_NUMSEGS             3
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -82,6 +90,17 @@ static void Close( vlc_object_t * );
 
 #define RATECONTROL_TEXT N_("Use muxers rate control mechanism")
 
+#define PARTLEN_TEXT N_("Partial segment length")
+#define PARTLEN_LONGTEXT N_("Length in milliseconds of the partial segments "\
+                            "published in the index while a segment is "\
+                            "being written (0 to disable). This lowers the "\
+                            "latency below one segment length.")
+
+#define HTTPD_TEXT N_("Serve segments from memory")
+#define HTTPD_LONGTEXT N_("Keep the index and the segments in memory and "\
+                          "serve them with the internal HTTP server instead "\
+                          "of writing files.")
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -101,6 +120,10 @@ vlc_module_begin ()
                 INDEX_TEXT, INDEX_LONGTEXT, true )
     add_string( SOUT_CFG_PREFIX "index-url", NULL,
                 INDEXURL_TEXT, INDEXURL_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "partlen", 0, PARTLEN_TEXT, PARTLEN_LONGTEXT, true )
+        change_integer_range( 0, 10000 )
+    add_bool( SOUT_CFG_PREFIX "httpd", false,
+              HTTPD_TEXT, HTTPD_LONGTEXT, true )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -116,6 +139,8 @@ static const char *const ppsz_sout_options[] = {
     "index",
     "index-url",
     "ratecontrol",
+    "partlen",
+    "httpd",
     NULL
 };
 
@@ -123,6 +148,27 @@ static ssize_t Write( sout_access_out_t *, block_t * );
 static int Seek ( sout_access_out_t *, off_t  );
 static int Control( sout_access_out_t *, int, va_list );
 
+typedef struct
+{
+    size_t  i_offset;
+    size_t  i_length;
+    mtime_t i_duration;
+    bool    b_independent;
+} output_part_t;
+
+typedef struct
+{
+    sout_access_out_t *p_access;
+    uint32_t i_segment;
+    char *psz_entry;            /* index lines, once the segment is complete */
+    output_part_t *p_parts;
+    unsigned i_parts;
+    uint8_t *p_data;            /* content, when served from memory */
+    size_t i_data;
+    size_t i_alloc;
+    httpd_file_t *p_httpd_file;
+} output_segment_t;
+
 struct sout_access_out_sys_t
 {
     char *psz_cursegPath;
@@ -137,8 +183,37 @@ struct sout_access_out_sys_t
     bool b_delsegs;
     bool b_ratecontrol;
     bool b_splitanywhere;
+
+    /* Segments listed in the index, and the one being written */
+    int i_segments;
+    output_segment_t **pp_segments;
+    output_segment_t *p_curseg;
+    size_t i_segsize;
+
+    /* Partial segments */
+    mtime_t i_partlen;
+    mtime_t i_partdts;
+    size_t i_partoffset;
+    bool b_partindependent;
+
+    /* Memory output */
+    httpd_host_t *p_httpd_host;
+    httpd_file_t *p_httpd_index;
+    vlc_mutex_t lock;           /* protects the segment data and the index */
+    char *psz_index;
+    size_t i_index;
 };
 
+static int httpdIndexCallback( httpd_file_sys_t *, httpd_file_t *,
+                               uint8_t *, uint8_t **, int * );
+
+/* Last component of a path */
+static const char *baseName( const char *psz_path )
+{
+    const char *psz_base = strrchr( psz_path, DIR_SEP_CHAR );
+    return psz_base ? psz_base + 1 : psz_path;
+}
+
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -167,6 +242,7 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_splitanywhere = var_GetBool( p_access, SOUT_CFG_PREFIX "splitanywhere" );
     p_sys->b_delsegs = var_GetBool( p_access, SOUT_CFG_PREFIX "delsegs" );
     p_sys->b_ratecontrol = var_GetBool( p_access, SOUT_CFG_PREFIX "ratecontrol") ;
+    p_sys->i_partlen = var_GetInteger( p_access, SOUT_CFG_PREFIX "partlen" ) * 1000;
 
     p_sys->psz_indexPath = NULL;
     psz_idx = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "index" );
@@ -191,6 +267,48 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_handle = -1;
     p_sys->i_segment = 0;
     p_sys->psz_cursegPath = NULL;
+    TAB_INIT( p_sys->i_segments, p_sys->pp_segments );
+    p_sys->p_curseg = NULL;
+    p_sys->i_segsize = 0;
+    p_sys->p_httpd_host = NULL;
+    p_sys->p_httpd_index = NULL;
+    p_sys->psz_index = NULL;
+    p_sys->i_index = 0;
+    vlc_mutex_init( &p_sys->lock );
+
+    if ( var_GetBool( p_access, SOUT_CFG_PREFIX "httpd" ) )
+    {
+        /* Nothing is written to disk: only the names of the files are used */
+        const char *psz_name = p_sys->psz_indexPath ?
+                               p_sys->psz_indexPath : "index.m3u8";
+        char *psz_url;
+
+        if ( p_sys->i_numsegs == 0 )
+            p_sys->i_numsegs = MEMORY_NUMSEGS;
+
+        p_sys->p_httpd_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+        if ( p_sys->p_httpd_host &&
+             asprintf( &psz_url, "/%s", baseName( psz_name ) ) >= 0 )
+        {
+            p_sys->p_httpd_index = httpd_FileNew( p_sys->p_httpd_host, psz_url,
+                                                  "application/vnd.apple.mpegurl",
+                                                  NULL, NULL, NULL,
+                                                  httpdIndexCallback,
+                                                  (httpd_file_sys_t *)p_sys );
+            free( psz_url );
+        }
+        if ( !p_sys->p_httpd_index )
+        {
+            msg_Err( p_access, "cannot serve the index with the HTTP server" );
+            if ( p_sys->p_httpd_host )
+                httpd_HostDelete( p_sys->p_httpd_host );
+            vlc_mutex_destroy( &p_sys->lock );
+            free( p_sys->psz_indexUrl );
+            free( p_sys->psz_indexPath );
+            free( p_sys );
+            return VLC_EGENERIC;
+        }
+    }
 
     p_access->pf_write = Write;
     p_access->pf_seek  = Seek;
@@ -231,117 +349,399 @@ static char *formatSegmentPath( sout_access_out_t *p_access, char *psz_path, uin
     return psz_result;
 }
 
-/************************************************************************
- * updateIndexAndDel: If necessary, update index file & delete old segments
- ************************************************************************/
-static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+/*****************************************************************************
+ * HTTP callbacks: serve the index and the segments from memory
+ *****************************************************************************/
+static int httpdIndexCallback( httpd_file_sys_t *p_args, httpd_file_t *p_file,
+                               uint8_t *psz_request,
+                               uint8_t **pp_data, int *pi_data )
 {
+    VLC_UNUSED(p_file); VLC_UNUSED(psz_request);
+    sout_access_out_sys_t *p_sys = (sout_access_out_sys_t *)p_args;
 
-    uint32_t i_firstseg;
-
-    if ( p_sys->i_numsegs == 0 || p_sys->i_segment < p_sys->i_numsegs )
-        i_firstseg = 1;
-    else
-        i_firstseg = ( p_sys->i_segment - p_sys->i_numsegs ) + 1;
+    *pp_data = NULL;
+    *pi_data = 0;
 
-    // First update index
-    if ( p_sys->psz_indexPath )
+    vlc_mutex_lock( &p_sys->lock );
+    if ( p_sys->i_index > 0 && ( *pp_data = malloc( p_sys->i_index ) ) )
     {
-        int val;
-        FILE *fp;
-        char *psz_idxTmp;
-        if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
-            return -1;
+        memcpy( *pp_data, p_sys->psz_index, p_sys->i_index );
+        *pi_data = p_sys->i_index;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return VLC_SUCCESS;
+}
+
+static int httpdSegmentCallback( httpd_file_sys_t *p_args, httpd_file_t *p_file,
+                                 uint8_t *psz_request,
+                                 uint8_t **pp_data, int *pi_data )
+{
+    VLC_UNUSED(p_file);
+    output_segment_t *p_seg = (output_segment_t *)p_args;
+    sout_access_out_sys_t *p_sys = p_seg->p_access->p_sys;
+    size_t i_offset = 0;
+    size_t i_length;
 
-        fp = vlc_fopen( psz_idxTmp, "wt");
-        if ( !fp )
+    *pp_data = NULL;
+    *pi_data = 0;
+
+    vlc_mutex_lock( &p_sys->lock );
+    i_length = p_seg->i_data;
+
+    /* Partial segments are requested as "?part=<n>" */
+    if ( psz_request && !strncmp( (char *)psz_request, "part=", 5 ) )
+    {
+        unsigned i_part = strtoul( (char *)psz_request + 5, NULL, 10 );
+        if ( i_part < p_seg->i_parts )
         {
-            msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
-            free( psz_idxTmp );
-            return -1;
+            i_offset = p_seg->p_parts[i_part].i_offset;
+            i_length = p_seg->p_parts[i_part].i_length;
         }
+        else
+            i_length = 0;
+    }
 
-        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n", p_sys->i_seglen, i_firstseg ) < 0 )
+    if ( i_length > 0 && ( *pp_data = malloc( i_length ) ) )
+    {
+        memcpy( *pp_data, p_seg->p_data + i_offset, i_length );
+        *pi_data = i_length;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Segment list
+ *****************************************************************************/
+static output_segment_t *newSegment( sout_access_out_t *p_access, uint32_t i_seg )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    output_segment_t *p_seg = calloc( 1, sizeof( *p_seg ) );
+
+    if ( !p_seg )
+        return NULL;
+    p_seg->p_access = p_access;
+    p_seg->i_segment = i_seg;
+
+    if ( p_sys->p_httpd_host )
+    {
+        char *psz_name = formatSegmentPath( p_access, p_access->psz_path, i_seg, false );
+        char *psz_url;
+
+        if ( psz_name && asprintf( &psz_url, "/%s", baseName( psz_name ) ) >= 0 )
         {
-            free( psz_idxTmp );
-            fclose( fp );
-            return -1;
+            p_seg->p_httpd_file = httpd_FileNew( p_sys->p_httpd_host, psz_url,
+                                                 "video/MP2T", NULL, NULL, NULL,
+                                                 httpdSegmentCallback,
+                                                 (httpd_file_sys_t *)p_seg );
+            free( psz_url );
         }
-
-        char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
-        for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+        free( psz_name );
+        if ( !p_seg->p_httpd_file )
         {
-            char *psz_name;
-            if ( ! ( psz_name = formatSegmentPath( p_access, psz_idxFormat, i, false ) ) )
-            {
-                free( psz_idxTmp );
-                fclose( fp );
-                return -1;
-            }
-            val = fprintf( fp, "#EXTINF:%zu,\n%s\n", p_sys->i_seglen, psz_name );
-            free( psz_name );
-            if ( val < 0 )
-            {
-                free( psz_idxTmp );
-                fclose( fp );
-                return -1;
-            }
+            free( p_seg );
+            return NULL;
         }
+    }
+    return p_seg;
+}
 
-        if ( b_isend )
-        {
-            if ( fputs ( STR_ENDLIST, fp ) < 0)
-            {
-                free( psz_idxTmp );
-                fclose( fp ) ;
-                return -1;
-            }
+/* The segment is only shared with the HTTP server through its file, which
+ * must not be locked here: the server holds its own lock while it calls
+ * the callbacks. */
+static void deleteSegment( output_segment_t *p_seg )
+{
+    if ( p_seg->p_httpd_file )
+        httpd_FileDelete( p_seg->p_httpd_file );
+    free( p_seg->psz_entry );
+    free( p_seg->p_parts );
+    free( p_seg->p_data );
+    free( p_seg );
+}
 
-        }
-        fclose( fp );
+/* Appends formatted text to a growing buffer */
+static int appendIndex( char **ppsz_index, size_t *pi_index, const char *psz_fmt, ... )
+{
+    va_list args;
+    char *psz_line;
+    int i_line;
+
+    va_start( args, psz_fmt );
+    i_line = vasprintf( &psz_line, psz_fmt, args );
+    va_end( args );
+    if ( i_line < 0 )
+        return -1;
+
+    char *psz_new = realloc( *ppsz_index, *pi_index + i_line + 1 );
+    if ( !psz_new )
+    {
+        free( psz_line );
+        return -1;
+    }
+    memcpy( psz_new + *pi_index, psz_line, i_line + 1 );
+    *ppsz_index = psz_new;
+    *pi_index += i_line;
+    free( psz_line );
+    return 0;
+}
 
-        val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+/* URI of a segment in the index */
+static char *formatSegmentUri( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, uint32_t i_seg )
+{
+    char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
+    char *psz_name = formatSegmentPath( p_access, psz_idxFormat, i_seg, false );
 
-        if ( val < 0 )
-        {
-            vlc_unlink( psz_idxTmp );
-            msg_Err( p_access, "Error moving LiveHttp index file" );
-        }
+    if ( psz_name && p_sys->p_httpd_host && !p_sys->psz_indexUrl )
+    {
+        /* Relative to the index */
+        char *psz_base = strdup( baseName( psz_name ) );
+        free( psz_name );
+        psz_name = psz_base;
+    }
+    return psz_name;
+}
+
+/* Partial segment lines of a segment */
+static int appendParts( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys,
+                        const output_segment_t *p_seg, char **ppsz_index, size_t *pi_index )
+{
+    char *psz_uri = formatSegmentUri( p_access, p_sys, p_seg->i_segment );
+    int val = 0;
+
+    if ( !psz_uri )
+        return -1;
+
+    for ( unsigned i = 0; i < p_seg->i_parts && val == 0; i++ )
+    {
+        const output_part_t *p_part = &p_seg->p_parts[i];
+
+        /* Byte ranges of the segment file, or queries to the HTTP server
+         * which does not handle ranges */
+        if ( p_sys->p_httpd_host )
+            val = appendIndex( ppsz_index, pi_index,
+                               "#EXT-X-PART:DURATION=%.3f,URI=\"%s?part=%u\"%s\n",
+                               (double)p_part->i_duration / CLOCK_FREQ, psz_uri, i,
+                               p_part->b_independent ? ",INDEPENDENT=YES" : "" );
         else
-            msg_Info( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+            val = appendIndex( ppsz_index, pi_index,
+                               "#EXT-X-PART:DURATION=%.3f,URI=\"%s\",BYTERANGE=\"%zu@%zu\"%s\n",
+                               (double)p_part->i_duration / CLOCK_FREQ, psz_uri,
+                               p_part->i_length, p_part->i_offset,
+                               p_part->b_independent ? ",INDEPENDENT=YES" : "" );
+    }
+    free( psz_uri );
+    return val;
+}
 
+/************************************************************************
+ * updateIndex: write the index, listing the segments from i_first on
+ ************************************************************************/
+static int updateIndex( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys,
+                        int i_first, bool b_isend )
+{
+    if ( !p_sys->psz_indexPath && !p_sys->p_httpd_host )
+        return 0;
+
+    // The index is built from the entries kept since the segments were closed
+    uint32_t i_firstseg = i_first < p_sys->i_segments ? p_sys->pp_segments[i_first]->i_segment : 1;
+    char *psz_index = NULL;
+    size_t i_index = 0;
+    bool b_parts = p_sys->i_partlen > 0;
+    int val;
+
+    if ( b_parts )
+        val = appendIndex( &psz_index, &i_index,
+                           "#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-TARGETDURATION:%zu\n"
+                           "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%.3f\n"
+                           "#EXT-X-PART-INF:PART-TARGET=%.3f\n"
+                           "#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n",
+                           p_sys->i_seglen,
+                           3. * p_sys->i_partlen / CLOCK_FREQ,
+                           (double)p_sys->i_partlen / CLOCK_FREQ, i_firstseg );
+    else
+        val = appendIndex( &psz_index, &i_index,
+                           "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n",
+                           p_sys->i_seglen, i_firstseg );
+
+    /* The partial segments of the last completed segments precede their
+     * entries, as long as the stream goes on */
+    for ( int i = i_first; i < p_sys->i_segments && val == 0; i++ )
+    {
+        const output_segment_t *p_seg = p_sys->pp_segments[i];
+
+        if ( b_parts && !b_isend && i >= p_sys->i_segments - PARTS_NUMSEGS )
+            val = appendParts( p_access, p_sys, p_seg, &psz_index, &i_index );
+        if ( val == 0 )
+            val = appendIndex( &psz_index, &i_index, "%s", p_seg->psz_entry );
+    }
+
+    /* Partial segments of the segment being written */
+    if ( b_parts && p_sys->p_curseg && !b_isend && val == 0 )
+        val = appendParts( p_access, p_sys, p_sys->p_curseg, &psz_index, &i_index );
+
+    if ( b_isend && val == 0 )
+        val = appendIndex( &psz_index, &i_index, "%s", STR_ENDLIST );
+
+    if ( val < 0 )
+    {
+        free( psz_index );
+        return -1;
+    }
+
+    if ( p_sys->p_httpd_host )
+    {
+        vlc_mutex_lock( &p_sys->lock );
+        free( p_sys->psz_index );
+        p_sys->psz_index = psz_index;
+        p_sys->i_index = i_index;
+        vlc_mutex_unlock( &p_sys->lock );
+        return 0;
+    }
+
+    FILE *fp;
+    char *psz_idxTmp;
+    if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
+    {
+        free( psz_index );
+        return -1;
+    }
+
+    fp = vlc_fopen( psz_idxTmp, "wt");
+    if ( !fp )
+    {
+        msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
         free( psz_idxTmp );
+        free( psz_index );
+        return -1;
     }
 
-    // Then take care of deletion
-    if ( p_sys->b_delsegs && i_firstseg > 1 )
+    val = fwrite( psz_index, 1, i_index, fp ) == i_index ? 0 : -1;
+    free( psz_index );
+    if ( fclose( fp ) != 0 || val < 0 )
     {
-        char *psz_name = formatSegmentPath( p_access, p_access->psz_path, i_firstseg-1, true );
-         if ( psz_name )
-         {
-             vlc_unlink( psz_name );
-             free( psz_name );
-         }
+        vlc_unlink( psz_idxTmp );
+        free( psz_idxTmp );
+        return -1;
+    }
+
+    val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+
+    if ( val < 0 )
+    {
+        vlc_unlink( psz_idxTmp );
+        msg_Err( p_access, "Error moving LiveHttp index file" );
     }
+    else if ( !b_parts || !p_sys->p_curseg )
+        msg_Info( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+
+    free( psz_idxTmp );
     return 0;
 }
 
+/************************************************************************
+ * updateIndexAndDel: If necessary, update index file & delete old segments
+ ************************************************************************/
+static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+{
+    int i_expired = 0;
+
+    if ( p_sys->i_numsegs > 0 && (unsigned)p_sys->i_segments > p_sys->i_numsegs )
+        i_expired = p_sys->i_segments - p_sys->i_numsegs;
+
+    // First update index, so that it no longer lists the expired segments
+    int val = updateIndex( p_access, p_sys, i_expired, b_isend );
+
+    // Then take care of deletion
+    while ( i_expired-- > 0 )
+    {
+        output_segment_t *p_seg = p_sys->pp_segments[0];
+
+        TAB_REMOVE( p_sys->i_segments, p_sys->pp_segments, p_seg );
+        if ( p_sys->b_delsegs && !p_sys->p_httpd_host )
+        {
+            char *psz_name = formatSegmentPath( p_access, p_access->psz_path, p_seg->i_segment, true );
+            if ( psz_name )
+            {
+                vlc_unlink( psz_name );
+                free( psz_name );
+            }
+        }
+        deleteSegment( p_seg );
+    }
+    return val;
+}
+
+/*****************************************************************************
+ * closeCurrentPart: Publish what was written since the last partial segment
+ *****************************************************************************/
+static void closeCurrentPart( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, mtime_t i_dts )
+{
+    output_segment_t *p_seg = p_sys->p_curseg;
+
+    if ( !p_seg || p_sys->i_segsize <= p_sys->i_partoffset )
+        return;
+
+    vlc_mutex_lock( &p_sys->lock );
+    output_part_t *p_parts = realloc( p_seg->p_parts, ( p_seg->i_parts + 1 ) * sizeof( *p_parts ) );
+    if ( p_parts )
+    {
+        output_part_t *p_part = &p_parts[p_seg->i_parts++];
+
+        p_part->i_offset = p_sys->i_partoffset;
+        p_part->i_length = p_sys->i_segsize - p_sys->i_partoffset;
+        p_part->i_duration = i_dts - p_sys->i_partdts;
+        p_part->b_independent = p_sys->b_partindependent;
+        p_seg->p_parts = p_parts;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    p_sys->i_partoffset = p_sys->i_segsize;
+    p_sys->i_partdts = i_dts;
+
+    if ( p_parts )
+        updateIndexAndDel( p_access, p_sys, false );
+}
+
 /*****************************************************************************
  * closeCurrentSegment: Close the segment file
  *****************************************************************************/
 static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
 {
-    if ( p_sys->i_handle >= 0 )
+    if ( p_sys->p_curseg )
     {
-        close( p_sys->i_handle );
-        p_sys->i_handle = -1;
+        if ( p_sys->i_handle >= 0 )
+        {
+            close( p_sys->i_handle );
+            p_sys->i_handle = -1;
+        }
         if ( p_sys->psz_cursegPath )
         {
+            output_segment_t *p_seg = p_sys->p_curseg;
+            char *psz_uri = formatSegmentUri( p_access, p_sys, p_seg->i_segment );
+
             msg_Info( p_access, "LiveHttpSegmentComplete: %s (%"PRIu32")" , p_sys->psz_cursegPath, p_sys->i_segment );
             free( p_sys->psz_cursegPath );
             p_sys->psz_cursegPath = 0;
+
+            /* Only the entry of this segment is formatted, the index is
+             * assembled from the entries of the previous ones */
+            if ( psz_uri &&
+                 asprintf( &p_seg->psz_entry, "#EXTINF:%zu,\n%s\n", p_sys->i_seglen, psz_uri ) >= 0 )
+            {
+                TAB_APPEND( p_sys->i_segments, p_sys->pp_segments, p_seg );
+                p_sys->p_curseg = NULL;
+            }
+            else
+                p_seg->psz_entry = NULL;
+            free( psz_uri );
             updateIndexAndDel( p_access, p_sys, b_isend );
         }
+        /* Not listed in the index */
+        if ( p_sys->p_curseg )
+        {
+            deleteSegment( p_sys->p_curseg );
+            p_sys->p_curseg = NULL;
+        }
     }
 }
 
@@ -355,6 +755,17 @@ static void Close( vlc_object_t * p_this )
 
 
     closeCurrentSegment( p_access, p_sys, true );
+
+    if ( p_sys->p_httpd_index )
+        httpd_FileDelete( p_sys->p_httpd_index );
+    for ( int i = 0; i < p_sys->i_segments; i++ )
+        deleteSegment( p_sys->pp_segments[i] );
+    TAB_CLEAN( p_sys->i_segments, p_sys->pp_segments );
+    if ( p_sys->p_httpd_host )
+        httpd_HostDelete( p_sys->p_httpd_host );
+    vlc_mutex_destroy( &p_sys->lock );
+
+    free( p_sys->psz_index );
     free( p_sys->psz_indexUrl );
     free( p_sys->psz_indexPath );
     free( p_sys );
@@ -387,7 +798,7 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
  *****************************************************************************/
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
 {
-    int fd;
+    int fd = -1;
 
     uint32_t i_newseg = p_sys->i_segment + 1;
 
@@ -395,22 +806,74 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
     if ( !psz_seg )
         return -1;
 
-    fd = vlc_open( psz_seg, O_WRONLY | O_CREAT | O_LARGEFILE |
-                     O_TRUNC, 0666 );
-    if ( fd == -1 )
+    output_segment_t *p_seg = newSegment( p_access, i_newseg );
+    if ( !p_seg )
     {
-        msg_Err( p_access, "cannot open `%s' (%m)", psz_seg );
+        msg_Err( p_access, "cannot serve `%s'", psz_seg );
         free( psz_seg );
         return -1;
     }
 
+    if ( !p_sys->p_httpd_host )
+    {
+        fd = vlc_open( psz_seg, O_WRONLY | O_CREAT | O_LARGEFILE |
+                         O_TRUNC, 0666 );
+        if ( fd == -1 )
+        {
+            msg_Err( p_access, "cannot open `%s' (%m)", psz_seg );
+            deleteSegment( p_seg );
+            free( psz_seg );
+            return -1;
+        }
+    }
+
     msg_Dbg( p_access, "Successfully opened livehttp file: %s (%"PRIu32")" , psz_seg, i_newseg );
 
     //free( psz_seg );
     p_sys->psz_cursegPath = psz_seg;
     p_sys->i_handle = fd;
     p_sys->i_segment = i_newseg;
-    return fd;
+    p_sys->p_curseg = p_seg;
+    p_sys->i_segsize = 0;
+    p_sys->i_partoffset = 0;
+    p_sys->i_partdts = p_sys->i_opendts;
+    return 0;
+}
+
+/*****************************************************************************
+ * writeSegment: append data to the segment file or to memory
+ *****************************************************************************/
+static ssize_t writeSegment( sout_access_out_sys_t *p_sys, const uint8_t *p_data, size_t i_data )
+{
+    if ( p_sys->i_handle >= 0 )
+        return write( p_sys->i_handle, p_data, i_data );
+
+    output_segment_t *p_seg = p_sys->p_curseg;
+    ssize_t val = i_data;
+
+    vlc_mutex_lock( &p_sys->lock );
+    if ( p_seg->i_data + i_data > p_seg->i_alloc )
+    {
+        size_t i_alloc = __MAX( 2 * p_seg->i_alloc, p_seg->i_data + i_data );
+        uint8_t *p_new = realloc( p_seg->p_data, i_alloc );
+        if ( p_new )
+        {
+            p_seg->p_data = p_new;
+            p_seg->i_alloc = i_alloc;
+        }
+        else
+        {
+            errno = ENOMEM;
+            val = -1;
+        }
+    }
+    if ( val > 0 )
+    {
+        memcpy( p_seg->p_data + p_seg->i_data, p_data, i_data );
+        p_seg->i_data += i_data;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return val;
 }
 
 /*****************************************************************************
@@ -423,18 +886,26 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 
     while( p_buffer )
     {
-        if ( p_sys->i_handle >= 0 && ( p_sys->b_splitanywhere || ( p_buffer->i_flags & BLOCK_FLAG_TYPE_I ) ) && ( p_buffer->i_dts-p_sys->i_opendts ) > p_sys->i_seglenm )
+        if ( p_sys->p_curseg && ( p_sys->b_splitanywhere || ( p_buffer->i_flags & BLOCK_FLAG_TYPE_I ) ) && ( p_buffer->i_dts-p_sys->i_opendts ) > p_sys->i_seglenm )
         {
             closeCurrentSegment( p_access, p_sys, false );
         }
-        if ( p_buffer->i_buffer > 0 && p_sys->i_handle < 0 )
+        else if ( p_sys->p_curseg && p_sys->i_partlen > 0 && p_sys->i_segsize > p_sys->i_partoffset &&
+                  ( p_buffer->i_dts - p_sys->i_partdts ) >= p_sys->i_partlen )
+        {
+            closeCurrentPart( p_access, p_sys, p_buffer->i_dts );
+        }
+        if ( p_sys->i_segsize == p_sys->i_partoffset )
+            p_sys->b_partindependent = ( p_buffer->i_flags & BLOCK_FLAG_TYPE_I ) != 0;
+        if ( p_buffer->i_buffer > 0 && !p_sys->p_curseg )
         {
             p_sys->i_opendts = p_buffer->i_dts;
             if ( openNextFile( p_access, p_sys ) < 0 )
                 return -1;
+            p_sys->b_partindependent = ( p_buffer->i_flags & BLOCK_FLAG_TYPE_I ) != 0;
         }
-        ssize_t val = write ( p_sys->i_handle,
-                             p_buffer->p_buffer, p_buffer->i_buffer );
+        ssize_t val = writeSegment( p_sys,
+                                    p_buffer->p_buffer, p_buffer->i_buffer );
         if ( val == -1 )
         {
             if ( errno == EINTR )
@@ -455,6 +926,7 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
             p_buffer->i_buffer -= val;
         }
         i_write += val;
+        p_sys->i_segsize += val;
     }
     return i_write;
 }
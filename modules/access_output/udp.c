@@ -34,6 +34,7 @@
 
 #include <sys/types.h>
 #include <assert.h>
+#include <errno.h>
 
 #include <vlc_sout.h>
 #include <vlc_block.h>
@@ -47,11 +48,16 @@
 #   include <ws2tcpip.h>
 #else
 #   include <sys/socket.h>
+#   include <sys/uio.h>
 #endif
 
-#include <vlc_network.h>
+#if defined(__linux__) && defined(SO_TXTIME)
+#   include <linux/net_tstamp.h>
+#   include <time.h>
+#   define UDP_TXTIME 1
+#endif
 
-#define MAX_EMPTY_BLOCKS 200
+#include <vlc_network.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -73,6 +79,11 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define TXTIME_TEXT N_("Kernel transmit times")
+#define TXTIME_LONGTEXT N_("Let the kernel send each packet at its " \
+                          "departure time (SO_TXTIME). This needs an " \
+                          "\"etf\" queuing discipline on the interface." )
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -81,6 +92,8 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_bool( SOUT_CFG_PREFIX "txtime", false, TXTIME_TEXT, TXTIME_LONGTEXT,
+              true )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -94,6 +107,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "txtime",
     NULL
 };
 
@@ -109,25 +123,151 @@ static ssize_t Write   ( sout_access_out_t *, block_t * );
 static int  Seek    ( sout_access_out_t *, off_t  );
 static int Control( sout_access_out_t *, int, va_list );
 
-static void* ThreadWrite( void * );
 static block_t *NewUDPPacket( sout_access_out_t *, mtime_t );
+static void Enqueue( sout_access_out_t *, block_t * );
+static void QueueRun( sout_access_out_sys_t *, mtime_t );
+
+/* Packets due within this time are sent together */
+#define PACER_WINDOW    1000
+/* With kernel transmit times, how early packets are handed to the kernel */
+#define PACER_TXTIME    10000
+/* Maximum number of packets per system call */
+#define PACER_BURST     64
+/* Packets sharing the same date are spread up to the next date, if it is
+ * not further than this */
+#define PACER_SPREAD    100000
+#define PACER_RUN       1000
+
+/*****************************************************************************
+ * Pacer: one thread sends the packets of all the UDP outputs
+ *****************************************************************************/
+typedef struct
+{
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait;
+    vlc_cond_t    idle;
+    vlc_thread_t  thread;
+    unsigned      i_refs;
+
+    int                     i_outputs;
+    sout_access_out_sys_t **pp_outputs;
+    sout_access_out_sys_t  *p_busy; /* output being sent, without the lock */
+
+    /* Only used by the pacer thread */
+    block_t      *burst[PACER_BURST];
+#ifndef WIN32
+# ifdef HAVE_SENDMMSG
+    struct mmsghdr msgv[PACER_BURST];
+# else
+    struct msghdr  msgv[PACER_BURST];
+# endif
+    struct iovec   iov[PACER_BURST];
+#endif
+#ifdef UDP_TXTIME
+    union
+    {
+        char           buf[CMSG_SPACE(sizeof (uint64_t))];
+        struct cmsghdr align;
+    } control[PACER_BURST];
+#endif
+} udp_pacer_t;
+
+static vlc_mutex_t pacer_lock = VLC_STATIC_MUTEX;
+static udp_pacer_t *pacer = NULL;
+
+static void* ThreadPacer( void * );
 
 struct sout_access_out_sys_t
 {
+    sout_access_out_t *p_access;
+    udp_pacer_t  *p_pacer;
+
     mtime_t       i_caching;
     int           i_handle;
     bool          b_mtu_warning;
+    bool          b_txtime;
     size_t        i_mtu;
+    unsigned      i_group;
 
-    block_fifo_t *p_fifo;
-    block_fifo_t *p_empty_blocks;
+    /* Only used by the muxer thread */
     block_t      *p_buffer;
-
-    vlc_thread_t  thread;
+    block_t      *p_run;        /* packets with the same departure date */
+    block_t     **pp_run_last;
+    unsigned      i_run;
+    mtime_t       i_date_last;
+    unsigned      i_dropped;
+
+    /* Protected by the pacer lock, ordered by departure date (i_dts) */
+    block_t      *p_queue;
+    block_t     **pp_queue_last;
 };
 
 #define DEFAULT_PORT 1234
 
+static udp_pacer_t *PacerAttach( sout_access_out_sys_t *p_sys )
+{
+    vlc_mutex_lock( &pacer_lock );
+    if( pacer == NULL )
+    {
+        udp_pacer_t *p = malloc( sizeof( *p ) );
+        if( p == NULL )
+            goto out;
+
+        vlc_mutex_init( &p->lock );
+        vlc_cond_init( &p->wait );
+        vlc_cond_init( &p->idle );
+        p->i_refs = 0;
+        TAB_INIT( p->i_outputs, p->pp_outputs );
+        p->p_busy = NULL;
+
+        if( vlc_clone( &p->thread, ThreadPacer, p,
+                       VLC_THREAD_PRIORITY_HIGHEST ) )
+        {
+            vlc_cond_destroy( &p->idle );
+            vlc_cond_destroy( &p->wait );
+            vlc_mutex_destroy( &p->lock );
+            free( p );
+            goto out;
+        }
+        pacer = p;
+    }
+
+    pacer->i_refs++;
+    vlc_mutex_lock( &pacer->lock );
+    TAB_APPEND( pacer->i_outputs, pacer->pp_outputs, p_sys );
+    vlc_mutex_unlock( &pacer->lock );
+    p_sys->p_pacer = pacer;
+out:
+    vlc_mutex_unlock( &pacer_lock );
+    return p_sys->p_pacer;
+}
+
+static void PacerDetach( sout_access_out_sys_t *p_sys )
+{
+    udp_pacer_t *p = p_sys->p_pacer;
+
+    /* Let the pacer send the queued packets */
+    vlc_mutex_lock( &p->lock );
+    while( p_sys->p_queue != NULL || p->p_busy == p_sys )
+        vlc_cond_wait( &p->idle, &p->lock );
+    TAB_REMOVE( p->i_outputs, p->pp_outputs, p_sys );
+    vlc_mutex_unlock( &p->lock );
+
+    vlc_mutex_lock( &pacer_lock );
+    if( --p->i_refs == 0 )
+    {
+        vlc_cancel( p->thread );
+        vlc_join( p->thread, NULL );
+        TAB_CLEAN( p->i_outputs, p->pp_outputs );
+        vlc_cond_destroy( &p->idle );
+        vlc_cond_destroy( &p->wait );
+        vlc_mutex_destroy( &p->lock );
+        free( p );
+        pacer = NULL;
+    }
+    vlc_mutex_unlock( &pacer_lock );
+}
+
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -207,21 +347,45 @@ static int Open( vlc_object_t *p_this )
     }
     shutdown( i_handle, SHUT_RD );
 
+    p_sys->p_access = p_access;
+    p_sys->p_pacer = NULL;
     p_sys->i_caching = UINT64_C(1000)
                      * var_GetInteger( p_access, SOUT_CFG_PREFIX "caching");
     p_sys->i_handle = i_handle;
     p_sys->i_mtu = var_CreateGetInteger( p_this, "mtu" );
     p_sys->b_mtu_warning = false;
-    p_sys->p_fifo = block_FifoNew();
-    p_sys->p_empty_blocks = block_FifoNew();
+    p_sys->b_txtime = false;
+    p_sys->i_group = __MAX( var_GetInteger( p_access,
+                                            SOUT_CFG_PREFIX "group" ), 1 );
+    p_sys->i_group = __MIN( p_sys->i_group, PACER_BURST );
     p_sys->p_buffer = NULL;
+    p_sys->p_run = NULL;
+    p_sys->pp_run_last = &p_sys->p_run;
+    p_sys->i_run = 0;
+    p_sys->i_date_last = -1;
+    p_sys->i_dropped = 0;
+    p_sys->p_queue = NULL;
+    p_sys->pp_queue_last = &p_sys->p_queue;
+
+    if( var_GetBool( p_access, SOUT_CFG_PREFIX "txtime" ) )
+    {
+#ifdef UDP_TXTIME
+        /* mdate() is the monotonic clock */
+        struct sock_txtime cfg = { .clockid = CLOCK_MONOTONIC, .flags = 0 };
+
+        if( setsockopt( i_handle, SOL_SOCKET, SO_TXTIME,
+                        &cfg, sizeof( cfg ) ) == 0 )
+            p_sys->b_txtime = true;
+        else
+            msg_Warn( p_access, "cannot set transmit times: %m" );
+#else
+        msg_Warn( p_access, "transmit times not supported" );
+#endif
+    }
 
-    if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
-                           VLC_THREAD_PRIORITY_HIGHEST ) )
+    if( PacerAttach( p_sys ) == NULL )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
-        block_FifoRelease( p_sys->p_fifo );
-        block_FifoRelease( p_sys->p_empty_blocks );
         net_Close (i_handle);
         free (p_sys);
         return VLC_EGENERIC;
@@ -242,10 +406,10 @@ static void Close( vlc_object_t * p_this )
     sout_access_out_t     *p_access = (sout_access_out_t*)p_this;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
 
-    vlc_cancel( p_sys->thread );
-    vlc_join( p_sys->thread, NULL );
-    block_FifoRelease( p_sys->p_fifo );
-    block_FifoRelease( p_sys->p_empty_blocks );
+    /* Flush the held packets */
+    if( p_sys->p_run != NULL )
+        QueueRun( p_sys, p_sys->p_run->i_dts );
+    PacerDetach( p_sys );
 
     if( p_sys->p_buffer ) block_Release( p_sys->p_buffer );
 
@@ -300,7 +464,7 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
                          now - p_sys->p_buffer->i_dts
                           - p_sys->i_caching );
             }
-            block_FifoPut( p_sys->p_fifo, p_sys->p_buffer );
+            Enqueue( p_access, p_sys->p_buffer );
             p_sys->p_buffer = NULL;
         }
 
@@ -340,7 +504,7 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
                              mdate() - p_sys->p_buffer->i_dts
                               - p_sys->i_caching );
                 }
-                block_FifoPut( p_sys->p_fifo, p_sys->p_buffer );
+                Enqueue( p_access, p_sys->p_buffer );
                 p_sys->p_buffer = NULL;
             }
         }
@@ -350,6 +514,12 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
         p_buffer = p_next;
     }
 
+    /* Do not hold back packets which are already due until the next date
+     * is known */
+    if( p_sys->p_run != NULL &&
+        p_sys->p_run->i_dts <= mdate() + PACER_WINDOW )
+        QueueRun( p_sys, p_sys->p_run->i_dts );
+
     return i_len;
 }
 
@@ -369,101 +539,255 @@ static int Seek( sout_access_out_t *p_access, off_t i_pos )
 static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
 {
     sout_access_out_sys_t *p_sys = p_access->p_sys;
-    block_t *p_buffer;
+    block_t *p_buffer = block_Alloc( p_sys->i_mtu );
+
+    if( p_buffer == NULL )
+        return NULL;
+
+    p_buffer->i_dts = i_dts;
+    p_buffer->i_buffer = 0;
 
-    while ( block_FifoCount( p_sys->p_empty_blocks ) > MAX_EMPTY_BLOCKS )
+    return p_buffer;
+}
+
+/*****************************************************************************
+ * Enqueue: compute the departure date of a packet
+ *****************************************************************************
+ * The muxer dates each packet (the TS muxer interpolates the dates between
+ * PCRs), so the departure date is the packet date plus the caching delay.
+ * Consecutive packets with the same date are held back until the next date
+ * is known, then spread evenly in between, so that they do not leave in a
+ * single burst.
+ *****************************************************************************/
+static void Enqueue( sout_access_out_t *p_access, block_t *p_pk )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    mtime_t i_date = p_sys->i_caching + p_pk->i_dts;
+
+    if( p_sys->i_date_last > 0 )
     {
-        p_buffer = block_FifoGet( p_sys->p_empty_blocks );
-        block_Release( p_buffer );
+        if( i_date - p_sys->i_date_last > 2000000 )
+        {
+            if( !p_sys->i_dropped )
+                msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                         i_date - p_sys->i_date_last );
+
+            block_Release( p_pk );
+
+            p_sys->i_date_last = i_date;
+            p_sys->i_dropped++;
+            return;
+        }
+        else if( i_date - p_sys->i_date_last < -1000 )
+        {
+            if( !p_sys->i_dropped )
+                msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
+                         p_sys->i_date_last - i_date );
+        }
     }
 
-    if( block_FifoCount( p_sys->p_empty_blocks ) == 0 )
+    if( p_sys->i_dropped )
     {
-        p_buffer = block_Alloc( p_sys->i_mtu );
+        msg_Dbg( p_access, "dropped %u packets", p_sys->i_dropped );
+        p_sys->i_dropped = 0;
     }
-    else
+    p_sys->i_date_last = i_date;
+
+    if( p_sys->p_run != NULL &&
+        ( p_sys->p_run->i_dts != i_date || p_sys->i_run >= PACER_RUN ) )
+        QueueRun( p_sys, i_date );
+
+    p_pk->i_dts = i_date;
+    *p_sys->pp_run_last = p_pk;
+    p_sys->pp_run_last = &p_pk->p_next;
+    p_sys->i_run++;
+}
+
+/* Hands the held packets over to the pacer, spread up to i_next */
+static void QueueRun( sout_access_out_sys_t *p_sys, mtime_t i_next )
+{
+    block_t *p_run = p_sys->p_run;
+    mtime_t i_span = i_next - p_run->i_dts;
+
+    if( i_span > 0 && i_span <= PACER_SPREAD )
     {
-        p_buffer = block_FifoGet(p_sys->p_empty_blocks );
-        p_buffer->i_flags = 0;
-        p_buffer = block_Realloc( p_buffer, 0, p_sys->i_mtu );
+        mtime_t i_start = p_run->i_dts;
+        unsigned i = 0;
+
+        for( block_t *p_pk = p_run; p_pk != NULL; p_pk = p_pk->p_next )
+            p_pk->i_dts = i_start + i_span * i++ / p_sys->i_run;
     }
 
-    p_buffer->i_dts = i_dts;
-    p_buffer->i_buffer = 0;
+    vlc_mutex_lock( &p_sys->p_pacer->lock );
+    bool b_wake = p_sys->p_queue == NULL;
+    *p_sys->pp_queue_last = p_run;
+    p_sys->pp_queue_last = p_sys->pp_run_last;
+    if( b_wake )
+        vlc_cond_signal( &p_sys->p_pacer->wait );
+    vlc_mutex_unlock( &p_sys->p_pacer->lock );
+
+    p_sys->p_run = NULL;
+    p_sys->pp_run_last = &p_sys->p_run;
+    p_sys->i_run = 0;
+}
 
-    return p_buffer;
+/*****************************************************************************
+ * SendBurst: send packets of one output with as few system calls as possible
+ *****************************************************************************/
+static void SendBurst( udp_pacer_t *p, sout_access_out_sys_t *p_sys,
+                       unsigned i_count )
+{
+#ifdef WIN32
+    for( unsigned i = 0; i < i_count; i++ )
+        if( send( p_sys->i_handle, p->burst[i]->p_buffer,
+                  p->burst[i]->i_buffer, 0 ) == -1 )
+            msg_Warn( p_sys->p_access, "send error: %m" );
+#else
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+# ifdef HAVE_SENDMMSG
+        struct msghdr *msg = &p->msgv[i].msg_hdr;
+# else
+        struct msghdr *msg = &p->msgv[i];
+# endif
+
+        p->iov[i].iov_base = p->burst[i]->p_buffer;
+        p->iov[i].iov_len = p->burst[i]->i_buffer;
+        memset( msg, 0, sizeof( *msg ) );
+        msg->msg_iov = &p->iov[i];
+        msg->msg_iovlen = 1;
+# ifdef UDP_TXTIME
+        if( p_sys->b_txtime )
+        {
+            uint64_t i_txtime = UINT64_C(1000) * p->burst[i]->i_dts;
+            struct cmsghdr *cmsg;
+
+            msg->msg_control = p->control[i].buf;
+            msg->msg_controllen = sizeof( p->control[i].buf );
+            cmsg = CMSG_FIRSTHDR( msg );
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_TXTIME;
+            cmsg->cmsg_len = CMSG_LEN( sizeof( i_txtime ) );
+            memcpy( CMSG_DATA( cmsg ), &i_txtime, sizeof( i_txtime ) );
+        }
+# endif
+    }
+
+# ifdef HAVE_SENDMMSG
+    for( unsigned i = 0; i < i_count; )
+    {
+        int val = sendmmsg( p_sys->i_handle, p->msgv + i, i_count - i, 0 );
+        if( val == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+            msg_Warn( p_sys->p_access, "send error: %m" );
+            /* Skip the packet which failed */
+            val = 1;
+        }
+        i += val;
+    }
+# else
+    for( unsigned i = 0; i < i_count; i++ )
+        if( sendmsg( p_sys->i_handle, &p->msgv[i], 0 ) == -1 )
+            msg_Warn( p_sys->p_access, "send error: %m" );
+# endif
+#endif
 }
 
 /*****************************************************************************
- * ThreadWrite: Write a packet on the network at the good time.
+ * ThreadPacer: Write the packets of all outputs on the network at the good
+ * time.
  *****************************************************************************/
-static void* ThreadWrite( void *data )
+static void* ThreadPacer( void *data )
 {
-    sout_access_out_t *p_access = data;
-    sout_access_out_sys_t *p_sys = p_access->p_sys;
-    mtime_t i_date_last = -1;
-    const unsigned i_group = var_GetInteger( p_access,
-                                             SOUT_CFG_PREFIX "group" );
-    mtime_t i_to_send = i_group;
-    unsigned i_dropped_packets = 0;
+    udp_pacer_t *p = data;
 
+    vlc_mutex_lock( &p->lock );
+    mutex_cleanup_push( &p->lock );
     for (;;)
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
-        mtime_t       i_date, i_sent;
+        mtime_t i_wakeup = INT64_MAX;
 
-        i_date = p_sys->i_caching + p_pk->i_dts;
-        if( i_date_last > 0 )
+        for( int i = 0; i < p->i_outputs; i++ )
         {
-            if( i_date - i_date_last > 2000000 )
-            {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
-                             i_date - i_date_last );
-
-                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+            sout_access_out_sys_t *p_sys = p->pp_outputs[i];
 
-                i_date_last = i_date;
-                i_dropped_packets++;
-                continue;
-            }
-            else if( i_date - i_date_last < -1000 )
+            if( p_sys->p_queue != NULL )
             {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
-                             i_date_last - i_date );
+                mtime_t i_lead = p_sys->b_txtime ? PACER_TXTIME : PACER_WINDOW;
+                i_wakeup = __MIN( i_wakeup, p_sys->p_queue->i_dts - i_lead );
             }
         }
 
-        block_cleanup_push( p_pk );
-        i_to_send--;
-        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
+        if( i_wakeup == INT64_MAX )
         {
-            mwait( i_date );
-            i_to_send = i_group;
+            vlc_cond_wait( &p->wait, &p->lock );
+            continue;
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %m" );
-        vlc_cleanup_pop();
-
-        if( i_dropped_packets )
+        if( i_wakeup > mdate() )
         {
-            msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
-            i_dropped_packets = 0;
+            vlc_cond_timedwait( &p->wait, &p->lock, i_wakeup );
+            continue;
         }
 
-#if 1
-        i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
+        int canc = vlc_savecancel();
+        mtime_t now = mdate();
+
+        for( int i = 0; i < p->i_outputs; i++ )
         {
-            msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
-        }
-#endif
+            sout_access_out_sys_t *p_sys = p->pp_outputs[i];
+            mtime_t i_limit = now + ( p_sys->b_txtime ? PACER_TXTIME
+                                                      : PACER_WINDOW );
+            unsigned i_count = 0;
 
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
+            if( p_sys->p_queue == NULL || p_sys->p_queue->i_dts > i_limit )
+                continue;
+
+            /* Send what is due, and a group at least */
+            while( p_sys->p_queue != NULL && i_count < PACER_BURST
+                && ( i_count < p_sys->i_group
+                  || p_sys->p_queue->i_dts <= i_limit ) )
+            {
+                block_t *p_pk = p_sys->p_queue;
+
+                p_sys->p_queue = p_pk->p_next;
+                p_pk->p_next = NULL;
+                p->burst[i_count++] = p_pk;
+            }
+            if( p_sys->p_queue == NULL )
+                p_sys->pp_queue_last = &p_sys->p_queue;
+
+            /* Do not hold up the muxers while sending */
+            p->p_busy = p_sys;
+            vlc_mutex_unlock( &p->lock );
+
+            SendBurst( p, p_sys, i_count );
 
-        i_date_last = i_date;
+            mtime_t i_sent = mdate();
+            if( i_sent > p->burst[0]->i_dts + 20000 )
+            {
+                msg_Dbg( p_sys->p_access, "packet has been sent too late "
+                         "(%"PRId64 ")", i_sent - p->burst[0]->i_dts );
+            }
+
+            for( unsigned j = 0; j < i_count; j++ )
+                block_Release( p->burst[j] );
+
+            vlc_mutex_lock( &p->lock );
+            p->p_busy = NULL;
+            if( p_sys->p_queue == NULL )
+                vlc_cond_broadcast( &p->idle );
+
+            /* Other outputs may have been attached or detached meanwhile,
+             * but not this one (see PacerDetach): resume the scan after it */
+            int i_index;
+            TAB_FIND( p->i_outputs, p->pp_outputs, p_sys, i_index );
+            assert( i_index >= 0 );
+            i = i_index;
+        }
+        vlc_restorecancel( canc );
     }
+    vlc_cleanup_pop();
     return NULL;
 }
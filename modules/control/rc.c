@@ -1872,6 +1872,12 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
             p_item->p_stats->i_displayed_pictures );
     msg_rc(_("| frames lost      :    %5"PRIi64),
             p_item->p_stats->i_lost_pictures );
+    msg_rc(_("| packetizing time : %8"PRIi64" ms"),
+            p_item->p_stats->i_packetize_time / 1000 );
+    msg_rc(_("| decoding time    : %8"PRIi64" ms"),
+            p_item->p_stats->i_decode_time / 1000 );
+    msg_rc(_("| display time     : %8"PRIi64" ms"),
+            p_item->p_stats->i_display_time / 1000 );
     msg_rc("|");
     /* Audio*/
     msg_rc("%s", _("+-[Audio Decoding]"));
@@ -1891,6 +1897,19 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
     msg_rc(_("| sending bitrate  :   %6.0f kb/s"),
             (float)(p_item->p_stats->f_send_bitrate*8)*1000 );
     msg_rc("|");
+    /* Memory */
+    msg_rc("%s", _("+-[Memory (all inputs)]"));
+    msg_rc(_("| block pool hits  : %8"PRIi64),
+           p_item->p_stats->i_block_pool_hits );
+    msg_rc(_("| block pool misses: %8"PRIi64),
+           p_item->p_stats->i_block_pool_misses );
+    msg_rc(_("| picture pool gets: %8"PRIi64),
+           p_item->p_stats->i_picture_pool_gets );
+    msg_rc(_("| pool starvations : %8"PRIi64),
+           p_item->p_stats->i_picture_pool_starved );
+    msg_rc(_("| pool peak in use : %8"PRIi64),
+           p_item->p_stats->i_picture_pool_peak );
+    msg_rc("|");
     msg_rc( "+----[ end of statistical info ]" );
     vlc_mutex_unlock( &p_item->p_stats->lock );
     vlc_mutex_unlock( &p_item->lock );
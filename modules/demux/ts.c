@@ -43,6 +43,14 @@
 
 #include <vlc_network.h>   /* net_ for ts-out mode */
 #include <vlc_fs.h>        /* vlc_fopen for file-dump mode */
+#include <vlc_md5.h>       /* PCR index file name */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#   include <unistd.h>
+#endif
 
 #include "../mux/mpeg/csa.h"
 
@@ -143,6 +151,12 @@ static void Close ( vlc_object_t * );
     "Seek and position based on a percent byte position, not a PCR generated " \
     "time position. If seeking doesn't work property, turn on this option." )
 
+#define SEEK_INDEX_TEXT N_("Index PCR positions for seeking")
+#define SEEK_INDEX_LONGTEXT N_( \
+    "Read local files once in the background to index the position of " \
+    "the PCRs, and keep that index in the cache directory. Seeking then " \
+    "needs a single read instead of searching through the file." )
+
 
 vlc_module_begin ()
     set_description( N_("MPEG Transport Stream demuxer") )
@@ -172,6 +186,7 @@ vlc_module_begin ()
                  DUMPSIZE_LONGTEXT, true )
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_bool( "ts-seek-index", false, SEEK_INDEX_TEXT, SEEK_INDEX_LONGTEXT, true )
 
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
@@ -303,7 +318,8 @@ typedef struct
     int         i_pes_size;
     int         i_pes_gathered;
     block_t     *p_pes;
-    block_t     **pp_last;
+    size_t      i_pes_alloc;    /* room allocated in p_pes */
+    size_t      i_pes_last;     /* size of the previous PES */
 
     es_mpeg4_descriptor_t *p_mpeg4desc;
     int         b_gather;
@@ -333,6 +349,33 @@ typedef struct
 
 } ts_pid_t;
 
+typedef struct
+{
+    int64_t     i_pos;  /* position of a packet with the reference PCR */
+    mtime_t     i_pcr;  /* PCR, without wrap around */
+    bool        b_rap;  /* random access indicator set in that packet */
+} ts_index_entry_t;
+
+typedef struct
+{
+    vlc_mutex_t lock;
+    vlc_thread_t thread;
+    bool        b_thread;
+    bool        b_stop;
+    bool        b_complete;     /* the whole file is indexed */
+
+    int         i_entries;
+    int         i_alloc;
+    ts_index_entry_t *p_entries;
+
+    /* identity of the indexed file */
+    char        *psz_path;      /* index file */
+    uint64_t    i_size;
+    uint64_t    i_mtime;
+    int         i_packet_size;
+    int         i_pid;
+} ts_index_t;
+
 struct demux_sys_t
 {
     vlc_mutex_t     csa_lock;
@@ -343,6 +386,12 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     int         i_ts_read;
 
+    /* TS packets read ahead from the stream, and parsed in place */
+    uint8_t     *p_batch;
+    int         i_batch;        /* bytes in p_batch */
+    int         i_batch_pos;    /* first byte not parsed yet */
+    int         i_batch_read;   /* how many TS packets to read at once */
+
     /* to determine length and time */
     int         i_pid_ref_pcr;
     mtime_t     i_first_pcr;
@@ -352,6 +401,7 @@ struct demux_sys_t
     int         i_pcrs_num;
     mtime_t     *p_pcrs;
     int64_t     *p_pos;
+    ts_index_t  *p_index;       /* NULL if not indexing */
 
     /* All pid */
     ts_pid_t    pid[8192];
@@ -411,21 +461,26 @@ static void PSINewTableCallBack( demux_t *, dvbpsi_handle,
                                  uint8_t  i_table_id, uint16_t i_extension );
 static int ChangeKeyCallback( vlc_object_t *, char const *, vlc_value_t, vlc_value_t, void * );
 
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return ( (p[1]&0x1f)<<8 )|p[2];
 }
 
-static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
+static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, uint8_t *p );
 
-static block_t* ReadTSPacket( demux_t *p_demux );
-static mtime_t GetPCR( block_t *p_pkt );
+static uint8_t *ReadTSPacket( demux_t *p_demux );
+static int64_t TSTell( demux_t *p_demux );
+static int TSSeek( demux_t *p_demux, int64_t i_pos );
+static mtime_t GetPCR( const uint8_t *p );
 static int SeekToPCR( demux_t *p_demux, int64_t i_pos );
 static int Seek( demux_t *p_demux, double f_percent );
 static void GetFirstPCR( demux_t *p_demux );
 static void GetLastPCR( demux_t *p_demux );
 static void CheckPCR( demux_t *p_demux );
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void TSIndexOpen( demux_t *p_demux );
+static void TSIndexClose( demux_t *p_demux );
+static int TSIndexSeek( demux_t *p_demux, mtime_t i_target );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
 
 static iod_descriptor_t *IODNew( int , uint8_t * );
 static void              IODFree( iod_descriptor_t * );
@@ -442,6 +497,20 @@ static void SetPrgFilter( demux_t *, int i_prg, bool b_selected );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_TOPFIELD_HEADER 1320
 
+/* TS packets read at once from seekable streams */
+#define TS_READ_BATCH 128
+/* ... and from live streams, as much as a typical UDP/RTP datagram carries,
+ * so that reading ahead does not add latency */
+#define TS_READ_BATCH_LIVE 7
+
+/* PCR index */
+#define TS_INDEX_MAGIC "VLCTSIX1"
+#define TS_INDEX_HEADER 32
+#define TS_INDEX_ENTRY 16
+#define TS_INDEX_BATCH 1024         /* packets read at once */
+#define TS_INDEX_INTERVAL 45000     /* 500 ms in 90 kHz units */
+#define TS_INDEX_RAP_DISTANCE 180000 /* 2 s */
+
 static int DetectPacketSize( demux_t *p_demux )
 {
     const uint8_t *p_peek;
@@ -810,6 +879,12 @@ static int Open( vlc_object_t *p_this )
 
     bool can_seek = false;
     stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &can_seek );
+
+    p_sys->i_batch_read = can_seek ? TS_READ_BATCH : TS_READ_BATCH_LIVE;
+    p_sys->p_batch = xmalloc( p_sys->i_batch_read * p_sys->i_packet_size );
+    p_sys->i_batch = 0;
+    p_sys->i_batch_pos = 0;
+
     if( can_seek  )
     {
         GetFirstPCR( p_demux );
@@ -820,6 +895,10 @@ static int Open( vlc_object_t *p_this )
     {
         p_sys->b_force_seek_per_percent = true;
     }
+    p_sys->p_index = NULL;
+    if( can_seek && !p_sys->b_force_seek_per_percent &&
+        var_InheritBool( p_demux, "ts-seek-index" ) )
+        TSIndexOpen( p_demux );
 
     while( !p_sys->b_file_out && p_sys->i_pmt_es <= 0 &&
            vlc_object_alive( p_demux ) )
@@ -915,7 +994,10 @@ static void Close( vlc_object_t *p_this )
         net_Close( p_sys->fd );
     }
 
+    TSIndexClose( p_demux );
+
     free( p_sys->buffer );
+    free( p_sys->p_batch );
     free( p_sys->psz_file );
 
     free( p_sys->p_pcrs );
@@ -1061,7 +1143,7 @@ static int Demux( demux_t *p_demux )
     for( int i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
     {
         bool         b_frame = false;
-        block_t     *p_pkt;
+        uint8_t     *p_pkt;
         if( !(p_pkt = ReadTSPacket( p_demux )) )
         {
             return 0;
@@ -1077,7 +1159,7 @@ static int Demux( demux_t *p_demux )
         if( p_sys->b_udp_out )
         {
             memcpy( &p_sys->buffer[i_pkt * p_sys->i_packet_size],
-                    p_pkt->p_buffer, p_sys->i_packet_size );
+                    p_pkt, p_sys->i_packet_size );
         }
 
         /* Parse the TS packet */
@@ -1089,17 +1171,16 @@ static int Demux( demux_t *p_demux )
             {
                 if( p_pid->i_pid == 0 || ( p_sys->b_dvb_meta && ( p_pid->i_pid == 0x11 || p_pid->i_pid == 0x12 || p_pid->i_pid == 0x14 ) ) )
                 {
-                    dvbpsi_PushPacket( p_pid->psi->handle, p_pkt->p_buffer );
+                    dvbpsi_PushPacket( p_pid->psi->handle, p_pkt );
                 }
                 else
                 {
                     for( int i_prg = 0; i_prg < p_pid->psi->i_prg; i_prg++ )
                     {
                         dvbpsi_PushPacket( p_pid->psi->prg[i_prg]->handle,
-                                           p_pkt->p_buffer );
+                                           p_pkt );
                     }
                 }
-                block_Release( p_pkt );
             }
             else if( !p_sys->b_udp_out )
             {
@@ -1108,7 +1189,6 @@ static int Demux( demux_t *p_demux )
             else
             {
                 PCRHandle( p_demux, p_pid, p_pkt );
-                block_Release( p_pkt );
             }
         }
         else
@@ -1119,7 +1199,6 @@ static int Demux( demux_t *p_demux )
             }
             /* We have to handle PCR if present */
             PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
         }
         p_pid->b_seen = true;
 
@@ -1194,7 +1273,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             if( !DVBEventInformation( p_demux, &i_time, &i_length ) && i_length > 0 )
                 *pf = (double)i_time/(double)i_length;
             else if( (i64 = stream_Size( p_demux->s) ) > 0 )
-                *pf = (double)stream_Tell( p_demux->s ) / (double)i64;
+                *pf = (double)TSTell( p_demux ) / (double)i64;
             else
                 *pf = 0.0;
         }
@@ -1212,7 +1291,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             p_sys->i_last_pcr - p_sys->i_first_pcr <= 0 )
         {
             i64 = stream_Size( p_demux->s );
-            if( stream_Seek( p_demux->s, (int64_t)(i64 * f) ) )
+            if( TSSeek( p_demux, (int64_t)(i64 * f) ) )
                 return VLC_EGENERIC;
         }
         else
@@ -1573,7 +1652,8 @@ static void PIDInit( ts_pid_t *pid, bool b_psi, ts_psi_t *p_owner )
             pid->es->p_pes   = NULL;
             pid->es->i_pes_size= 0;
             pid->es->i_pes_gathered= 0;
-            pid->es->pp_last = &pid->es->p_pes;
+            pid->es->i_pes_alloc = 0;
+            pid->es->i_pes_last = 0;
             pid->es->p_mpeg4desc = NULL;
             pid->es->b_gather = false;
         }
@@ -1651,10 +1731,11 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid )
     mtime_t i_length = 0;
 
     /* remove the pes from pid */
+    pid->es->i_pes_last = p_pes->i_buffer;
     pid->es->p_pes = NULL;
     pid->es->i_pes_size= 0;
     pid->es->i_pes_gathered= 0;
-    pid->es->pp_last = &pid->es->p_pes;
+    pid->es->i_pes_alloc = 0;
 
     /* FIXME find real max size */
     /* const int i_max = */ block_ChainExtract( p_pes, header, 34 );
@@ -1852,63 +1933,106 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid )
     }
 }
 
-static block_t* ReadTSPacket( demux_t *p_demux )
+/* Refills the batch of packets, keeping the bytes not parsed yet in front.
+ * Returns false at the end of the stream. */
+static bool FillTSBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const int i_left = p_sys->i_batch - p_sys->i_batch_pos;
+
+    memmove( p_sys->p_batch, &p_sys->p_batch[p_sys->i_batch_pos], i_left );
+    p_sys->i_batch = i_left;
+    p_sys->i_batch_pos = 0;
+
+    /* The bytes left start on a sync byte, so this reads whole packets */
+    const int i_read = stream_Read( p_demux->s, &p_sys->p_batch[i_left],
+                  p_sys->i_batch_read * p_sys->i_packet_size - i_left );
+    if( i_read <= 0 )
+        return false;
+    p_sys->i_batch += i_read;
+    return true;
+}
+
+/* Returns the next TS packet, straight from the batch buffer. It remains
+ * valid (and can be modified in place) until the next read or seek. */
+static uint8_t *ReadTSPacket( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+    const int i_size = p_sys->i_packet_size;
 
-    block_t     *p_pkt;
+    uint8_t     *p_pkt;
 
     /* Get a new TS packet */
-    if( !( p_pkt = stream_Block( p_demux->s, p_sys->i_packet_size ) ) )
+    if( p_sys->i_batch - p_sys->i_batch_pos < i_size &&
+        ( !FillTSBatch( p_demux ) || p_sys->i_batch < i_size ) )
     {
         msg_Dbg( p_demux, "eof ?" );
         return NULL;
     }
 
     /* Check sync byte and re-sync if needed */
-    if( p_pkt->p_buffer[0] != 0x47 )
+    if( p_sys->p_batch[p_sys->i_batch_pos] != 0x47 )
     {
         msg_Warn( p_demux, "lost synchro" );
-        block_Release( p_pkt );
         while( vlc_object_alive (p_demux) )
         {
             const uint8_t *p_peek;
             int i_peek, i_skip = 0;
 
-            i_peek = stream_Peek( p_demux->s, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < p_sys->i_packet_size + 1 )
+            if( p_sys->i_batch - p_sys->i_batch_pos < i_size + 1 )
+                FillTSBatch( p_demux );
+            i_peek = p_sys->i_batch - p_sys->i_batch_pos;
+            if( i_peek < i_size + 1 )
             {
                 msg_Dbg( p_demux, "eof ?" );
                 return NULL;
             }
+            p_peek = &p_sys->p_batch[p_sys->i_batch_pos];
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
+            while( i_skip < i_peek - i_size )
             {
                 if( p_peek[i_skip] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_size] == 0x47 )
+                        p_peek[i_skip + i_size] == 0x47 )
                 {
                     break;
                 }
                 i_skip++;
             }
             msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            stream_Read( p_demux->s, NULL, i_skip );
+            p_sys->i_batch_pos += i_skip;
 
-            if( i_skip < i_peek - p_sys->i_packet_size )
+            if( i_skip < i_peek - i_size )
             {
                 break;
             }
         }
-        if( !( p_pkt = stream_Block( p_demux->s, p_sys->i_packet_size ) ) )
-        {
-            msg_Dbg( p_demux, "eof ?" );
-            return NULL;
-        }
     }
+
+    p_pkt = &p_sys->p_batch[p_sys->i_batch_pos];
+    p_sys->i_batch_pos += i_size;
     return p_pkt;
 }
 
+/* Stream position of the next packet to parse */
+static int64_t TSTell( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    return stream_Tell( p_demux->s ) - ( p_sys->i_batch - p_sys->i_batch_pos );
+}
+
+static int TSSeek( demux_t *p_demux, int64_t i_pos )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( stream_Seek( p_demux->s, i_pos ) )
+        return VLC_EGENERIC;
+    /* drop the packets read ahead */
+    p_sys->i_batch = 0;
+    p_sys->i_batch_pos = 0;
+    return VLC_SUCCESS;
+}
+
 static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
@@ -1917,7 +2041,7 @@ static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
      * So, need to add 0x1FFFFFFFF, for calculating duration or current position.
      */
     mtime_t i_adjust = 0;
-    int64_t i_pos = stream_Tell( p_demux->s );
+    int64_t i_pos = TSTell( p_demux );
     int i;
     for( i = 1; i < p_sys->i_pcrs_num && p_sys->p_pos[i] <= i_pos; ++i )
     {
@@ -1930,10 +2054,8 @@ static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
     return i_pcr + i_adjust;
 }
 
-static mtime_t GetPCR( block_t *p_pkt )
+static mtime_t GetPCR( const uint8_t *p )
 {
-    const uint8_t *p = p_pkt->p_buffer;
-
     mtime_t i_pcr = -1;
 
     if( ( p[3]&0x20 ) && /* adaptation */
@@ -1955,7 +2077,7 @@ static int SeekToPCR( demux_t *p_demux, int64_t i_pos )
     demux_sys_t *p_sys = p_demux->p_sys;
 
     mtime_t i_pcr = -1;
-    int64_t i_initial_pos = stream_Tell( p_demux->s );
+    int64_t i_initial_pos = TSTell( p_demux );
 
     if( i_pos < 0 )
         return VLC_EGENERIC;
@@ -1966,12 +2088,12 @@ static int SeekToPCR( demux_t *p_demux, int64_t i_pos )
         i_last_pos = stream_Size( p_demux->s ) - p_sys->i_packet_size;
     }
 
-    if( stream_Seek( p_demux->s, i_pos ) )
+    if( TSSeek( p_demux, i_pos ) )
         return VLC_EGENERIC;
 
     while( vlc_object_alive( p_demux ) )
     {
-        block_t     *p_pkt;
+        uint8_t     *p_pkt;
         if( !( p_pkt = ReadTSPacket( p_demux ) ) )
         {
             break;
@@ -1980,15 +2102,14 @@ static int SeekToPCR( demux_t *p_demux, int64_t i_pos )
         {
             i_pcr = GetPCR( p_pkt );
         }
-        block_Release( p_pkt );
         if( i_pcr >= 0 )
             break;
-        if( stream_Tell( p_demux->s ) >= i_last_pos )
+        if( TSTell( p_demux ) >= i_last_pos )
             break;
     }
     if( i_pcr < 0 )
     {
-        stream_Seek( p_demux->s, i_initial_pos );
+        TSSeek( p_demux, i_initial_pos );
         return VLC_EGENERIC;
     }
     else
@@ -2002,7 +2123,7 @@ static int Seek( demux_t *p_demux, double f_percent )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    int64_t i_initial_pos = stream_Tell( p_demux->s );
+    int64_t i_initial_pos = TSTell( p_demux );
     mtime_t i_initial_pcr = p_sys->i_current_pcr;
 
     /*
@@ -2010,6 +2131,9 @@ static int Seek( demux_t *p_demux, double f_percent )
      */
     mtime_t i_target_pcr = (p_sys->i_last_pcr - p_sys->i_first_pcr) * f_percent + p_sys->i_first_pcr;
 
+    if( TSIndexSeek( p_demux, i_target_pcr ) == VLC_SUCCESS )
+        return VLC_SUCCESS;
+
     int64_t i_head_pos = 0;
     int64_t i_tail_pos = stream_Size( p_demux->s );
     {
@@ -2055,7 +2179,7 @@ static int Seek( demux_t *p_demux, double f_percent )
     if( !b_found )
     {
         msg_Dbg( p_demux, "Seek():cannot find a time position. i_cnt:%d", i_cnt );
-        stream_Seek( p_demux->s, i_initial_pos );
+        TSSeek( p_demux, i_initial_pos );
         p_sys->i_current_pcr = i_initial_pcr;
         return VLC_EGENERIC;
     }
@@ -2070,14 +2194,14 @@ static void GetFirstPCR( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    int64_t i_initial_pos = stream_Tell( p_demux->s );
+    int64_t i_initial_pos = TSTell( p_demux );
 
-    if( stream_Seek( p_demux->s, 0 ) )
+    if( TSSeek( p_demux, 0 ) )
         return;
 
     while( vlc_object_alive (p_demux) )
     {
-        block_t     *p_pkt;
+        uint8_t     *p_pkt;
         if( !( p_pkt = ReadTSPacket( p_demux ) ) )
         {
             break;
@@ -2089,18 +2213,17 @@ static void GetFirstPCR( demux_t *p_demux )
             p_sys->i_first_pcr = i_pcr;
             p_sys->i_current_pcr = i_pcr;
         }
-        block_Release( p_pkt );
         if( p_sys->i_first_pcr >= 0 )
             break;
     }
-    stream_Seek( p_demux->s, i_initial_pos );
+    TSSeek( p_demux, i_initial_pos );
 }
 
 static void GetLastPCR( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    int64_t i_initial_pos = stream_Tell( p_demux->s );
+    int64_t i_initial_pos = TSTell( p_demux );
     mtime_t i_initial_pcr = p_sys->i_current_pcr;
 
     int64_t i_last_pos = stream_Size( p_demux->s ) - p_sys->i_packet_size;
@@ -2113,7 +2236,7 @@ static void GetLastPCR( demux_t *p_demux )
         if( SeekToPCR( p_demux, i_pos ) )
             break;
         p_sys->i_last_pcr = AdjustPCRWrapAround( p_demux, p_sys->i_current_pcr );
-        if( ( i_pos = stream_Tell( p_demux->s ) ) >= i_last_pos )
+        if( ( i_pos = TSTell( p_demux ) ) >= i_last_pos )
             break;
     }
     if( p_sys->i_last_pcr >= 0 )
@@ -2130,7 +2253,7 @@ static void GetLastPCR( demux_t *p_demux )
             p_sys->i_last_pcr = -1;
         }
     }
-    stream_Seek( p_demux->s, i_initial_pos );
+    TSSeek( p_demux, i_initial_pos );
     p_sys->i_current_pcr = i_initial_pcr;
 }
 
@@ -2138,7 +2261,7 @@ static void CheckPCR( demux_t *p_demux )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
-    int64_t i_initial_pos = stream_Tell( p_demux->s );
+    int64_t i_initial_pos = TSTell( p_demux );
     mtime_t i_initial_pcr = p_sys->i_current_pcr;
 
     int64_t i_size = stream_Size( p_demux->s );
@@ -2153,7 +2276,7 @@ static void CheckPCR( demux_t *p_demux )
         if( SeekToPCR( p_demux, i_pos ) )
             break;
         p_sys->p_pcrs[i] = p_sys->i_current_pcr;
-        p_sys->p_pos[i] = stream_Tell( p_demux->s );
+        p_sys->p_pos[i] = TSTell( p_demux );
         if( p_sys->p_pcrs[i-1] > p_sys->p_pcrs[i] )
         {
             msg_Dbg( p_demux, "PCR Wrap Around found between %d%% and %d%% (pcr:%lld(0x%09llx) pcr:%lld(0x%09llx))",
@@ -2166,18 +2289,357 @@ static void CheckPCR( demux_t *p_demux )
         p_sys->b_force_seek_per_percent = true;
     }
 
-    stream_Seek( p_demux->s, i_initial_pos );
+    TSSeek( p_demux, i_initial_pos );
     p_sys->i_current_pcr = i_initial_pcr;
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/*****************************************************************************
+ * PCR index: a background thread reads a local file once and records where
+ * the reference PCR is, so that seeking is a lookup instead of a bisection.
+ * The index is kept in the cache directory for the next time.
+ *****************************************************************************/
+static char *TSIndexPath( demux_t *p_demux )
+{
+    char *psz_cachedir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_path;
+    struct md5_s md5;
+
+    if( psz_cachedir == NULL )
+        return NULL;
+
+    InitMD5( &md5 );
+    AddMD5( &md5, p_demux->psz_file, strlen( p_demux->psz_file ) );
+    EndMD5( &md5 );
+    char *psz_hash = psz_md5_hash( &md5 );
+
+    vlc_mkdir( psz_cachedir, 0700 );
+    if( asprintf( &psz_path, "%s" DIR_SEP "tsindex", psz_cachedir ) != -1 )
+    {
+        vlc_mkdir( psz_path, 0700 );
+        free( psz_path );
+    }
+    if( psz_hash == NULL ||
+        asprintf( &psz_path, "%s" DIR_SEP "tsindex" DIR_SEP "%s",
+                  psz_cachedir, psz_hash ) == -1 )
+        psz_path = NULL;
+    free( psz_hash );
+    free( psz_cachedir );
+    return psz_path;
+}
+
+static void TSIndexAppend( ts_index_t *p_index,
+                           int64_t i_pos, mtime_t i_pcr, bool b_rap )
+{
+    vlc_mutex_lock( &p_index->lock );
+    if( p_index->i_entries >= p_index->i_alloc )
+    {
+        int i_alloc = __MAX( 2 * p_index->i_alloc, 1024 );
+        ts_index_entry_t *p_entries = realloc( p_index->p_entries,
+                                               i_alloc * sizeof(*p_entries) );
+        if( unlikely(p_entries == NULL) )
+        {
+            vlc_mutex_unlock( &p_index->lock );
+            return;
+        }
+        p_index->p_entries = p_entries;
+        p_index->i_alloc = i_alloc;
+    }
+    ts_index_entry_t *p_entry = &p_index->p_entries[p_index->i_entries++];
+    p_entry->i_pos = i_pos;
+    p_entry->i_pcr = i_pcr;
+    p_entry->b_rap = b_rap;
+    vlc_mutex_unlock( &p_index->lock );
+}
+
+static void TSIndexHeader( const ts_index_t *p_index, uint8_t *p_hdr,
+                           int i_entries )
+{
+    memcpy( p_hdr, TS_INDEX_MAGIC, 8 );
+    SetQWLE( &p_hdr[8], p_index->i_size );
+    SetQWLE( &p_hdr[16], p_index->i_mtime );
+    SetWLE( &p_hdr[24], p_index->i_packet_size );
+    SetWLE( &p_hdr[26], p_index->i_pid );
+    SetDWLE( &p_hdr[28], i_entries );
+}
+
+static bool TSIndexLoad( demux_t *p_demux, ts_index_t *p_index )
+{
+    FILE *p_file = vlc_fopen( p_index->psz_path, "rb" );
+    uint8_t hdr[TS_INDEX_HEADER], ref[TS_INDEX_HEADER];
+    bool b_ok = false;
+
+    if( p_file == NULL )
+        return false;
+
+    if( fread( hdr, 1, sizeof(hdr), p_file ) != sizeof(hdr) )
+        goto out;
+    /* The file must not have changed since it was indexed */
+    TSIndexHeader( p_index, ref, GetDWLE( &hdr[28] ) );
+    if( memcmp( hdr, ref, sizeof(hdr) ) )
+        goto out;
+
+    for( uint32_t i = 0; i < GetDWLE( &hdr[28] ); i++ )
+    {
+        uint8_t entry[TS_INDEX_ENTRY];
+
+        if( fread( entry, 1, sizeof(entry), p_file ) != sizeof(entry) )
+            goto out;
+        const uint64_t i_pcr = GetQWLE( &entry[8] );
+        TSIndexAppend( p_index, GetQWLE( entry ), i_pcr >> 1, i_pcr & 1 );
+    }
+    b_ok = true;
+    msg_Dbg( p_demux, "PCR index loaded (%d entries)", p_index->i_entries );
+out:
+    fclose( p_file );
+    if( !b_ok )
+        p_index->i_entries = 0;
+    return b_ok;
+}
+
+static void TSIndexSave( demux_t *p_demux, ts_index_t *p_index )
+{
+    char *psz_tmp;
+    uint8_t hdr[TS_INDEX_HEADER];
+
+    if( asprintf( &psz_tmp, "%s.part", p_index->psz_path ) == -1 )
+        return;
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( p_file == NULL )
+    {
+        msg_Warn( p_demux, "cannot create PCR index %s", psz_tmp );
+        free( psz_tmp );
+        return;
+    }
+
+    /* The thread is done: the entries do not change anymore */
+    TSIndexHeader( p_index, hdr, p_index->i_entries );
+    bool b_ok = fwrite( hdr, 1, sizeof(hdr), p_file ) == sizeof(hdr);
+    for( int i = 0; b_ok && i < p_index->i_entries; i++ )
+    {
+        const ts_index_entry_t *p_entry = &p_index->p_entries[i];
+        uint8_t entry[TS_INDEX_ENTRY];
+
+        SetQWLE( entry, p_entry->i_pos );
+        SetQWLE( &entry[8], ( p_entry->i_pcr << 1 ) | p_entry->b_rap );
+        b_ok = fwrite( entry, 1, sizeof(entry), p_file ) == sizeof(entry);
+    }
+    if( fclose( p_file ) )
+        b_ok = false;
+
+    if( b_ok && vlc_rename( psz_tmp, p_index->psz_path ) == 0 )
+        msg_Dbg( p_demux, "PCR index saved to %s", p_index->psz_path );
+    else
+        vlc_unlink( psz_tmp );
+    free( psz_tmp );
+}
+
+static void *TSIndexThread( void *data )
+{
+    demux_t *p_demux = data;
+    ts_index_t *p_index = p_demux->p_sys->p_index;
+    const int i_size = p_index->i_packet_size;
+    const int i_batch = TS_INDEX_BATCH * i_size;
+    uint8_t *p_buffer = malloc( i_batch );
+    int fd = vlc_open( p_demux->psz_file, O_RDONLY );
+    bool b_eof = false;
+
+    if( p_buffer == NULL || fd == -1 )
+        goto out;
+
+    int64_t i_pos = 0;  /* file position of p_buffer[0] */
+    int     i_buffer = 0, i_off = 0;
+    mtime_t i_last = -1, i_last_rap = -1, i_prev = -1, i_adjust = 0;
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &p_index->lock );
+        bool b_stop = p_index->b_stop;
+        vlc_mutex_unlock( &p_index->lock );
+        if( b_stop )
+            break;
+
+        /* keep the partial packet in front */
+        memmove( p_buffer, &p_buffer[i_off], i_buffer - i_off );
+        i_pos += i_off;
+        i_buffer -= i_off;
+        i_off = 0;
+
+        ssize_t i_read = read( fd, &p_buffer[i_buffer], i_batch - i_buffer );
+        if( i_read <= 0 )
+        {
+            if( i_read < 0 && errno == EINTR )
+                continue;
+            b_eof = i_read == 0;
+            break;
+        }
+        i_buffer += i_read;
+
+        while( i_off + i_size <= i_buffer )
+        {
+            const uint8_t *p = &p_buffer[i_off];
+
+            if( p[0] != 0x47 )
+            {   /* resynchronize */
+                i_off++;
+                continue;
+            }
+
+            mtime_t i_pcr;
+            if( PIDGet( p ) == p_index->i_pid && ( i_pcr = GetPCR( p ) ) >= 0 )
+            {
+                if( i_prev >= 0 && i_pcr < i_prev &&
+                    i_prev - i_pcr > INT64_C(0x100000000) )
+                    i_adjust += 0x1FFFFFFFF; /* same as AdjustPCRWrapAround */
+                i_prev = i_pcr;
+                i_pcr += i_adjust;
+
+                const bool b_rap = p[5]&0x40;
+                if( i_last < 0 || i_pcr - i_last >= TS_INDEX_INTERVAL ||
+                    ( b_rap && ( i_last_rap < 0 ||
+                                 i_pcr - i_last_rap >= TS_INDEX_INTERVAL ) ) )
+                {
+                    TSIndexAppend( p_index, i_pos + i_off, i_pcr, b_rap );
+                    i_last = i_pcr;
+                    if( b_rap )
+                        i_last_rap = i_pcr;
+                }
+            }
+            i_off += i_size;
+        }
+    }
+
+    if( b_eof )
+    {
+        vlc_mutex_lock( &p_index->lock );
+        p_index->b_complete = true;
+        vlc_mutex_unlock( &p_index->lock );
+
+        msg_Dbg( p_demux, "PCR index built (%d entries)", p_index->i_entries );
+        TSIndexSave( p_demux, p_index );
+    }
+out:
+    if( fd != -1 )
+        close( fd );
+    free( p_buffer );
+    return NULL;
+}
+
+static void TSIndexOpen( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    struct stat st;
+
+    if( p_demux->psz_file == NULL || vlc_stat( p_demux->psz_file, &st ) )
+        return;
+
+    ts_index_t *p_index = calloc( 1, sizeof(*p_index) );
+    if( unlikely(p_index == NULL) )
+        return;
+    p_index->psz_path = TSIndexPath( p_demux );
+    if( p_index->psz_path == NULL )
+    {
+        free( p_index );
+        return;
+    }
+    vlc_mutex_init( &p_index->lock );
+    p_index->i_size = st.st_size;
+    p_index->i_mtime = st.st_mtime;
+    p_index->i_packet_size = p_sys->i_packet_size;
+    p_index->i_pid = p_sys->i_pid_ref_pcr;
+    p_sys->p_index = p_index;
+
+    if( TSIndexLoad( p_demux, p_index ) )
+    {
+        p_index->b_complete = true;
+        return;
+    }
+
+    p_index->b_thread = !vlc_clone( &p_index->thread, TSIndexThread, p_demux,
+                                    VLC_THREAD_PRIORITY_LOW );
+}
+
+static void TSIndexClose( demux_t *p_demux )
+{
+    ts_index_t *p_index = p_demux->p_sys->p_index;
+
+    if( p_index == NULL )
+        return;
+
+    if( p_index->b_thread )
+    {
+        vlc_mutex_lock( &p_index->lock );
+        p_index->b_stop = true;
+        vlc_mutex_unlock( &p_index->lock );
+        vlc_join( p_index->thread, NULL );
+    }
+    vlc_mutex_destroy( &p_index->lock );
+    free( p_index->p_entries );
+    free( p_index->psz_path );
+    free( p_index );
+}
+
+/* Seeks to the indexed position closest before the given (unwrapped) PCR,
+ * preferably on a random access point. Fails if that part of the file is
+ * not indexed yet. */
+static int TSIndexSeek( demux_t *p_demux, mtime_t i_target )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_index_t *p_index = p_sys->p_index;
+
+    if( p_index == NULL )
+        return VLC_EGENERIC;
+
+    vlc_mutex_lock( &p_index->lock );
+    const ts_index_entry_t *p_entries = p_index->p_entries;
+    const int i_entries = p_index->i_entries;
+
+    if( i_entries == 0 ||
+        ( !p_index->b_complete && p_entries[i_entries-1].i_pcr < i_target ) )
+    {
+        vlc_mutex_unlock( &p_index->lock );
+        return VLC_EGENERIC;
+    }
+
+    /* last entry not after the target */
+    int i_low = 0, i_high = i_entries - 1;
+    while( i_low < i_high )
+    {
+        const int i_mid = ( i_low + i_high + 1 ) / 2;
+        if( p_entries[i_mid].i_pcr <= i_target )
+            i_low = i_mid;
+        else
+            i_high = i_mid - 1;
+    }
+    int i = i_low;
+    for( int j = i; j >= 0 &&
+         p_entries[j].i_pcr >= p_entries[i].i_pcr - TS_INDEX_RAP_DISTANCE; j-- )
+    {
+        if( p_entries[j].b_rap )
+        {
+            i = j;
+            break;
+        }
+    }
+    const int64_t i_pos = p_entries[i].i_pos;
+    const mtime_t i_pcr = p_entries[i].i_pcr;
+    vlc_mutex_unlock( &p_index->lock );
+
+    if( TSSeek( p_demux, i_pos ) )
+        return VLC_EGENERIC;
+    p_sys->i_current_pcr = i_pcr;
+    msg_Dbg( p_demux, "Seek():found position %"PRId64" in the PCR index", i_pos );
+    return VLC_SUCCESS;
+}
+
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
     if( p_sys->i_pmt_es <= 0 )
         return;
 
-    mtime_t i_pcr = GetPCR( p_bk );
+    mtime_t i_pcr = GetPCR( p );
     if( i_pcr >= 0 )
     {
         if( p_sys->i_pid_ref_pcr == pid->i_pid )
@@ -2201,9 +2663,52 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     }
 }
 
-static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/* Appends TS payload to the PES being gathered. The PES is gathered in a
+ * single block, sized after the announced PES length if any, or else after
+ * the previous PES, so that it seldom needs to be reallocated. */
+static bool PESAppend( ts_es_t *es, const uint8_t *p_data, size_t i_data )
+{
+    block_t *p_pes = es->p_pes;
+
+    if( p_pes == NULL || p_pes->i_buffer + i_data > es->i_pes_alloc )
+    {
+        size_t i_alloc;
+
+        if( p_pes != NULL )
+            i_alloc = 2 * es->i_pes_alloc;
+        else if( es->i_pes_size > 0 )
+            i_alloc = es->i_pes_size;
+        else
+            i_alloc = __MAX( es->i_pes_last + es->i_pes_last / 4, 4096 );
+        if( i_alloc < ( p_pes ? p_pes->i_buffer : 0 ) + i_data )
+            i_alloc = ( p_pes ? p_pes->i_buffer : 0 ) + i_data;
+
+        block_t *p_new = block_Alloc( i_alloc );
+        if( unlikely(p_new == NULL) )
+        {
+            if( p_pes )
+                p_pes->i_flags |= BLOCK_FLAG_CORRUPTED;
+            return false;
+        }
+        p_new->i_buffer = 0;
+        if( p_pes )
+        {
+            memcpy( p_new->p_buffer, p_pes->p_buffer, p_pes->i_buffer );
+            p_new->i_buffer = p_pes->i_buffer;
+            p_new->i_flags = p_pes->i_flags;
+            block_Release( p_pes );
+        }
+        es->p_pes = p_pes = p_new;
+        es->i_pes_alloc = i_alloc;
+    }
+
+    memcpy( &p_pes->p_buffer[p_pes->i_buffer], p_data, i_data );
+    p_pes->i_buffer += i_data;
+    return true;
+}
+
+static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, uint8_t *p )
 {
-    const uint8_t *p = p_bk->p_buffer;
     const bool b_unit_start = p[1]&0x40;
     const bool b_scrambled  = p[3]&0x80;
     const bool b_adaptation = p[3]&0x20;
@@ -2223,7 +2728,6 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
 
     /* For now, ignore additional error correction
      * TODO: handle Reed-Solomon 204,188 error correction */
-    p_bk->i_buffer = TS_PACKET_SIZE_188;
 
     if( p[1]&0x80 )
     {
@@ -2236,7 +2740,7 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     if( p_demux->p_sys->csa )
     {
         vlc_mutex_lock( &p_demux->p_sys->csa_lock );
-        csa_Decrypt( p_demux->p_sys->csa, p_bk->p_buffer, p_demux->p_sys->i_csa_pkt_size );
+        csa_Decrypt( p_demux->p_sys->csa, p, p_demux->p_sys->i_csa_pkt_size );
         vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
     }
 
@@ -2302,11 +2806,10 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
     }
 
-    PCRHandle( p_demux, pid, p_bk );
+    PCRHandle( p_demux, pid, p );
 
     if( i_skip >= 188 || pid->es->id == NULL || p_demux->p_sys->b_udp_out )
     {
-        block_Release( p_bk );
         return i_ret;
     }
 
@@ -2328,8 +2831,8 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     }
 
     /* We have to gather it */
-    p_bk->p_buffer += i_skip;
-    p_bk->i_buffer -= i_skip;
+    const uint8_t *p_payload = &p[i_skip];
+    const size_t i_payload = TS_PACKET_SIZE_188 - i_skip;
 
     if( b_unit_start )
     {
@@ -2339,16 +2842,16 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             i_ret = true;
         }
 
-        block_ChainLastAppend( &pid->es->pp_last, p_bk );
-        if( p_bk->i_buffer > 6 )
+        if( i_payload > 6 )
         {
-            pid->es->i_pes_size = GetWBE( &p_bk->p_buffer[4] );
+            pid->es->i_pes_size = GetWBE( &p_payload[4] );
             if( pid->es->i_pes_size > 0 )
             {
                 pid->es->i_pes_size += 6;
             }
         }
-        pid->es->i_pes_gathered += p_bk->i_buffer;
+        if( PESAppend( pid->es, p_payload, i_payload ) )
+            pid->es->i_pes_gathered += i_payload;
         if( pid->es->i_pes_size > 0 &&
             pid->es->i_pes_gathered >= pid->es->i_pes_size )
         {
@@ -2361,12 +2864,11 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         if( pid->es->p_pes == NULL )
         {
             /* msg_Dbg( p_demux, "broken packet" ); */
-            block_Release( p_bk );
         }
         else
         {
-            block_ChainLastAppend( &pid->es->pp_last, p_bk );
-            pid->es->i_pes_gathered += p_bk->i_buffer;
+            if( PESAppend( pid->es, p_payload, i_payload ) )
+                pid->es->i_pes_gathered += i_payload;
             if( pid->es->i_pes_size > 0 &&
                 pid->es->i_pes_gathered >= pid->es->i_pes_size )
             {
@@ -3606,7 +4108,8 @@ static void PMTSetupEsTeletext( demux_t *p_demux, ts_pid_t *pid,
                 p_es->p_pes   = NULL;
                 p_es->i_pes_size = 0;
                 p_es->i_pes_gathered = 0;
-                p_es->pp_last = &p_es->p_pes;
+                p_es->i_pes_alloc = 0;
+                p_es->i_pes_last = 0;
                 p_es->p_mpeg4desc = NULL;
                 p_es->b_gather = false;
 
@@ -3693,7 +4196,8 @@ static void PMTSetupEsDvbSubtitle( demux_t *p_demux, ts_pid_t *pid,
                 p_es->p_pes   = NULL;
                 p_es->i_pes_size = 0;
                 p_es->i_pes_gathered = 0;
-                p_es->pp_last = &p_es->p_pes;
+                p_es->i_pes_alloc = 0;
+                p_es->i_pes_last = 0;
                 p_es->p_mpeg4desc = NULL;
                 p_es->b_gather = false;
 
@@ -149,6 +149,7 @@ struct sout_mux_sys_t
     int             i_pk_used;
     int             i_pk_frame;
     mtime_t         i_pk_dts;
+    bool            b_pk_key;
 
     bool      b_asf_http;
     int             i_seq;
@@ -209,6 +210,7 @@ static int Open( vlc_object_t *p_this )
     }
     p_sys->pk = NULL;
     p_sys->i_pk_used    = 0;
+    p_sys->b_pk_key     = false;
     p_sys->i_pk_frame   = 0;
     p_sys->i_dts_first  =
     p_sys->i_dts_last   = VLC_TS_INVALID;
@@ -1160,6 +1162,10 @@ static block_t *asf_packet_flush( sout_mux_t *p_mux )
     pk = p_sys->pk;
     p_sys->pk = NULL;
 
+    /* A video key frame starts in this packet: readers may join here */
+    if( p_sys->b_pk_key )
+        pk->i_flags |= BLOCK_FLAG_TYPE_I;
+
     p_sys->i_packet_count++;
 
     return pk;
@@ -1188,8 +1194,13 @@ static block_t *asf_packet_create( sout_mux_t *p_mux,
             p_sys->i_pk_used = 14 + i_preheader;
             p_sys->i_pk_frame = 0;
             p_sys->i_pk_dts = data->i_dts;
+            p_sys->b_pk_key = false;
         }
 
+        if( i_pos == 0 && tk->i_cat == VIDEO_ES &&
+            (data->i_flags & BLOCK_FLAG_TYPE_I) )
+            p_sys->b_pk_key = true;
+
         bo_init( &bo, &p_sys->pk->p_buffer[p_sys->i_pk_used],
                  p_sys->i_packet_size - p_sys->i_pk_used );
 
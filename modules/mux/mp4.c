@@ -49,6 +49,13 @@
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
 
+#define FRAGMENT_TEXT N_("Fragment duration (ms)")
+#define FRAGMENT_LONGTEXT N_( \
+    "Create fragmented files, made of movie fragments of about this " \
+    "duration (0 disables). They are written progressively, so that memory " \
+    "use does not depend on the length of the recording and the file can " \
+    "be played while it is being written.")
+
 static int  Open   ( vlc_object_t * );
 static void Close  ( vlc_object_t * );
 
@@ -63,6 +70,9 @@ vlc_module_begin ()
     add_bool( SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true )
+    add_integer( SOUT_CFG_PREFIX "fragment", 0,
+                 FRAGMENT_TEXT, FRAGMENT_LONGTEXT, true )
+        change_integer_range( 0, 3600000 )
     set_capability( "sout mux", 5 )
     add_shortcut( "mp4", "mov", "3gp" )
     set_callbacks( Open, Close )
@@ -72,7 +82,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "fragment", NULL
 };
 
 static int Control( sout_mux_t *, int, va_list );
@@ -88,6 +98,7 @@ typedef struct
     uint64_t i_pos;
     int      i_size;
 
+    mtime_t  i_dts;
     mtime_t  i_pts_dts;
     mtime_t  i_length;
     unsigned int i_flags;
@@ -116,6 +127,12 @@ typedef struct
     /* for spu */
     int64_t i_last_dts;
 
+    /* fragmented files: samples of the current fragment */
+    block_t  *p_frag;
+    block_t  **pp_frag_last;
+    bool     b_decode_time;     /* i_dts_start is final */
+    int      i_trun_pos;
+
 } mp4_stream_t;
 
 struct sout_mux_sys_t
@@ -132,6 +149,13 @@ struct sout_mux_sys_t
 
     int          i_nb_streams;
     mp4_stream_t **pp_streams;
+
+    /* fragmented files */
+    bool     b_fragmented;
+    bool     b_header;          /* moov sent */
+    int64_t  i_frag_duration;
+    int64_t  i_frag_start;      /* dts of the current fragment */
+    uint32_t i_frag_seq;
 };
 
 typedef struct bo_t
@@ -169,6 +193,8 @@ static block_t *bo_to_sout( sout_instance_t *p_sout,  bo_t *box );
 
 static bo_t *GetMoovBox( sout_mux_t *p_mux );
 
+static void FragmentFlush( sout_mux_t *p_mux );
+
 static block_t *ConvertSUBT( block_t *);
 static block_t *ConvertAVC1( block_t * );
 
@@ -198,6 +224,11 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_mov        = p_mux->psz_mux && !strcmp( p_mux->psz_mux, "mov" );
     p_sys->b_3gp        = p_mux->psz_mux && !strcmp( p_mux->psz_mux, "3gp" );
     p_sys->i_dts_start  = 0;
+    p_sys->i_frag_duration = var_GetInteger( p_mux, SOUT_CFG_PREFIX "fragment" ) * 1000;
+    p_sys->b_fragmented = p_sys->i_frag_duration > 0;
+    p_sys->b_header     = false;
+    p_sys->i_frag_start = 0;
+    p_sys->i_frag_seq   = 0;
 
 
     if( !p_sys->b_mov )
@@ -211,6 +242,8 @@ static int Open( vlc_object_t *p_this )
         else bo_add_fourcc( box, "mp41" );
         bo_add_fourcc( box, "avc1" );
         bo_add_fourcc( box, "qt  " );
+        if( p_sys->b_fragmented )
+            bo_add_fourcc( box, "iso5" );
         box_fix( box );
 
         p_sys->i_pos += box->i_buffer;
@@ -223,6 +256,10 @@ static int Open( vlc_object_t *p_this )
      * Quicktime actually doesn't like the 64 bits extensions !!! */
     p_sys->b_64_ext = false;
 
+    /* Fragments carry their own mdat */
+    if( p_sys->b_fragmented )
+        return VLC_SUCCESS;
+
     /* Now add mdat header */
     box = box_new( "mdat" );
     bo_add_64be  ( box, 0 ); // enough to store an extended size
@@ -250,6 +287,17 @@ static void Close( vlc_object_t * p_this )
 
     msg_Dbg( p_mux, "Close" );
 
+    if( p_sys->b_fragmented )
+    {
+        if( !p_sys->b_header )
+        {
+            box_send( p_mux, GetMoovBox( p_mux ) );
+            p_sys->b_header = true;
+        }
+        FragmentFlush( p_mux );
+        goto cleanup;
+    }
+
     /* Update mdat size */
     bo_init( &bo, 0, NULL, true );
     if( p_sys->i_pos - p_sys->i_mdat_pos >= (((uint64_t)1)<<32) )
@@ -348,11 +396,13 @@ static void Close( vlc_object_t * p_this )
     sout_AccessOutSeek( p_mux->p_access, i_moov_pos );
     box_send( p_mux, moov );
 
+cleanup:
     /* Clean-up */
     for( i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
     {
         mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
 
+        block_ChainRelease( p_stream->p_frag );
         es_format_Clean( &p_stream->fmt );
         free( p_stream->entry );
         free( p_stream );
@@ -366,8 +416,9 @@ static void Close( vlc_object_t * p_this )
  *****************************************************************************/
 static int Control( sout_mux_t *p_mux, int i_query, va_list args )
 {
-    VLC_UNUSED(p_mux);
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
     bool *pb_bool;
+    char **ppsz;
 
     switch( i_query )
     {
@@ -381,7 +432,13 @@ static int Control( sout_mux_t *p_mux, int i_query, va_list args )
             *pb_bool = true;
             return VLC_SUCCESS;
 
-        case MUX_GET_MIME:   /* Not needed, as not streamable */
+        case MUX_GET_MIME:   /* Only fragmented files are streamable */
+            if( !p_sys->b_fragmented )
+                return VLC_EGENERIC;
+            ppsz = (char**)va_arg( args, char ** );
+            *ppsz = strdup( p_sys->b_3gp ? "video/3gpp" : "video/mp4" );
+            return VLC_SUCCESS;
+
         default:
             return VLC_EGENERIC;
     }
@@ -395,6 +452,12 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
     sout_mux_sys_t  *p_sys = p_mux->p_sys;
     mp4_stream_t    *p_stream;
 
+    if( p_sys->b_fragmented && p_sys->b_header )
+    {
+        msg_Err( p_mux, "cannot add a stream once the header is written" );
+        return VLC_EGENERIC;
+    }
+
     switch( p_input->p_fmt->i_codec )
     {
         case VLC_CODEC_MP4A:
@@ -433,6 +496,9 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
         calloc( p_stream->i_entry_max, sizeof( mp4_entry_t ) );
     p_stream->i_dts_start   = 0;
     p_stream->i_duration    = 0;
+    p_stream->p_frag        = NULL;
+    p_stream->pp_frag_last  = &p_stream->p_frag;
+    p_stream->b_decode_time = false;
 
     p_input->p_sys          = p_stream;
 
@@ -455,10 +521,35 @@ static int DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
 /*****************************************************************************
  * Mux:
  *****************************************************************************/
+static bool HasVideo( sout_mux_sys_t *p_sys )
+{
+    for( int i = 0; i < p_sys->i_nb_streams; i++ )
+        if( p_sys->pp_streams[i]->fmt.i_cat == VIDEO_ES )
+            return true;
+    return false;
+}
+
+/* Writes the sample, or keeps it for the current fragment */
+static void MuxWrite( sout_mux_t *p_mux, mp4_stream_t *p_stream, block_t *p_data )
+{
+    if( p_mux->p_sys->b_fragmented )
+        block_ChainLastAppend( &p_stream->pp_frag_last, p_data );
+    else
+        sout_AccessOutWrite( p_mux->p_access, p_data );
+}
+
 static int Mux( sout_mux_t *p_mux )
 {
     sout_mux_sys_t *p_sys = p_mux->p_sys;
 
+    /* The header lists the streams added so far, later ones are refused
+     * by AddStream(). Its sample tables are empty. */
+    if( p_sys->b_fragmented && !p_sys->b_header )
+    {
+        box_send( p_mux, GetMoovBox( p_mux ) );
+        p_sys->b_header = true;
+    }
+
     for( ;; )
     {
         sout_input_t    *p_input;
@@ -515,14 +606,29 @@ again:
             }
         }
 
+        /* Start a new fragment, on a video key frame if possible */
+        if( p_sys->b_fragmented && p_sys->i_frag_start > 0 )
+        {
+            const int64_t i_frag = p_data->i_dts - p_sys->i_frag_start;
+
+            if( i_frag >= 2 * p_sys->i_frag_duration ||
+                ( i_frag >= p_sys->i_frag_duration &&
+                  ( p_stream->fmt.i_cat != VIDEO_ES ?
+                    !HasVideo( p_sys ) : (p_data->i_flags & BLOCK_FLAG_TYPE_I) ) ) )
+                FragmentFlush( p_mux );
+        }
+        if( p_sys->b_fragmented && p_sys->i_frag_start <= 0 )
+            p_sys->i_frag_start = p_data->i_dts;
+
         /* Save starting time */
-        if( p_stream->i_entry_count == 0 )
+        if( p_stream->i_entry_count == 0 && !p_stream->b_decode_time )
         {
             p_stream->i_dts_start = p_data->i_dts;
 
-            /* Update global dts_start */
-            if( p_sys->i_dts_start <= 0 ||
-                p_stream->i_dts_start < p_sys->i_dts_start )
+            /* Update global dts_start, unless fragments were dated from it */
+            if( p_sys->i_frag_seq == 0 &&
+                ( p_sys->i_dts_start <= 0 ||
+                  p_stream->i_dts_start < p_sys->i_dts_start ) )
             {
                 p_sys->i_dts_start = p_stream->i_dts_start;
             }
@@ -549,6 +655,7 @@ again:
         /* add index entry */
         p_stream->entry[p_stream->i_entry_count].i_pos    = p_sys->i_pos;
         p_stream->entry[p_stream->i_entry_count].i_size   = p_data->i_buffer;
+        p_stream->entry[p_stream->i_entry_count].i_dts    = p_data->i_dts;
         p_stream->entry[p_stream->i_entry_count].i_pts_dts=
             __MAX( p_data->i_pts - p_data->i_dts, 0 );
         p_stream->entry[p_stream->i_entry_count].i_length = p_data->i_length;
@@ -571,7 +678,7 @@ again:
         p_stream->i_last_dts = p_data->i_dts;
 
         /* write data */
-        sout_AccessOutWrite( p_mux->p_access, p_data );
+        MuxWrite( p_mux, p_stream, p_data );
 
         if( p_stream->fmt.i_cat == SPU_ES )
         {
@@ -585,6 +692,8 @@ again:
                 /* Append a idx entry */
                 p_stream->entry[p_stream->i_entry_count].i_pos    = p_sys->i_pos;
                 p_stream->entry[p_stream->i_entry_count].i_size   = 3;
+                p_stream->entry[p_stream->i_entry_count].i_dts    =
+                    p_stream->i_last_dts + i_length;
                 p_stream->entry[p_stream->i_entry_count].i_pts_dts= 0;
                 p_stream->entry[p_stream->i_entry_count].i_length = 0;
                 p_stream->entry[p_stream->i_entry_count].i_flags  = 0;
@@ -603,7 +712,7 @@ again:
 
                 p_sys->i_pos += p_data->i_buffer;
 
-                sout_AccessOutWrite( p_mux->p_access, p_data );
+                MuxWrite( p_mux, p_stream, p_data );
             }
 
             /* Fix duration */
@@ -1659,6 +1768,10 @@ static bo_t *GetMoovBox( sout_mux_t *p_mux )
         box_gather( trak, tkhd );
 
         /* *** add /moov/trak/edts and elst */
+        /* The start of fragmented tracks is given by their tfdt */
+        if( p_sys->b_fragmented )
+            goto mdia;
+
         edts = box_new( "edts" );
         elst = box_full_new( "elst", p_sys->b_64_ext ? 1 : 0, 0 );
         if( p_stream->i_dts_start > p_sys->i_dts_start )
@@ -1704,6 +1817,7 @@ static bo_t *GetMoovBox( sout_mux_t *p_mux )
         box_fix( edts );
         box_gather( trak, edts );
 
+mdia:
         /* *** add /moov/trak/mdia *** */
         mdia = box_new( "mdia" );
 
@@ -1882,6 +1996,27 @@ static bo_t *GetMoovBox( sout_mux_t *p_mux )
         box_gather( moov, trak );
     }
 
+    /* *** add /moov/mvex *** */
+    if( p_sys->b_fragmented )
+    {
+        bo_t *mvex = box_new( "mvex" );
+
+        for( i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+        {
+            bo_t *trex = box_full_new( "trex", 0, 0 );
+
+            bo_add_32be( trex, p_sys->pp_streams[i_trak]->i_track_id );
+            bo_add_32be( trex, 1 );     // sample-description-index
+            bo_add_32be( trex, 0 );     // default-sample-duration
+            bo_add_32be( trex, 0 );     // default-sample-size
+            bo_add_32be( trex, 0 );     // default-sample-flags
+            box_fix( trex );
+            box_gather( mvex, trex );
+        }
+        box_fix( mvex );
+        box_gather( moov, mvex );
+    }
+
     /* Add user data tags */
     box_gather( moov, GetUdtaTag( p_mux ) );
 
@@ -1889,6 +2024,174 @@ static bo_t *GetMoovBox( sout_mux_t *p_mux )
     return moov;
 }
 
+/*****************************************************************************
+ * FragmentFlush: write the samples kept since the last fragment as a
+ * moof box followed by their mdat
+ *****************************************************************************/
+#define TRUN_DATA_OFFSET      0x000001
+#define TRUN_SAMPLE_DURATION  0x000100
+#define TRUN_SAMPLE_SIZE      0x000200
+#define TRUN_SAMPLE_FLAGS     0x000400
+#define TRUN_SAMPLE_CTS       0x000800
+
+#define TFHD_BASE_IS_MOOF     0x020000
+
+/* Decode time of a date, in the track timescale */
+static uint64_t FragmentTime( sout_mux_sys_t *p_sys, mtime_t i_dts,
+                              uint32_t i_timescale )
+{
+    if( i_dts <= p_sys->i_dts_start )
+        return 0;
+    return ( i_dts - p_sys->i_dts_start ) * i_timescale / INT64_C(1000000);
+}
+
+static void FragmentFlush( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    bo_t *moof, *mfhd;
+    bo_t bo;
+    uint32_t i_data = 0;
+    bool b_empty = true;
+
+    p_sys->i_frag_start = 0;
+
+    /* The decode times of all the fragments are counted from the earliest
+     * track start when the first one is written */
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+
+        if( p_stream->i_entry_count == 0 )
+            continue;
+        b_empty = false;
+        if( p_sys->i_frag_seq == 0 &&
+            ( p_sys->i_dts_start <= 0 || p_stream->i_dts_start < p_sys->i_dts_start ) )
+            p_sys->i_dts_start = p_stream->i_dts_start;
+    }
+    if( b_empty )
+        return;
+
+    moof = box_new( "moof" );
+
+    mfhd = box_full_new( "mfhd", 0, 0 );
+    bo_add_32be( mfhd, ++p_sys->i_frag_seq );   // sequence-number
+    box_fix( mfhd );
+    box_gather( moof, mfhd );
+
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        bo_t *traf, *tfhd, *tfdt, *trun;
+        uint32_t i_timescale;
+
+        if( p_stream->i_entry_count == 0 )
+            continue;
+
+        if( p_stream->fmt.i_cat == AUDIO_ES )
+            i_timescale = p_stream->fmt.audio.i_rate;
+        else
+            i_timescale = 1001;
+
+        p_stream->b_decode_time = true;
+
+        /* Sample durations are taken from the dates rather than the
+         * lengths, which are not known yet for the last empty subtitle.
+         * Quantizing the dates also keeps rounding errors from adding up. */
+        uint64_t i_start_q = FragmentTime( p_sys, p_stream->entry[0].i_dts,
+                                           i_timescale );
+
+        traf = box_new( "traf" );
+
+        tfhd = box_full_new( "tfhd", 0, TFHD_BASE_IS_MOOF );
+        bo_add_32be( tfhd, p_stream->i_track_id );
+        box_fix( tfhd );
+        box_gather( traf, tfhd );
+
+        tfdt = box_full_new( "tfdt", 1, 0 );
+        bo_add_64be( tfdt, i_start_q );                 // base-media-decode-time
+        box_fix( tfdt );
+        box_gather( traf, tfdt );
+
+        trun = box_full_new( "trun", 0, TRUN_DATA_OFFSET |
+                             TRUN_SAMPLE_DURATION | TRUN_SAMPLE_SIZE |
+                             TRUN_SAMPLE_FLAGS | TRUN_SAMPLE_CTS );
+        bo_add_32be( trun, p_stream->i_entry_count );   // sample-count
+        p_stream->i_trun_pos = moof->i_buffer + traf->i_buffer + trun->i_buffer;
+        bo_add_32be( trun, i_data );                    // data-offset (fixed later)
+
+        for( unsigned i = 0; i < p_stream->i_entry_count; i++ )
+        {
+            const mp4_entry_t *p_entry = &p_stream->entry[i];
+            uint64_t i_end_q;
+
+            if( i + 1 < p_stream->i_entry_count )
+                i_end_q = FragmentTime( p_sys, p_entry[1].i_dts, i_timescale );
+            else
+                i_end_q = FragmentTime( p_sys, p_entry->i_dts + p_entry->i_length,
+                                        i_timescale );
+            if( i_end_q < i_start_q )
+                i_end_q = i_start_q;
+
+            bo_add_32be( trun, i_end_q - i_start_q );
+            bo_add_32be( trun, p_entry->i_size );
+            if( p_stream->fmt.i_cat != VIDEO_ES ||
+                (p_entry->i_flags & BLOCK_FLAG_TYPE_I) )
+                bo_add_32be( trun, 0x02000000 );    // depends on nothing
+            else
+                bo_add_32be( trun, 0x01010000 );    // depends on others, non-sync
+            bo_add_32be( trun, p_entry->i_pts_dts * i_timescale / INT64_C(1000000) );
+
+            i_start_q = i_end_q;
+            i_data += p_entry->i_size;
+        }
+        box_fix( trun );
+        box_gather( traf, trun );
+
+        box_fix( traf );
+        box_gather( moof, traf );
+    }
+    box_fix( moof );
+
+    /* Point each track run to its samples in the mdat */
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+
+        if( p_stream->i_entry_count > 0 )
+        {
+            uint32_t i_offset = GetDWBE( &moof->p_buffer[p_stream->i_trun_pos] );
+            bo_fix_32be( moof, p_stream->i_trun_pos,
+                         moof->i_buffer + 8 + i_offset );
+        }
+    }
+
+    box_send( p_mux, moof );
+
+    bo_init( &bo, 0, NULL, true );
+    bo_add_32be  ( &bo, 8 + i_data );
+    bo_add_fourcc( &bo, "mdat" );
+    sout_AccessOutWrite( p_mux->p_access, bo_to_sout( p_mux->p_sout, &bo ) );
+    free( bo.p_buffer );
+
+    for( int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++ )
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+        block_t *p_data = p_stream->p_frag;
+
+        while( p_data )
+        {
+            block_t *p_next = p_data->p_next;
+
+            p_data->p_next = NULL;
+            sout_AccessOutWrite( p_mux->p_access, p_data );
+            p_data = p_next;
+        }
+        p_stream->p_frag = NULL;
+        p_stream->pp_frag_last = &p_stream->p_frag;
+        p_stream->i_entry_count = 0;
+    }
+}
+
 /****************************************************************************/
 
 static void bo_init( bo_t *p_bo, int i_size, uint8_t *p_buffer,
@@ -139,6 +139,7 @@ typedef struct
     int     i_num_frames; /* Theora only */
     uint64_t u_last_granulepos; /* Used for correct EOS page */
     int64_t i_num_keyframes;
+    bool    b_keyframe_page; /* next page starts with a key frame */
     ogg_stream_state os;
 
     oggds_header_t *p_oggds_header;
@@ -1037,6 +1038,23 @@ static int MuxBlock( sout_mux_t *p_mux, sout_input_t *p_input )
     else
         return VLC_EGENERIC;
 
+    if( p_stream->i_cat == VIDEO_ES &&
+        (p_data->i_flags & BLOCK_FLAG_TYPE_I) )
+    {
+        /* Start key frames on a fresh page, so that a reader joining the
+         * stream (e.g. a late HTTP client) can begin decoding there */
+        p_og = OggStreamFlush( p_mux, &p_stream->os, 0 );
+        if( p_og )
+        {
+            OggSetDate( p_og, p_stream->i_dts, p_stream->i_length );
+            p_stream->i_dts = -1;
+            p_stream->i_length = 0;
+
+            sout_AccessOutWrite( p_mux->p_access, p_og );
+        }
+        p_stream->b_keyframe_page = true;
+    }
+
     p_stream->u_last_granulepos = op.granulepos;
     ogg_stream_packetin( &p_stream->os, &op );
 
@@ -1062,6 +1080,11 @@ static int MuxBlock( sout_mux_t *p_mux, sout_input_t *p_input )
         p_stream->i_dts = -1;
         p_stream->i_length = 0;
 
+        if( p_stream->b_keyframe_page )
+        {
+            p_og->i_flags |= BLOCK_FLAG_TYPE_I;
+            p_stream->b_keyframe_page = false;
+        }
         sout_AccessOutWrite( p_mux->p_access, p_og );
     }
     else
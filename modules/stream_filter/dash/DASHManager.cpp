@@ -35,8 +35,11 @@ using namespace dash::mpd;
 using namespace dash::exception;
 
 DASHManager::DASHManager    ( HTTPConnectionManager *conManager, MPD *mpd,
-                              IAdaptationLogic::LogicType type ) :
+                              IAdaptationLogic::LogicType type,
+                              size_t prefetchChunks, time_t prefetchSeconds,
+                              unsigned prefetchThreads ) :
     conManager( conManager ),
+    prefetcher( NULL ),
     currentChunk( NULL ),
     adaptationLogic( NULL ),
     logicType( type ),
@@ -49,16 +52,33 @@ DASHManager::DASHManager    ( HTTPConnectionManager *conManager, MPD *mpd,
     this->adaptationLogic   = AdaptationLogicFactory::create( this->logicType, this->mpdManager );
     if ( this->adaptationLogic == NULL )
         return ;
+
+    if ( prefetchChunks > 0 )
+    {
+        this->prefetcher = new ChunkPrefetcher( this->conManager->getStream(),
+                                                this->adaptationLogic, prefetchChunks,
+                                                prefetchSeconds, prefetchThreads );
+        this->prefetcher->attach( this->adaptationLogic );
+        if ( this->prefetcher->start() )
+            return ;
+        delete this->prefetcher;
+        this->prefetcher = NULL;
+    }
     this->conManager->attach(this->adaptationLogic);
 }
 DASHManager::~DASHManager   ()
 {
+    /* the download threads use the adaptation logic */
+    delete this->prefetcher;
     delete this->adaptationLogic;
     delete this->mpdManager;
 }
 
 int     DASHManager::read( void *p_buffer, size_t len )
 {
+    if ( this->prefetcher != NULL )
+        return this->prefetcher->read( p_buffer, len );
+
     if ( this->currentChunk == NULL )
     {
         try
@@ -84,6 +104,9 @@ int     DASHManager::read( void *p_buffer, size_t len )
 
 int     DASHManager::peek( const uint8_t **pp_peek, size_t i_peek )
 {
+    if ( this->prefetcher != NULL )
+        return this->prefetcher->peek( pp_peek, i_peek );
+
     if ( this->currentChunk == NULL )
     {
         try
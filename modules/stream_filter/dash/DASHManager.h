@@ -26,6 +26,7 @@
 #define DASHMANAGER_H_
 
 #include "http/HTTPConnectionManager.h"
+#include "http/ChunkPrefetcher.h"
 #include "xml/Node.h"
 #include "adaptationlogic/IAdaptationLogic.h"
 #include "adaptationlogic/AdaptationLogicFactory.h"
@@ -40,7 +41,9 @@ namespace dash
     {
         public:
             DASHManager( http::HTTPConnectionManager *conManager, mpd::MPD *mpd,
-                         logic::IAdaptationLogic::LogicType type );
+                         logic::IAdaptationLogic::LogicType type,
+                         size_t prefetchChunks = 0, time_t prefetchSeconds = 0,
+                         unsigned prefetchThreads = 1 );
             virtual ~DASHManager    ();
 
             int read( void *p_buffer, size_t len );
@@ -50,6 +53,7 @@ namespace dash
 
         private:
             http::HTTPConnectionManager         *conManager;
+            http::ChunkPrefetcher               *prefetcher;
             http::Chunk                         *currentChunk;
             logic::IAdaptationLogic             *adaptationLogic;
             logic::IAdaptationLogic::LogicType  logicType;
@@ -36,6 +36,7 @@ AbstractAdaptationLogic::AbstractAdaptationLogic    (IMPDManager *mpdManager)
 {
     this->bpsAvg        = -1;
     this->bpsLastChunk  = 0;
+    this->bufferLevel   = 0;
     this->mpdManager    = mpdManager;
 }
 AbstractAdaptationLogic::~AbstractAdaptationLogic   ()
@@ -47,6 +48,10 @@ void AbstractAdaptationLogic::downloadRateChanged    (long bpsAvg, long bpsLastC
     this->bpsAvg        = bpsAvg;
     this->bpsLastChunk  = bpsLastChunk;
 }
+void AbstractAdaptationLogic::bufferLevelChanged     (double seconds)
+{
+    this->bufferLevel   = seconds;
+}
 long AbstractAdaptationLogic::getBpsAvg              ()
 {
     return this->bpsAvg;
@@ -55,3 +60,7 @@ long AbstractAdaptationLogic::getBpsLastChunk        ()
 {
     return this->bpsLastChunk;
 }
+double AbstractAdaptationLogic::getBufferLevel       ()
+{
+    return this->bufferLevel;
+}
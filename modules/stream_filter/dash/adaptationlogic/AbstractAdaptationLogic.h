@@ -46,13 +46,16 @@ namespace dash
                 virtual ~AbstractAdaptationLogic    ();
 
                 virtual void                downloadRateChanged     (long bpsAvg, long bpsLastChunk);
+                virtual void                bufferLevelChanged      (double seconds);
 
                 long                        getBpsAvg               ();
                 long                        getBpsLastChunk         ();
+                double                      getBufferLevel          ();
 
             private:
                 int                     bpsAvg;
                 long                    bpsLastChunk;
+                double                  bufferLevel;
                 dash::mpd::IMPDManager  *mpdManager;
         };
     }
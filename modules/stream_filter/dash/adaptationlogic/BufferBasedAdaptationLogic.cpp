@@ -0,0 +1,114 @@
+/*****************************************************************************
+ * BufferBasedAdaptationLogic.cpp: buffer occupancy aware adaptation logic
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedAdaptationLogic.h"
+
+#include <algorithm>
+
+using namespace dash::logic;
+using namespace dash::http;
+using namespace dash::mpd;
+using namespace dash::exception;
+
+static bool compareBandwidth( const Representation *a, const Representation *b )
+{
+    return a->getBandwidth() < b->getBandwidth();
+}
+
+BufferBasedAdaptationLogic::BufferBasedAdaptationLogic  (IMPDManager *mpdManager) :
+    AbstractAdaptationLogic( mpdManager ),
+    mpdManager( mpdManager ),
+    count( 0 ),
+    currentPeriod( mpdManager->getFirstPeriod() ),
+    lastRate( 0 ),
+    lastBits( 0 )
+{
+    this->initRepresentations();
+}
+
+void    BufferBasedAdaptationLogic::initRepresentations ()
+{
+    this->representations.clear();
+    if ( this->currentPeriod == NULL )
+        return;
+
+    const std::vector<Group *> &groups = this->currentPeriod->getGroups();
+    for ( size_t i = 0; i < groups.size(); i++ )
+    {
+        std::vector<Representation *> reps = groups.at( i )->getRepresentations();
+        this->representations.insert( this->representations.end(), reps.begin(), reps.end() );
+    }
+    std::stable_sort( this->representations.begin(), this->representations.end(),
+                      compareBandwidth );
+
+    std::vector<long> bitrates;
+    for ( size_t i = 0; i < this->representations.size(); i++ )
+        bitrates.push_back( this->representations.at( i )->getBandwidth() );
+    this->selector.setBitrates( bitrates );
+}
+void    BufferBasedAdaptationLogic::downloadRateChanged (long bpsAvg, long bpsLastChunk)
+{
+    AbstractAdaptationLogic::downloadRateChanged( bpsAvg, bpsLastChunk );
+    this->lastRate = bpsLastChunk > 0 ? bpsLastChunk : bpsAvg;
+}
+
+Chunk*  BufferBasedAdaptationLogic::getNextChunk() throw(EOFException)
+{
+    if ( this->mpdManager == NULL || this->currentPeriod == NULL )
+        throw EOFException();
+
+    if ( this->representations.empty() )
+        throw EOFException();
+
+    /* One throughput sample per chunk, weighted by its download time */
+    if ( this->lastRate > 0 && this->lastBits > 0 )
+        this->selector.addThroughputSample( this->lastRate, this->lastBits / this->lastRate );
+    this->lastRate = 0;
+
+    this->selector.setBufferLevel( this->getBufferLevel() );
+    Representation *rep = this->representations.at( this->selector.select() );
+
+    std::vector<Segment *> segments = this->mpdManager->getSegments( rep );
+
+    if ( this->count >= segments.size() )
+    {
+        this->currentPeriod = this->mpdManager->getNextPeriod( this->currentPeriod );
+        this->count = 0;
+        this->initRepresentations();
+        return this->getNextChunk();
+    }
+
+    Segment *seg = segments.at( this->count );
+    Chunk *chunk = new Chunk;
+    chunk->setUrl( seg->getSourceUrl() );
+    if ( rep->getSegmentInfo() != NULL )
+        chunk->setDuration( rep->getSegmentInfo()->getDuration() );
+    this->lastBits = (double)rep->getBandwidth() *
+                     ( chunk->getDuration() > 0 ? chunk->getDuration() : 1 );
+    //In case of UrlTemplate, we must stay on the same segment.
+    if ( seg->isSingleShot() == true )
+        this->count++;
+    seg->done();
+    return chunk;
+}
@@ -0,0 +1,56 @@
+/*****************************************************************************
+ * BufferBasedAdaptationLogic.h: buffer occupancy aware adaptation logic
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef BUFFERBASEDADAPTATIONLOGIC_H_
+#define BUFFERBASEDADAPTATIONLOGIC_H_
+
+#include "adaptationlogic/AbstractAdaptationLogic.h"
+#include "adaptationlogic/BufferBasedRateSelector.h"
+#include "mpd/IMPDManager.h"
+#include "http/Chunk.h"
+#include "exceptions/EOFException.h"
+
+namespace dash
+{
+    namespace logic
+    {
+        class BufferBasedAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                BufferBasedAdaptationLogic          (dash::mpd::IMPDManager *mpdManager);
+
+                dash::http::Chunk*      getNextChunk() throw(dash::exception::EOFException);
+                virtual void            downloadRateChanged     (long bpsAvg, long bpsLastChunk);
+
+            private:
+                dash::mpd::IMPDManager                  *mpdManager;
+                size_t                                  count;
+                dash::mpd::Period                       *currentPeriod;
+                std::vector<dash::mpd::Representation *> representations;
+                BufferBasedRateSelector                 selector;
+                long                                    lastRate;
+                double                                  lastBits;
+
+                void                    initRepresentations     ();
+        };
+    }
+}
+
+#endif /* BUFFERBASEDADAPTATIONLOGIC_H_ */
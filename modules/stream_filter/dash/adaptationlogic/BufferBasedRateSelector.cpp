@@ -0,0 +1,172 @@
+/*****************************************************************************
+ * BufferBasedRateSelector.cpp: buffer and throughput based bitrate selection
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedRateSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace dash::logic;
+
+/* Only pick levels below this share of the measured throughput */
+const double BufferBasedRateSelector::safetyFactor  = 0.9;
+/* Relative score gain required to leave the current level */
+const double BufferBasedRateSelector::switchPenalty = 0.1;
+
+/* Half-lives of the throughput averages, in seconds of download */
+#define FAST_HALF_LIFE 3.
+#define SLOW_HALF_LIFE 8.
+
+BufferBasedRateSelector::BufferBasedRateSelector    (double minBuffer, double maxBuffer)
+{
+    this->minBuffer     = minBuffer > 1 ? minBuffer : 1;
+    this->maxBuffer     = maxBuffer > this->minBuffer + 1 ? maxBuffer : this->minBuffer + 1;
+    this->gp            = 0;
+    this->vp            = 0;
+    this->bufferLevel   = 0;
+    this->fastAvg       = 0;
+    this->fastWeight    = 0;
+    this->slowAvg       = 0;
+    this->slowWeight    = 0;
+    this->current       = 0;
+}
+
+void    BufferBasedRateSelector::setBitrates            (const std::vector<long>& bitrates)
+{
+    this->bitrates = bitrates;
+    std::sort(this->bitrates.begin(), this->bitrates.end());
+    this->utilities.clear();
+    this->current = 0;
+
+    if(this->bitrates.empty())
+        return;
+
+    /* BOLA utilities, with the lowest level at 1 */
+    for(size_t i = 0; i < this->bitrates.size(); i++)
+        this->utilities.push_back(log((double)std::max(this->bitrates.at(i), 1L) /
+                                      std::max(this->bitrates.front(), 1L)) + 1);
+
+    /* Scale so that the lowest level is chosen up to minBuffer, and the
+     * highest from maxBuffer */
+    this->gp = (this->utilities.back() - 1) / (this->maxBuffer / this->minBuffer - 1);
+    this->vp = this->gp > 0 ? this->minBuffer / this->gp : 0;
+}
+void    BufferBasedRateSelector::addThroughputSample    (long bps, double seconds)
+{
+    if(bps <= 0 || seconds <= 0)
+        return;
+
+    /* Weight by the download time, so that the many short downloads of a
+     * fast period do not hide the few long ones of a slow period */
+    double fast = pow(0.5, seconds / FAST_HALF_LIFE);
+    double slow = pow(0.5, seconds / SLOW_HALF_LIFE);
+
+    this->fastAvg       = fast * this->fastAvg + (1 - fast) * bps;
+    this->fastWeight    = fast * this->fastWeight + (1 - fast);
+    this->slowAvg       = slow * this->slowAvg + (1 - slow) * bps;
+    this->slowWeight    = slow * this->slowWeight + (1 - slow);
+}
+void    BufferBasedRateSelector::setBufferLevel         (double seconds)
+{
+    this->bufferLevel = seconds > 0 ? seconds : 0;
+}
+long    BufferBasedRateSelector::getThroughput          () const
+{
+    if(this->fastWeight <= 0 || this->slowWeight <= 0)
+        return 0;
+
+    /* Zero-bias corrected, and pessimistic: react fast to drops, slowly to
+     * increases */
+    return (long)std::min(this->fastAvg / this->fastWeight,
+                          this->slowAvg / this->slowWeight);
+}
+size_t  BufferBasedRateSelector::getCurrent             () const
+{
+    return this->current;
+}
+double  BufferBasedRateSelector::score                  (size_t level) const
+{
+    return (this->vp * (this->utilities.at(level) + this->gp) - this->bufferLevel) /
+           std::max(this->bitrates.at(level), 1L);
+}
+size_t  BufferBasedRateSelector::select                 ()
+{
+    if(this->bitrates.size() <= 1)
+        return 0;
+
+    /* While the buffer is low, a throughput drop would stall playback
+     * before the average notices it: be more careful */
+    double  safety      = this->safetyFactor;
+    if(this->bufferLevel < this->minBuffer)
+        safety *= this->bufferLevel / this->minBuffer;
+
+    long    throughput  = this->getThroughput();
+    size_t  sustainable = 0;
+
+    while(sustainable + 1 < this->bitrates.size() &&
+          this->bitrates.at(sustainable + 1) <= safety * throughput)
+        sustainable++;
+
+    size_t choice;
+
+    if(this->bufferLevel < this->minBuffer)
+    {
+        /* Filling up: follow the throughput, never above it */
+        choice = std::min(sustainable, this->current + 1);
+    }
+    else
+    {
+        choice = 0;
+        for(size_t i = 1; i < this->bitrates.size(); i++)
+            if(this->score(i) > this->score(choice))
+                choice = i;
+
+        if(choice != this->current)
+        {
+            double best = this->score(choice);
+            double cur  = this->score(this->current);
+
+            if(best - cur < this->switchPenalty * fabs(cur))
+                choice = this->current;
+        }
+
+        if(choice < this->current)
+        {
+            /* The buffer level alone is not a reason to go down while the
+             * network still sustains the current level */
+            choice = std::max(choice, std::min(this->current, sustainable));
+        }
+        else if(choice > this->current)
+        {
+            /* Do not go above what the network sustains unless the buffer
+             * is full enough to absorb it */
+            size_t limit = this->bufferLevel >= this->maxBuffer ? choice :
+                           std::max(this->current, sustainable);
+            choice = std::min(std::min(choice, limit), this->current + 1);
+        }
+    }
+
+    this->current = choice;
+    return choice;
+}
@@ -0,0 +1,78 @@
+/*****************************************************************************
+ * BufferBasedRateSelector.h: buffer and throughput based bitrate selection
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef BUFFERBASEDRATESELECTOR_H_
+#define BUFFERBASEDRATESELECTOR_H_
+
+#include <vector>
+#include <cstddef>
+
+namespace dash
+{
+    namespace logic
+    {
+        /*
+         * Chooses a level in a bitrate ladder from the buffer occupancy
+         * (BOLA utility scores) while the buffer is healthy, and from the
+         * smoothed throughput while it is filling. Up switches are limited
+         * to one level at a time, to what the throughput sustains, and must
+         * beat the current level by a margin; down switches need both the
+         * buffer and the throughput to agree. This way, short bandwidth
+         * variations do not make the quality oscillate.
+         *
+         * This has no dependency on the rest of the module, so that it can
+         * be exercised offline against bandwidth traces.
+         */
+        class BufferBasedRateSelector
+        {
+            public:
+                BufferBasedRateSelector             (double minBuffer = 10, double maxBuffer = 30);
+
+                void                setBitrates         (const std::vector<long>& bitrates);
+                void                addThroughputSample (long bps, double seconds);
+                void                setBufferLevel      (double seconds);
+                size_t              select              ();
+
+                long                getThroughput       () const;
+                size_t              getCurrent          () const;
+
+                static const double safetyFactor;
+                static const double switchPenalty;
+
+            private:
+                std::vector<long>   bitrates;   /* ascending */
+                std::vector<double> utilities;
+                double              minBuffer;
+                double              maxBuffer;
+                double              gp;
+                double              vp;
+                double              bufferLevel;
+                double              fastAvg;
+                double              fastWeight;
+                double              slowAvg;
+                double              slowWeight;
+                size_t              current;
+
+                double              score               (size_t level) const;
+        };
+    }
+}
+
+#endif /* BUFFERBASEDRATESELECTOR_H_ */
@@ -42,10 +42,13 @@ namespace dash
                     Default,
                     AlwaysBest,
                     AlwaysLowest,
-                    RateBased
+                    RateBased,
+                    BufferBased
                 };
 
                 virtual dash::http::Chunk*  getNextChunk() throw(dash::exception::EOFException) = 0;
+                /* Duration of the media downloaded but not read yet, in seconds */
+                virtual void                bufferLevelChanged(double seconds) = 0;
 
         };
     }
@@ -70,6 +70,8 @@ Chunk*  RateBasedAdaptationLogic::getNextChunk() throw(EOFException)
         Segment *seg = segments.at( this->count );
         Chunk *chunk = new Chunk;
         chunk->setUrl( seg->getSourceUrl() );
+        if ( rep->getSegmentInfo() != NULL )
+            chunk->setDuration( rep->getSegmentInfo()->getDuration() );
         //In case of UrlTemplate, we must stay on the same segment.
         if ( seg->isSingleShot() == true )
             this->count++;
@@ -48,12 +48,45 @@
 static int  Open    (vlc_object_t *);
 static void Close   (vlc_object_t *);
 
+#define LOGIC_TEXT N_("Adaptation logic")
+#define LOGIC_LONGTEXT N_("How the representation of each segment is chosen. " \
+    "The buffer based logic needs segment prefetching, the download rate " \
+    "is used instead when prefetching is disabled.")
+
+static const int pi_logic[] = { dash::logic::IAdaptationLogic::RateBased,
+                                dash::logic::IAdaptationLogic::BufferBased,
+                                dash::logic::IAdaptationLogic::AlwaysBest };
+static const char *const ppsz_logic[] = { N_("Download rate"),
+                                          N_("Buffer level and download rate"),
+                                          N_("Always the best") };
+
+#define PREFETCH_TEXT N_("Segments to prefetch")
+#define PREFETCH_LONGTEXT N_("Number of segments downloaded ahead of " \
+    "playback. With 0, each segment is downloaded when the demuxer reaches it.")
+#define PREFETCH_DURATION_TEXT N_("Prefetch duration (s)")
+#define PREFETCH_DURATION_LONGTEXT N_("Maximum duration of the media " \
+    "downloaded ahead of playback, in seconds. 0 means no limit.")
+#define PREFETCH_THREADS_TEXT N_("Prefetch threads")
+#define PREFETCH_THREADS_LONGTEXT N_("Number of segments downloaded " \
+    "in parallel.")
+
 vlc_module_begin ()
         set_shortname( N_("DASH"))
         set_description( N_("Dynamic Adaptive Streaming over HTTP") )
         set_capability( "stream_filter", 19 )
         set_category( CAT_INPUT )
         set_subcategory( SUBCAT_INPUT_STREAM_FILTER )
+        add_integer( "dash-logic", dash::logic::IAdaptationLogic::RateBased,
+                     LOGIC_TEXT, LOGIC_LONGTEXT, false )
+            change_integer_list( pi_logic, ppsz_logic )
+        add_integer( "dash-prefetch", 3, PREFETCH_TEXT, PREFETCH_LONGTEXT, true )
+            change_integer_range( 0, 32 )
+        add_integer( "dash-prefetch-duration", 30, PREFETCH_DURATION_TEXT,
+                     PREFETCH_DURATION_LONGTEXT, true )
+            change_integer_range( 0, 3600 )
+        add_integer( "dash-prefetch-threads", 2, PREFETCH_THREADS_TEXT,
+                     PREFETCH_THREADS_LONGTEXT, true )
+            change_integer_range( 1, 8 )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -105,9 +138,24 @@ static int Open(vlc_object_t *p_obj)
     p_sys->p_mpd = mpdParser.getMPD();
     dash::http::HTTPConnectionManager *p_conManager =
                               new dash::http::HTTPConnectionManager( p_stream );
+    dash::logic::IAdaptationLogic::LogicType logic =
+            (dash::logic::IAdaptationLogic::LogicType)
+            var_InheritInteger( p_obj, "dash-logic" );
+    int i_prefetch = var_InheritInteger( p_obj, "dash-prefetch" );
+
+    /* The buffer level is only known from the prefetcher */
+    if ( logic == dash::logic::IAdaptationLogic::BufferBased && i_prefetch <= 0 )
+    {
+        msg_Warn( p_obj, "buffer based adaptation needs segment prefetching, "
+                  "using the download rate instead" );
+        logic = dash::logic::IAdaptationLogic::RateBased;
+    }
+
     dash::DASHManager*p_dashManager =
-            new dash::DASHManager( p_conManager, p_sys->p_mpd,
-                                   dash::logic::IAdaptationLogic::RateBased );
+            new dash::DASHManager( p_conManager, p_sys->p_mpd, logic,
+                                   i_prefetch,
+                                   var_InheritInteger( p_obj, "dash-prefetch-duration" ),
+                                   var_InheritInteger( p_obj, "dash-prefetch-threads" ) );
 
     if ( p_dashManager->getMpdManager() == NULL ||
          p_dashManager->getMpdManager()->getMPD() == NULL ||
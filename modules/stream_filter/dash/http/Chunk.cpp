@@ -30,10 +30,15 @@
 using namespace dash::http;
 
 Chunk::Chunk() : startByte( 0 ),
-    endByte( 0 )
+    endByte( 0 ),
+    duration( 0 )
 {
 }
 
+time_t      Chunk::getDuration  () const
+{
+    return duration;
+}
 int         Chunk::getEndByte   () const
 {
     return endByte;
@@ -47,6 +52,10 @@ const std::string& Chunk::getUrl       () const
 {
     return url;
 }
+void        Chunk::setDuration  (time_t duration)
+{
+    this->duration = duration;
+}
 void        Chunk::setEndByte   (int endByte)
 {
     this->endByte = endByte;
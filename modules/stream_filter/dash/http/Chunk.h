@@ -27,6 +27,7 @@
 
 #include <vector>
 #include <string>
+#include <ctime>
 
 namespace dash
 {
@@ -37,9 +38,11 @@ namespace dash
             public:
                 Chunk           ();
 
+                time_t              getDuration     () const;
                 int                 getEndByte      () const;
                 int                 getStartByte    () const;
                 const std::string&  getUrl          () const;
+                void                setDuration     (time_t duration);
                 void                setEndByte      (int endByte);
                 void                setStartByte    (int startByte);
                 void                setUrl          (const std::string& url);
@@ -49,6 +52,7 @@ namespace dash
                 std::vector<std::string>    optionalUrls;
                 int                         startByte;
                 int                         endByte;
+                time_t                      duration;
 
         };
     }
@@ -0,0 +1,427 @@
+/*****************************************************************************
+ * ChunkPrefetcher.cpp: download the next chunks ahead of the demuxer
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "ChunkPrefetcher.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace dash::http;
+using namespace dash::logic;
+using namespace dash::exception;
+
+#define PREFETCH_READ_SIZE 32768
+
+ChunkPrefetcher::ChunkPrefetcher    (stream_t *stream, IAdaptationLogic *logic,
+                                     size_t maxChunks, time_t maxSeconds, unsigned threads)
+{
+    this->stream            = stream;
+    this->logic             = logic;
+    this->maxChunks         = maxChunks > 0 ? maxChunks : 1;
+    this->maxSeconds        = maxSeconds;
+    this->threadCount       = threads > 0 ? threads : 1;
+    this->eof               = false;
+    this->bpsAvg            = 0;
+    this->bytesReadSession  = 0;
+    this->timeSecSession    = 0;
+    this->chunkCount        = 0;
+
+    vlc_mutex_init(&this->lock);
+    vlc_cond_init(&this->dataWait);
+    vlc_cond_init(&this->spaceWait);
+}
+ChunkPrefetcher::~ChunkPrefetcher   ()
+{
+    for(size_t i = 0; i < this->workers.size(); i++)
+        vlc_cancel(this->workers.at(i)->thread);
+
+    for(size_t i = 0; i < this->workers.size(); i++)
+    {
+        PrefetchWorker *worker = this->workers.at(i);
+
+        vlc_join(worker->thread, NULL);
+        if(worker->con != NULL)
+        {
+            worker->con->closeSocket();
+            delete(worker->con);
+        }
+        free(worker->buffer);
+        delete(worker);
+    }
+    this->workers.clear();
+
+    while(!this->slots.empty())
+    {
+        this->releaseSlot(this->slots.front());
+        this->slots.pop_front();
+    }
+
+    vlc_cond_destroy(&this->spaceWait);
+    vlc_cond_destroy(&this->dataWait);
+    vlc_mutex_destroy(&this->lock);
+}
+
+bool                ChunkPrefetcher::start          ()
+{
+    for(unsigned i = 0; i < this->threadCount; i++)
+    {
+        PrefetchWorker *worker = new PrefetchWorker;
+
+        worker->prefetcher  = this;
+        worker->con         = NULL;
+        worker->buffer      = (uint8_t *)malloc(PREFETCH_READ_SIZE);
+
+        if(worker->buffer == NULL ||
+           vlc_clone(&worker->thread, downloadThread, worker, VLC_THREAD_PRIORITY_INPUT))
+        {
+            free(worker->buffer);
+            delete(worker);
+            break;
+        }
+        this->workers.push_back(worker);
+    }
+    return !this->workers.empty();
+}
+void                ChunkPrefetcher::attach         (IDownloadRateObserver *observer)
+{
+    vlc_mutex_lock(&this->lock);
+    this->rateObservers.push_back(observer);
+    vlc_mutex_unlock(&this->lock);
+}
+
+int                 ChunkPrefetcher::read           (void *p_buffer, size_t len)
+{
+    uint8_t *p      = (uint8_t *)p_buffer;
+    size_t  done    = 0;
+
+    vlc_mutex_lock(&this->lock);
+    while(done < len)
+    {
+        PrefetchSlot *slot = this->waitHead(1);
+        if(slot == NULL)
+            break;
+
+        if(slot->size == 0)
+        {
+            if(slot->failed)
+            {
+                /* Return what was read first, the error on the next call */
+                if(done > 0)
+                    break;
+                msg_Err(this->stream, "chunk %s is incomplete",
+                        slot->chunk->getUrl().c_str());
+                this->slots.pop_front();
+                this->releaseSlot(slot);
+                vlc_cond_signal(&this->spaceWait);
+                vlc_mutex_unlock(&this->lock);
+                return -1;
+            }
+
+            /* This chunk is over, move on to the next one */
+            this->slots.pop_front();
+            this->releaseSlot(slot);
+            vlc_cond_signal(&this->spaceWait);
+            continue;
+        }
+
+        block_t *block  = slot->data;
+        size_t  copy    = __MIN(len - done, block->i_buffer);
+
+        memcpy(p + done, block->p_buffer, copy);
+        block->p_buffer += copy;
+        block->i_buffer -= copy;
+        slot->size      -= copy;
+        done            += copy;
+
+        if(block->i_buffer == 0)
+        {
+            slot->data = block->p_next;
+            if(slot->data == NULL)
+                slot->last = &slot->data;
+            block_Release(block);
+        }
+    }
+    vlc_mutex_unlock(&this->lock);
+    return done;
+}
+int                 ChunkPrefetcher::peek           (const uint8_t **pp_peek, size_t i_peek)
+{
+    vlc_mutex_lock(&this->lock);
+    PrefetchSlot *slot = this->waitHead(i_peek);
+
+    if(slot == NULL || slot->size == 0)
+    {
+        vlc_mutex_unlock(&this->lock);
+        return 0;
+    }
+
+    if(slot->data->p_next != NULL && slot->data->i_buffer < i_peek)
+    {
+        block_t *block = block_ChainGather(slot->data);
+        if(block == NULL)
+        {
+            slot->data  = NULL;
+            slot->last  = &slot->data;
+            slot->size  = 0;
+            vlc_mutex_unlock(&this->lock);
+            return -1;
+        }
+        slot->data  = block;
+        slot->last  = &block->p_next;
+    }
+
+    /* Only this thread removes data, and the download threads only append
+     * blocks to the chain, so the first block remains valid unlocked. */
+    *pp_peek = slot->data->p_buffer;
+    int ret = __MIN(slot->data->i_buffer, i_peek);
+    vlc_mutex_unlock(&this->lock);
+    return ret;
+}
+
+/* Waits until the first chunk holds len bytes, or is complete.
+ * Returns NULL once all chunks have been consumed. */
+PrefetchSlot*       ChunkPrefetcher::waitHead       (size_t len)
+{
+    for(;;)
+    {
+        if(!this->slots.empty())
+        {
+            PrefetchSlot *slot = this->slots.front();
+            if(slot->size >= len || slot->done)
+                return slot;
+        }
+        else if(this->eof)
+            return NULL;
+
+        vlc_cond_wait(&this->dataWait, &this->lock);
+    }
+}
+bool                ChunkPrefetcher::isFull         () const
+{
+    if(this->slots.size() >= this->maxChunks)
+        return true;
+
+    if(this->maxSeconds <= 0 || this->slots.empty())
+        return false;
+
+    time_t duration = 0;
+    for(size_t i = 0; i < this->slots.size(); i++)
+        duration += this->slots.at(i)->chunk->getDuration();
+
+    return duration >= this->maxSeconds;
+}
+/* Duration of the downloaded media which has not been read yet */
+double              ChunkPrefetcher::bufferLevel    () const
+{
+    double level = 0;
+
+    for(size_t i = 0; i < this->slots.size(); i++)
+    {
+        const PrefetchSlot *slot = this->slots.at(i);
+
+        if(slot->done && slot->total > 0)
+            level += (double)slot->chunk->getDuration() * slot->size / slot->total;
+    }
+    return level;
+}
+void                ChunkPrefetcher::releaseSlot    (PrefetchSlot *slot)
+{
+    block_ChainRelease(slot->data);
+    delete(slot->chunk);
+    delete(slot);
+}
+
+void*               ChunkPrefetcher::downloadThread (void *data)
+{
+    PrefetchWorker *worker = (PrefetchWorker *)data;
+
+    worker->prefetcher->download(worker);
+    return NULL;
+}
+/* Reserves a slot for the next chunk once there is room in the buffer */
+PrefetchSlot*       ChunkPrefetcher::nextSlot       ()
+{
+    PrefetchSlot *slot = NULL;
+
+    vlc_mutex_lock(&this->lock);
+    mutex_cleanup_push(&this->lock);
+    while(!this->eof && this->isFull())
+        vlc_cond_wait(&this->spaceWait, &this->lock);
+
+    if(!this->eof)
+    {
+        int canc = vlc_savecancel();
+        Chunk *chunk;
+
+        try
+        {
+            this->logic->bufferLevelChanged(this->bufferLevel());
+            chunk = this->logic->getNextChunk();
+        }
+        catch(EOFException &e)
+        {
+            chunk = NULL;
+        }
+        vlc_restorecancel(canc);
+
+        if(chunk != NULL)
+        {
+            slot = new PrefetchSlot;
+            slot->chunk     = chunk;
+            slot->data      = NULL;
+            slot->last      = &slot->data;
+            slot->size      = 0;
+            slot->total     = 0;
+            slot->done      = false;
+            slot->failed    = false;
+            this->slots.push_back(slot);
+            this->chunkCount++;
+        }
+        else
+        {
+            this->eof = true;
+            vlc_cond_broadcast(&this->spaceWait);
+            vlc_cond_broadcast(&this->dataWait);
+        }
+    }
+    vlc_cleanup_run();
+    return slot;
+}
+static void         deleteConnection                (void *data)
+{
+    HTTPConnection *con = (HTTPConnection *)data;
+
+    con->closeSocket();
+    delete(con);
+}
+bool                ChunkPrefetcher::connect        (PrefetchWorker *worker, const std::string& url)
+{
+    if(worker->con != NULL)
+    {
+        if(worker->con->isSameHost(url) && worker->con->reuse(url))
+            return true;
+
+        worker->con->closeSocket();
+        delete(worker->con);
+        worker->con = NULL;
+    }
+
+    HTTPConnection *con = new HTTPConnection(url, this->stream);
+    bool ok;
+
+    /* init() blocks in the network functions, which are cancellation points */
+    vlc_cleanup_push(deleteConnection, con);
+    ok = con->init();
+    vlc_cleanup_pop();
+
+    if(!ok)
+    {
+        con->closeSocket();
+        delete(con);
+        return false;
+    }
+    worker->con = con;
+    return true;
+}
+void                ChunkPrefetcher::download       (PrefetchWorker *worker)
+{
+    PrefetchSlot *slot;
+
+    while((slot = this->nextSlot()) != NULL)
+    {
+        bool    ok          = this->connect(worker, slot->chunk->getUrl());
+        long    bytesChunk  = 0;
+        mtime_t timeChunk   = 0;
+
+        while(ok)
+        {
+            mtime_t start   = mdate();
+            int     ret     = worker->con->read(worker->buffer, PREFETCH_READ_SIZE);
+            mtime_t time    = mdate() - start;
+
+            if(ret <= 0)
+                break;
+
+            bytesChunk  += ret;
+            timeChunk   += time;
+            this->append(slot, worker->buffer, ret, time,
+                         timeChunk > 0 ? (long)(bytesChunk * INT64_C(8000000) / timeChunk) : 0);
+        }
+
+        if(!ok)
+            msg_Warn(this->stream, "cannot download %s", slot->chunk->getUrl().c_str());
+        else if(!worker->con->isComplete())
+        {
+            msg_Warn(this->stream, "download of %s was interrupted", slot->chunk->getUrl().c_str());
+            ok = false;
+        }
+
+        vlc_mutex_lock(&this->lock);
+        slot->done      = true;
+        slot->failed    = !ok;
+        vlc_cond_broadcast(&this->dataWait);
+        vlc_mutex_unlock(&this->lock);
+
+        if(worker->con != NULL && !worker->con->isReusable())
+        {
+            worker->con->closeSocket();
+            delete(worker->con);
+            worker->con = NULL;
+        }
+    }
+}
+void                ChunkPrefetcher::append         (PrefetchSlot *slot, const uint8_t *p, size_t len,
+                                                     mtime_t time, long bpsChunk)
+{
+    block_t *block = block_Alloc(len);
+    if(block != NULL)
+        memcpy(block->p_buffer, p, len);
+
+    vlc_mutex_lock(&this->lock);
+    if(block != NULL)
+    {
+        *slot->last = block;
+        slot->last  = &block->p_next;
+        slot->size += len;
+        slot->total += len;
+        vlc_cond_broadcast(&this->dataWait);
+    }
+
+    this->bytesReadSession  += len;
+    this->timeSecSession    += ((double)time) / 1000000;
+
+    if(this->timeSecSession > 0)
+        this->bpsAvg = (this->bytesReadSession / this->timeSecSession) * 8;
+
+    if(this->bpsAvg < 0 || this->chunkCount < 2)
+        this->bpsAvg = 0;
+
+    if(this->chunkCount < 2)
+        bpsChunk = 0;
+
+    if(this->bpsAvg > 0)
+        for(size_t i = 0; i < this->rateObservers.size(); i++)
+            this->rateObservers.at(i)->downloadRateChanged(this->bpsAvg, bpsChunk);
+    vlc_mutex_unlock(&this->lock);
+}
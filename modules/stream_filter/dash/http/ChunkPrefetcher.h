@@ -0,0 +1,105 @@
+/*****************************************************************************
+ * ChunkPrefetcher.h: download the next chunks ahead of the demuxer
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef CHUNKPREFETCHER_H_
+#define CHUNKPREFETCHER_H_
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include <vlc_block.h>
+
+#include <deque>
+#include <vector>
+
+#include "http/Chunk.h"
+#include "http/HTTPConnection.h"
+#include "adaptationlogic/IAdaptationLogic.h"
+#include "adaptationlogic/IDownloadRateObserver.h"
+
+namespace dash
+{
+    namespace http
+    {
+        /* A chunk being downloaded, or waiting to be read */
+        struct PrefetchSlot
+        {
+            Chunk       *chunk;
+            block_t     *data;
+            block_t     **last;
+            size_t      size;
+            size_t      total;
+            bool        done;
+            bool        failed;
+        };
+
+        /* Per download thread state, released once the thread is joined */
+        struct PrefetchWorker
+        {
+            class ChunkPrefetcher   *prefetcher;
+            vlc_thread_t            thread;
+            HTTPConnection          *con;
+            uint8_t                 *buffer;
+        };
+
+        class ChunkPrefetcher
+        {
+            public:
+                ChunkPrefetcher             (stream_t *stream, dash::logic::IAdaptationLogic *logic,
+                                             size_t maxChunks, time_t maxSeconds, unsigned threads);
+                virtual ~ChunkPrefetcher    ();
+
+                bool                start   ();
+                int                 read    (void *p_buffer, size_t len);
+                int                 peek    (const uint8_t **pp_peek, size_t i_peek);
+                void                attach  (dash::logic::IDownloadRateObserver *observer);
+
+            private:
+                stream_t                                            *stream;
+                dash::logic::IAdaptationLogic                       *logic;
+                std::deque<PrefetchSlot *>                          slots;
+                std::vector<PrefetchWorker *>                       workers;
+                std::vector<dash::logic::IDownloadRateObserver *>   rateObservers;
+                size_t                                              maxChunks;
+                time_t                                              maxSeconds;
+                unsigned                                            threadCount;
+                bool                                                eof;
+                vlc_mutex_t                                         lock;
+                vlc_cond_t                                          dataWait;
+                vlc_cond_t                                          spaceWait;
+                long                                                bpsAvg;
+                long                                                bytesReadSession;
+                double                                              timeSecSession;
+                int                                                 chunkCount;
+
+                static void*        downloadThread  (void *data);
+                void                download        (PrefetchWorker *worker);
+                PrefetchSlot*       nextSlot        ();
+                bool                isFull          () const;
+                double              bufferLevel     () const;
+                bool                connect         (PrefetchWorker *worker, const std::string& url);
+                void                append          (PrefetchSlot *slot, const uint8_t *p, size_t len,
+                                                     mtime_t time, long bpsChunk);
+                PrefetchSlot*       waitHead        (size_t len);
+                void                releaseSlot     (PrefetchSlot *slot);
+        };
+    }
+}
+
+#endif /* CHUNKPREFETCHER_H_ */
@@ -27,49 +27,128 @@
 
 #include "HTTPConnection.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
 using namespace dash::http;
 
+/* Splits a plain http:// URL. Other schemes are left to the access modules. */
+static bool splitURL( const std::string& url, std::string& hostname, int& port,
+                      std::string& path )
+{
+    if( url.compare( 0, 7, "http://" ) )
+        return false;
+
+    vlc_url_t parsed;
+    vlc_UrlParse( &parsed, url.c_str(), 0 );
+    bool ret = parsed.psz_host != NULL && *parsed.psz_host != '\0';
+    if( ret )
+    {
+        hostname = parsed.psz_host;
+        port     = parsed.i_port > 0 ? parsed.i_port : 80;
+        path     = parsed.psz_path != NULL ? parsed.psz_path : "/";
+    }
+    vlc_UrlClean( &parsed );
+    return ret;
+}
+
 HTTPConnection::HTTPConnection  (const std::string& url, stream_t *stream)
 {
-    this->url       = url;
-    this->stream    = stream;
+    this->url           = url;
+    this->stream        = stream;
+    this->httpSocket    = -1;
+    this->port          = 80;
+    this->urlStream     = NULL;
+    this->keepAlive     = false;
+    this->chunked       = false;
+    this->bodyDone      = true;
+    this->bodyLost      = false;
+    this->bodyLeft      = -1;
+    this->peekBuffer    = NULL;
+    this->peekSize      = 0;
 }
 
 HTTPConnection::~HTTPConnection ()
 {
-
+    free(this->peekBuffer);
 }
 
 int             HTTPConnection::read            (void *p_buffer, size_t len)
 {
-    int size = stream_Read(this->urlStream, p_buffer, len);
+    if(this->urlStream != NULL)
+    {
+        int size = stream_Read(this->urlStream, p_buffer, len);
 
-    if(size <= 0)
-        return 0;
+        if(size <= 0)
+            return 0;
 
-    return size;
+        return size;
+    }
+
+    uint8_t *p = (uint8_t *)p_buffer;
+    size_t  done = 0;
+
+    if(this->peekSize > 0)
+    {
+        done = __MIN(len, this->peekSize);
+        memcpy(p, this->peekBuffer, done);
+        this->peekSize -= done;
+        memmove(this->peekBuffer, this->peekBuffer + done, this->peekSize);
+    }
+
+    while(done < len)
+    {
+        int size = this->readBody(p + done, len - done);
+        if(size <= 0)
+            break;
+        done += size;
+    }
+    return done;
 }
 int             HTTPConnection::peek            (const uint8_t **pp_peek, size_t i_peek)
 {
-    return stream_Peek(this->urlStream, pp_peek, i_peek);
-}
-void            HTTPConnection::parseURL        ()
-{
-    this->hostname = this->url;
-    this->hostname.erase(0, 7);
-    this->path = this->hostname;
+    if(this->urlStream != NULL)
+        return stream_Peek(this->urlStream, pp_peek, i_peek);
 
-    size_t pos = this->hostname.find("/");
+    if(this->peekSize < i_peek)
+    {
+        uint8_t *buffer = (uint8_t *)realloc(this->peekBuffer, i_peek);
+        if(buffer == NULL)
+            return -1;
+        this->peekBuffer = buffer;
 
-    this->hostname  = this->hostname.substr(0, pos);
-    this->path      = this->path.substr(pos, this->path.size());
+        while(this->peekSize < i_peek)
+        {
+            int size = this->readBody(this->peekBuffer + this->peekSize,
+                                      i_peek - this->peekSize);
+            if(size <= 0)
+                break;
+            this->peekSize += size;
+        }
+    }
 
-    this->request = "GET " + this->path + " HTTP/1.1\r\n" +
-                    "Host: " + this->hostname + "\r\nConnection: close\r\n\r\n";
+    *pp_peek = this->peekBuffer;
+    return __MIN(this->peekSize, i_peek);
+}
+bool            HTTPConnection::parseURL        ()
+{
+    return splitURL(this->url, this->hostname, this->port, this->path);
 }
 
 bool            HTTPConnection::init()
 {
+    if(this->parseURL())
+    {
+        this->httpSocket = net_ConnectTCP(this->stream, this->hostname.c_str(), this->port);
+
+        if(this->httpSocket != -1 && this->sendRequest())
+            return true;
+
+        /* Let the access module deal with redirections and errors */
+        this->closeSocket();
+    }
+
     this->urlStream = stream_UrlNew( this->stream, this->url.c_str() );
 
     if( this->urlStream == NULL )
@@ -78,24 +157,173 @@ bool            HTTPConnection::init()
     return true;
 
 }
+bool            HTTPConnection::reuse           (const std::string& url)
+{
+    if(!this->isReusable())
+        return false;
+
+    this->url = url;
+    if(!this->parseURL())
+        return false;
+
+    return this->sendRequest();
+}
+bool            HTTPConnection::isReusable      () const
+{
+    return this->httpSocket != -1 && this->keepAlive && this->bodyDone &&
+           this->peekSize == 0;
+}
+/* Whether the whole response body was received, so far */
+bool            HTTPConnection::isComplete      () const
+{
+    return !this->bodyLost;
+}
+bool            HTTPConnection::isSameHost      (const std::string& url) const
+{
+    std::string hostname, path;
+    int         port;
+
+    if(!splitURL(url, hostname, port, path))
+        return false;
+
+    return port == this->port && !strcasecmp(hostname.c_str(), this->hostname.c_str());
+}
+bool            HTTPConnection::sendRequest     ()
+{
+    std::stringstream host;
+
+    host << this->hostname;
+    if(this->port != 80)
+        host << ":" << this->port;
+
+    this->request = "GET " + this->path + " HTTP/1.1\r\n" +
+                    "Host: " + host.str() + "\r\nConnection: keep-alive\r\n\r\n";
+
+    return this->sendData(this->request) && this->parseHeader();
+}
 bool            HTTPConnection::parseHeader     ()
 {
     std::string line = this->readLine();
+    int         status;
+    int         minor;
 
-    while(line.compare("\r\n"))
+    if(sscanf(line.c_str(), "HTTP/1.%d %d", &minor, &status) != 2)
+        return false;
+
+    this->keepAlive = minor >= 1;
+    this->chunked   = false;
+    this->bodyLost  = false;
+    this->bodyLeft  = -1;
+
+    line = this->readLine();
+
+    while(!line.empty() && line.compare("\r\n"))
     {
+        size_t colon = line.find(':');
+
+        if(colon != std::string::npos)
+        {
+            std::string name  = line.substr(0, colon);
+            const char  *value = line.c_str() + colon + 1;
+
+            value += strspn(value, " \t");
+            if(!strcasecmp(name.c_str(), "Content-Length"))
+                this->bodyLeft = strtoll(value, NULL, 10);
+            else if(!strcasecmp(name.c_str(), "Transfer-Encoding"))
+                this->chunked = !strncasecmp(value, "chunked", 7);
+            else if(!strcasecmp(name.c_str(), "Connection"))
+                this->keepAlive = strncasecmp(value, "close", 5) != 0;
+        }
         line = this->readLine();
     }
 
+    if(line.empty()) /* connection lost in the header */
+        return false;
+
+    if(status < 200 || status >= 300)
+        return false;
+
+    if(this->chunked)
+        this->bodyLeft = 0; /* size of the current chunk */
+    else if(this->bodyLeft < 0)
+        this->keepAlive = false; /* the body ends with the connection */
+
+    this->bodyDone = !this->chunked && this->bodyLeft == 0;
     return true;
 }
+int             HTTPConnection::readBody        (void *p_buffer, size_t len)
+{
+    if(this->bodyDone)
+        return 0;
+
+    if(this->chunked)
+    {
+        if(this->bodyLeft == 0)
+        {
+            std::string line = this->readLine();
+            if(line.empty())
+            {
+                /* connection lost between two chunks */
+                this->keepAlive = false;
+                this->bodyDone  = true;
+                this->bodyLost  = true;
+                return 0;
+            }
+            this->bodyLeft = strtoll(line.c_str(), NULL, 16);
+            if(this->bodyLeft <= 0)
+            {
+                /* last chunk: skip the trailer */
+                do
+                    line = this->readLine();
+                while(!line.empty() && line.compare("\r\n"));
+                if(line.empty())
+                    this->keepAlive = false;
+                this->bodyDone = true;
+                return 0;
+            }
+        }
+    }
+    if(this->bodyLeft >= 0 && (uint64_t)this->bodyLeft < len)
+        len = this->bodyLeft;
+
+    ssize_t size = net_Read(this->stream, this->httpSocket, NULL, p_buffer, len, false);
+    if(size <= 0)
+    {
+        /* connection lost or closed by the server */
+        this->keepAlive = false;
+        this->bodyDone  = true;
+        this->bodyLost  = this->chunked || this->bodyLeft > 0;
+        return 0;
+    }
+
+    if(this->bodyLeft >= 0)
+    {
+        this->bodyLeft -= size;
+        if(this->bodyLeft == 0)
+        {
+            if(this->chunked)
+            {
+                /* CRLF after the chunk data */
+                if(this->readLine().empty())
+                {
+                    this->keepAlive = false;
+                    this->bodyDone  = true;
+                    this->bodyLost  = true;
+                }
+            }
+            else
+                this->bodyDone = true;
+        }
+    }
+    return size;
+}
 std::string     HTTPConnection::readLine        ()
 {
     std::stringstream ss;
     char c[1];
-    size_t size = net_Read(this->stream, this->httpSocket, NULL, c, 1, false);
+    ssize_t size = net_Read(this->stream, this->httpSocket, NULL, c, 1, false);
 
-    while(size)
+    while(size > 0)
     {
         ss << c[0];
         if(c[0] == '\n')
@@ -107,23 +335,30 @@ std::string     HTTPConnection::readLine        ()
     if(size > 0)
         return ss.str();
 
-    return "\r\n";
+    return ""; /* connection lost */
 }
 bool            HTTPConnection::sendData        (const std::string& data)
 {
-    ssize_t size = net_Write(this->stream, this->httpSocket, NULL, data.c_str(), data.size());
-    if (size == -1)
-    {
-        return false;
-    }
-    if ((size_t)size != data.length())
+    size_t done = 0;
+
+    while(done < data.size())
     {
-        this->sendData(data.substr(size, data.size()));
+        ssize_t size = net_Write(this->stream, this->httpSocket, NULL,
+                                 data.c_str() + done, data.size() - done);
+        if(size <= 0)
+            return false;
+        done += size;
     }
-
     return true;
 }
 void            HTTPConnection::closeSocket     ()
 {
-    stream_Delete(this->urlStream);
+    if(this->urlStream != NULL)
+        stream_Delete(this->urlStream);
+    this->urlStream = NULL;
+
+    if(this->httpSocket != -1)
+        net_Close(this->httpSocket);
+    this->httpSocket = -1;
+    this->keepAlive  = false;
 }
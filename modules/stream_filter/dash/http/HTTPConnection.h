@@ -29,6 +29,7 @@
 #include <vlc_plugin.h>
 #include <vlc_stream.h>
 #include <vlc_network.h>
+#include <vlc_url.h>
 
 #include <string>
 #include <stdint.h>
@@ -48,6 +49,10 @@ namespace dash
                 virtual ~HTTPConnection ();
 
                 bool        init            ();
+                bool        reuse           (const std::string& url);
+                bool        isReusable      () const;
+                bool        isSameHost      (const std::string& url) const;
+                bool        isComplete      () const;
                 void        closeSocket     ();
 
                 virtual int     read        (void *p_buffer, size_t len);
@@ -57,15 +62,27 @@ namespace dash
                 int                     httpSocket;
                 std::string             url;
                 std::string             hostname;
+                int                     port;
                 std::string             path;
                 std::string             request;
                 stream_t                *stream;
                 stream_t                *urlStream;
 
-                void            parseURL        ();
+                /* state of the response body */
+                bool                    keepAlive;
+                bool                    chunked;
+                bool                    bodyDone;
+                bool                    bodyLost;   /* ended before its end */
+                int64_t                 bodyLeft;   /* -1 if unknown */
+                uint8_t                 *peekBuffer;
+                size_t                  peekSize;
+
+                bool            parseURL        ();
+                bool            sendRequest     ();
                 bool            sendData        (const std::string& data);
                 bool            parseHeader     ();
                 std::string     readLine        ();
+                int             readBody        (void *p_buffer, size_t len);
         };
     }
 }
@@ -65,11 +65,62 @@ bool                HTTPConnectionManager::closeConnection( IHTTPConnection *con
 bool                HTTPConnectionManager::closeConnection( Chunk *chunk )
 {
     HTTPConnection *con = this->chunkMap[chunk];
-    bool ret = this->closeConnection(con);
+    bool ret = false;
+
+    for(std::vector<HTTPConnection *>::iterator it = this->connections.begin();
+        it != this->connections.end(); ++it)
+    {
+        if(*it == con)
+        {
+            this->connections.erase(it);
+            this->releaseConnection(con);
+            ret = true;
+            break;
+        }
+    }
     this->chunkMap.erase(chunk);
     delete(chunk);
     return ret;
 }
+/* Keeps a connection whose response has been fully read for the next chunk */
+void                HTTPConnectionManager::releaseConnection( HTTPConnection *con )
+{
+    if(con->isReusable())
+    {
+        if(this->idleConnections.size() >= maxIdleConnections)
+        {
+            HTTPConnection *oldest = this->idleConnections.front();
+            oldest->closeSocket();
+            delete(oldest);
+            this->idleConnections.erase(this->idleConnections.begin());
+        }
+        this->idleConnections.push_back(con);
+        return;
+    }
+    con->closeSocket();
+    delete(con);
+}
+HTTPConnection*     HTTPConnectionManager::reuseConnection( const std::string& url )
+{
+    for(std::vector<HTTPConnection *>::iterator it = this->idleConnections.begin();
+        it != this->idleConnections.end(); ++it)
+    {
+        HTTPConnection *con = *it;
+
+        if(!con->isSameHost(url))
+            continue;
+
+        this->idleConnections.erase(it);
+        if(con->reuse(url))
+            return con;
+
+        /* The server may have dropped the connection in the meantime */
+        con->closeSocket();
+        delete(con);
+        return NULL;
+    }
+    return NULL;
+}
 
 void                HTTPConnectionManager::closeAllConnections      ()
 {
@@ -81,6 +132,13 @@ void                HTTPConnectionManager::closeAllConnections      ()
     this->connections.clear();
     this->urlMap.clear();
 
+    for(size_t i = 0; i < this->idleConnections.size(); i++)
+    {
+        this->idleConnections.at(i)->closeSocket();
+        delete(this->idleConnections.at(i));
+    }
+    this->idleConnections.clear();
+
     std::map<Chunk *, HTTPConnection *>::iterator it;
 
     for(it = this->chunkMap.begin(); it != this->chunkMap.end(); ++it)
@@ -147,9 +205,17 @@ int                 HTTPConnectionManager::peek                     (Chunk *chun
 
 IHTTPConnection*     HTTPConnectionManager::initConnection(Chunk *chunk)
 {
-    HTTPConnection *con = new HTTPConnection(chunk->getUrl(), this->stream);
-    if ( con->init() == false )
-        return NULL;
+    HTTPConnection *con = this->reuseConnection(chunk->getUrl());
+
+    if ( con == NULL )
+    {
+        con = new HTTPConnection(chunk->getUrl(), this->stream);
+        if ( con->init() == false )
+        {
+            delete(con);
+            return NULL;
+        }
+    }
     this->connections.push_back(con);
     this->chunkMap[chunk] = con;
     this->chunkCount++;
@@ -166,3 +232,7 @@ void                HTTPConnectionManager::notify                   ()
     for(size_t i = 0; i < this->rateObservers.size(); i++)
         this->rateObservers.at(i)->downloadRateChanged(this->bpsAvg, this->bpsLastChunk);
 }
+stream_t*           HTTPConnectionManager::getStream                () const
+{
+    return this->stream;
+}
@@ -54,9 +54,11 @@ namespace dash
                 int                 peek                (Chunk *chunk, const uint8_t **pp_peek, size_t i_peek);
                 void                attach              (dash::logic::IDownloadRateObserver *observer);
                 void                notify              ();
+                stream_t*           getStream           () const;
 
             private:
                 std::vector<HTTPConnection *>                       connections;
+                std::vector<HTTPConnection *>                       idleConnections;
                 std::map<Chunk *, HTTPConnection *>                 chunkMap;
                 std::map<std::string, HTTPConnection *>             urlMap;
                 std::vector<dash::logic::IDownloadRateObserver *>   rateObservers;
@@ -69,7 +71,11 @@ namespace dash
                 stream_t                                            *stream;
                 int                                                 chunkCount;
 
+                static const size_t maxIdleConnections = 4;
+
                 bool                closeConnection( Chunk *chunk );
+                void                releaseConnection( HTTPConnection *con );
+                HTTPConnection*     reuseConnection( const std::string& url );
                 IHTTPConnection*    initConnection( Chunk *chunk );
 
         };
@@ -50,11 +50,23 @@
 static int  Open (vlc_object_t *);
 static void Close(vlc_object_t *);
 
+#define PREFETCH_TEXT N_("Segments to prefetch")
+#define PREFETCH_LONGTEXT N_( \
+    "Number of segments downloaded ahead of the playback position.")
+#define THREADS_TEXT N_("Concurrent downloads")
+#define THREADS_LONGTEXT N_( \
+    "Number of segments downloaded at the same time. Several downloads " \
+    "make better use of links with a high latency.")
+
 vlc_module_begin()
     set_category(CAT_INPUT)
     set_subcategory(SUBCAT_INPUT_STREAM_FILTER)
     set_description(N_("Http Live Streaming stream filter"))
     set_capability("stream_filter", 20)
+    add_integer("hls-prefetch", 6, PREFETCH_TEXT, PREFETCH_LONGTEXT, true)
+        change_integer_range(2, 100)
+    add_integer("hls-threads", 2, THREADS_TEXT, THREADS_LONGTEXT, true)
+        change_integer_range(1, 16)
     set_callbacks(Open, Close)
 vlc_module_end()
 
@@ -98,24 +110,50 @@ typedef struct hls_stream_s
     bool         b_iv_loaded;
 } hls_stream_t;
 
+typedef struct hls_worker_s
+{
+    stream_t     *s;
+    vlc_thread_t  thread;
+    int           segment;  /* segment being downloaded (-1 if none) */
+    int           epoch;    /* seek generation it was claimed in */
+} hls_worker_t;
+
+#define HLS_BW_SAMPLES   5      /* samples in the harmonic mean */
+#define HLS_BW_HALF_LIFE 8      /* seconds of download to halve the average */
+
 struct stream_sys_t
 {
     char         *m3u8;         /* M3U8 url */
     vlc_thread_t  reload;       /* HLS m3u8 reload thread */
-    vlc_thread_t  thread;       /* HLS segment download thread */
+    hls_worker_t *workers;      /* HLS segment download threads */
+    int           i_workers;
 
     block_t      *peeked;
 
     /* */
     vlc_array_t  *hls_stream;   /* bandwidth adaptation */
-    uint64_t      bandwidth;    /* measured bandwidth (bits per second) */
+    uint64_t      bandwidth;    /* estimated bandwidth (bits per second) */
+
+    /* Bandwidth estimation, protected by download.lock_wait */
+    struct hls_estimator_s
+    {
+        double      average;    /* moving average (bits per second) */
+        double      weight;     /* for the zero bias of the average */
+        double      samples[HLS_BW_SAMPLES]; /* last measures */
+        int         count;
+        int         index;
+    } estimator;
 
     /* Download */
     struct hls_download_s
     {
         int         stream;     /* current hls_stream  */
-        int         segment;    /* current segment for downloading */
+        int         segment;    /* segments before this one are downloaded */
+        int         next;       /* next segment to hand to a worker */
         int         seek;       /* segment requested by seek (default -1) */
+        int         epoch;      /* incremented on each seek */
+        int         active;     /* downloads in progress */
+        int         prefetch;   /* segments to download ahead of playback */
         vlc_mutex_t lock_wait;  /* protect segment download counter */
         vlc_cond_t  wait;       /* some condition to wait on */
     } download;
@@ -1146,6 +1184,7 @@ static int hls_DownloadSegmentKey(stream_t *s, segment_t *seg)
     return VLC_SUCCESS;
 }
 
+/* hls->lock must be held */
 static int hls_ManageSegmentKeys(stream_t *s, hls_stream_t *hls)
 {
     segment_t   *seg = NULL;
@@ -1178,12 +1217,12 @@ static int hls_ManageSegmentKeys(stream_t *s, hls_stream_t *hls)
     return VLC_SUCCESS;
 }
 
-static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segment)
+/* Copies the key and the IV of the segment, loading the key if needed.
+ * The IV is derived in the caller buffer, as several workers may decode
+ * segments of the same stream at once. hls->lock must be held. */
+static int hls_GetSegmentKey(stream_t *s, hls_stream_t *hls, segment_t *segment,
+                             uint8_t key[AES_BLOCK_SIZE], uint8_t iv[AES_BLOCK_SIZE])
 {
-    /* Did the segment need to be decoded ? */
-    if (segment->psz_key_path == NULL)
-        return VLC_SUCCESS;
-
     /* Do we have loaded the key ? */
     if (!segment->b_key_loaded)
     {
@@ -1191,6 +1230,25 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
         if (hls_ManageSegmentKeys(s, hls) != VLC_SUCCESS)
             return VLC_EGENERIC;
     }
+    memcpy(key, segment->aes_key, AES_BLOCK_SIZE);
+
+    if (hls->b_iv_loaded == false)
+    {
+        memset(iv, 0, AES_BLOCK_SIZE);
+        iv[15] = segment->sequence & 0xff;
+        iv[14] = (segment->sequence >> 8)& 0xff;
+        iv[13] = (segment->sequence >> 16)& 0xff;
+        iv[12] = (segment->sequence >> 24)& 0xff;
+    }
+    else
+        memcpy(iv, hls->psz_AES_IV, AES_BLOCK_SIZE);
+    return VLC_SUCCESS;
+}
+
+static int hls_DecodeSegmentData(stream_t *s, segment_t *segment,
+                                 const uint8_t key[AES_BLOCK_SIZE],
+                                 const uint8_t iv[AES_BLOCK_SIZE])
+{
 
     /* For now, we only decode AES-128 data */
     gcry_error_t i_gcrypt_err;
@@ -1206,8 +1264,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     }
 
     /* Set key */
-    i_gcrypt_err = gcry_cipher_setkey(aes_ctx, segment->aes_key,
-                                       sizeof(segment->aes_key));
+    i_gcrypt_err = gcry_cipher_setkey(aes_ctx, key, AES_BLOCK_SIZE);
     if (i_gcrypt_err)
     {
         msg_Err(s, "gcry_cipher_setkey failed: %s", gpg_strerror(i_gcrypt_err));
@@ -1215,17 +1272,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
         return VLC_EGENERIC;
     }
 
-    if (hls->b_iv_loaded == false)
-    {
-        memset(hls->psz_AES_IV, 0, AES_BLOCK_SIZE);
-        hls->psz_AES_IV[15] = segment->sequence & 0xff;
-        hls->psz_AES_IV[14] = (segment->sequence >> 8)& 0xff;
-        hls->psz_AES_IV[13] = (segment->sequence >> 16)& 0xff;
-        hls->psz_AES_IV[12] = (segment->sequence >> 24)& 0xff;
-    }
-
-    i_gcrypt_err = gcry_cipher_setiv(aes_ctx, hls->psz_AES_IV,
-                                      sizeof(hls->psz_AES_IV));
+    i_gcrypt_err = gcry_cipher_setiv(aes_ctx, iv, AES_BLOCK_SIZE);
 
     if (i_gcrypt_err)
     {
@@ -1443,6 +1490,42 @@ static int hls_ReloadPlaylist(stream_t *s)
 /****************************************************************************
  * hls_Thread
  ****************************************************************************/
+
+/* Adds the throughput of a download to the estimation. The downloads in
+ * progress share the link, so each measure is scaled by their number.
+ * The estimation is the lowest of a moving average weighted by the download
+ * time and of the harmonic mean of the last samples, so that it follows
+ * drops quickly but is not fooled by a single fast segment.
+ * download.lock_wait must be held. */
+static void hls_EstimateBandwidth(stream_sys_t *p_sys, uint64_t size,
+                                  mtime_t duration, int active)
+{
+    struct hls_estimator_s *est = &p_sys->estimator;
+
+    if (size == 0)
+        return;
+    duration = __MAX(1, duration);
+
+    double bps = (double)size * 8 * CLOCK_FREQ / duration * __MAX(1, active);
+    double seconds = (double)duration / CLOCK_FREQ;
+    double alpha = seconds / (seconds + HLS_BW_HALF_LIFE);
+
+    est->average = (1 - alpha) * est->average + alpha * bps;
+    est->weight = (1 - alpha) * est->weight + alpha;
+
+    est->samples[est->index] = bps;
+    est->index = (est->index + 1) % HLS_BW_SAMPLES;
+    if (est->count < HLS_BW_SAMPLES)
+        est->count++;
+
+    double inverse = 0;
+    for (int i = 0; i < est->count; i++)
+        inverse += 1 / est->samples[i];
+    double harmonic = est->count / inverse;
+
+    p_sys->bandwidth = (uint64_t)__MIN(est->average / est->weight, harmonic);
+}
+
 static int BandwidthAdaptation(stream_t *s, int progid, uint64_t *bandwidth)
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -1480,6 +1563,17 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
     assert(hls);
     assert(segment);
 
+    /* hls->lock is taken before the segment locks, never the other way:
+     * load the key and read the stream bandwidth first */
+    uint8_t aes_key[AES_BLOCK_SIZE], aes_iv[AES_BLOCK_SIZE];
+    bool b_key = false;
+
+    vlc_mutex_lock(&hls->lock);
+    if (segment->psz_key_path != NULL)
+        b_key = hls_GetSegmentKey(s, hls, segment, aes_key, aes_iv) == VLC_SUCCESS;
+    uint64_t hls_bandwidth = hls->bandwidth;
+    vlc_mutex_unlock(&hls->lock);
+
     vlc_mutex_lock(&segment->lock);
     if (segment->data != NULL)
     {
@@ -1489,10 +1583,13 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
     }
 
     /* sanity check - can we download this segment on time? */
-    if ((p_sys->bandwidth > 0) && (hls->bandwidth > 0))
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    uint64_t bandwidth = p_sys->bandwidth;
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+    if ((bandwidth > 0) && (hls_bandwidth > 0))
     {
-        uint64_t size = (segment->duration * hls->bandwidth); /* bits */
-        int estimated = (int)(size / p_sys->bandwidth);
+        uint64_t size = (segment->duration * hls_bandwidth); /* bits */
+        int estimated = (int)(size / bandwidth);
         if (estimated > segment->duration)
         {
             msg_Warn(s,"downloading of segment %d takes %ds, which is longer than its playback (%ds)",
@@ -1509,114 +1606,126 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
         return VLC_EGENERIC;
     }
     mtime_t duration = mdate() - start;
-    if (hls->bandwidth == 0 && segment->duration > 0)
-    {
-        /* Try to estimate the bandwidth for this stream */
-        hls->bandwidth = (uint64_t)(((double)segment->size * 8) / ((double)segment->duration));
-    }
 
     /* If the segment is encrypted, decode it */
-    if (hls_DecodeSegmentData(s, hls, segment) != VLC_SUCCESS)
+    if (segment->psz_key_path != NULL &&
+        (!b_key || hls_DecodeSegmentData(s, segment, aes_key, aes_iv) != VLC_SUCCESS))
     {
         vlc_mutex_unlock(&segment->lock);
         return VLC_EGENERIC;
     }
 
+    uint64_t size = segment->size;
+    int segment_duration = segment->duration;
     vlc_mutex_unlock(&segment->lock);
 
+    vlc_mutex_lock(&hls->lock);
+    if (hls->bandwidth == 0 && segment_duration > 0)
+    {
+        /* Try to estimate the bandwidth for this stream */
+        hls->bandwidth = (uint64_t)(((double)size * 8) / ((double)segment_duration));
+    }
+    hls_bandwidth = hls->bandwidth;
+    vlc_mutex_unlock(&hls->lock);
+
     msg_Info(s, "downloaded segment %d from stream %d",
                 segment->sequence, *cur_stream);
 
-    uint64_t bw = segment->size * 8 * 1000000 / __MAX(1, duration); /* bits / s */
-    p_sys->bandwidth = bw;
-    if (p_sys->b_meta && (hls->bandwidth != bw))
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    hls_EstimateBandwidth(p_sys, size, duration, p_sys->download.active);
+    /* Keep a margin for the variations of the link */
+    uint64_t bw = p_sys->bandwidth / 10 * 8; /* bits / s */
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+
+    if (p_sys->b_meta && (hls_bandwidth != bw))
     {
         int newstream = BandwidthAdaptation(s, hls->id, &bw);
 
-        /* FIXME: we need an average here */
         if ((newstream >= 0) && (newstream != *cur_stream))
         {
             msg_Info(s, "detected %s bandwidth (%"PRIu64") stream",
-                     (bw >= hls->bandwidth) ? "faster" : "lower", bw);
+                     (bw >= hls_bandwidth) ? "faster" : "lower", bw);
             *cur_stream = newstream;
         }
     }
     return VLC_SUCCESS;
 }
 
+/* Segments before the first one still downloaded for the current seek are
+ * all available. download.lock_wait must be held. */
+static void hls_UpdateDownloaded(stream_sys_t *p_sys)
+{
+    int segment = p_sys->download.next;
+
+    for (int i = 0; i < p_sys->i_workers; i++)
+    {
+        hls_worker_t *worker = &p_sys->workers[i];
+        if ((worker->segment >= 0) &&
+            (worker->epoch == p_sys->download.epoch) &&
+            (worker->segment < segment))
+            segment = worker->segment;
+    }
+    p_sys->download.segment = segment;
+}
+
 static void* hls_Thread(void *p_this)
 {
-    stream_t *s = (stream_t *)p_this;
+    hls_worker_t *worker = (hls_worker_t *)p_this;
+    stream_t *s = worker->s;
     stream_sys_t *p_sys = s->p_sys;
 
     int canc = vlc_savecancel();
 
-    while (vlc_object_alive(s))
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    while (vlc_object_alive(s) && !p_sys->b_error)
     {
-        hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->download.stream);
+        if (p_sys->download.seek >= 0)
+        {
+            /* Downloads claimed before the seek no longer count */
+            p_sys->download.next = p_sys->download.seek;
+            p_sys->download.seek = -1;
+            p_sys->download.epoch++;
+            hls_UpdateDownloaded(p_sys);
+            vlc_cond_broadcast(&p_sys->download.wait);
+        }
+
+        int stream = p_sys->download.stream;
+        hls_stream_t *hls = hls_Get(p_sys->hls_stream, stream);
         assert(hls);
 
-        /* Sliding window (~60 seconds worth of movie) */
         vlc_mutex_lock(&hls->lock);
         int count = vlc_array_count(hls->segments);
+        segment_t *segment = segment_GetSegment(hls, p_sys->download.next);
         vlc_mutex_unlock(&hls->lock);
 
-        /* Is there a new segment to process? */
-        if ((!p_sys->b_live && (p_sys->playback.segment < (count - 6))) ||
-            (p_sys->download.segment >= count))
+        /* Is there a new segment to process within the prefetch window? */
+        if ((segment == NULL) || (p_sys->download.next >= count) ||
+            (p_sys->download.next - p_sys->playback.segment > p_sys->download.prefetch))
         {
-            /* wait */
-            vlc_mutex_lock(&p_sys->download.lock_wait);
-            while (((p_sys->download.segment - p_sys->playback.segment > 6) ||
-                    (p_sys->download.segment >= count)) &&
-                   (p_sys->download.seek == -1))
-            {
-                vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
-                if (p_sys->b_live /*&& (mdate() >= p_sys->playlist.wakeup)*/)
-                    break;
-                if (!vlc_object_alive(s))
-                    break;
-            }
-            /* */
-            if (p_sys->download.seek >= 0)
-            {
-                p_sys->download.segment = p_sys->download.seek;
-                p_sys->download.seek = -1;
-            }
-            vlc_mutex_unlock(&p_sys->download.lock_wait);
+            vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
+            continue;
         }
 
-        if (!vlc_object_alive(s)) break;
-
-        vlc_mutex_lock(&hls->lock);
-        segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
-        vlc_mutex_unlock(&hls->lock);
+        worker->segment = p_sys->download.next++;
+        worker->epoch = p_sys->download.epoch;
+        p_sys->download.active++;
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
 
-        if ((segment != NULL) &&
-            (hls_DownloadSegmentData(s, hls, segment, &p_sys->download.stream) != VLC_SUCCESS))
-        {
-            if (!vlc_object_alive(s)) break;
+        int current = stream;
+        int ret = hls_DownloadSegmentData(s, hls, segment, &current);
 
-            if (!p_sys->b_live)
-            {
-                p_sys->b_error = true;
-                break;
-            }
-        }
-
-        /* download succeeded */
-        /* determine next segment to download */
         vlc_mutex_lock(&p_sys->download.lock_wait);
-        if (p_sys->download.seek >= 0)
-        {
-            p_sys->download.segment = p_sys->download.seek;
-            p_sys->download.seek = -1;
-        }
-        else if (p_sys->download.segment < count)
-            p_sys->download.segment++;
-        vlc_cond_signal(&p_sys->download.wait);
-        vlc_mutex_unlock(&p_sys->download.lock_wait);
+        p_sys->download.active--;
+        worker->segment = -1;
+        if (ret != VLC_SUCCESS && vlc_object_alive(s) && !p_sys->b_live)
+            p_sys->b_error = true;
+        /* bandwidth adaptation */
+        if (current != stream)
+            p_sys->download.stream = current;
+        hls_UpdateDownloaded(p_sys);
+        vlc_cond_broadcast(&p_sys->download.wait);
     }
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
 
     vlc_restorecancel(canc);
     return NULL;
@@ -1657,6 +1766,11 @@ static void* hls_Reload(void *p_this)
             {
                 p_sys->playlist.tries = 0;
                 wait = 0.5;
+
+                /* New segments may be available for download */
+                vlc_mutex_lock(&p_sys->download.lock_wait);
+                vlc_cond_broadcast(&p_sys->download.wait);
+                vlc_mutex_unlock(&p_sys->download.lock_wait);
             }
 
             hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->download.stream);
@@ -1950,25 +2064,35 @@ static int Open(vlc_object_t *p_this)
     p_sys->playback.segment = p_sys->download.segment = ChooseSegment(s, current);
 
     /* manage encryption key if needed */
-    hls_ManageSegmentKeys(s, hls_Get(p_sys->hls_stream, current));
+    hls_stream_t *hls = hls_Get(p_sys->hls_stream, current);
+    vlc_mutex_lock(&hls->lock);
+    hls_ManageSegmentKeys(s, hls);
+    vlc_mutex_unlock(&hls->lock);
 
     if (p_sys->b_live && (p_sys->playback.segment < 0))
     {
         msg_Warn(s, "less data than 3 times 'target duration' available for live playback, playback may stall");
     }
 
+    vlc_mutex_init(&p_sys->download.lock_wait);
+    vlc_cond_init(&p_sys->download.wait);
+
     if (Prefetch(s, &current) != VLC_SUCCESS)
     {
         msg_Err(s, "fetching first segment failed.");
-        goto fail;
+        goto fail_thread;
     }
 
     p_sys->download.stream = current;
+    p_sys->download.next = p_sys->download.segment;
+    p_sys->download.prefetch = var_InheritInteger(s, "hls-prefetch");
     p_sys->playback.stream = current;
     p_sys->download.seek = -1;
 
-    vlc_mutex_init(&p_sys->download.lock_wait);
-    vlc_cond_init(&p_sys->download.wait);
+    int i_workers = var_InheritInteger(s, "hls-threads");
+    p_sys->workers = calloc(i_workers, sizeof(*p_sys->workers));
+    if (p_sys->workers == NULL)
+        goto fail_thread;
 
     /* Initialize HLS live stream */
     if (p_sys->b_live)
@@ -1984,7 +2108,18 @@ static int Open(vlc_object_t *p_this)
         }
     }
 
-    if (vlc_clone(&p_sys->thread, hls_Thread, s, VLC_THREAD_PRIORITY_INPUT))
+    for (int i = 0; i < i_workers; i++)
+    {
+        hls_worker_t *worker = &p_sys->workers[p_sys->i_workers];
+
+        worker->s = s;
+        worker->segment = -1;
+        if (vlc_clone(&worker->thread, hls_Thread, worker, VLC_THREAD_PRIORITY_INPUT))
+            break;
+        p_sys->i_workers++;
+    }
+
+    if (p_sys->i_workers == 0)
     {
         if (p_sys->b_live)
             vlc_join(p_sys->reload, NULL);
@@ -1994,6 +2129,7 @@ static int Open(vlc_object_t *p_this)
     return VLC_SUCCESS;
 
 fail_thread:
+    free(p_sys->workers);
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
 
@@ -2024,13 +2160,15 @@ static void Close(vlc_object_t *p_this)
 
     /* */
     vlc_mutex_lock(&p_sys->download.lock_wait);
-    vlc_cond_signal(&p_sys->download.wait);
+    vlc_cond_broadcast(&p_sys->download.wait);
     vlc_mutex_unlock(&p_sys->download.lock_wait);
 
     /* */
     if (p_sys->b_live)
         vlc_join(p_sys->reload, NULL);
-    vlc_join(p_sys->thread, NULL);
+    for (int i = 0; i < p_sys->i_workers; i++)
+        vlc_join(p_sys->workers[i].thread, NULL);
+    free(p_sys->workers);
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
 
@@ -2057,6 +2195,15 @@ static segment_t *GetSegment(stream_t *s)
     stream_sys_t *p_sys = s->p_sys;
     segment_t *segment = NULL;
 
+    /* Wait for this segment if it is being downloaded */
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    while ((p_sys->playback.segment >= p_sys->download.segment) &&
+           (p_sys->playback.segment < p_sys->download.next) &&
+           (p_sys->download.seek == -1) && !p_sys->b_error &&
+           vlc_object_alive(s))
+        vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+
     /* Is this segment of the current HLS stream ready? */
     hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->playback.stream);
     if (hls != NULL)
@@ -2080,6 +2227,10 @@ static segment_t *GetSegment(stream_t *s)
     }
 
     /* Was the HLS stream changed to another bitrate? */
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    int i_segment = p_sys->download.segment;
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+
     segment = NULL;
     for (int i_stream = 0; i_stream < vlc_array_count(p_sys->hls_stream); i_stream++)
     {
@@ -2096,10 +2247,6 @@ static segment_t *GetSegment(stream_t *s)
             break;
         }
 
-        vlc_mutex_lock(&p_sys->download.lock_wait);
-        int i_segment = p_sys->download.segment;
-        vlc_mutex_unlock(&p_sys->download.lock_wait);
-
         vlc_mutex_lock(&segment->lock);
         /* This segment is ready? */
         if ((segment->data != NULL) &&
@@ -2182,9 +2329,9 @@ static ssize_t hls_Read(stream_t *s, uint8_t *p_read, unsigned int i_read)
             p_sys->playback.segment++;
             vlc_mutex_unlock(&segment->lock);
 
-            /* signal download thread */
+            /* signal download threads */
             vlc_mutex_lock(&p_sys->download.lock_wait);
-            vlc_cond_signal(&p_sys->download.wait);
+            vlc_cond_broadcast(&p_sys->download.wait);
             vlc_mutex_unlock(&p_sys->download.lock_wait);
             continue;
         }
@@ -2447,10 +2594,10 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
         /* start download at current playback segment */
         vlc_mutex_unlock(&hls->lock);
 
-        /* Wake up download thread */
+        /* Wake up download threads */
         vlc_mutex_lock(&p_sys->download.lock_wait);
         p_sys->download.seek = p_sys->playback.segment;
-        vlc_cond_signal(&p_sys->download.wait);
+        vlc_cond_broadcast(&p_sys->download.wait);
 
         /* Wait for download to be finished */
         msg_Info(s, "seek to segment %d", p_sys->playback.segment);
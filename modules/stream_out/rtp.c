@@ -1187,7 +1187,8 @@ static sout_stream_id_t *Add( sout_stream_t *p_stream, es_format_t *p_fmt )
         id->rtsp_id = RtspAddId( p_sys->rtsp, id, GetDWBE( id->ssrc ),
                                  id->rtp_fmt.clock_rate, mcast_fd );
 
-    id->p_fifo = block_FifoNew();
+    /* Only the packetizer of this ES queues and only ThreadSend dequeues */
+    id->p_fifo = block_FifoNewExt( BLOCK_FIFO_SPSC );
     if( unlikely(id->p_fifo == NULL) )
         goto error;
     if( vlc_clone( &id->thread, ThreadSend, id, VLC_THREAD_PRIORITY_HIGHEST ) )
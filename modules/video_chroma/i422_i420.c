@@ -112,33 +112,59 @@ VIDEO_FILTER_WRAPPER( I422_I420 )
 VIDEO_FILTER_WRAPPER( I422_YV12 )
 VIDEO_FILTER_WRAPPER( I422_YUVA )
 
+/*****************************************************************************
+ * I422_420_Lines: converts one band of lines, by pairs of luma lines
+ *****************************************************************************/
+typedef struct
+{
+    picture_t *p_source;
+    picture_t *p_dest;
+    bool b_swap_uv;
+} i422_slice_t;
+
+static void I422_420_Lines( filter_t *p_filter, void *p_data,
+                            unsigned i_slice, unsigned i_slices )
+{
+    const i422_slice_t *p_slice = p_data;
+    picture_t *p_source = p_slice->p_source;
+    picture_t *p_dest = p_slice->p_dest;
+    const int i_dpy = p_dest->p[Y_PLANE].i_pitch;
+    const int i_spy = p_source->p[Y_PLANE].i_pitch;
+    const int i_dpuv = p_dest->p[U_PLANE].i_pitch;
+    const int i_spuv = p_source->p[U_PLANE].i_pitch;
+    const unsigned i_width = p_filter->fmt_in.video.i_width;
+    int i_start, i_end;
+
+    filter_SliceLines( p_filter->fmt_in.video.i_height & ~1, 2,
+                       i_slice, i_slices, &i_start, &i_end );
+
+    uint8_t *p_dy = p_dest->Y_PIXELS + i_start * i_dpy;
+    uint8_t *p_y = p_source->Y_PIXELS + i_start * i_spy;
+    uint8_t *p_du = (p_slice->b_swap_uv ? p_dest->V_PIXELS : p_dest->U_PIXELS)
+                  + i_start / 2 * i_dpuv;
+    uint8_t *p_u = p_source->U_PIXELS + i_start * i_spuv;
+    uint8_t *p_dv = (p_slice->b_swap_uv ? p_dest->U_PIXELS : p_dest->V_PIXELS)
+                  + i_start / 2 * i_dpuv;
+    uint8_t *p_v = p_source->V_PIXELS + i_start * i_spuv;
+
+    for( int i_y = i_start; i_y < i_end; i_y += 2 )
+    {
+        vlc_memcpy(p_dy, p_y, i_width); p_dy += i_dpy; p_y += i_spy;
+        vlc_memcpy(p_dy, p_y, i_width); p_dy += i_dpy; p_y += i_spy;
+        vlc_memcpy(p_du, p_u, i_width/2); p_du += i_dpuv; p_u += 2*i_spuv;
+        vlc_memcpy(p_dv, p_v, i_width/2); p_dv += i_dpuv; p_v += 2*i_spuv;
+    }
+}
+
 /*****************************************************************************
  * I422_I420: planar YUV 4:2:2 to planar I420 4:2:0 Y:U:V
  *****************************************************************************/
 static void I422_I420( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
-    uint16_t i_dpy = p_dest->p[Y_PLANE].i_pitch;
-    uint16_t i_spy = p_source->p[Y_PLANE].i_pitch;
-    uint16_t i_dpuv = p_dest->p[U_PLANE].i_pitch;
-    uint16_t i_spuv = p_source->p[U_PLANE].i_pitch;
-    uint16_t i_width = p_filter->fmt_in.video.i_width;
-    uint16_t i_y = p_filter->fmt_in.video.i_height;
-    uint8_t *p_dy = p_dest->Y_PIXELS + (i_y-1)*i_dpy;
-    uint8_t *p_y = p_source->Y_PIXELS + (i_y-1)*i_spy;
-    uint8_t *p_du = p_dest->U_PIXELS + (i_y/2-1)*i_dpuv;
-    uint8_t *p_u = p_source->U_PIXELS + (i_y-1)*i_spuv;
-    uint8_t *p_dv = p_dest->V_PIXELS + (i_y/2-1)*i_dpuv;
-    uint8_t *p_v = p_source->V_PIXELS + (i_y-1)*i_spuv;
-    i_y /= 2;
-
-    for ( ; i_y--; )
-    {
-        vlc_memcpy(p_dy, p_y, i_width); p_dy -= i_dpy; p_y -= i_spy;
-        vlc_memcpy(p_dy, p_y, i_width); p_dy -= i_dpy; p_y -= i_spy;
-        vlc_memcpy(p_du, p_u, i_width/2); p_du -= i_dpuv; p_u -= 2*i_spuv;
-        vlc_memcpy(p_dv, p_v, i_width/2); p_dv -= i_dpuv; p_v -= 2*i_spuv;
-    }
+    i422_slice_t slice = { p_source, p_dest, false };
+
+    filter_Slice( p_filter, I422_420_Lines, &slice );
 }
 
 /*****************************************************************************
@@ -147,27 +173,9 @@ static void I422_I420( filter_t *p_filter, picture_t *p_source,
 static void I422_YV12( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
-    uint16_t i_dpy = p_dest->p[Y_PLANE].i_pitch;
-    uint16_t i_spy = p_source->p[Y_PLANE].i_pitch;
-    uint16_t i_dpuv = p_dest->p[U_PLANE].i_pitch;
-    uint16_t i_spuv = p_source->p[U_PLANE].i_pitch;
-    uint16_t i_width = p_filter->fmt_in.video.i_width;
-    uint16_t i_y = p_filter->fmt_in.video.i_height;
-    uint8_t *p_dy = p_dest->Y_PIXELS + (i_y-1)*i_dpy;
-    uint8_t *p_y = p_source->Y_PIXELS + (i_y-1)*i_spy;
-    uint8_t *p_du = p_dest->V_PIXELS + (i_y/2-1)*i_dpuv; /* U and V are swapped */
-    uint8_t *p_u = p_source->U_PIXELS + (i_y-1)*i_spuv;
-    uint8_t *p_dv = p_dest->U_PIXELS + (i_y/2-1)*i_dpuv; /* U and V are swapped */
-    uint8_t *p_v = p_source->V_PIXELS + (i_y-1)*i_spuv;
-    i_y /= 2;
-
-    for ( ; i_y--; )
-    {
-        vlc_memcpy(p_dy, p_y, i_width); p_dy -= i_dpy; p_y -= i_spy;
-        vlc_memcpy(p_dy, p_y, i_width); p_dy -= i_dpy; p_y -= i_spy;
-        vlc_memcpy(p_du, p_u, i_width/2); p_du -= i_dpuv; p_u -= 2*i_spuv;
-        vlc_memcpy(p_dv, p_v, i_width/2); p_dv -= i_dpuv; p_v -= 2*i_spuv;
-    }
+    i422_slice_t slice = { p_source, p_dest, true }; /* U and V are swapped */
+
+    filter_Slice( p_filter, I422_420_Lines, &slice );
 }
 
 /*****************************************************************************
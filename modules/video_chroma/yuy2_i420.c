@@ -32,8 +32,17 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 
-#define SRC_FOURCC "YUY2,YUNV,YVYU,UYVY,UYNV,Y422,cyuv"
+#include "yuy2_i422.h"
+
+#if defined (MODULE_NAME_IS_yuy2_i420)
+#    define SRC_FOURCC "YUY2,YUNV,YVYU,UYVY,UYNV,Y422,cyuv"
+#    define VLC_TARGET
+#elif defined (MODULE_NAME_IS_yuy2_i420_sse2)
+#    define SRC_FOURCC "YUY2,YUNV,YVYU,UYVY,UYNV,Y422"
+#    define VLC_TARGET VLC_SSE
+#endif
 #define DEST_FOURCC  "I420"
 
 /*****************************************************************************
@@ -44,19 +53,28 @@ static int  Activate ( vlc_object_t * );
 static void YUY2_I420           ( filter_t *, picture_t *, picture_t * );
 static void YVYU_I420           ( filter_t *, picture_t *, picture_t * );
 static void UYVY_I420           ( filter_t *, picture_t *, picture_t * );
-static void cyuv_I420           ( filter_t *, picture_t *, picture_t * );
 
 static picture_t *YUY2_I420_Filter    ( filter_t *, picture_t * );
 static picture_t *YVYU_I420_Filter    ( filter_t *, picture_t * );
 static picture_t *UYVY_I420_Filter    ( filter_t *, picture_t * );
+#if defined (MODULE_NAME_IS_yuy2_i420)
+static void cyuv_I420           ( filter_t *, picture_t *, picture_t * );
 static picture_t *cyuv_I420_Filter    ( filter_t *, picture_t * );
+#endif
 
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
 vlc_module_begin ()
+#if defined (MODULE_NAME_IS_yuy2_i420)
     set_description( N_("Conversions from " SRC_FOURCC " to " DEST_FOURCC) )
     set_capability( "video filter2", 80 )
+# define CPU_CAPABILITY 0
+#elif defined (MODULE_NAME_IS_yuy2_i420_sse2)
+    set_description( N_("SSE2 conversions from " SRC_FOURCC " to " DEST_FOURCC) )
+    set_capability( "video filter2", 250 )
+# define CPU_CAPABILITY CPU_CAPABILITY_SSE2
+#endif
     set_callbacks( Activate, NULL )
 vlc_module_end ()
 
@@ -69,6 +87,10 @@ static int Activate( vlc_object_t *p_this )
 {
     filter_t *p_filter = (filter_t *)p_this;
 
+#if CPU_CAPABILITY
+    if( !(vlc_CPU() & CPU_CAPABILITY) )
+        return VLC_EGENERIC;
+#endif
     if( p_filter->fmt_in.video.i_width & 1
      || p_filter->fmt_in.video.i_height & 1 )
     {
@@ -96,9 +118,11 @@ static int Activate( vlc_object_t *p_this )
                     p_filter->pf_video_filter = UYVY_I420_Filter;
                     break;
 
+#if defined (MODULE_NAME_IS_yuy2_i420)
                 case VLC_CODEC_CYUV:
                     p_filter->pf_video_filter = cyuv_I420_Filter;
                     break;
+#endif
 
                 default:
                     return -1;
@@ -115,11 +139,14 @@ static int Activate( vlc_object_t *p_this )
 VIDEO_FILTER_WRAPPER( YUY2_I420 )
 VIDEO_FILTER_WRAPPER( YVYU_I420 )
 VIDEO_FILTER_WRAPPER( UYVY_I420 )
+#if defined (MODULE_NAME_IS_yuy2_i420)
 VIDEO_FILTER_WRAPPER( cyuv_I420 )
+#endif
 
 /*****************************************************************************
  * YUY2_I420: packed YUY2 4:2:2 to planar YUV 4:2:0
  *****************************************************************************/
+VLC_TARGET
 static void YUY2_I420( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
@@ -144,7 +171,15 @@ static void YUY2_I420( filter_t *p_filter, picture_t *p_source,
     {
         if( b_skip )
         {
+#if defined (MODULE_NAME_IS_yuy2_i420_sse2)
+            for( i_x = p_filter->fmt_out.video.i_width / 16 ; i_x-- ; )
+            {
+                SSE2_CALL_Y( SSE2_YUYV_Y );
+            }
+            for( i_x = ( p_filter->fmt_out.video.i_width % 16 ) / 8 ; i_x-- ; )
+#else
             for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
+#endif
             {
     #define C_YUYV_YUV422_skip( p_line, p_y, p_u, p_v )      \
                 *p_y++ = *p_line++; p_line++; \
@@ -161,7 +196,15 @@ static void YUY2_I420( filter_t *p_filter, picture_t *p_source,
         }
         else
         {
+#if defined (MODULE_NAME_IS_yuy2_i420_sse2)
+            for( i_x = p_filter->fmt_out.video.i_width / 16 ; i_x-- ; )
+            {
+                SSE2_CALL( SSE2_YUYV_YUV422( "%2", "%3" ) );
+            }
+            for( i_x = ( p_filter->fmt_out.video.i_width % 16 ) / 8 ; i_x-- ; )
+#else
             for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
+#endif
             {
     #define C_YUYV_YUV422( p_line, p_y, p_u, p_v )      \
                 *p_y++ = *p_line++; *p_u++ = *p_line++; \
@@ -188,6 +231,7 @@ static void YUY2_I420( filter_t *p_filter, picture_t *p_source,
 /*****************************************************************************
  * YVYU_I420: packed YVYU 4:2:2 to planar YUV 4:2:0
  *****************************************************************************/
+VLC_TARGET
 static void YVYU_I420( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
@@ -212,7 +256,15 @@ static void YVYU_I420( filter_t *p_filter, picture_t *p_source,
     {
         if( b_skip )
         {
+#if defined (MODULE_NAME_IS_yuy2_i420_sse2)
+            for( i_x = p_filter->fmt_out.video.i_width / 16 ; i_x-- ; )
+            {
+                SSE2_CALL_Y( SSE2_YUYV_Y );
+            }
+            for( i_x = ( p_filter->fmt_out.video.i_width % 16 ) / 8 ; i_x-- ; )
+#else
             for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
+#endif
             {
     #define C_YVYU_YUV422_skip( p_line, p_y, p_u, p_v )      \
                 *p_y++ = *p_line++; p_line++; \
@@ -229,7 +281,15 @@ static void YVYU_I420( filter_t *p_filter, picture_t *p_source,
         }
         else
         {
+#if defined (MODULE_NAME_IS_yuy2_i420_sse2)
+            for( i_x = p_filter->fmt_out.video.i_width / 16 ; i_x-- ; )
+            {
+                SSE2_CALL( SSE2_YUYV_YUV422( "%3", "%2" ) );
+            }
+            for( i_x = ( p_filter->fmt_out.video.i_width % 16 ) / 8 ; i_x-- ; )
+#else
             for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
+#endif
             {
     #define C_YVYU_YUV422( p_line, p_y, p_u, p_v )      \
                 *p_y++ = *p_line++; *p_v++ = *p_line++; \
@@ -256,6 +316,7 @@ static void YVYU_I420( filter_t *p_filter, picture_t *p_source,
 /*****************************************************************************
  * UYVY_I420: packed UYVY 4:2:2 to planar YUV 4:2:0
  *****************************************************************************/
+VLC_TARGET
 static void UYVY_I420( filter_t *p_filter, picture_t *p_source,
                                            picture_t *p_dest )
 {
@@ -280,11 +341,19 @@ static void UYVY_I420( filter_t *p_filter, picture_t *p_source,
     {
         if( b_skip )
         {
+#if defined (MODULE_NAME_IS_yuy2_i420_sse2)
+            for( i_x = p_filter->fmt_out.video.i_width / 16 ; i_x-- ; )
+            {
+                SSE2_CALL_Y( SSE2_UYVY_Y );
+            }
+            for( i_x = ( p_filter->fmt_out.video.i_width % 16 ) / 8 ; i_x-- ; )
+#else
             for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
+#endif
             {
     #define C_UYVY_YUV422_skip( p_line, p_y, p_u, p_v )      \
-                *p_u++ = *p_line++; p_line++; \
-                *p_v++ = *p_line++; p_line++
+                p_line++; *p_y++ = *p_line++; \
+                p_line++; *p_y++ = *p_line++
                 C_UYVY_YUV422_skip( p_line, p_y, p_u, p_v );
                 C_UYVY_YUV422_skip( p_line, p_y, p_u, p_v );
                 C_UYVY_YUV422_skip( p_line, p_y, p_u, p_v );
@@ -297,7 +366,15 @@ static void UYVY_I420( filter_t *p_filter, picture_t *p_source,
         }
         else
         {
+#if defined (MODULE_NAME_IS_yuy2_i420_sse2)
+            for( i_x = p_filter->fmt_out.video.i_width / 16 ; i_x-- ; )
+            {
+                SSE2_CALL( SSE2_UYVY_YUV422 );
+            }
+            for( i_x = ( p_filter->fmt_out.video.i_width % 16 ) / 8 ; i_x-- ; )
+#else
             for( i_x = p_filter->fmt_out.video.i_width / 8 ; i_x-- ; )
+#endif
             {
     #define C_UYVY_YUV422( p_line, p_y, p_u, p_v )      \
                 *p_u++ = *p_line++; *p_y++ = *p_line++; \
@@ -321,6 +398,7 @@ static void UYVY_I420( filter_t *p_filter, picture_t *p_source,
     }
 }
 
+#if defined (MODULE_NAME_IS_yuy2_i420)
 /*****************************************************************************
  * cyuv_I420: upside-down packed UYVY 4:2:2 to planar YUV 4:2:0
  * FIXME
@@ -389,3 +467,4 @@ static void cyuv_I420( filter_t *p_filter, picture_t *p_source,
         b_skip = !b_skip;
     }
 }
+#endif
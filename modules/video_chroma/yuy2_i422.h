@@ -0,0 +1,124 @@
+/*****************************************************************************
+ * yuy2_i422.h : Packed YUV 4:2:2 to Planar YUV conversion module for vlc
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Shared by yuy2_i422 and yuy2_i420, which drops the chroma of every other
+ * line */
+
+#if defined( MODULE_NAME_IS_yuy2_i422_sse2 ) \
+ || defined( MODULE_NAME_IS_yuy2_i420_sse2 )
+
+#if defined(CAN_COMPILE_SSE2)
+
+/* SSE2 assembly, 16 pixels at a time */
+
+#define SSE2_CALL(SSE2_INSTRUCTIONS)    \
+    do {                                \
+    __asm__ __volatile__(               \
+        ".p2align 3 \n\t                \
+pcmpeqw   %%xmm7, %%xmm7  #                   ffff ffff .. ffff ffff      \n\
+psrlw        $8, %%xmm7   # Build a mask      00ff 00ff .. 00ff 00ff      \n\
+"                                       \
+        SSE2_INSTRUCTIONS               \
+        :                               \
+        : "r" (p_line), "r" (p_y),      \
+          "r" (p_u), "r" (p_v)          \
+        : "xmm0", "xmm1", "xmm2", "xmm3", "xmm7", "memory"); \
+        p_line += 32; p_y += 16;        \
+        p_u += 8; p_v += 8;             \
+    } while(0)
+
+/* Luma only */
+#define SSE2_CALL_Y(SSE2_INSTRUCTIONS)  \
+    do {                                \
+    __asm__ __volatile__(               \
+        ".p2align 3 \n\t                \
+pcmpeqw   %%xmm7, %%xmm7  #                   ffff ffff .. ffff ffff      \n\
+psrlw        $8, %%xmm7   # Build a mask      00ff 00ff .. 00ff 00ff      \n\
+"                                       \
+        SSE2_INSTRUCTIONS               \
+        :                               \
+        : "r" (p_line), "r" (p_y)       \
+        : "xmm0", "xmm1", "xmm7", "memory"); \
+        p_line += 32; p_y += 16;        \
+    } while(0)
+
+#define SSE2_YUYV_YUV422( U, V ) "                                        \n\
+movdqu      (%0), %%xmm0  # Load 8 YUYV       v3 y7 u3 y6 .. v0 y1 u0 y0  \n\
+movdqu    16(%0), %%xmm1  # Load 8 YUYV       v7 yf u7 ye .. v4 y9 u4 y8  \n\
+movdqa    %%xmm0, %%xmm2  #                   v3 y7 u3 y6 .. v0 y1 u0 y0  \n\
+movdqa    %%xmm1, %%xmm3  #                   v7 yf u7 ye .. v4 y9 u4 y8  \n\
+pand      %%xmm7, %%xmm0  #                   00 y7 00 y6 .. 00 y1 00 y0  \n\
+pand      %%xmm7, %%xmm1  #                   00 yf 00 ye .. 00 y9 00 y8  \n\
+psrlw        $8, %%xmm2   #                   00 v3 00 u3 .. 00 v0 00 u0  \n\
+psrlw        $8, %%xmm3   #                   00 v7 00 u7 .. 00 v4 00 u4  \n\
+packuswb  %%xmm1, %%xmm0  #                   yf ye yd yc .. y2 y1 y0     \n\
+packuswb  %%xmm3, %%xmm2  #                   v7 u7 v6 u6 .. v0 u0        \n\
+movdqu    %%xmm0, (%1)    # Store 16 Y                                    \n\
+movdqa    %%xmm2, %%xmm3  #                   v7 u7 v6 u6 .. v0 u0        \n\
+pand      %%xmm7, %%xmm2  #                   00 u7 00 u6 .. 00 u0        \n\
+psrlw        $8, %%xmm3   #                   00 v7 00 v6 .. 00 v0        \n\
+packuswb  %%xmm2, %%xmm2  #                   .. u7 u6 u5 u4 u3 u2 u1 u0  \n\
+packuswb  %%xmm3, %%xmm3  #                   .. v7 v6 v5 v4 v3 v2 v1 v0  \n\
+movq      %%xmm2, (" U ") # Store 8 U                                     \n\
+movq      %%xmm3, (" V ") # Store 8 V                                     \n\
+"
+
+#define SSE2_UYVY_YUV422 "                                                \n\
+movdqu      (%0), %%xmm0  # Load 8 UYVY       y7 v3 y6 u3 .. y1 v0 y0 u0  \n\
+movdqu    16(%0), %%xmm1  # Load 8 UYVY       yf v7 ye u7 .. y9 v4 y8 u4  \n\
+movdqa    %%xmm0, %%xmm2  #                   y7 v3 y6 u3 .. y1 v0 y0 u0  \n\
+movdqa    %%xmm1, %%xmm3  #                   yf v7 ye u7 .. y9 v4 y8 u4  \n\
+psrlw        $8, %%xmm0   #                   00 y7 00 y6 .. 00 y1 00 y0  \n\
+psrlw        $8, %%xmm1   #                   00 yf 00 ye .. 00 y9 00 y8  \n\
+pand      %%xmm7, %%xmm2  #                   00 v3 00 u3 .. 00 v0 00 u0  \n\
+pand      %%xmm7, %%xmm3  #                   00 v7 00 u7 .. 00 v4 00 u4  \n\
+packuswb  %%xmm1, %%xmm0  #                   yf ye yd yc .. y2 y1 y0     \n\
+packuswb  %%xmm3, %%xmm2  #                   v7 u7 v6 u6 .. v0 u0        \n\
+movdqu    %%xmm0, (%1)    # Store 16 Y                                    \n\
+movdqa    %%xmm2, %%xmm3  #                   v7 u7 v6 u6 .. v0 u0        \n\
+pand      %%xmm7, %%xmm2  #                   00 u7 00 u6 .. 00 u0        \n\
+psrlw        $8, %%xmm3   #                   00 v7 00 v6 .. 00 v0        \n\
+packuswb  %%xmm2, %%xmm2  #                   .. u7 u6 u5 u4 u3 u2 u1 u0  \n\
+packuswb  %%xmm3, %%xmm3  #                   .. v7 v6 v5 v4 v3 v2 v1 v0  \n\
+movq      %%xmm2, (%2)    # Store 8 U                                     \n\
+movq      %%xmm3, (%3)    # Store 8 V                                     \n\
+"
+
+#define SSE2_YUYV_Y "                                                     \n\
+movdqu      (%0), %%xmm0  # Load 8 YUYV       v3 y7 u3 y6 .. v0 y1 u0 y0  \n\
+movdqu    16(%0), %%xmm1  # Load 8 YUYV       v7 yf u7 ye .. v4 y9 u4 y8  \n\
+pand      %%xmm7, %%xmm0  #                   00 y7 00 y6 .. 00 y1 00 y0  \n\
+pand      %%xmm7, %%xmm1  #                   00 yf 00 ye .. 00 y9 00 y8  \n\
+packuswb  %%xmm1, %%xmm0  #                   yf ye yd yc .. y2 y1 y0     \n\
+movdqu    %%xmm0, (%1)    # Store 16 Y                                    \n\
+"
+
+#define SSE2_UYVY_Y "                                                     \n\
+movdqu      (%0), %%xmm0  # Load 8 UYVY       y7 v3 y6 u3 .. y1 v0 y0 u0  \n\
+movdqu    16(%0), %%xmm1  # Load 8 UYVY       yf v7 ye u7 .. y9 v4 y8 u4  \n\
+psrlw        $8, %%xmm0   #                   00 y7 00 y6 .. 00 y1 00 y0  \n\
+psrlw        $8, %%xmm1   #                   00 yf 00 ye .. 00 y9 00 y8  \n\
+packuswb  %%xmm1, %%xmm0  #                   yf ye yd yc .. y2 y1 y0     \n\
+movdqu    %%xmm0, (%1)    # Store 16 Y                                    \n\
+"
+
+#endif
+
+#endif
@@ -215,6 +215,62 @@ static void Destroy( vlc_object_t *p_this )
     free( p_sys );
 }
 
+/*****************************************************************************
+ * Apply the luma lookup table to one band of a Planar YUV picture
+ *****************************************************************************/
+typedef struct
+{
+    picture_t *p_pic;
+    picture_t *p_outpic;
+    const int *pi_luma;
+} adjust_slice_t;
+
+static void FilterPlanarLuma( filter_t *p_filter, void *p_data,
+                              unsigned i_slice, unsigned i_slices )
+{
+    const adjust_slice_t *p_slice = p_data;
+    const plane_t *p_src = &p_slice->p_pic->p[Y_PLANE];
+    const plane_t *p_dst = &p_slice->p_outpic->p[Y_PLANE];
+    const int *pi_luma = p_slice->pi_luma;
+    uint8_t *p_in, *p_in_end, *p_line_end;
+    uint8_t *p_out;
+    int i_start, i_end;
+
+    VLC_UNUSED(p_filter);
+
+    filter_SliceLines( p_src->i_visible_lines, 1, i_slice, i_slices,
+                       &i_start, &i_end );
+
+    p_in = p_src->p_pixels + i_start * p_src->i_pitch;
+    p_in_end = p_src->p_pixels + i_end * p_src->i_pitch;
+
+    p_out = p_dst->p_pixels + i_start * p_dst->i_pitch;
+
+    for( ; p_in < p_in_end ; )
+    {
+        p_line_end = p_in + p_src->i_visible_pitch - 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            /* Do 8 pixels at a time */
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_line_end += 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_in += p_src->i_pitch - p_src->i_visible_pitch;
+        p_out += p_dst->i_pitch - p_dst->i_visible_pitch;
+    }
+}
+
 /*****************************************************************************
  * Run the filter on a Planar YUV picture
  *****************************************************************************/
@@ -224,8 +280,7 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     int pi_gamma[256];
 
     picture_t *p_outpic;
-    uint8_t *p_in, *p_in_end, *p_line_end;
-    uint8_t *p_out;
+    adjust_slice_t slice;
 
     bool b_thres;
     double  f_hue;
@@ -295,40 +350,13 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     }
 
     /*
-     * Do the Y plane
+     * Do the Y plane, in bands
      */
 
-    p_in = p_pic->p[Y_PLANE].p_pixels;
-    p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-                      * p_pic->p[Y_PLANE].i_pitch - 8;
-
-    p_out = p_outpic->p[Y_PLANE].p_pixels;
-
-    for( ; p_in < p_in_end ; )
-    {
-        p_line_end = p_in + p_pic->p[Y_PLANE].i_visible_pitch - 8;
-
-        for( ; p_in < p_line_end ; )
-        {
-            /* Do 8 pixels at a time */
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-        }
-
-        p_line_end += 8;
-
-        for( ; p_in < p_line_end ; )
-        {
-            *p_out++ = pi_luma[ *p_in++ ];
-        }
-
-        p_in += p_pic->p[Y_PLANE].i_pitch
-              - p_pic->p[Y_PLANE].i_visible_pitch;
-        p_out += p_outpic->p[Y_PLANE].i_pitch
-               - p_outpic->p[Y_PLANE].i_visible_pitch;
-    }
+    slice.p_pic = p_pic;
+    slice.p_outpic = p_outpic;
+    slice.pi_luma = pi_luma;
+    filter_Slice( p_filter, FilterPlanarLuma, &slice );
 
     /*
      * Do the U and V planes
@@ -32,6 +32,7 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
 /*****************************************************************************
@@ -83,6 +84,19 @@ public:
     {
         return true;
     }
+    /* Direct access for the span kernels */
+    const picture_t *getPicture() const
+    {
+        return picture;
+    }
+    unsigned getX() const
+    {
+        return x;
+    }
+    unsigned getY() const
+    {
+        return y;
+    }
 
 protected:
     template <unsigned ry>
@@ -262,6 +276,21 @@ private:
     uint8_t *data;
 };
 
+static void getRgbOffsets(const video_format_t *fmt, unsigned bytes,
+                          unsigned *offset_r, unsigned *offset_g, unsigned *offset_b)
+{
+#ifdef WORDS_BIGENDIAN
+    *offset_r = (8 * bytes - fmt->i_lrshift) / 8;
+    *offset_g = (8 * bytes - fmt->i_lgshift) / 8;
+    *offset_b = (8 * bytes - fmt->i_lbshift) / 8;
+#else
+    VLC_UNUSED(bytes);
+    *offset_r = fmt->i_lrshift / 8;
+    *offset_g = fmt->i_lgshift / 8;
+    *offset_b = fmt->i_lbshift / 8;
+#endif
+}
+
 template <unsigned bytes, bool has_alpha>
 class CPictureRGBX : public CPicture {
 public:
@@ -273,15 +302,7 @@ public:
             offset_b = 2;
             offset_a = 3;
         } else {
-#ifdef WORDS_BIGENDIAN
-            offset_r = (8 * bytes - fmt->i_lrshift) / 8;
-            offset_g = (8 * bytes - fmt->i_lgshift) / 8;
-            offset_b = (8 * bytes - fmt->i_lbshift) / 8;
-#else
-            offset_r = fmt->i_lrshift / 8;
-            offset_g = fmt->i_lgshift / 8;
-            offset_b = fmt->i_lbshift / 8;
-#endif
+            getRgbOffsets(fmt, bytes, &offset_r, &offset_g, &offset_b);
         }
         data = CPicture::getLine<1>(0);
     }
@@ -523,6 +544,401 @@ void Blend(const CPicture &dst_data, const CPicture &src_data,
 typedef void (*blend_function_t)(const CPicture &dst_data, const CPicture &src_data,
                                  unsigned width, unsigned height, int alpha);
 
+/*****************************************************************************
+ * Span kernels
+ *****************************************************************************
+ * For the most common cases (8 bits YUVA or RGBA subpictures onto 8 bits
+ * planar, semi planar or 32 bits RGB pictures), the blending is done line by
+ * line on spans of 8 destination pixels. Fully transparent spans are skipped
+ * without touching the destination. The kernels give exactly the same
+ * results as the generic Blend<>().
+ *****************************************************************************/
+static inline void mergeAlpha(uint8_t *dst, unsigned src, unsigned a, unsigned alpha)
+{
+    merge(dst, src, div255(alpha * a));
+}
+
+static inline bool isTransparent(const uint8_t *a, unsigned count)
+{
+    for (unsigned i = 0; i < count; i += 8) {
+        uint64_t v;
+        memcpy(&v, &a[i], sizeof(v));
+        if (v)
+            return false;
+    }
+    return true;
+}
+
+struct CBlendKernels {
+    /* dst[i] with src[i] and a[i] */
+    static void plane(uint8_t *dst, const uint8_t *src, const uint8_t *a, unsigned alpha)
+    {
+        for (unsigned i = 0; i < 8; i++)
+            mergeAlpha(&dst[i], src[i], a[i], alpha);
+    }
+    /* dst[i] with src[2*i] and a[2*i] */
+    static void planeSub(uint8_t *dst, const uint8_t *src, const uint8_t *a, unsigned alpha)
+    {
+        for (unsigned i = 0; i < 8; i++)
+            mergeAlpha(&dst[i], src[2 * i], a[2 * i], alpha);
+    }
+    /* dst[2*i] with u[2*i] and dst[2*i+1] with v[2*i], using a[2*i] */
+    static void planeUV(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                        const uint8_t *a, unsigned alpha)
+    {
+        for (unsigned i = 0; i < 8; i++) {
+            mergeAlpha(&dst[2 * i + 0], u[2 * i], a[2 * i], alpha);
+            mergeAlpha(&dst[2 * i + 1], v[2 * i], a[2 * i], alpha);
+        }
+    }
+    /* dst[4*i+c] with src[4*i+c] and a[i] */
+    static void packed32(uint8_t *dst, const uint8_t *src, const uint8_t *a, unsigned alpha)
+    {
+        for (unsigned i = 0; i < 8; i++)
+            for (unsigned c = 0; c < 4; c++)
+                mergeAlpha(&dst[4 * i + c], src[4 * i + c], a[i], alpha);
+    }
+};
+
+#ifdef CAN_COMPILE_SSE2
+/* Constants: xmm4 = 1, xmm5 = 255, xmm6 = alpha, xmm7 = 0 (words) */
+#define SSE2_INIT \
+    "pxor       %%xmm7, %%xmm7\n" \
+    "pcmpeqw    %%xmm5, %%xmm5\n" \
+    "psrlw      $8,     %%xmm5\n" \
+    "pcmpeqw    %%xmm4, %%xmm4\n" \
+    "psrlw      $15,    %%xmm4\n" \
+    "movd       %[alpha], %%xmm6\n" \
+    "pshuflw    $0, %%xmm6, %%xmm6\n" \
+    "punpcklqdq %%xmm6, %%xmm6\n"
+/* xmm0 = div255(alpha * xmm0), clobbers xmm1 */
+#define SSE2_ALPHA \
+    "pmullw     %%xmm6, %%xmm0\n" \
+    "movdqa     %%xmm0, %%xmm1\n" \
+    "psrlw      $8,     %%xmm1\n" \
+    "paddw      %%xmm1, %%xmm0\n" \
+    "paddw      %%xmm4, %%xmm0\n" \
+    "psrlw      $8,     %%xmm0\n"
+/* d = div255((255 - xmm0) * d + xmm0 * s), clobbers s and xmm3 */
+#define SSE2_MERGE(d, s) \
+    "pmullw     %%xmm0, %%" #s "\n" \
+    "movdqa     %%xmm5, %%xmm3\n" \
+    "psubw      %%xmm0, %%xmm3\n" \
+    "pmullw     %%xmm3, %%" #d "\n" \
+    "paddw      %%" #s ", %%" #d "\n" \
+    "movdqa     %%" #d ", %%" #s "\n" \
+    "psrlw      $8,     %%" #s "\n" \
+    "paddw      %%" #s ", %%" #d "\n" \
+    "paddw      %%xmm4, %%" #d "\n" \
+    "psrlw      $8,     %%" #d "\n"
+
+#define SSE2_CLOBBERS "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "memory"
+
+struct SSE2BlendKernels {
+    VLC_SSE
+    static void plane(uint8_t *dst, const uint8_t *src, const uint8_t *a, unsigned alpha)
+    {
+        asm volatile (
+            SSE2_INIT
+            "movq       (%[a]),   %%xmm0\n"
+            "punpcklbw  %%xmm7,   %%xmm0\n"
+            SSE2_ALPHA
+            "movq       (%[src]), %%xmm1\n"
+            "punpcklbw  %%xmm7,   %%xmm1\n"
+            "movq       (%[dst]), %%xmm2\n"
+            "punpcklbw  %%xmm7,   %%xmm2\n"
+            SSE2_MERGE(xmm2, xmm1)
+            "packuswb   %%xmm2,   %%xmm2\n"
+            "movq       %%xmm2,   (%[dst])\n"
+            : : [dst]"r"(dst), [src]"r"(src), [a]"r"(a), [alpha]"r"(alpha)
+            : SSE2_CLOBBERS);
+    }
+    VLC_SSE
+    static void planeSub(uint8_t *dst, const uint8_t *src, const uint8_t *a, unsigned alpha)
+    {
+        asm volatile (
+            SSE2_INIT
+            "movdqu     (%[a]),   %%xmm0\n"
+            "pand       %%xmm5,   %%xmm0\n"
+            SSE2_ALPHA
+            "movdqu     (%[src]), %%xmm1\n"
+            "pand       %%xmm5,   %%xmm1\n"
+            "movq       (%[dst]), %%xmm2\n"
+            "punpcklbw  %%xmm7,   %%xmm2\n"
+            SSE2_MERGE(xmm2, xmm1)
+            "packuswb   %%xmm2,   %%xmm2\n"
+            "movq       %%xmm2,   (%[dst])\n"
+            : : [dst]"r"(dst), [src]"r"(src), [a]"r"(a), [alpha]"r"(alpha)
+            : SSE2_CLOBBERS);
+    }
+    VLC_SSE
+    static void planeUV(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                        const uint8_t *a, unsigned alpha)
+    {
+        asm volatile (
+            SSE2_INIT
+            "movdqu     (%[a]),   %%xmm0\n"
+            "pand       %%xmm5,   %%xmm0\n"
+            SSE2_ALPHA
+            "movdqu     (%[dst]), %%xmm2\n"
+            "movdqa     %%xmm2,   %%xmm7\n"
+            "psrlw      $8,       %%xmm7\n"
+            "pand       %%xmm5,   %%xmm2\n"
+            "movdqu     (%[u]),   %%xmm1\n"
+            "pand       %%xmm5,   %%xmm1\n"
+            SSE2_MERGE(xmm2, xmm1)
+            "movdqu     (%[v]),   %%xmm1\n"
+            "pand       %%xmm5,   %%xmm1\n"
+            SSE2_MERGE(xmm7, xmm1)
+            "psllw      $8,       %%xmm7\n"
+            "por        %%xmm7,   %%xmm2\n"
+            "movdqu     %%xmm2,   (%[dst])\n"
+            : : [dst]"r"(dst), [u]"r"(u), [v]"r"(v), [a]"r"(a), [alpha]"r"(alpha)
+            : SSE2_CLOBBERS);
+    }
+    VLC_SSE
+    static void packed32(uint8_t *dst, const uint8_t *src, const uint8_t *a, unsigned alpha)
+    {
+        /* xmm6 keeps the 8 alpha values, xmm0 gets them per component */
+#define SSE2_PACKED32(unpack_w, unpack_d, offset) \
+            "movdqa     %%xmm6,   %%xmm0\n" \
+            unpack_w "  %%xmm0,   %%xmm0\n" \
+            unpack_d "  %%xmm0,   %%xmm0\n" \
+            "movq       " #offset "(%[src]), %%xmm1\n" \
+            "punpcklbw  %%xmm7,   %%xmm1\n" \
+            "movq       " #offset "(%[dst]), %%xmm2\n" \
+            "punpcklbw  %%xmm7,   %%xmm2\n" \
+            SSE2_MERGE(xmm2, xmm1) \
+            "packuswb   %%xmm2,   %%xmm2\n" \
+            "movq       %%xmm2,   " #offset "(%[dst])\n"
+        asm volatile (
+            SSE2_INIT
+            "movq       (%[a]),   %%xmm0\n"
+            "punpcklbw  %%xmm7,   %%xmm0\n"
+            SSE2_ALPHA
+            "movdqa     %%xmm0,   %%xmm6\n"
+            SSE2_PACKED32("punpcklwd", "punpckldq",  0)
+            SSE2_PACKED32("punpcklwd", "punpckhdq",  8)
+            SSE2_PACKED32("punpckhwd", "punpckldq", 16)
+            SSE2_PACKED32("punpckhwd", "punpckhdq", 24)
+            : : [dst]"r"(dst), [src]"r"(src), [a]"r"(a), [alpha]"r"(alpha)
+            : SSE2_CLOBBERS);
+#undef SSE2_PACKED32
+    }
+};
+#undef SSE2_INIT
+#undef SSE2_ALPHA
+#undef SSE2_MERGE
+#undef SSE2_CLOBBERS
+#endif
+
+/* Blends count pixels of src onto dst */
+template <class K>
+static void BlendSpan(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                      unsigned count, unsigned alpha)
+{
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8) {
+        if (!isTransparent(&a[i], 8))
+            K::plane(&dst[i], &src[i], &a[i], alpha);
+    }
+    for (; i < count; i++)
+        mergeAlpha(&dst[i], src[i], a[i], alpha);
+}
+
+/* Blends count pixels of the even pixels of src (src_count pixels) onto dst */
+template <class K>
+static void BlendSpanSub(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                         unsigned count, unsigned src_count, unsigned alpha)
+{
+    unsigned i = 0;
+    for (; i + 8 <= count && 2 * i + 16 <= src_count; i += 8) {
+        if (!isTransparent(&a[2 * i], 16))
+            K::planeSub(&dst[i], &src[2 * i], &a[2 * i], alpha);
+    }
+    for (; i < count; i++)
+        mergeAlpha(&dst[i], src[2 * i], a[2 * i], alpha);
+}
+
+/* Same as BlendSpanSub() for interleaved U and V destination samples */
+template <class K>
+static void BlendSpanUV(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                        const uint8_t *a, unsigned count, unsigned src_count,
+                        unsigned alpha)
+{
+    unsigned i = 0;
+    for (; i + 8 <= count && 2 * i + 16 <= src_count; i += 8) {
+        if (!isTransparent(&a[2 * i], 16))
+            K::planeUV(&dst[2 * i], &u[2 * i], &v[2 * i], &a[2 * i], alpha);
+    }
+    for (; i < count; i++) {
+        mergeAlpha(&dst[2 * i + 0], u[2 * i], a[2 * i], alpha);
+        mergeAlpha(&dst[2 * i + 1], v[2 * i], a[2 * i], alpha);
+    }
+}
+
+/* Blends count 32 bits pixels of src onto dst, with one alpha per pixel */
+template <class K>
+static void BlendSpan32(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                        unsigned count, unsigned alpha)
+{
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8) {
+        if (!isTransparent(&a[i], 8))
+            K::packed32(&dst[4 * i], &src[4 * i], &a[i], alpha);
+    }
+    for (; i < count; i++)
+        for (unsigned c = 0; c < 4; c++)
+            mergeAlpha(&dst[4 * i + c], src[4 * i + c], a[i], alpha);
+}
+
+/* Source line, as 8 bits planes */
+struct CSpanSource {
+    const uint8_t *y, *u, *v, *a;
+};
+
+/* Blends a source line onto the line dst_y of a 4:2:0 picture, planar
+ * (uv_step = 1) or semi planar (uv_step = 2) */
+template <class K, unsigned uv_step, bool swap_uv>
+static void BlendLine420(const picture_t *dst, unsigned dst_x, unsigned dst_y,
+                         const CSpanSource &src, unsigned width, unsigned alpha)
+{
+    BlendSpan<K>(&dst->p[0].p_pixels[dst_y * dst->p[0].i_pitch + dst_x],
+                 src.y, src.a, width, alpha);
+
+    /* Only the source pixels on the chroma sites are used, as in Blend<> */
+    const unsigned first = dst_x % 2;
+    if ((dst_y % 2) != 0 || width <= first)
+        return;
+
+    const unsigned count = (width - first + 1) / 2;
+    const unsigned src_count = width - first;
+    const uint8_t *u = swap_uv ? src.v : src.u;
+    const uint8_t *v = swap_uv ? src.u : src.v;
+
+    if (uv_step == 2) {
+        uint8_t *uv = &dst->p[1].p_pixels[dst_y / 2 * dst->p[1].i_pitch +
+                                          (dst_x + first) / 2 * 2];
+        BlendSpanUV<K>(uv, &u[first], &v[first], &src.a[first],
+                       count, src_count, alpha);
+    } else {
+        const unsigned offset = (dst_x + first) / 2;
+        BlendSpanSub<K>(&dst->p[1].p_pixels[dst_y / 2 * dst->p[1].i_pitch + offset],
+                        &u[first], &src.a[first], count, src_count, alpha);
+        BlendSpanSub<K>(&dst->p[2].p_pixels[dst_y / 2 * dst->p[2].i_pitch + offset],
+                        &v[first], &src.a[first], count, src_count, alpha);
+    }
+}
+
+template <class K, unsigned uv_step, bool swap_uv>
+void BlendYUVATo420(const CPicture &dst_data, const CPicture &src_data,
+                    unsigned width, unsigned height, int alpha)
+{
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned sy = src_data.getY() + y;
+        const unsigned sx = src_data.getX();
+        CSpanSource line;
+
+        line.y = &src->p[0].p_pixels[sy * src->p[0].i_pitch + sx];
+        line.u = &src->p[1].p_pixels[sy * src->p[1].i_pitch + sx];
+        line.v = &src->p[2].p_pixels[sy * src->p[2].i_pitch + sx];
+        line.a = &src->p[3].p_pixels[sy * src->p[3].i_pitch + sx];
+
+        BlendLine420<K, uv_step, swap_uv>(dst, dst_data.getX(), dst_data.getY() + y,
+                                          line, width, alpha);
+    }
+}
+
+template <class K, bool swap_uv>
+void BlendRGBAToI420(const CPicture &dst_data, const CPicture &src_data,
+                     unsigned width, unsigned height, int alpha)
+{
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+
+    uint8_t *buffer = (uint8_t *)calloc(4, width);
+    if (!buffer) {
+        Blend<CPictureYUVPlanar<uint8_t, 2,2, false, swap_uv>, CPictureRGBA,
+              compose<convertNone, convertRgbToYuv8> >(dst_data, src_data,
+                                                       width, height, alpha);
+        return;
+    }
+    CSpanSource line;
+    line.y = &buffer[0 * width];
+    line.u = &buffer[1 * width];
+    line.v = &buffer[2 * width];
+    line.a = &buffer[3 * width];
+
+    for (unsigned y = 0; y < height; y++) {
+        const uint8_t *rgba = &src->p[0].p_pixels[(src_data.getY() + y) * src->p[0].i_pitch +
+                                                  src_data.getX() * 4];
+        uint8_t *a = &buffer[3 * width];
+
+        /* Only the visible pixels are converted */
+        for (unsigned x = 0; x < width; x++) {
+            a[x] = rgba[4 * x + 3];
+            if (a[x])
+                rgb_to_yuv(&buffer[0 * width + x], &buffer[1 * width + x],
+                           &buffer[2 * width + x],
+                           rgba[4 * x + 0], rgba[4 * x + 1], rgba[4 * x + 2]);
+        }
+        BlendLine420<K, 1, swap_uv>(dst, dst_data.getX(), dst_data.getY() + y,
+                                    line, width, alpha);
+    }
+    free(buffer);
+}
+
+template <class K>
+void BlendYUVAToRGB32(const CPicture &dst_data, const CPicture &src_data,
+                      unsigned width, unsigned height, int alpha)
+{
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+
+    /* The byte which is not a color component is blended with itself */
+    unsigned offset_r, offset_g, offset_b, offset_x;
+    getRgbOffsets(dst_data.getFormat(), 4, &offset_r, &offset_g, &offset_b);
+    const unsigned unused = 0xf & ~((1 << offset_r) | (1 << offset_g) | (1 << offset_b));
+    for (offset_x = 0; offset_x < 4 && !(unused & (1 << offset_x)); offset_x++);
+
+    uint8_t *buffer = NULL;
+    if (offset_r < 4 && offset_g < 4 && offset_b < 4 && unused == (1u << offset_x))
+        buffer = (uint8_t *)calloc(4, width);
+    if (!buffer) {
+        Blend<CPictureRGB32, CPictureYUVA, compose<convertNone, convertYuv8ToRgb> >(
+            dst_data, src_data, width, height, alpha);
+        return;
+    }
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned sy = src_data.getY() + y;
+        const unsigned sx = src_data.getX();
+        const uint8_t *sy_line = &src->p[0].p_pixels[sy * src->p[0].i_pitch + sx];
+        const uint8_t *su_line = &src->p[1].p_pixels[sy * src->p[1].i_pitch + sx];
+        const uint8_t *sv_line = &src->p[2].p_pixels[sy * src->p[2].i_pitch + sx];
+        const uint8_t *sa_line = &src->p[3].p_pixels[sy * src->p[3].i_pitch + sx];
+        uint8_t *d = &dst->p[0].p_pixels[(dst_data.getY() + y) * dst->p[0].i_pitch +
+                                         dst_data.getX() * 4];
+
+        /* Only the visible pixels are converted */
+        for (unsigned x = 0; x < width; x++) {
+            if (!sa_line[x])
+                continue;
+            int r, g, b;
+            yuv_to_rgb(&r, &g, &b, sy_line[x], su_line[x], sv_line[x]);
+            buffer[4 * x + offset_r] = r;
+            buffer[4 * x + offset_g] = g;
+            buffer[4 * x + offset_b] = b;
+            buffer[4 * x + offset_x] = d[4 * x + offset_x];
+        }
+        BlendSpan32<K>(d, buffer, sa_line, width, alpha);
+    }
+    free(buffer);
+}
+
 static const struct {
     vlc_fourcc_t     dst;
     vlc_fourcc_t     src;
@@ -591,6 +1007,32 @@ static const struct {
 #undef YUV
 };
 
+/* Checked before blends[], the first usable one is taken */
+static const struct {
+    vlc_fourcc_t     dst;
+    vlc_fourcc_t     src;
+    unsigned         cpu;
+    blend_function_t blend;
+} span_blends[] = {
+#define SPAN(cpu, kernels) \
+    { VLC_CODEC_I420,  VLC_CODEC_YUVA, cpu, BlendYUVATo420<kernels, 1, false> }, \
+    { VLC_CODEC_J420,  VLC_CODEC_YUVA, cpu, BlendYUVATo420<kernels, 1, false> }, \
+    { VLC_CODEC_YV12,  VLC_CODEC_YUVA, cpu, BlendYUVATo420<kernels, 1, true> }, \
+    { VLC_CODEC_NV12,  VLC_CODEC_YUVA, cpu, BlendYUVATo420<kernels, 2, false> }, \
+    { VLC_CODEC_NV21,  VLC_CODEC_YUVA, cpu, BlendYUVATo420<kernels, 2, true> }, \
+    { VLC_CODEC_RGB32, VLC_CODEC_YUVA, cpu, BlendYUVAToRGB32<kernels> }, \
+    { VLC_CODEC_I420,  VLC_CODEC_RGBA, cpu, BlendRGBAToI420<kernels, false> }, \
+    { VLC_CODEC_J420,  VLC_CODEC_RGBA, cpu, BlendRGBAToI420<kernels, false> }, \
+    { VLC_CODEC_YV12,  VLC_CODEC_RGBA, cpu, BlendRGBAToI420<kernels, true> }
+
+#ifdef CAN_COMPILE_SSE2
+    SPAN(CPU_CAPABILITY_SSE2, SSE2BlendKernels),
+#endif
+    SPAN(0,                   CBlendKernels),
+
+#undef SPAN
+};
+
 struct filter_sys_t {
     filter_sys_t() : blend(NULL)
     {
@@ -633,7 +1075,15 @@ static int Open(vlc_object_t *object)
     const vlc_fourcc_t dst = filter->fmt_out.video.i_chroma;
 
     filter_sys_t *sys = new filter_sys_t();
-    for (size_t i = 0; i < sizeof(blends) / sizeof(*blends); i++) {
+    const unsigned cpu = vlc_CPU();
+    for (size_t i = 0; i < sizeof(span_blends) / sizeof(*span_blends); i++) {
+        if (span_blends[i].src == src && span_blends[i].dst == dst &&
+            (span_blends[i].cpu & cpu) == span_blends[i].cpu) {
+            sys->blend = span_blends[i].blend;
+            break;
+        }
+    }
+    for (size_t i = 0; i < sizeof(blends) / sizeof(*blends) && !sys->blend; i++) {
         if (blends[i].src == src && blends[i].dst == dst)
             sys->blend = blends[i].blend;
     }
@@ -68,6 +68,18 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define BLEND_CHROMA_LONGTEXT N_("Chroma which the blend image will be loaded" \
                                  " in")
 
+#define ALL_TEXT N_("Benchmark all the chromas")
+#define ALL_LONGTEXT N_("Blend generated pictures for every pair of base " \
+                        "and blend chromas, instead of the given images")
+
+#define WIDTH_TEXT N_("Width of the generated pictures")
+#define WIDTH_LONGTEXT N_("Width of the pictures blended when benchmarking " \
+                          "all the chromas")
+
+#define HEIGHT_TEXT N_("Height of the generated pictures")
+#define HEIGHT_LONGTEXT N_("Height of the pictures blended when benchmarking " \
+                           "all the chromas")
+
 #define CFG_PREFIX "blendbench-"
 
 vlc_module_begin ()
@@ -95,12 +107,19 @@ vlc_module_begin ()
     add_string( CFG_PREFIX "blend-chroma", "YUVA", BLEND_CHROMA_TEXT,
               BLEND_CHROMA_LONGTEXT, false )
 
+    set_section( N_("All chromas"), NULL )
+    add_bool( CFG_PREFIX "all", false, ALL_TEXT, ALL_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "width", 1920, 16, 8192, WIDTH_TEXT,
+              WIDTH_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "height", 1080, 16, 8192, HEIGHT_TEXT,
+              HEIGHT_LONGTEXT, false )
+
     set_callbacks( Create, Destroy )
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
     "loops", "alpha", "base-image", "base-chroma", "blend-image",
-    "blend-chroma", NULL
+    "blend-chroma", "all", "width", "height", NULL
 };
 
 /*****************************************************************************
@@ -111,6 +130,9 @@ struct filter_sys_t
     bool b_done;
     int i_loops, i_alpha;
 
+    bool b_all;
+    int i_width, i_height;
+
     picture_t *p_base_image;
     picture_t *p_blend_image;
 
@@ -175,6 +197,14 @@ static int Create( vlc_object_t *p_this )
     p_sys->i_alpha = var_CreateGetIntegerCommand( p_filter,
                                                   CFG_PREFIX "alpha" );
 
+    p_sys->b_all = var_CreateGetBool( p_filter, CFG_PREFIX "all" );
+    p_sys->i_width = var_CreateGetInteger( p_filter, CFG_PREFIX "width" );
+    p_sys->i_height = var_CreateGetInteger( p_filter, CFG_PREFIX "height" );
+    p_sys->p_base_image = NULL;
+    p_sys->p_blend_image = NULL;
+    if( p_sys->b_all )
+        return VLC_SUCCESS;
+
     psz_temp = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-chroma" );
     p_sys->i_base_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
                                        psz_temp[2], psz_temp[3] );
@@ -210,8 +240,181 @@ static void Destroy( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
-    picture_Release( p_sys->p_base_image );
-    picture_Release( p_sys->p_blend_image );
+    if( p_sys->p_base_image )
+        picture_Release( p_sys->p_base_image );
+    if( p_sys->p_blend_image )
+        picture_Release( p_sys->p_blend_image );
+    free( p_sys );
+}
+
+/*****************************************************************************
+ * All chromas benchmark
+ *****************************************************************************/
+static const vlc_fourcc_t pi_base_chromas[] = {
+    VLC_CODEC_RGB15, VLC_CODEC_RGB16, VLC_CODEC_RGB24, VLC_CODEC_RGB32,
+    VLC_CODEC_YV9, VLC_CODEC_I410, VLC_CODEC_I411,
+    VLC_CODEC_YV12, VLC_CODEC_NV12, VLC_CODEC_NV21, VLC_CODEC_J420,
+    VLC_CODEC_I420,
+#ifdef WORDS_BIGENDIAN
+    VLC_CODEC_I420_9B, VLC_CODEC_I420_10B,
+#else
+    VLC_CODEC_I420_9L, VLC_CODEC_I420_10L,
+#endif
+    VLC_CODEC_J422, VLC_CODEC_I422,
+#ifdef WORDS_BIGENDIAN
+    VLC_CODEC_I422_9B, VLC_CODEC_I422_10B,
+#else
+    VLC_CODEC_I422_9L, VLC_CODEC_I422_10L,
+#endif
+    VLC_CODEC_J444, VLC_CODEC_I444,
+#ifdef WORDS_BIGENDIAN
+    VLC_CODEC_I444_9B, VLC_CODEC_I444_10B,
+#else
+    VLC_CODEC_I444_9L, VLC_CODEC_I444_10L,
+#endif
+    VLC_CODEC_YUYV, VLC_CODEC_UYVY, VLC_CODEC_YVYU, VLC_CODEC_VYUY,
+    0
+};
+
+static const vlc_fourcc_t pi_blend_chromas[] = {
+    VLC_CODEC_YUVA, VLC_CODEC_RGBA, VLC_CODEC_YUVP, 0
+};
+
+/* Same pseudo random content on every run */
+static void blendbench_FillPicture( picture_t *p_pic, uint32_t i_seed )
+{
+    for( int i_plane = 0; i_plane < p_pic->i_planes; i_plane++ )
+    {
+        plane_t *p = &p_pic->p[i_plane];
+
+        for( int i_line = 0; i_line < p->i_lines; i_line++ )
+            for( int i = 0; i < p->i_pitch; i++ )
+            {
+                i_seed = i_seed * 1103515245 + 12345;
+                p->p_pixels[i_line * p->i_pitch + i] = i_seed >> 24;
+            }
+    }
+}
+
+/* Subtitle like alpha: transparent but for the lower fifth of the picture,
+ * where opaque, translucent and transparent runs alternate */
+static uint8_t blendbench_Alpha( int x, int y, int i_height )
+{
+    if( y < i_height * 4 / 5 )
+        return 0;
+    switch( (x / 24) % 4 )
+    {
+        case 0: return 0;
+        case 1: return 128;
+        default: return 255;
+    }
+}
+
+static void blendbench_FillAlpha( picture_t *p_pic, int i_width, int i_height )
+{
+    for( int y = 0; y < i_height; y++ )
+    {
+        uint8_t *p_line;
+
+        switch( p_pic->format.i_chroma )
+        {
+            case VLC_CODEC_YUVA:
+                p_line = &p_pic->p[A_PLANE].p_pixels[y * p_pic->p[A_PLANE].i_pitch];
+                for( int x = 0; x < i_width; x++ )
+                    p_line[x] = blendbench_Alpha( x, y, i_height );
+                break;
+            case VLC_CODEC_RGBA:
+                p_line = &p_pic->p[0].p_pixels[y * p_pic->p[0].i_pitch];
+                for( int x = 0; x < i_width; x++ )
+                    p_line[4 * x + 3] = blendbench_Alpha( x, y, i_height );
+                break;
+            case VLC_CODEC_YUVP:
+                /* Palette entries have the alpha of their index */
+                p_line = &p_pic->p[0].p_pixels[y * p_pic->p[0].i_pitch];
+                for( int x = 0; x < i_width; x++ )
+                    p_line[x] = blendbench_Alpha( x, y, i_height );
+                break;
+        }
+    }
+}
+
+static void blendbench_All( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const int i_width = p_sys->i_width;
+    const int i_height = p_sys->i_height;
+    video_palette_t palette;
+
+    palette.i_entries = 256;
+    for( int i = 0; i < 256; i++ )
+    {
+        palette.palette[i][0] = 16 + i * 219 / 255;
+        palette.palette[i][1] = 255 - i;
+        palette.palette[i][2] = i;
+        palette.palette[i][3] = i;
+    }
+
+    msg_Info( p_filter, "Blending %dx%d pictures %d times", i_width,
+              i_height, p_sys->i_loops );
+
+    for( int i_base = 0; pi_base_chromas[i_base]; i_base++ )
+    {
+        for( int i_blend = 0; pi_blend_chromas[i_blend]; i_blend++ )
+        {
+            const vlc_fourcc_t i_base_chroma = pi_base_chromas[i_base];
+            const vlc_fourcc_t i_blend_chroma = pi_blend_chromas[i_blend];
+            video_format_t fmt_base, fmt_blend;
+
+            video_format_Setup( &fmt_base, i_base_chroma, i_width, i_height, 1, 1 );
+            video_format_Setup( &fmt_blend, i_blend_chroma, i_width, i_height, 1, 1 );
+            if( i_blend_chroma == VLC_CODEC_YUVP )
+                fmt_blend.p_palette = &palette;
+
+            picture_t *p_base = picture_NewFromFormat( &fmt_base );
+            picture_t *p_blend_pic = picture_NewFromFormat( &fmt_blend );
+            filter_t *p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
+            if( !p_base || !p_blend_pic || !p_blend )
+                goto next;
+
+            blendbench_FillPicture( p_base, 1 );
+            blendbench_FillPicture( p_blend_pic, 2 );
+            blendbench_FillAlpha( p_blend_pic, i_width, i_height );
+
+            p_blend->fmt_out.video = p_base->format;
+            p_blend->fmt_in.video = p_blend_pic->format;
+            p_blend->fmt_in.video.p_palette = fmt_blend.p_palette;
+            p_blend->p_module = module_need( p_blend, "video blending", NULL, false );
+            if( !p_blend->p_module )
+            {
+                msg_Info( p_filter, "%4.4s -> %4.4s: unsupported",
+                          (const char *)&i_blend_chroma,
+                          (const char *)&i_base_chroma );
+                goto next;
+            }
+
+            mtime_t time = mdate();
+            for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
+                p_blend->pf_video_blend( p_blend, p_base, p_blend_pic,
+                                         0, 0, p_sys->i_alpha );
+            time = mdate() - time;
+            if( time <= 0 )
+                time = 1;
+
+            msg_Info( p_filter, "%4.4s -> %4.4s: %8.3f ms/image, %8.1f Mpixels/s",
+                      (const char *)&i_blend_chroma, (const char *)&i_base_chroma,
+                      time / 1000.0 / __MAX( p_sys->i_loops, 1 ),
+                      (double)p_sys->i_loops * i_width * i_height / time );
+
+            module_unneed( p_blend, p_blend->p_module );
+next:
+            if( p_blend )
+                vlc_object_release( p_blend );
+            if( p_blend_pic )
+                picture_Release( p_blend_pic );
+            if( p_base )
+                picture_Release( p_base );
+        }
+    }
 }
 
 /*****************************************************************************
@@ -225,6 +428,13 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     if( p_sys->b_done )
         return p_pic;
 
+    if( p_sys->b_all )
+    {
+        blendbench_All( p_filter );
+        p_sys->b_done = true;
+        return p_pic;
+    }
+
     p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
     if( !p_blend )
     {
@@ -0,0 +1,346 @@
+/*****************************************************************************
+ * chromabench.c : chroma conversion benchmark plugin for vlc
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_modules.h>
+
+#include <vlc_filter.h>
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+static int Create( vlc_object_t * );
+static void Destroy( vlc_object_t * );
+
+static picture_t *Filter( filter_t *, picture_t * );
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+
+#define LOOPS_TEXT N_("Number of conversions")
+#define LOOPS_LONGTEXT N_("The number of time each conversion will be " \
+                          "performed")
+
+#define WIDTH_TEXT N_("Width of the generated pictures")
+#define WIDTH_LONGTEXT N_("Width of the pictures converted")
+
+#define HEIGHT_TEXT N_("Height of the generated pictures")
+#define HEIGHT_LONGTEXT N_("Height of the pictures converted")
+
+#define CFG_PREFIX "chromabench-"
+
+vlc_module_begin ()
+    set_description( N_("Chroma conversion benchmark filter") )
+    set_shortname( N_("Chromabench" ))
+    set_category( CAT_VIDEO )
+    set_subcategory( SUBCAT_VIDEO_VFILTER )
+    set_capability( "video filter2", 0 )
+
+    add_integer( CFG_PREFIX "loops", 100, LOOPS_TEXT,
+              LOOPS_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "width", 1920, 16, 8192, WIDTH_TEXT,
+              WIDTH_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "height", 1080, 16, 8192, HEIGHT_TEXT,
+              HEIGHT_LONGTEXT, false )
+
+    set_callbacks( Create, Destroy )
+vlc_module_end ()
+
+static const char *const ppsz_filter_options[] = {
+    "loops", "width", "height", NULL
+};
+
+/*****************************************************************************
+ * filter_sys_t: filter method descriptor
+ *****************************************************************************/
+struct filter_sys_t
+{
+    bool b_done;
+    int i_loops;
+    int i_width, i_height;
+};
+
+/* Every conversion writes into the same destination picture, so that the
+ * timings do not include the allocations */
+struct filter_owner_sys_t
+{
+    picture_t *p_dst;
+};
+
+/*****************************************************************************
+ * Create: allocates video thread output method
+ *****************************************************************************/
+static int Create( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys;
+
+    /* Allocate structure */
+    p_filter->p_sys = malloc( sizeof( filter_sys_t ) );
+    if( p_filter->p_sys == NULL )
+        return VLC_ENOMEM;
+
+    p_sys = p_filter->p_sys;
+    p_sys->b_done = false;
+
+    p_filter->pf_video_filter = Filter;
+
+    config_ChainParse( p_filter, CFG_PREFIX, ppsz_filter_options,
+                       p_filter->p_cfg );
+
+    p_sys->i_loops = var_CreateGetInteger( p_filter, CFG_PREFIX "loops" );
+    p_sys->i_width = var_CreateGetInteger( p_filter, CFG_PREFIX "width" );
+    p_sys->i_height = var_CreateGetInteger( p_filter, CFG_PREFIX "height" );
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Destroy: destroy video thread output method
+ *****************************************************************************/
+static void Destroy( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+
+    free( p_filter->p_sys );
+}
+
+/*****************************************************************************
+ * Conversions benchmark
+ *****************************************************************************/
+static const vlc_fourcc_t pi_chromas[] = {
+    VLC_CODEC_I420, VLC_CODEC_YV12, VLC_CODEC_I422,
+    VLC_CODEC_YUYV, VLC_CODEC_YVYU, VLC_CODEC_UYVY,
+    VLC_CODEC_CYUV, VLC_CODEC_Y211, VLC_CODEC_GREY,
+    VLC_CODEC_RGB15, VLC_CODEC_RGB16, VLC_CODEC_RGB24, VLC_CODEC_RGB32,
+    0
+};
+
+/* The modules/video_chroma plugins, the optimized versions following the
+ * C one they are checked against */
+static const char *const ppsz_converters[] = {
+    "grey_yuv",
+    "i420_rgb", "i420_rgb_mmx", "i420_rgb_sse2",
+    "i420_yuy2", "i420_yuy2_mmx", "i420_yuy2_sse2", "i420_yuy2_altivec",
+    "i422_i420",
+    "i422_yuy2", "i422_yuy2_mmx", "i422_yuy2_sse2",
+    "yuy2_i420", "yuy2_i420_sse2",
+    "yuy2_i422", "yuy2_i422_sse2",
+    "rv32",
+    NULL
+};
+
+static picture_t *chromabench_NewPicture( filter_t *p_conv )
+{
+    return picture_Hold( p_conv->p_owner->p_dst );
+}
+
+/* Same pseudo random content on every run */
+static void chromabench_FillPicture( picture_t *p_pic, uint32_t i_seed )
+{
+    for( int i_plane = 0; i_plane < p_pic->i_planes; i_plane++ )
+    {
+        plane_t *p = &p_pic->p[i_plane];
+
+        for( int i_line = 0; i_line < p->i_lines; i_line++ )
+            for( int i = 0; i < p->i_pitch; i++ )
+            {
+                i_seed = i_seed * 1103515245 + 12345;
+                p->p_pixels[i_line * p->i_pitch + i] = i_seed >> 24;
+            }
+    }
+}
+
+static void chromabench_ClearPicture( picture_t *p_pic )
+{
+    for( int i_plane = 0; i_plane < p_pic->i_planes; i_plane++ )
+        memset( p_pic->p[i_plane].p_pixels, 0,
+                p_pic->p[i_plane].i_lines * p_pic->p[i_plane].i_pitch );
+}
+
+/* Compares the visible part of the pictures */
+static bool chromabench_Equal( const picture_t *p_a, const picture_t *p_b )
+{
+    for( int i_plane = 0; i_plane < p_a->i_planes; i_plane++ )
+    {
+        const plane_t *a = &p_a->p[i_plane];
+        const plane_t *b = &p_b->p[i_plane];
+
+        for( int i_line = 0; i_line < a->i_visible_lines; i_line++ )
+            if( memcmp( &a->p_pixels[i_line * a->i_pitch],
+                        &b->p_pixels[i_line * b->i_pitch],
+                        a->i_visible_pitch ) )
+                return false;
+    }
+    return true;
+}
+
+/* Runs one converter on the pair of formats, and checks its output against
+ * the reference one, or makes it the reference if there is none yet */
+static void chromabench_Run( filter_t *p_filter, const char *psz_converter,
+                             picture_t *p_src, picture_t *p_dst,
+                             picture_t **pp_ref, const char **ppsz_ref )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const vlc_fourcc_t i_src_chroma = p_src->format.i_chroma;
+    const vlc_fourcc_t i_dst_chroma = p_dst->format.i_chroma;
+    struct filter_owner_sys_t owner = { p_dst };
+
+    filter_t *p_conv = vlc_object_create( p_filter, sizeof(filter_t) );
+    if( !p_conv )
+        return;
+
+    es_format_Init( &p_conv->fmt_in, VIDEO_ES, i_src_chroma );
+    es_format_Init( &p_conv->fmt_out, VIDEO_ES, i_dst_chroma );
+    p_conv->fmt_in.video = p_src->format;
+    p_conv->fmt_out.video = p_dst->format;
+    p_conv->pf_video_buffer_new = chromabench_NewPicture;
+    p_conv->p_owner = &owner;
+
+    p_conv->p_module = module_need( p_conv, "video filter2", psz_converter,
+                                    true );
+    if( !p_conv->p_module )
+    {
+        vlc_object_release( p_conv );
+        return;
+    }
+
+    /* Check the output once, then time the conversions */
+    chromabench_ClearPicture( p_dst );
+    picture_t *p_out = p_conv->pf_video_filter( p_conv,
+                                                picture_Hold( p_src ) );
+    if( !p_out )
+    {
+        msg_Warn( p_filter, "%4.4s -> %4.4s: %s failed",
+                  (const char *)&i_src_chroma, (const char *)&i_dst_chroma,
+                  psz_converter );
+        goto end;
+    }
+    picture_Release( p_out );
+
+    if( *pp_ref == NULL )
+    {
+        *pp_ref = picture_NewFromFormat( &p_dst->format );
+        if( *pp_ref )
+        {
+            picture_Copy( *pp_ref, p_dst );
+            *ppsz_ref = psz_converter;
+        }
+    }
+    else if( !chromabench_Equal( *pp_ref, p_dst ) )
+        msg_Warn( p_filter, "%4.4s -> %4.4s: %s output differs from %s",
+                  (const char *)&i_src_chroma, (const char *)&i_dst_chroma,
+                  psz_converter, *ppsz_ref );
+
+    mtime_t time = mdate();
+    for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
+    {
+        p_out = p_conv->pf_video_filter( p_conv, picture_Hold( p_src ) );
+        if( p_out )
+            picture_Release( p_out );
+    }
+    time = mdate() - time;
+    if( time <= 0 )
+        time = 1;
+
+    msg_Info( p_filter, "%4.4s -> %4.4s: %-18s %8.3f ms/image, "
+              "%8.1f Mpixels/s",
+              (const char *)&i_src_chroma, (const char *)&i_dst_chroma,
+              psz_converter, time / 1000.0 / __MAX( p_sys->i_loops, 1 ),
+              (double)p_sys->i_loops * p_sys->i_width * p_sys->i_height / time );
+
+end:
+    module_unneed( p_conv, p_conv->p_module );
+    vlc_object_release( p_conv );
+}
+
+static void chromabench_All( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const int i_width = p_sys->i_width;
+    const int i_height = p_sys->i_height;
+
+    msg_Info( p_filter, "Converting %dx%d pictures %d times", i_width,
+              i_height, p_sys->i_loops );
+
+    for( int i_in = 0; pi_chromas[i_in]; i_in++ )
+    {
+        for( int i_out = 0; pi_chromas[i_out]; i_out++ )
+        {
+            const vlc_fourcc_t i_src_chroma = pi_chromas[i_in];
+            const vlc_fourcc_t i_dst_chroma = pi_chromas[i_out];
+            video_format_t fmt_src, fmt_dst;
+            picture_t *p_ref = NULL;
+            const char *psz_ref = NULL;
+
+            if( i_in == i_out )
+                continue;
+
+            video_format_Setup( &fmt_src, i_src_chroma, i_width, i_height, 1, 1 );
+            video_format_Setup( &fmt_dst, i_dst_chroma, i_width, i_height, 1, 1 );
+            video_format_FixRgb( &fmt_src );
+            video_format_FixRgb( &fmt_dst );
+
+            picture_t *p_src = picture_NewFromFormat( &fmt_src );
+            picture_t *p_dst = picture_NewFromFormat( &fmt_dst );
+            if( !p_src || !p_dst )
+                goto next;
+
+            chromabench_FillPicture( p_src, 1 );
+
+            for( int i = 0; ppsz_converters[i]; i++ )
+                chromabench_Run( p_filter, ppsz_converters[i], p_src, p_dst,
+                                 &p_ref, &psz_ref );
+
+next:
+            if( p_ref )
+                picture_Release( p_ref );
+            if( p_dst )
+                picture_Release( p_dst );
+            if( p_src )
+                picture_Release( p_src );
+        }
+    }
+}
+
+/*****************************************************************************
+ * Filter: runs the benchmark on the first picture
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( !p_sys->b_done )
+    {
+        chromabench_All( p_filter );
+        p_sys->b_done = true;
+    }
+    return p_pic;
+}
@@ -166,6 +166,46 @@ static void Close(vlc_object_t *object)
     free(sys);
 }
 
+/* The planes are filtered independently, each with its own part of the
+ * blur buffer, so they can run on different slice threads. */
+typedef struct {
+    picture_t *src;
+    picture_t *dst;
+    size_t     buf_size;
+} gradfun_slice_t;
+
+static void FilterPlanes(filter_t *filter, void *data,
+                         unsigned slice, unsigned slices)
+{
+    filter_sys_t *sys = filter->p_sys;
+    const gradfun_slice_t *ctx = data;
+    const video_format_t *fmt = &filter->fmt_in.video;
+    const vlc_chroma_description_t *chroma = sys->chroma;
+
+    for (int i = slice; i < ctx->dst->i_planes; i += slices) {
+        const plane_t *srcp = &ctx->src->p[i];
+        plane_t       *dstp = &ctx->dst->p[i];
+
+        struct vf_priv_s cfg = sys->cfg;
+        if (i < 3 && cfg.buf)
+            cfg.buf += i * ctx->buf_size;
+        else
+            cfg.buf = NULL;
+
+        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
+        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
+        int r = (cfg.radius  * chroma->p[i].w.num / chroma->p[i].w.den +
+                 cfg.radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
+        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
+        if (__MIN(w, h) > 2 * r && cfg.buf) {
+            filter_plane(&cfg, dstp->p_pixels, srcp->p_pixels,
+                         w, h, dstp->i_pitch, srcp->i_pitch, r);
+        } else {
+            plane_CopyPixels(dstp, srcp);
+        }
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     filter_sys_t *sys = filter->p_sys;
@@ -183,31 +223,20 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
 
     const video_format_t *fmt = &filter->fmt_in.video;
     struct vf_priv_s *cfg = &sys->cfg;
+    gradfun_slice_t slice = {
+        .src      = src,
+        .dst      = dst,
+        .buf_size = ((fmt->i_width + 15) & ~15) * (radius + 1) / 2 + 32,
+    };
 
     cfg->thresh = (1 << 15) / strength;
     if (cfg->radius != radius) {
         cfg->radius = radius;
-        cfg->buf    = vlc_memalign(16,
-                                   (((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32) * sizeof(*cfg->buf));
+        vlc_free(cfg->buf);
+        cfg->buf    = vlc_memalign(16, 3 * slice.buf_size * sizeof(*cfg->buf));
     }
 
-    for (int i = 0; i < dst->i_planes; i++) {
-        const plane_t *srcp = &src->p[i];
-        plane_t       *dstp = &dst->p[i];
-
-        const vlc_chroma_description_t *chroma = sys->chroma;
-        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
-        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
-                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
-        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
-        if (__MIN(w, h) > 2 * r && cfg->buf) {
-            filter_plane(cfg, dstp->p_pixels, srcp->p_pixels,
-                         w, h, dstp->i_pitch, srcp->i_pitch, r);
-        } else {
-            plane_CopyPixels(dstp, srcp);
-        }
-    }
+    filter_Slice(filter, FilterPlanes, &slice);
 
     picture_CopyProperties(dst, src);
     picture_Release(src);
@@ -32,6 +32,7 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
 
@@ -91,6 +92,7 @@ struct filter_sys_t
 {
     const vlc_chroma_description_t *chroma;
     int w[3], h[3];
+    int wmax;
 
     float luma_spat;
     float chroma_spat;
@@ -98,6 +100,7 @@ struct filter_sys_t
     float chroma_temp;
 
     struct vf_priv_s cfg;
+    const struct hqdn3d_dsp *dsp;
 };
 
 /*****************************************************************************
@@ -140,12 +143,28 @@ static int Open(vlc_object_t *this)
         if (sys->w[i] > wmax) wmax = sys->w[i];
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
     }
-    cfg->Line = malloc(wmax*sizeof(int));
-    if (!cfg->Line) {
+    /* One line buffer per plane, so that the planes can be denoised
+     * concurrently */
+    sys->wmax = wmax;
+    cfg->Line = malloc(3*wmax*sizeof(*cfg->Line));
+    cfg->Horiz = malloc(3*HQDN3D_LINES*wmax*sizeof(*cfg->Horiz));
+    if (!cfg->Line || !cfg->Horiz) {
+        free(cfg->Line);
+        free(cfg->Horiz);
         free(sys);
         return VLC_ENOMEM;
     }
 
+    sys->dsp = &hqdn3d_dsp_c;
+#if defined(CAN_COMPILE_SSE2) && defined(__x86_64__)
+    if (vlc_CPU() & CPU_CAPABILITY_SSE2)
+        sys->dsp = &hqdn3d_dsp_sse2;
+# ifdef CAN_COMPILE_SSSE3
+    if (vlc_CPU() & CPU_CAPABILITY_SSSE3)
+        sys->dsp = &hqdn3d_dsp_ssse3;
+# endif
+#endif
+
     filter->p_sys = sys;
     filter->pf_video_filter = Filter;
 
@@ -182,17 +201,45 @@ static void Close(vlc_object_t *this)
         free(cfg->Frame[i]);
     }
     free(cfg->Line);
+    free(cfg->Horiz);
     free(sys);
 }
 
 /*****************************************************************************
  * Filter
  *****************************************************************************/
-static picture_t *Filter(filter_t *filter, picture_t *src)
+typedef struct
 {
+    picture_t *src;
     picture_t *dst;
+} hqdn3d_slice_t;
+
+/* The denoiser is recursive along both axes, so the work is split by plane
+ * rather than by band. */
+static void FilterPlanes(filter_t *filter, void *data,
+                         unsigned slice, unsigned slices)
+{
     filter_sys_t *sys = filter->p_sys;
     struct vf_priv_s *cfg = &sys->cfg;
+    const hqdn3d_slice_t *ctx = data;
+
+    for (unsigned i = slice; i < 3; i += slices) {
+        int *spat = cfg->Coefs[i == 0 ? 0 : 2];
+        int *temp = cfg->Coefs[i == 0 ? 1 : 3];
+
+        deNoiseLines(ctx->src->p[i].p_pixels, ctx->dst->p[i].p_pixels,
+                     cfg->Line + i * sys->wmax,
+                     cfg->Horiz + i * HQDN3D_LINES * sys->wmax,
+                     &cfg->Frame[i], sys->w[i], sys->h[i],
+                     ctx->src->p[i].i_pitch, ctx->dst->p[i].i_pitch,
+                     spat, spat, temp, sys->dsp);
+    }
+}
+
+static picture_t *Filter(filter_t *filter, picture_t *src)
+{
+    picture_t *dst;
+    hqdn3d_slice_t slice;
 
     if (!src) return NULL;
 
@@ -202,24 +249,9 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
         return NULL;
     }
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
+    slice.src = src;
+    slice.dst = dst;
+    filter_Slice(filter, FilterPlanes, &slice);
 
     return CopyInfoAndRelease(dst, src);
 }
@@ -33,6 +33,7 @@
 struct vf_priv_s {
         int Coefs[4][512*16];
         unsigned int *Line;
+        unsigned int *Horiz;
         unsigned short *Frame[3];
 };
 
@@ -108,7 +109,8 @@ static void deNoiseSpacial(
     }
 }
 
-static void deNoise(unsigned char *Frame,        // mpi->planes[x]
+/* Reference implementation, see deNoiseLines() */
+static inline void deNoise(unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,      // vf->priv->Line (width bytes)
                     unsigned short **FrameAntPtr,
@@ -180,6 +182,392 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
 }
 
 
+//===========================================================================//
+
+/*
+ * Line based implementation, bit exact with deNoise().
+ *
+ * The horizontal low-pass is a recursion along the line, but the lines are
+ * independent, so it is run on HQDN3D_LINES lines at once to hide the
+ * latency of the coefficient lookups. The vertical and temporal low-pass
+ * are then independent for each pixel of a line, so they are done by
+ * (possibly vectorized) line functions.
+ */
+#define HQDN3D_LINES 8
+
+struct hqdn3d_dsp {
+    /* Prev[X] = LowPassMul(Prev[X], Curr[X], Coef) */
+    void (*lowpass)(unsigned int *Prev, const unsigned int *Curr,
+                    const int *Coef, int W);
+    /* Temporal low-pass of Curr against FrameAnt, to FrameAnt and Dest */
+    void (*temporal)(unsigned short *FrameAnt, const unsigned int *Curr,
+                     unsigned char *Dest, const int *Coef, int W);
+    /* Dest[X] = rounded Curr[X] */
+    void (*store)(unsigned char *Dest, const unsigned int *Curr, int W);
+    /* Curr[X] = Frame[X]<<16 */
+    void (*load)(unsigned int *Curr, const unsigned char *Frame, int W);
+};
+
+static void lowpass_c(unsigned int *Prev, const unsigned int *Curr,
+                      const int *Coef, int W)
+{
+    for (int X = 0; X < W; X++)
+        Prev[X] = LowPassMul(Prev[X], Curr[X], (int *)Coef);
+}
+
+static void temporal_c(unsigned short *FrameAnt, const unsigned int *Curr,
+                       unsigned char *Dest, const int *Coef, int W)
+{
+    for (int X = 0; X < W; X++){
+        unsigned int PixelDst = LowPassMul(FrameAnt[X]<<8, Curr[X],
+                                           (int *)Coef);
+        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
+        Dest[X]= ((PixelDst+0x10007FFF)>>16);
+    }
+}
+
+static void store_c(unsigned char *Dest, const unsigned int *Curr, int W)
+{
+    for (int X = 0; X < W; X++)
+        Dest[X]= ((Curr[X]+0x10007FFF)>>16);
+}
+
+static void load_c(unsigned int *Curr, const unsigned char *Frame, int W)
+{
+    for (int X = 0; X < W; X++)
+        Curr[X] = Frame[X]<<16;
+}
+
+static const struct hqdn3d_dsp hqdn3d_dsp_c = {
+    lowpass_c, temporal_c, store_c, load_c
+};
+
+#if defined(CAN_COMPILE_SSE2) && defined(__x86_64__)
+static const uint32_t __attribute__((aligned(16))) pd_lowpass[4] = {
+    0x10007FF, 0x10007FF, 0x10007FF, 0x10007FF };
+static const uint32_t __attribute__((aligned(16))) pd_round8[4] = {
+    0x1000007F, 0x1000007F, 0x1000007F, 0x1000007F };
+static const uint32_t __attribute__((aligned(16))) pd_round16[4] = {
+    0x10007FFF, 0x10007FFF, 0x10007FFF, 0x10007FFF };
+static const uint32_t __attribute__((aligned(16))) pd_ff[4] = {
+    0xFF, 0xFF, 0xFF, 0xFF };
+
+/* xmm0 = Coef[xmm0], one lookup for each dword, clobbers xmm4-xmm6 */
+#define GATHER(coef, t0, t1) \
+    "movq        %%xmm0, "t0"        \n" \
+    "punpckhqdq  %%xmm0, %%xmm0      \n" \
+    "mov          "t0"d, "t1"d       \n" \
+    "shr            $32, "t0"        \n" \
+    "movd  ("coef","t1",4), %%xmm4   \n" \
+    "movd  ("coef","t0",4), %%xmm5   \n" \
+    "movq        %%xmm0, "t0"        \n" \
+    "mov          "t0"d, "t1"d       \n" \
+    "shr            $32, "t0"        \n" \
+    "movd  ("coef","t1",4), %%xmm0   \n" \
+    "movd  ("coef","t0",4), %%xmm6   \n" \
+    "punpckldq   %%xmm5, %%xmm4      \n" \
+    "punpckldq   %%xmm6, %%xmm0      \n" \
+    "punpcklqdq  %%xmm0, %%xmm4      \n" \
+    "movdqa      %%xmm4, %%xmm0      \n"
+
+/* The lookups use 64 bits registers */
+#define T0 "%%r10"
+#define T1 "%%r11"
+
+VLC_SSE
+static void lowpass_sse2(unsigned int *Prev, const unsigned int *Curr,
+                         const int *Coef, int W)
+{
+    const int w = W & ~3;
+    intptr_t x = -4*(intptr_t)w;
+
+    if (w > 0)
+        __asm__ volatile(
+            "movdqa    %4, %%xmm7          \n"
+            "1:                            \n"
+            "movdqu    (%1,%0), %%xmm0     \n"
+            "movdqu    (%2,%0), %%xmm1     \n"
+            "psubd     %%xmm1, %%xmm0      \n"
+            "paddd     %%xmm7, %%xmm0      \n"
+            "psrld     $12, %%xmm0         \n"
+            GATHER("%3", T0, T1)
+            "paddd     %%xmm1, %%xmm0      \n"
+            "movdqu    %%xmm0, (%1,%0)     \n"
+            "add       $16, %0             \n"
+            "jl        1b                  \n"
+            : "+&r"(x)
+            : "r"(Prev+w), "r"(Curr+w), "r"(Coef), "m"(*pd_lowpass)
+            : "r10", "r11", "xmm0", "xmm1", "xmm4", "xmm5", "xmm6", "xmm7",
+              "memory"
+        );
+    lowpass_c(Prev+w, Curr+w, Coef, W-w);
+}
+
+/* Truncating packs, as the C code stores the low bits */
+#define PACK_SSE2 \
+    "pslld     $16, %%xmm2         \n" \
+    "psrad     $16, %%xmm2         \n" \
+    "packssdw  %%xmm2, %%xmm2      \n" \
+    "pand      %%xmm8, %%xmm3      \n" \
+    "packssdw  %%xmm3, %%xmm3      \n" \
+    "packuswb  %%xmm3, %%xmm3      \n"
+
+/* pshufb takes the bytes of interest before the shifts */
+#define PACK_SSSE3 \
+    "pshufb    %%xmm8, %%xmm2      \n" \
+    "pshufb    %%xmm9, %%xmm3      \n"
+
+#define TEMPORAL(pack, shifts, m0, m1) \
+    const int w = W & ~3; \
+    intptr_t x = -(intptr_t)w; \
+    if (w > 0) \
+        __asm__ volatile( \
+            "pxor      %%xmm7, %%xmm7      \n" \
+            "movdqa    %5, %%xmm10         \n" \
+            "movdqa    %6, %%xmm11         \n" \
+            "movdqa    %7, %%xmm12         \n" \
+            "movdqa    %8, %%xmm8          \n" \
+            "movdqa    %9, %%xmm9          \n" \
+            "1:                            \n" \
+            "movq      (%1,%0,2), %%xmm0   \n" \
+            "punpcklwd %%xmm7, %%xmm0      \n" \
+            "pslld     $8, %%xmm0          \n" \
+            "movdqu    (%2,%0,4), %%xmm1   \n" \
+            "psubd     %%xmm1, %%xmm0      \n" \
+            "paddd     %%xmm10, %%xmm0     \n" \
+            "psrld     $12, %%xmm0         \n" \
+            GATHER("%4", T0, T1) \
+            "paddd     %%xmm1, %%xmm0      \n" \
+            "movdqa    %%xmm0, %%xmm2      \n" \
+            "movdqa    %%xmm0, %%xmm3      \n" \
+            "paddd     %%xmm11, %%xmm2     \n" \
+            "paddd     %%xmm12, %%xmm3     \n" \
+            shifts \
+            pack \
+            "movq      %%xmm2, (%1,%0,2)   \n" \
+            "movd      %%xmm3, (%3,%0)     \n" \
+            "add       $4, %0              \n" \
+            "jl        1b                  \n" \
+            : "+&r"(x) \
+            : "r"(FrameAnt+w), "r"(Curr+w), "r"(Dest+w), "r"(Coef), \
+              "m"(*pd_lowpass), "m"(*pd_round8), "m"(*pd_round16), \
+              "m"(*m0), "m"(*m1) \
+            : "r10", "r11", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", \
+              "xmm6", "xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", \
+              "memory" \
+        ); \
+    temporal_c(FrameAnt+w, Curr+w, Dest+w, Coef, W-w);
+
+VLC_SSE
+static void temporal_sse2(unsigned short *FrameAnt, const unsigned int *Curr,
+                          unsigned char *Dest, const int *Coef, int W)
+{
+    TEMPORAL(PACK_SSE2,
+             "psrld     $8, %%xmm2          \n"
+             "psrld     $16, %%xmm3         \n",
+             pd_ff, pd_ff)
+}
+
+VLC_SSE
+static void store_sse2(unsigned char *Dest, const unsigned int *Curr, int W)
+{
+    const int w = W & ~15;
+    intptr_t x = -(intptr_t)w;
+
+    if (w > 0)
+        __asm__ volatile(
+            "movdqa    %3, %%xmm7          \n"
+            "movdqa    %4, %%xmm6          \n"
+            "1:                            \n"
+            "movdqu      (%2,%0,4), %%xmm0 \n"
+            "movdqu    16(%2,%0,4), %%xmm1 \n"
+            "movdqu    32(%2,%0,4), %%xmm2 \n"
+            "movdqu    48(%2,%0,4), %%xmm3 \n"
+            "paddd     %%xmm7, %%xmm0      \n"
+            "paddd     %%xmm7, %%xmm1      \n"
+            "paddd     %%xmm7, %%xmm2      \n"
+            "paddd     %%xmm7, %%xmm3      \n"
+            "psrld     $16, %%xmm0         \n"
+            "psrld     $16, %%xmm1         \n"
+            "psrld     $16, %%xmm2         \n"
+            "psrld     $16, %%xmm3         \n"
+            "pand      %%xmm6, %%xmm0      \n"
+            "pand      %%xmm6, %%xmm1      \n"
+            "pand      %%xmm6, %%xmm2      \n"
+            "pand      %%xmm6, %%xmm3      \n"
+            "packssdw  %%xmm1, %%xmm0      \n"
+            "packssdw  %%xmm3, %%xmm2      \n"
+            "packuswb  %%xmm2, %%xmm0      \n"
+            "movdqu    %%xmm0, (%1,%0)     \n"
+            "add       $16, %0             \n"
+            "jl        1b                  \n"
+            : "+&r"(x)
+            : "r"(Dest+w), "r"(Curr+w), "m"(*pd_round16), "m"(*pd_ff)
+            : "xmm0", "xmm1", "xmm2", "xmm3", "xmm6", "xmm7", "memory"
+        );
+    store_c(Dest+w, Curr+w, W-w);
+}
+
+VLC_SSE
+static void load_sse2(unsigned int *Curr, const unsigned char *Frame, int W)
+{
+    const int w = W & ~15;
+    intptr_t x = -(intptr_t)w;
+
+    if (w > 0)
+        __asm__ volatile(
+            "pxor      %%xmm7, %%xmm7      \n"
+            "1:                            \n"
+            "movdqu    (%2,%0), %%xmm0     \n"
+            "movdqa    %%xmm0, %%xmm2      \n"
+            "punpcklbw %%xmm7, %%xmm0      \n"
+            "punpckhbw %%xmm7, %%xmm2      \n"
+            "pxor      %%xmm1, %%xmm1      \n"
+            "pxor      %%xmm3, %%xmm3      \n"
+            "pxor      %%xmm4, %%xmm4      \n"
+            "pxor      %%xmm5, %%xmm5      \n"
+            "punpcklwd %%xmm0, %%xmm1      \n"
+            "punpckhwd %%xmm0, %%xmm3      \n"
+            "punpcklwd %%xmm2, %%xmm4      \n"
+            "punpckhwd %%xmm2, %%xmm5      \n"
+            "movdqu    %%xmm1,   (%1,%0,4) \n"
+            "movdqu    %%xmm3, 16(%1,%0,4) \n"
+            "movdqu    %%xmm4, 32(%1,%0,4) \n"
+            "movdqu    %%xmm5, 48(%1,%0,4) \n"
+            "add       $16, %0             \n"
+            "jl        1b                  \n"
+            : "+&r"(x)
+            : "r"(Curr+w), "r"(Frame+w)
+            : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm7", "memory"
+        );
+    load_c(Curr+w, Frame+w, W-w);
+}
+
+static const struct hqdn3d_dsp hqdn3d_dsp_sse2 = {
+    lowpass_sse2, temporal_sse2, store_sse2, load_sse2
+};
+
+#ifdef CAN_COMPILE_SSSE3
+/* Bytes 1-2 of each dword for FrameAnt, byte 2 for Dest */
+static const uint8_t __attribute__((aligned(16))) pb_shuf_ant[16] = {
+    1, 2, 5, 6, 9, 10, 13, 14, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 };
+static const uint8_t __attribute__((aligned(16))) pb_shuf_dst[16] = {
+    2, 6, 10, 14, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 };
+
+VLC_SSE
+static void temporal_ssse3(unsigned short *FrameAnt, const unsigned int *Curr,
+                           unsigned char *Dest, const int *Coef, int W)
+{
+    TEMPORAL(PACK_SSSE3, "", pb_shuf_ant, pb_shuf_dst)
+}
+
+static const struct hqdn3d_dsp hqdn3d_dsp_ssse3 = {
+    lowpass_sse2, temporal_ssse3, store_sse2, load_sse2
+};
+#endif
+#undef TEMPORAL
+#undef PACK_SSSE3
+#undef PACK_SSE2
+#undef T1
+#undef T0
+#undef GATHER
+#endif
+
+/* Horizontal low-pass of N lines, to Curr (W values per line) */
+static void deNoiseHorizontal(unsigned int *Curr, const unsigned char *Frame,
+                              int W, int N, int sStride, int *Horizontal)
+{
+    if (N == HQDN3D_LINES){
+        const unsigned char *F[HQDN3D_LINES];
+        unsigned int *C[HQDN3D_LINES], A[HQDN3D_LINES];
+
+        for (int k = 0; k < HQDN3D_LINES; k++){
+            F[k] = Frame + k*sStride;
+            C[k] = Curr + k*W;
+            C[k][0] = A[k] = F[k][0]<<16;
+        }
+        /* Unrolled, so that the recursions stay in registers */
+#define LOWPASS(k) C[k][X] = A[k] = LowPassMul(A[k], F[k][X]<<16, Horizontal);
+        for (int X = 1; X < W; X++){
+            LOWPASS(0) LOWPASS(1) LOWPASS(2) LOWPASS(3)
+            LOWPASS(4) LOWPASS(5) LOWPASS(6) LOWPASS(7)
+        }
+#undef LOWPASS
+        return;
+    }
+
+    for (int Y = 0; Y < N; Y++){
+        unsigned int PixelAnt;
+
+        Curr[0] = PixelAnt = Frame[0]<<16;
+        for (int X = 1; X < W; X++)
+            Curr[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16,
+                                            Horizontal);
+        Frame += sStride;
+        Curr += W;
+    }
+}
+
+static void deNoiseLines(unsigned char *Frame,        // mpi->planes[x]
+                         unsigned char *FrameDest,    // dmpi->planes[x]
+                         unsigned int *LineAnt,       // W values
+                         unsigned int *LineCur,       // HQDN3D_LINES*W values
+                         unsigned short **FrameAntPtr,
+                         int W, int H, int sStride, int dStride,
+                         int *Horizontal, int *Vertical, int *Temporal,
+                         const struct hqdn3d_dsp *dsp)
+{
+    unsigned short* FrameAnt=(*FrameAntPtr);
+    /* Same cases as deNoise() */
+    const bool Spatial = Horizontal[0] || Vertical[0];
+    const bool Temp = Temporal[0] || !Spatial;
+
+    if(!FrameAnt){
+        (*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
+        for (int Y = 0; Y < H; Y++){
+            unsigned short* dst=&FrameAnt[Y*W];
+            unsigned char* src=Frame+Y*sStride;
+            for (int X = 0; X < W; X++) dst[X]=src[X]<<8;
+        }
+    }
+
+    for (int Y = 0; Y < H; Y += HQDN3D_LINES){
+        const int N = H - Y < HQDN3D_LINES ? H - Y : HQDN3D_LINES;
+
+        if (Spatial)
+            deNoiseHorizontal(LineCur, Frame + Y*sStride, W, N, sStride,
+                              Horizontal);
+        if (Spatial && !Temp && Y == 0){
+            /* deNoiseSpacial() filters every pixel of the first line
+             * against the first one */
+            for (int X = 1; X < W; X++)
+                LineCur[X] = LowPassMul(LineCur[0], Frame[X]<<16,
+                                        Horizontal);
+        }
+
+        for (int i = 0; i < N; i++){
+            unsigned int *Curr = LineCur + i*W;
+            unsigned char *Dest = FrameDest + (Y+i)*dStride;
+
+            if (Spatial){
+                /* First line has no top neighbor */
+                if (Y + i == 0)
+                    memcpy(LineAnt, Curr, W*sizeof(*LineAnt));
+                else
+                    dsp->lowpass(LineAnt, Curr, Vertical, W);
+                Curr = LineAnt;
+            }
+            else
+                dsp->load(Curr, Frame + (Y+i)*sStride, W);
+
+            if (Temp)
+                dsp->temporal(FrameAnt + (Y+i)*W, Curr, Dest, Temporal, W);
+            else
+                dsp->store(Dest, Curr, W);
+        }
+    }
+}
+
 //===========================================================================//
 
 #define ABS(A) ( (A) > 0 ? (A) : -(A) )
@@ -81,50 +81,40 @@ static void Destroy( vlc_object_t *p_this )
 }
 
 /*****************************************************************************
- * Render: displays previously rendered output
- *****************************************************************************
- * This function send the currently rendered image to Invert image, waits
- * until it is displayed and switch the two rendering buffers, preparing next
- * frame.
+ * InvertLines: inverts one horizontal band of every plane
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+typedef struct
 {
+    picture_t *p_pic;
     picture_t *p_outpic;
-    int i_index;
     int i_planes;
+} invert_slice_t;
 
-    if( !p_pic ) return NULL;
-
-    p_outpic = filter_NewPicture( p_filter );
-    if( !p_outpic )
-    {
-        msg_Warn( p_filter, "can't get output picture" );
-        picture_Release( p_pic );
-        return NULL;
-    }
+static void InvertLines( filter_t *p_filter, void *p_data,
+                         unsigned i_slice, unsigned i_slices )
+{
+    const invert_slice_t *p_slice = p_data;
+    picture_t *p_pic = p_slice->p_pic;
+    picture_t *p_outpic = p_slice->p_outpic;
+    int i_index;
 
-    if( p_pic->format.i_chroma == VLC_CODEC_YUVA )
-    {
-        /* We don't want to invert the alpha plane */
-        i_planes = p_pic->i_planes - 1;
-        vlc_memcpy(
-            p_outpic->p[A_PLANE].p_pixels, p_pic->p[A_PLANE].p_pixels,
-            p_pic->p[A_PLANE].i_pitch *  p_pic->p[A_PLANE].i_lines );
-    }
-    else
-    {
-        i_planes = p_pic->i_planes;
-    }
+    VLC_UNUSED(p_filter);
 
-    for( i_index = 0 ; i_index < i_planes ; i_index++ )
+    for( i_index = 0 ; i_index < p_slice->i_planes ; i_index++ )
     {
         uint8_t *p_in, *p_in_end, *p_line_end, *p_out;
+        int i_start, i_end;
 
-        p_in = p_pic->p[i_index].p_pixels;
-        p_in_end = p_in + p_pic->p[i_index].i_visible_lines
-                           * p_pic->p[i_index].i_pitch;
+        filter_SliceLines( p_pic->p[i_index].i_visible_lines, 1,
+                           i_slice, i_slices, &i_start, &i_end );
 
-        p_out = p_outpic->p[i_index].p_pixels;
+        p_in = p_pic->p[i_index].p_pixels
+             + i_start * p_pic->p[i_index].i_pitch;
+        p_in_end = p_pic->p[i_index].p_pixels
+                 + i_end * p_pic->p[i_index].i_pitch;
+
+        p_out = p_outpic->p[i_index].p_pixels
+              + i_start * p_outpic->p[i_index].i_pitch;
 
         for( ; p_in < p_in_end ; )
         {
@@ -159,6 +149,46 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
                      - p_outpic->p[i_index].i_visible_pitch;
         }
     }
+}
+
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************
+ * This function send the currently rendered image to Invert image, waits
+ * until it is displayed and switch the two rendering buffers, preparing next
+ * frame.
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_outpic;
+    invert_slice_t slice;
+
+    if( !p_pic ) return NULL;
+
+    p_outpic = filter_NewPicture( p_filter );
+    if( !p_outpic )
+    {
+        msg_Warn( p_filter, "can't get output picture" );
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    if( p_pic->format.i_chroma == VLC_CODEC_YUVA )
+    {
+        /* We don't want to invert the alpha plane */
+        slice.i_planes = p_pic->i_planes - 1;
+        vlc_memcpy(
+            p_outpic->p[A_PLANE].p_pixels, p_pic->p[A_PLANE].p_pixels,
+            p_pic->p[A_PLANE].i_pitch *  p_pic->p[A_PLANE].i_lines );
+    }
+    else
+    {
+        slice.i_planes = p_pic->i_planes;
+    }
+
+    slice.p_pic = p_pic;
+    slice.p_outpic = p_outpic;
+    filter_Slice( p_filter, InvertLines, &slice );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
@@ -161,16 +161,21 @@ static void Destroy( vlc_object_t *p_this )
 }
 
 /*****************************************************************************
- * Render: displays previously rendered output
- *****************************************************************************
- * This function send the currently rendered image to Invert image, waits
- * until it is displayed and switch the two rendering buffers, preparing next
- * frame.
+ * SharpenLines: sharpens the lines [i_start, i_end[ of the Y plane
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+typedef struct
 {
+    picture_t *p_pic;
     picture_t *p_outpic;
-    int i, j;
+} sharpen_slice_t;
+
+static void SharpenLines( filter_t *p_filter, void *p_data,
+                          unsigned i_slice, unsigned i_slices )
+{
+    const sharpen_slice_t *p_slice = p_data;
+    picture_t *p_pic = p_slice->p_pic;
+    picture_t *p_outpic = p_slice->p_outpic;
+    int i, j, i_start, i_end;
     uint8_t *p_src = NULL;
     uint8_t *p_out = NULL;
     int i_src_pitch;
@@ -179,24 +184,16 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     const int v1 = -1;
     const int v2 = 3; /* 2^3 = 8 */
 
-    if( !p_pic ) return NULL;
-
-    p_outpic = filter_NewPicture( p_filter );
-    if( !p_outpic )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
-
-    /* process the Y plane */
     p_src = p_pic->p[Y_PLANE].p_pixels;
     p_out = p_outpic->p[Y_PLANE].p_pixels;
     i_src_pitch = p_pic->p[Y_PLANE].i_pitch;
     i_out_pitch = p_outpic->p[Y_PLANE].i_pitch;
 
+    filter_SliceLines( p_pic->p[Y_PLANE].i_visible_lines, 1, i_slice, i_slices,
+                       &i_start, &i_end );
+
     /* perform convolution only on Y plane. Avoid border line. */
-    vlc_mutex_lock( &p_filter->p_sys->lock );
-    for( i = 0; i < p_pic->p[Y_PLANE].i_visible_lines; i++ )
+    for( i = i_start; i < i_end; i++ )
     {
         if( (i == 0) || (i == p_pic->p[Y_PLANE].i_visible_lines - 1) )
         {
@@ -227,6 +224,35 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
                p_filter->p_sys->tab_precalc[pix + 256] );
         }
     }
+}
+
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************
+ * This function send the currently rendered image to Invert image, waits
+ * until it is displayed and switch the two rendering buffers, preparing next
+ * frame.
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_outpic;
+    sharpen_slice_t slice;
+
+    if( !p_pic ) return NULL;
+
+    p_outpic = filter_NewPicture( p_filter );
+    if( !p_outpic )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    /* process the Y plane, in bands */
+    slice.p_pic = p_pic;
+    slice.p_outpic = p_outpic;
+
+    vlc_mutex_lock( &p_filter->p_sys->lock );
+    filter_Slice( p_filter, SharpenLines, &slice );
     vlc_mutex_unlock( &p_filter->p_sys->lock );
 
     plane_CopyPixels( &p_outpic->p[U_PLANE], &p_pic->p[U_PLANE] );
@@ -59,6 +59,7 @@ static decoder_t *CreateDecoder( vlc_object_t *, input_thread_t *,
 static void       DeleteDecoder( decoder_t * );
 
 static void      *DecoderThread( void * );
+static void      *DecoderPacketizerThread( void * );
 static void       DecoderProcess( decoder_t *, block_t * );
 static void       DecoderError( decoder_t *p_dec, block_t *p_block );
 static void       DecoderOutputChangePause( decoder_t *, bool b_paused, mtime_t i_date );
@@ -114,6 +115,19 @@ struct decoder_owner_sys_t
     /* fifo */
     block_fifo_t *p_fifo;
 
+    /* Packetizer thread, between p_fifo and the decoder thread */
+    struct
+    {
+        bool          b_enabled;
+        vlc_thread_t  thread;
+        block_fifo_t  *p_fifo;      /* Packetized blocks */
+        vlc_cond_t    wait;         /* Room in p_fifo */
+        int64_t       i_preroll_end;/* Preroll as last sent to the decoder */
+        bool          b_extra;      /* The packetizer extra data were sent */
+        bool          b_fmt;        /* A new format is pending */
+        es_format_t   fmt;
+    } packetize;
+
     /* Lock for communication with decoder thread */
     vlc_mutex_t lock;
     vlc_cond_t  wait_request;
@@ -171,6 +185,12 @@ struct decoder_owner_sys_t
     mtime_t i_ts_delay;
 };
 
+/* Blocks which only carry preroll information, from the packetizer thread */
+#define BLOCK_FLAG_CORE_PREROLL (1 <<(BLOCK_FLAG_CORE_PRIVATE_SHIFT + 2))
+
+/* Maximum number of packetized blocks waiting for the decoder thread */
+#define DECODER_MAX_PACKETIZED_COUNT (16)
+
 #define DECODER_MAX_BUFFERING_COUNT (4)
 #define DECODER_MAX_BUFFERING_AUDIO_DURATION (AOUT_MAX_PREPARE_TIME)
 #define DECODER_MAX_BUFFERING_VIDEO_DURATION (1*CLOCK_FREQ)
@@ -295,10 +315,24 @@ static decoder_t *decoder_New( vlc_object_t *p_parent, input_thread_t *p_input,
     else
         i_priority = VLC_THREAD_PRIORITY_VIDEO;
 
+    /* Spawn the packetizer thread */
+    if( p_dec->p_owner->packetize.b_enabled &&
+        vlc_clone( &p_dec->p_owner->packetize.thread, DecoderPacketizerThread,
+                   p_dec, i_priority ) )
+    {
+        msg_Warn( p_dec, "cannot spawn packetizer thread" );
+        p_dec->p_owner->packetize.b_enabled = false;
+    }
+
     /* Spawn the decoder thread */
     if( vlc_clone( &p_dec->p_owner->thread, DecoderThread, p_dec, i_priority ) )
     {
         msg_Err( p_dec, "cannot spawn decoder thread" );
+        if( p_dec->p_owner->packetize.b_enabled )
+        {
+            vlc_cancel( p_dec->p_owner->packetize.thread );
+            vlc_join( p_dec->p_owner->packetize.thread, NULL );
+        }
         module_unneed( p_dec, p_dec->p_module );
         DeleteDecoder( p_dec );
         return NULL;
@@ -344,6 +378,8 @@ void input_DecoderDelete( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    if( p_owner->packetize.b_enabled )
+        vlc_cancel( p_owner->packetize.thread );
     vlc_cancel( p_owner->thread );
 
     /* Make sure we aren't paused/buffering/waiting/decoding anymore */
@@ -354,8 +390,12 @@ void input_DecoderDelete( decoder_t *p_dec )
     p_owner->b_flushing = true;
     p_owner->b_exit = true;
     vlc_cond_signal( &p_owner->wait_request );
+    if( p_owner->packetize.b_enabled )
+        vlc_cond_signal( &p_owner->packetize.wait );
     vlc_mutex_unlock( &p_owner->lock );
 
+    if( p_owner->packetize.b_enabled )
+        vlc_join( p_owner->packetize.thread, NULL );
     vlc_join( p_owner->thread, NULL );
     p_owner->b_paused = b_was_paused;
 
@@ -415,6 +455,8 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
     assert( !p_owner->b_buffering );
 
     bool b_empty = block_FifoCount( p_dec->p_owner->p_fifo ) <= 0;
+    if( p_owner->packetize.b_enabled )
+        b_empty = b_empty && block_FifoCount( p_owner->packetize.p_fifo ) <= 0;
     if( b_empty )
     {
         vlc_mutex_lock( &p_owner->lock );
@@ -657,7 +699,10 @@ size_t input_DecoderGetFifoSize( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    return block_FifoSize( p_owner->p_fifo );
+    size_t i_size = block_FifoSize( p_owner->p_fifo );
+    if( p_owner->packetize.b_enabled )
+        i_size += block_FifoSize( p_owner->packetize.p_fifo );
+    return i_size;
 }
 
 void input_DecoderGetObjects( decoder_t *p_dec,
@@ -882,6 +927,22 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
 
     p_owner->b_flushing = false;
 
+    /* Packetize in a separate thread */
+    p_owner->packetize.b_enabled = false;
+    if( p_owner->p_packetizer && fmt->i_cat == VIDEO_ES &&
+        var_InheritBool( p_dec, "packetizer-thread" ) )
+    {
+        p_owner->packetize.p_fifo = block_FifoNew();
+        if( p_owner->packetize.p_fifo != NULL )
+        {
+            vlc_cond_init( &p_owner->packetize.wait );
+            p_owner->packetize.b_enabled = true;
+        }
+    }
+    p_owner->packetize.i_preroll_end = VLC_TS_INVALID;
+    p_owner->packetize.b_extra = p_dec->fmt_in.i_extra > 0;
+    p_owner->packetize.b_fmt = false;
+
     /* */
     p_owner->cc.b_supported = false;
     if( !b_packetizer )
@@ -911,15 +972,25 @@ static void *DecoderThread( void *p_data )
     decoder_t *p_dec = (decoder_t *)p_data;
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    block_fifo_t *p_fifo = p_owner->packetize.b_enabled ?
+                           p_owner->packetize.p_fifo : p_owner->p_fifo;
+
     /* The decoder's main loop */
     for( ;; )
     {
-        block_t *p_block = block_FifoGet( p_owner->p_fifo );
+        block_t *p_block = block_FifoGet( p_fifo );
 
         /* Make sure there is no cancellation point other than this one^^.
          * If you need one, be sure to push cleanup of p_block. */
         DecoderSignalBuffering( p_dec, p_block == NULL );
 
+        if( p_owner->packetize.b_enabled )
+        {
+            vlc_mutex_lock( &p_owner->lock );
+            vlc_cond_signal( &p_owner->packetize.wait );
+            vlc_mutex_unlock( &p_owner->lock );
+        }
+
         if( p_block )
         {
             int canc = vlc_savecancel();
@@ -943,6 +1014,47 @@ static void *DecoderThread( void *p_data )
     return NULL;
 }
 
+static void DecoderPacketize( decoder_t *, block_t * );
+
+/**
+ * The packetizing loop, when it is not done by the decoder thread
+ *
+ * It feeds the decoder thread with packetized blocks, flush requests and
+ * preroll updates, in the order of the input blocks.
+ *
+ * \param p_dec the decoder
+ */
+static void *DecoderPacketizerThread( void *p_data )
+{
+    decoder_t *p_dec = (decoder_t *)p_data;
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    for( ;; )
+    {
+        block_t *p_block = block_FifoGet( p_owner->p_fifo );
+
+        if( p_block == NULL )
+        {
+            /* Forward the wake up (see input_DecoderWaitBuffering()) */
+            block_FifoWake( p_owner->packetize.p_fifo );
+            continue;
+        }
+
+        int canc = vlc_savecancel();
+
+        if( p_block->i_flags & BLOCK_FLAG_CORE_EOS )
+        {
+            /* A NULL block makes the packetizer flush its buffers */
+            block_Release( p_block );
+            p_block = NULL;
+        }
+        DecoderPacketize( p_dec, p_block );
+
+        vlc_restorecancel( canc );
+    }
+    return NULL;
+}
+
 static block_t *DecoderBlockFlushNew()
 {
     block_t *p_null = block_Alloc( 128 );
@@ -965,6 +1077,11 @@ static void DecoderFlush( decoder_t *p_dec )
 
     /* Empty the fifo */
     block_FifoEmpty( p_owner->p_fifo );
+    if( p_owner->packetize.b_enabled )
+    {
+        block_FifoEmpty( p_owner->packetize.p_fifo );
+        vlc_cond_signal( &p_owner->packetize.wait );
+    }
 
     /* Monitor for flush end */
     p_owner->b_flushing = true;
@@ -1513,10 +1630,18 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
     int i_lost = 0;
     int i_decoded = 0;
     int i_displayed = 0;
+    mtime_t i_decode_time = 0;
+    mtime_t i_display_time = 0;
+    mtime_t i_start = mdate();
 
     while( (p_pic = p_dec->pf_decode_video( p_dec, &p_block )) )
     {
         vout_thread_t  *p_vout = p_owner->p_vout;
+        const mtime_t i_decoded_date = mdate();
+
+        i_decode_time += i_decoded_date - i_start;
+        i_start = i_decoded_date;
+
         if( DecoderIsExitRequested( p_dec ) )
         {
             /* It prevent freezing VLC in case of broken decoder */
@@ -1548,11 +1673,27 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
             DecoderGetCc( p_dec, p_dec );
 
         DecoderPlayVideo( p_dec, p_pic, &i_displayed, &i_lost );
+
+        i_start = mdate();
+        i_display_time += i_start - i_decoded_date;
     }
+    i_decode_time += mdate() - i_start;
 
     /* Update ugly stat */
     input_thread_t *p_input = p_owner->p_input;
 
+    /* The counters only exist with statistics enabled */
+    if( p_input != NULL && libvlc_stats( p_dec ) &&
+        (i_decode_time > 0 || i_display_time > 0) )
+    {
+        vlc_mutex_lock( &p_input->p->counters.counters_lock );
+        stats_UpdateInteger( p_dec, p_input->p->counters.p_decode_time,
+                             i_decode_time, NULL );
+        stats_UpdateInteger( p_dec, p_input->p->counters.p_display_time,
+                             i_display_time, NULL );
+        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+    }
+
     if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_displayed > 0) )
     {
         vlc_mutex_lock( &p_input->p->counters.counters_lock );
@@ -1848,14 +1989,39 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block, bool b_flus
 {
     decoder_owner_sys_t *p_owner = (decoder_owner_sys_t *)p_dec->p_owner;
 
-    if( p_owner->p_packetizer )
+    if( p_owner->packetize.b_enabled )
+    {
+        /* Already packetized by DecoderPacketizerThread() */
+        vlc_mutex_lock( &p_owner->lock );
+        if( p_owner->packetize.b_fmt )
+        {
+            if( !p_dec->fmt_in.i_extra )
+            {
+                es_format_Clean( &p_dec->fmt_in );
+                es_format_Copy( &p_dec->fmt_in, &p_owner->packetize.fmt );
+            }
+            es_format_Clean( &p_owner->packetize.fmt );
+            p_owner->packetize.b_fmt = false;
+        }
+        vlc_mutex_unlock( &p_owner->lock );
+
+        /* A flush request is decoded as the flush block of the packetizer */
+        if( p_block )
+            DecoderDecodeVideo( p_dec, p_block );
+    }
+    else if( p_owner->p_packetizer )
     {
         block_t *p_packetized_block;
         decoder_t *p_packetizer = p_owner->p_packetizer;
+        input_thread_t *p_input = p_owner->p_input;
+        mtime_t i_time = 0;
+        mtime_t i_start = mdate();
 
         while( (p_packetized_block =
                 p_packetizer->pf_packetize( p_packetizer, p_block ? &p_block : NULL )) )
         {
+            i_time += mdate() - i_start;
+
             if( p_packetizer->fmt_out.i_extra && !p_dec->fmt_in.i_extra )
             {
                 es_format_Clean( &p_dec->fmt_in );
@@ -1873,7 +2039,18 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block, bool b_flus
 
                 p_packetized_block = p_next;
             }
+            i_start = mdate();
         }
+        i_time += mdate() - i_start;
+
+        if( p_input != NULL && libvlc_stats( p_dec ) && i_time > 0 )
+        {
+            vlc_mutex_lock( &p_input->p->counters.counters_lock );
+            stats_UpdateInteger( p_dec, p_input->p->counters.p_packetize_time,
+                                 i_time, NULL );
+            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+        }
+
         /* The packetizer does not output a block that tell the decoder to flush
          * do it ourself */
         if( b_flush )
@@ -1892,6 +2069,109 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block, bool b_flus
         vout_Flush( p_owner->p_vout, VLC_TS_INVALID+1 );
 }
 
+/* Queues a block for the decoder thread, and waits for room */
+static void DecoderPacketizerForward( decoder_t *p_dec, block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    block_FifoPut( p_owner->packetize.p_fifo, p_block );
+
+    vlc_mutex_lock( &p_owner->lock );
+    while( block_FifoCount( p_owner->packetize.p_fifo ) > DECODER_MAX_PACKETIZED_COUNT &&
+           !p_owner->b_flushing && !p_owner->b_exit )
+        vlc_cond_wait( &p_owner->packetize.wait, &p_owner->lock );
+    vlc_mutex_unlock( &p_owner->lock );
+}
+
+/* The packetizer thread counterpart of DecoderProcess() */
+static void DecoderPacketize( decoder_t *p_dec, block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    decoder_t *p_packetizer = p_owner->p_packetizer;
+    const bool b_flush_request = p_block && (p_block->i_flags & BLOCK_FLAG_CORE_FLUSH);
+
+    if( p_block && p_block->i_buffer <= 0 )
+    {
+        assert( !b_flush_request );
+        block_Release( p_block );
+        return;
+    }
+
+    if( p_block )
+    {
+        /* The decoder thread updates its preroll from the flush blocks, and
+         * from these markers, which are only sent when the value changes */
+        const int64_t i_preroll_end = p_owner->packetize.i_preroll_end;
+        DecoderUpdatePreroll( &p_owner->packetize.i_preroll_end, p_block );
+
+        if( !b_flush_request && p_owner->packetize.i_preroll_end != i_preroll_end )
+        {
+            block_t *p_marker = block_Alloc( 0 );
+            if( p_marker )
+            {
+                p_marker->i_flags = BLOCK_FLAG_CORE_PREROLL |
+                    (p_block->i_flags & (BLOCK_FLAG_PREROLL|BLOCK_FLAG_DISCONTINUITY));
+                p_marker->i_dts = p_block->i_dts;
+                DecoderPacketizerForward( p_dec, p_marker );
+            }
+        }
+        p_block->i_flags &= ~BLOCK_FLAG_CORE_PRIVATE_MASK;
+    }
+
+    input_thread_t *p_input = p_owner->p_input;
+    block_t *p_packetized_block;
+    mtime_t i_time = 0;
+    mtime_t i_start = mdate();
+
+    while( (p_packetized_block =
+            p_packetizer->pf_packetize( p_packetizer, p_block ? &p_block : NULL )) )
+    {
+        i_time += mdate() - i_start;
+
+        if( p_packetizer->fmt_out.i_extra && !p_owner->packetize.b_extra )
+        {
+            vlc_mutex_lock( &p_owner->lock );
+            if( p_owner->packetize.b_fmt )
+                es_format_Clean( &p_owner->packetize.fmt );
+            es_format_Copy( &p_owner->packetize.fmt, &p_packetizer->fmt_out );
+            p_owner->packetize.b_fmt = true;
+            vlc_mutex_unlock( &p_owner->lock );
+            p_owner->packetize.b_extra = true;
+        }
+        if( p_packetizer->pf_get_cc )
+            DecoderGetCc( p_dec, p_packetizer );
+
+        while( p_packetized_block )
+        {
+            block_t *p_next = p_packetized_block->p_next;
+            p_packetized_block->p_next = NULL;
+
+            DecoderPacketizerForward( p_dec, p_packetized_block );
+
+            p_packetized_block = p_next;
+        }
+        i_start = mdate();
+    }
+    i_time += mdate() - i_start;
+
+    if( p_input != NULL && libvlc_stats( p_dec ) && i_time > 0 )
+    {
+        vlc_mutex_lock( &p_input->p->counters.counters_lock );
+        stats_UpdateInteger( p_dec, p_input->p->counters.p_packetize_time,
+                             i_time, NULL );
+        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+    }
+
+    /* The packetizer does not output a block that tell the decoder to flush,
+     * and the decoder thread has to acknowledge the flush request anyway */
+    if( b_flush_request )
+    {
+        block_t *p_null = DecoderBlockFlushNew();
+        if( p_null )
+            DecoderPacketizerForward( p_dec, p_null );
+    }
+}
+
 /* This function process a audio block
  */
 static void DecoderProcessAudio( decoder_t *p_dec, block_t *p_block, bool b_flush )
@@ -2024,6 +2304,13 @@ static void DecoderProcess( decoder_t *p_dec, block_t *p_block )
     decoder_owner_sys_t *p_owner = (decoder_owner_sys_t *)p_dec->p_owner;
     const bool b_flush_request = p_block && (p_block->i_flags & BLOCK_FLAG_CORE_FLUSH);
 
+    if( p_block && (p_block->i_flags & BLOCK_FLAG_CORE_PREROLL) )
+    {
+        DecoderUpdatePreroll( &p_owner->i_preroll_end, p_block );
+        block_Release( p_block );
+        return;
+    }
+
     if( p_block && p_block->i_buffer <= 0 )
     {
         assert( !b_flush_request );
@@ -2052,6 +2339,13 @@ static void DecoderProcess( decoder_t *p_dec, block_t *p_block )
             b_flush = !b_flushing && b_flush_request;
 
             p_block->i_flags &= ~BLOCK_FLAG_CORE_PRIVATE_MASK;
+
+            /* The flush request was already given to the packetizer */
+            if( p_owner->packetize.b_enabled && b_flush_request && !b_flush )
+            {
+                block_Release( p_block );
+                p_block = NULL;
+            }
         }
 
         if( p_dec->fmt_out.i_cat == AUDIO_ES )
@@ -2108,6 +2402,14 @@ static void DeleteDecoder( decoder_t * p_dec )
     /* Free all packets still in the decoder fifo. */
     block_FifoEmpty( p_owner->p_fifo );
     block_FifoRelease( p_owner->p_fifo );
+    if( p_owner->packetize.b_enabled )
+    {
+        block_FifoEmpty( p_owner->packetize.p_fifo );
+        block_FifoRelease( p_owner->packetize.p_fifo );
+        vlc_cond_destroy( &p_owner->packetize.wait );
+    }
+    if( p_owner->packetize.b_fmt )
+        es_format_Clean( &p_owner->packetize.fmt );
 
     /* */
     vlc_mutex_lock( &p_owner->lock );
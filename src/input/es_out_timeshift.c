@@ -167,12 +167,28 @@ struct ts_storage_t
     FILE    *p_filer;   /* FILE handle for data reading */
 
     /* */
+    int64_t  i_seq_first; /* Number of the first command */
+    mtime_t  i_date_last; /* Date of the last command */
     int      i_cmd_r;
+    int      i_cmd_f;     /* Commands before have already been read once */
     int      i_cmd_w;
     int      i_cmd_max;
     ts_cmd_t *p_cmd;
 };
 
+/* Seek point, on a key frame or a clock reference */
+typedef struct
+{
+    int64_t i_seq;  /* Number of the command */
+    mtime_t i_date; /* Date of the command */
+    mtime_t i_time; /* Stream time */
+} ts_index_t;
+
+/* Key frames are indexed at most every TS_INDEX_MIN, clock references only
+ * when there was no key frame for TS_INDEX_MAX */
+#define TS_INDEX_MIN (CLOCK_FREQ/2)
+#define TS_INDEX_MAX (2*CLOCK_FREQ)
+
 typedef struct
 {
     vlc_thread_t   thread;
@@ -199,11 +215,29 @@ typedef struct
     mtime_t        i_buffering_delay;
 
     /* */
+    ts_storage_t   *p_storage_h; /* Oldest storage */
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
 
     mtime_t        i_cmd_delay;
 
+    /* Seekable window, commands are not kept once read if 0 */
+    mtime_t        i_window;
+    int64_t        i_seq_w;     /* Number of the next command written */
+    int64_t        i_seq_r;     /* Number of the next command read */
+    int64_t        i_seq_f;     /* Commands before have already been read once */
+    int64_t        i_seq_floor; /* No seek before this command */
+    int64_t        i_seq_skip;  /* Data commands before are dropped */
+    int            i_seek;
+    bool           b_seek;      /* Output to restart on the next command */
+
+    mtime_t        i_time;      /* Last stream time and its date */
+    mtime_t        i_time_date;
+
+    int            i_index;
+    int            i_index_max;
+    ts_index_t     *p_index;
+
 } ts_thread_t;
 
 struct es_out_id_t
@@ -219,6 +253,7 @@ struct es_out_sys_t
     /* Configuration */
     int64_t        i_tmp_size_max;    /* Maximal temporary file size in byte */
     char           *psz_tmp_path;     /* Path for temporary files */
+    mtime_t        i_window;          /* Duration kept to seek back */
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
@@ -254,6 +289,8 @@ static bool         TsHasCmd( ts_thread_t * );
 static bool         TsIsUnused( ts_thread_t * );
 static int          TsChangePause( ts_thread_t *, bool b_source_paused, bool b_paused, mtime_t i_date );
 static int          TsChangeRate( ts_thread_t *, int i_src_rate, int i_rate );
+static int          TsSeek( ts_thread_t *, mtime_t i_time );
+static void         TsFlush( ts_thread_t * );
 
 static void         *TsRun( void * );
 
@@ -266,6 +303,7 @@ static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, boo
 static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
 
 static void CmdClean( ts_cmd_t * );
+static bool CmdIsData( const ts_cmd_t * );
 static void cmd_cleanup_routine( void *p ) { CmdClean( p ); }
 
 static int  CmdInitAdd    ( ts_cmd_t *, es_out_id_t *, const es_format_t *, bool b_copy );
@@ -340,6 +378,11 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     msg_Dbg( p_input, "using timeshift granularity of %d MiB, in path '%s'",
              (int)p_sys->i_tmp_size_max/(1024*1024), p_sys->psz_tmp_path );
 
+    const int i_window = var_CreateGetInteger( p_input, "input-timeshift-duration" );
+    p_sys->i_window = __MAX( i_window, 0 ) * CLOCK_FREQ;
+    if( p_sys->i_window > 0 )
+        msg_Dbg( p_input, "keeping %d s of timeshift", i_window );
+
 #if 0
 #define S(t) msg_Err( p_input, "SIZEOF("#t")=%d", sizeof(t) )
     S(ts_cmd_t);
@@ -417,6 +460,11 @@ static int Send( es_out_t *p_out, es_out_id_t *p_es, block_t *p_block )
 
     TsAutoStop( p_out );
 
+    /* Keep the live streams from the start, to be able to seek back */
+    if( !p_sys->b_delayed && p_sys->i_window > 0 &&
+        !p_sys->p_input->p->b_can_pace_control )
+        TsStart( p_out );
+
     CmdInitSend( &cmd, p_es, p_block );
     if( p_sys->b_delayed )
         TsPushCmd( p_sys->p_ts, &cmd );
@@ -560,12 +608,21 @@ static int ControlLockedSetTime( es_out_t *p_out, mtime_t i_date )
 {
     es_out_sys_t *p_sys = p_out->p_sys;
 
+    /* Seek within the timeshift window */
+    if( i_date >= 0 )
+    {
+        if( !p_sys->b_delayed )
+            return VLC_EGENERIC;
+        return TsSeek( p_sys->p_ts, i_date );
+    }
+
     if( !p_sys->b_delayed )
         return es_out_SetTime( p_sys->p_out, i_date );
 
-    /* TODO */
-    msg_Err( p_sys->p_input, "EsOutTimeshift does not yet support time change" );
-    return VLC_EGENERIC;
+    /* The source is about to change position: what was not played yet and
+     * the window are not valid anymore */
+    TsFlush( p_sys->p_ts );
+    return VLC_SUCCESS;
 }
 static int ControlLockedSetFrameNext( es_out_t *p_out )
 {
@@ -729,6 +786,7 @@ static int Control( es_out_t *p_out, int i_query, va_list args )
  *****************************************************************************/
 static void TsDestroy( ts_thread_t *p_ts )
 {
+    free( p_ts->p_index );
     vlc_cond_destroy( &p_ts->wait );
     vlc_mutex_destroy( &p_ts->lock );
     free( p_ts );
@@ -758,8 +816,22 @@ static int TsStart( es_out_t *p_out )
     p_ts->i_rate_delay = 0;
     p_ts->i_buffering_delay = 0;
     p_ts->i_cmd_delay = 0;
+    p_ts->p_storage_h = NULL;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
+    p_ts->i_window = p_sys->i_window;
+    p_ts->i_seq_w = 0;
+    p_ts->i_seq_r = 0;
+    p_ts->i_seq_f = 0;
+    p_ts->i_seq_floor = 0;
+    p_ts->i_seq_skip = 0;
+    p_ts->i_seek = 0;
+    p_ts->b_seek = false;
+    p_ts->i_time = -1;
+    p_ts->i_time_date = -1;
+    p_ts->i_index = 0;
+    p_ts->i_index_max = 0;
+    p_ts->p_index = NULL;
 
     p_sys->b_delayed = true;
     if( vlc_clone( &p_ts->thread, TsRun, p_ts, VLC_THREAD_PRIORITY_INPUT ) )
@@ -792,22 +864,153 @@ static void TsStop( ts_thread_t *p_ts )
     vlc_join( p_ts->thread, NULL );
 
     vlc_mutex_lock( &p_ts->lock );
-    for( ;; )
+    while( p_ts->p_storage_h )
     {
-        ts_cmd_t cmd;
+        ts_storage_t *p_next = p_ts->p_storage_h->p_next;
 
-        if( TsPopCmdLocked( p_ts, &cmd, true ) )
-            break;
-
-        CmdClean( &cmd );
+        TsStorageDelete( p_ts->p_storage_h );
+        p_ts->p_storage_h = p_next;
     }
-    assert( !p_ts->p_storage_r || !p_ts->p_storage_r->p_next );
-    if( p_ts->p_storage_r )
-        TsStorageDelete( p_ts->p_storage_r );
     vlc_mutex_unlock( &p_ts->lock );
 
     TsDestroy( p_ts );
 }
+static void TsIndexTrim( ts_thread_t *p_ts, int64_t i_seq )
+{
+    int i = 0;
+
+    while( i < p_ts->i_index && p_ts->p_index[i].i_seq < i_seq )
+        i++;
+    if( i <= 0 )
+        return;
+
+    p_ts->i_index -= i;
+    memmove( p_ts->p_index, &p_ts->p_index[i], p_ts->i_index * sizeof(*p_ts->p_index) );
+}
+/* Returns the number of seek points at or before the given time (or date) */
+static int TsIndexFind( ts_thread_t *p_ts, mtime_t i_value, bool b_time )
+{
+    int i_low = 0;
+    int i_high = p_ts->i_index;
+
+    while( i_low < i_high )
+    {
+        const int i_mid = ( i_low + i_high ) / 2;
+        const ts_index_t *p_index = &p_ts->p_index[i_mid];
+
+        if( ( b_time ? p_index->i_time : p_index->i_date ) <= i_value )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+static void TsIndexPush( ts_thread_t *p_ts, const ts_cmd_t *p_cmd, int64_t i_seq, bool b_key )
+{
+    bool b_pcr = false;
+
+    if( p_cmd->i_type == C_CONTROL )
+    {
+        switch( p_cmd->u.control.i_query )
+        {
+        case ES_OUT_SET_TIMES:
+            if( p_cmd->u.control.u.times.i_time > 0 )
+            {
+                p_ts->i_time = p_cmd->u.control.u.times.i_time;
+                p_ts->i_time_date = p_cmd->i_date;
+            }
+            return;
+        case ES_OUT_SET_PCR:
+        case ES_OUT_SET_GROUP_PCR:
+            b_pcr = true;
+            break;
+        default:
+            return;
+        }
+    }
+    if( p_ts->i_window <= 0 || p_ts->i_time < 0 || ( !b_key && !b_pcr ) )
+        return;
+
+    if( p_ts->i_index > 0 )
+    {
+        const mtime_t i_delta = p_cmd->i_date - p_ts->p_index[p_ts->i_index-1].i_date;
+
+        if( i_delta < ( b_key ? TS_INDEX_MIN : TS_INDEX_MAX ) )
+            return;
+    }
+
+    if( p_ts->i_index >= p_ts->i_index_max )
+    {
+        const int i_max = __MAX( 2 * p_ts->i_index_max, 64 );
+        ts_index_t *p_new = realloc( p_ts->p_index, i_max * sizeof(*p_new) );
+        if( !p_new )
+            return;
+        p_ts->p_index = p_new;
+        p_ts->i_index_max = i_max;
+    }
+
+    ts_index_t *p_index = &p_ts->p_index[p_ts->i_index++];
+    p_index->i_seq = i_seq;
+    p_index->i_date = p_cmd->i_date;
+    p_index->i_time = p_ts->i_time + p_cmd->i_date - p_ts->i_time_date;
+}
+/* Deletes the storages that were read and are out of the window */
+static void TsTrimLocked( ts_thread_t *p_ts )
+{
+    vlc_assert_locked( &p_ts->lock );
+
+    while( p_ts->p_storage_h != p_ts->p_storage_r )
+    {
+        ts_storage_t *p_storage = p_ts->p_storage_h;
+
+        if( p_ts->i_window > 0 &&
+            p_storage->i_seq_first + p_storage->i_cmd_w > p_ts->i_seq_floor &&
+            p_storage->i_date_last >= p_ts->p_storage_w->i_date_last - p_ts->i_window )
+            break;
+
+        p_ts->p_storage_h = p_storage->p_next;
+        TsStorageDelete( p_storage );
+    }
+    if( p_ts->p_storage_h )
+        TsIndexTrim( p_ts, __MAX( p_ts->i_seq_floor, p_ts->p_storage_h->i_seq_first ) );
+}
+/* Moves the reading position. The commands already read once are replayed
+ * (only their data), the others are read with their data dropped up to the
+ * requested position, as they may change the elementary streams. */
+static void TsSeekLocked( ts_thread_t *p_ts, int64_t i_seq )
+{
+    const int64_t i_seq_r = __MIN( i_seq, p_ts->i_seq_f );
+
+    vlc_assert_locked( &p_ts->lock );
+
+    p_ts->p_storage_r = NULL;
+    for( ts_storage_t *p_storage = p_ts->p_storage_h; p_storage; p_storage = p_storage->p_next )
+    {
+        const int64_t i_cmd = i_seq_r - p_storage->i_seq_first;
+
+        p_storage->i_cmd_r = __MAX( __MIN( i_cmd, p_storage->i_cmd_w ), 0 );
+        if( !p_ts->p_storage_r && i_cmd < p_storage->i_cmd_w )
+            p_ts->p_storage_r = p_storage;
+    }
+    if( !p_ts->p_storage_r )
+        p_ts->p_storage_r = p_ts->p_storage_w;
+
+    p_ts->i_seq_r = i_seq_r;
+    p_ts->i_seq_skip = i_seq;
+    p_ts->i_seek++;
+    p_ts->b_seek = true;
+
+    vlc_cond_signal( &p_ts->wait );
+}
+static bool TsIsEmptyLocked( ts_thread_t *p_ts )
+{
+    for( ts_storage_t *p_storage = p_ts->p_storage_r; p_storage; p_storage = p_storage->p_next )
+    {
+        if( !TsStorageIsEmpty( p_storage ) )
+            return false;
+    }
+    return true;
+}
 static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 {
     vlc_mutex_lock( &p_ts->lock );
@@ -823,10 +1026,11 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
             /* TODO warn the user (but only once) */
             return;
         }
+        p_storage->i_seq_first = p_ts->i_seq_w;
 
         if( !p_ts->p_storage_w )
         {
-            p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
+            p_ts->p_storage_h = p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
         }
         else
         {
@@ -836,8 +1040,37 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
         }
     }
 
+    ts_storage_t *p_storage = p_ts->p_storage_w;
+    const bool b_key = p_cmd->i_type == C_SEND &&
+                       ( p_cmd->u.send.p_block->i_flags & BLOCK_FLAG_TYPE_I );
+
     /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    TsStoragePushCmd( p_storage, p_cmd, p_ts->p_storage_r == p_storage );
+
+    if( p_storage->i_seq_first + p_storage->i_cmd_w > p_ts->i_seq_w )
+    {
+        const ts_cmd_t *p_stored = &p_storage->p_cmd[p_storage->i_cmd_w - 1];
+
+        TsIndexPush( p_ts, p_stored, p_ts->i_seq_w++, b_key );
+
+        /* Bound the window even when not reading (paused): skip to the
+         * oldest seek point still inside */
+        ts_storage_t *p_storage_r = p_ts->p_storage_r;
+        const mtime_t i_oldest = p_stored->i_date - p_ts->i_window;
+
+        while( TsStorageIsEmpty( p_storage_r ) && p_storage_r->p_next )
+            p_storage_r = p_storage_r->p_next;
+
+        if( p_ts->i_window > 0 && !TsStorageIsEmpty( p_storage_r ) &&
+            p_storage_r->p_cmd[p_storage_r->i_cmd_r].i_date < i_oldest )
+        {
+            const int i = TsIndexFind( p_ts, i_oldest - 1, false );
+
+            if( i < p_ts->i_index &&
+                p_ts->p_index[i].i_seq > __MAX( p_ts->i_seq_r, p_ts->i_seq_skip ) )
+                TsSeekLocked( p_ts, p_ts->p_index[i].i_seq );
+        }
+    }
 
     vlc_cond_signal( &p_ts->wait );
 
@@ -847,29 +1080,55 @@ static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
 {
     vlc_assert_locked( &p_ts->lock );
 
-    if( TsStorageIsEmpty( p_ts->p_storage_r ) )
-        return VLC_EGENERIC;
+    for( ;; )
+    {
+        ts_storage_t *p_storage = p_ts->p_storage_r;
 
-    TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
+        if( !p_storage )
+            return VLC_EGENERIC;
 
-    while( p_ts->p_storage_r && TsStorageIsEmpty( p_ts->p_storage_r ) )
-    {
-        ts_storage_t *p_next = p_ts->p_storage_r->p_next;
-        if( !p_next )
-            break;
+        if( TsStorageIsEmpty( p_storage ) )
+        {
+            if( !p_storage->p_next )
+                return VLC_EGENERIC;
 
-        TsStorageDelete( p_ts->p_storage_r );
-        p_ts->p_storage_r = p_next;
-    }
+            p_ts->p_storage_r = p_storage->p_next;
+            TsTrimLocked( p_ts );
+            continue;
+        }
 
-    return VLC_SUCCESS;
+        /* Only the data is replayed */
+        const bool b_replay = p_storage->i_cmd_r < p_storage->i_cmd_f;
+        if( b_replay && !CmdIsData( &p_storage->p_cmd[p_storage->i_cmd_r] ) )
+        {
+            p_storage->i_cmd_r++;
+            p_ts->i_seq_r++;
+            continue;
+        }
+
+        TsStoragePopCmd( p_storage, p_cmd, b_flush );
+        p_ts->i_seq_r++;
+
+        if( !b_replay )
+        {
+            p_ts->i_seq_f = p_ts->i_seq_r;
+
+            /* The data before cannot be replayed once its es is deleted */
+            if( p_cmd->i_type == C_DEL )
+            {
+                p_ts->i_seq_floor = p_ts->i_seq_r;
+                TsTrimLocked( p_ts );
+            }
+        }
+        return VLC_SUCCESS;
+    }
 }
 static bool TsHasCmd( ts_thread_t *p_ts )
 {
     bool b_cmd;
 
     vlc_mutex_lock( &p_ts->lock );
-    b_cmd =  TsStorageIsEmpty( p_ts->p_storage_r );
+    b_cmd = !TsIsEmptyLocked( p_ts );
     vlc_mutex_unlock( &p_ts->lock );
 
     return b_cmd;
@@ -881,7 +1140,8 @@ static bool TsIsUnused( ts_thread_t *p_ts )
     vlc_mutex_lock( &p_ts->lock );
     b_unused = !p_ts->b_paused &&
                p_ts->i_rate == p_ts->i_rate_source &&
-               TsStorageIsEmpty( p_ts->p_storage_r );
+               p_ts->i_window <= 0 &&
+               TsIsEmptyLocked( p_ts );
     vlc_mutex_unlock( &p_ts->lock );
 
     return b_unused;
@@ -935,6 +1195,86 @@ static int TsChangeRate( ts_thread_t *p_ts, int i_src_rate, int i_rate )
 
     return i_ret;
 }
+static int TsSeek( ts_thread_t *p_ts, mtime_t i_time )
+{
+    int i_ret = VLC_EGENERIC;
+
+    vlc_mutex_lock( &p_ts->lock );
+    if( p_ts->i_index > 0 && i_time >= p_ts->p_index[0].i_time )
+    {
+        /* Closest seek point before, or the last one to go back to live */
+        const int i = TsIndexFind( p_ts, i_time, true );
+
+        TsSeekLocked( p_ts, p_ts->p_index[__MAX( i - 1, 0 )].i_seq );
+        i_ret = VLC_SUCCESS;
+    }
+    vlc_mutex_unlock( &p_ts->lock );
+
+    return i_ret;
+}
+static void TsFlush( ts_thread_t *p_ts )
+{
+    vlc_mutex_lock( &p_ts->lock );
+    p_ts->i_seq_floor = p_ts->i_seq_w;
+    TsSeekLocked( p_ts, p_ts->i_seq_w );
+    TsTrimLocked( p_ts );
+    vlc_mutex_unlock( &p_ts->lock );
+}
+
+/* Pops the next command to execute, waiting for one if needed.
+ * p_ts->lock must be held. Returns whether the output is buffering. */
+static bool TsWaitCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
+{
+    bool b_buffering;
+
+    mutex_cleanup_push( &p_ts->lock );
+    for( ;; )
+    {
+        const int canc = vlc_savecancel();
+        b_buffering = es_out_GetBuffering( p_ts->p_out );
+
+        /* The commands before a seek position are read even when paused */
+        if( ( !p_ts->b_paused || b_buffering || p_ts->i_seq_r < p_ts->i_seq_skip ) &&
+            !TsPopCmdLocked( p_ts, p_cmd, false ) )
+        {
+            /* Drop the data before the seek position */
+            if( p_ts->i_seq_r <= p_ts->i_seq_skip && CmdIsData( p_cmd ) )
+            {
+                CmdClean( p_cmd );
+                vlc_restorecancel( canc );
+                continue;
+            }
+            vlc_restorecancel( canc );
+            break;
+        }
+        vlc_restorecancel( canc );
+
+        vlc_cond_wait( &p_ts->wait, &p_ts->lock );
+    }
+    vlc_cleanup_pop();
+    return b_buffering;
+}
+
+/* Regulates the speed of command processing to the same one than reading,
+ * unless a seek happens meanwhile. Returns true in the latter case.
+ * The cleanup handlers are kept out of TsRun() so that none of its variables
+ * are live across them. */
+static bool TsWaitDeadline( ts_thread_t *p_ts, ts_cmd_t *p_cmd, int i_seek,
+                            mtime_t i_deadline )
+{
+    bool b_seek;
+
+    vlc_cleanup_push( cmd_cleanup_routine, p_cmd );
+    vlc_mutex_lock( &p_ts->lock );
+    mutex_cleanup_push( &p_ts->lock );
+    while( p_ts->i_seek == i_seek &&
+           !vlc_cond_timedwait( &p_ts->wait, &p_ts->lock, i_deadline ) )
+        ;
+    b_seek = p_ts->i_seek != i_seek;
+    vlc_cleanup_run();
+    vlc_cleanup_pop();
+    return b_seek;
+}
 
 static void *TsRun( void *p_data )
 {
@@ -946,24 +1286,31 @@ static void *TsRun( void *p_data )
         ts_cmd_t cmd;
         mtime_t  i_deadline;
         bool b_buffering;
+        bool b_skip;
+        int i_seek;
 
         /* Pop a command to execute */
         vlc_mutex_lock( &p_ts->lock );
-        mutex_cleanup_push( &p_ts->lock );
+        b_buffering = TsWaitCmd( p_ts, &cmd );
 
-        for( ;; )
+        /* Commands before the seek position are executed at once */
+        i_seek = p_ts->i_seek;
+        b_skip = p_ts->i_seq_r <= p_ts->i_seq_skip;
+        if( !b_skip && p_ts->b_seek )
         {
             const int canc = vlc_savecancel();
-            b_buffering = es_out_GetBuffering( p_ts->p_out );
 
-            if( ( !p_ts->b_paused || b_buffering ) && !TsPopCmdLocked( p_ts, &cmd, false ) )
-            {
-                vlc_restorecancel( canc );
-                break;
-            }
-            vlc_restorecancel( canc );
+            /* Restart the output at the new position, now */
+            es_out_SetTime( p_ts->p_out, -1 );
+            i_buffering_date = -1;
+
+            p_ts->b_seek = false;
+            p_ts->i_cmd_delay = mdate() - cmd.i_date;
+            p_ts->i_buffering_delay = 0;
+            p_ts->i_rate_date = -1;
+            p_ts->i_rate_delay = 0;
 
-            vlc_cond_wait( &p_ts->wait, &p_ts->lock );
+            vlc_restorecancel( canc );
         }
 
         if( b_buffering && i_buffering_date < 0 )
@@ -1014,16 +1361,18 @@ static void *TsRun( void *p_data )
             vlc_restorecancel( canc );
         }
         i_deadline = cmd.i_date + p_ts->i_cmd_delay + p_ts->i_rate_delay + p_ts->i_buffering_delay;
+        if( b_skip )
+            i_deadline = VLC_TS_INVALID;
 
-        vlc_cleanup_run();
-
-        /* Regulate the speed of command processing to the same one than
-         * reading  */
-        vlc_cleanup_push( cmd_cleanup_routine, &cmd );
+        vlc_mutex_unlock( &p_ts->lock );
 
-        mwait( i_deadline );
+        b_skip = TsWaitDeadline( p_ts, &cmd, i_seek, i_deadline );
 
-        vlc_cleanup_pop();
+        if( b_skip && CmdIsData( &cmd ) )
+        {
+            CmdClean( &cmd );
+            continue;
+        }
 
         /* Execute the command  */
         const int canc = vlc_savecancel();
@@ -1074,8 +1423,11 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         p_storage->p_filer = vlc_fopen( p_storage->psz_file, "rb" );
 
     /* */
+    p_storage->i_seq_first = 0;
+    p_storage->i_date_last = VLC_TS_INVALID;
     p_storage->i_cmd_w = 0;
     p_storage->i_cmd_r = 0;
+    p_storage->i_cmd_f = 0;
     p_storage->i_cmd_max = 30000;
     p_storage->p_cmd = malloc( p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) );
     //fprintf( stderr, "\nSTORAGE name=%s size=%d KiB\n", p_storage->psz_file, p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) /1024 );
@@ -1089,14 +1441,10 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
 }
 static void TsStorageDelete( ts_storage_t *p_storage )
 {
-    while( p_storage->i_cmd_r < p_storage->i_cmd_w )
-    {
-        ts_cmd_t cmd;
-
-        TsStoragePopCmd( p_storage, &cmd, true );
-
-        CmdClean( &cmd );
-    }
+    /* The commands already read were cleaned by their reader, and the data
+     * of the others is still in the file */
+    for( int i = p_storage->i_cmd_f; i < p_storage->i_cmd_w; i++ )
+        CmdClean( &p_storage->p_cmd[i] );
     free( p_storage->p_cmd );
 
     if( p_storage->p_filer )
@@ -1114,6 +1462,9 @@ static void TsStorageDelete( ts_storage_t *p_storage )
 }
 static void TsStoragePack( ts_storage_t *p_storage )
 {
+    /* No more writing, but the data may still be read */
+    fflush( p_storage->p_filew );
+
     /* Try to release a bit of memory */
     if( p_storage->i_cmd_w >= p_storage->i_cmd_max )
         return;
@@ -1173,12 +1524,14 @@ static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bo
             fflush( p_storage->p_filew );
     }
     p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
+    p_storage->i_date_last = cmd.i_date;
 }
 static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
 {
     assert( !TsStorageIsEmpty( p_storage ) );
 
     *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++];
+    p_storage->i_cmd_f = __MAX( p_storage->i_cmd_f, p_storage->i_cmd_r );
     if( p_cmd->i_type == C_SEND )
     {
         block_t block;
@@ -1231,6 +1584,26 @@ static void CmdClean( ts_cmd_t *p_cmd )
     }
 }
 
+/* Commands which only carry the stream data, and can be dropped or replayed */
+static bool CmdIsData( const ts_cmd_t *p_cmd )
+{
+    if( p_cmd->i_type == C_SEND )
+        return true;
+    if( p_cmd->i_type != C_CONTROL )
+        return false;
+
+    switch( p_cmd->u.control.i_query )
+    {
+    case ES_OUT_SET_PCR:
+    case ES_OUT_SET_GROUP_PCR:
+    case ES_OUT_SET_NEXT_DISPLAY_TIME:
+    case ES_OUT_SET_TIMES:
+        return true;
+    default:
+        return false;
+    }
+}
+
 static int CmdInitAdd( ts_cmd_t *p_cmd, es_out_id_t *p_es, const es_format_t *p_fmt, bool b_copy )
 {
     p_cmd->i_type = C_ADD;
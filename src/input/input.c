@@ -602,14 +602,16 @@ static void MainLoopDemux( input_thread_t *p_input, bool *pb_changed, bool *pb_d
             UpdateGenericFromDemux( p_input );
         }
         else if( p_input->p->input.p_access &&
-                 p_input->p->input.p_access->info.i_update )
+                 stream_AccessUpdated( p_input->p->input.p_stream ) )
         {
+            stream_AccessLock( p_input->p->input.p_stream );
             if( !p_input->p->input.b_title_demux )
             {
                 i_ret = UpdateTitleSeekpointFromAccess( p_input );
                 *pb_changed = true;
             }
             UpdateGenericFromAccess( p_input );
+            stream_AccessUnlock( p_input->p->input.p_stream );
         }
     }
 
@@ -880,6 +882,9 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( decoded_audio, INTEGER, COUNTER );
         INIT_COUNTER( decoded_video, INTEGER, COUNTER );
         INIT_COUNTER( decoded_sub, INTEGER, COUNTER );
+        INIT_COUNTER( packetize_time, INTEGER, COUNTER );
+        INIT_COUNTER( decode_time, INTEGER, COUNTER );
+        INIT_COUNTER( display_time, INTEGER, COUNTER );
         p_input->p->counters.p_sout_send_bitrate = NULL;
         p_input->p->counters.p_sout_sent_packets = NULL;
         p_input->p->counters.p_sout_sent_bytes = NULL;
@@ -1365,6 +1370,9 @@ error:
         EXIT_COUNTER( decoded_audio );
         EXIT_COUNTER( decoded_video );
         EXIT_COUNTER( decoded_sub );
+        EXIT_COUNTER( packetize_time );
+        EXIT_COUNTER( decode_time );
+        EXIT_COUNTER( display_time );
 
         if( p_input->p->p_sout )
         {
@@ -1438,6 +1446,9 @@ static void End( input_thread_t * p_input )
             CL_CO( decoded_audio) ;
             CL_CO( decoded_video );
             CL_CO( decoded_sub) ;
+            CL_CO( packetize_time );
+            CL_CO( decode_time );
+            CL_CO( display_time );
         }
 
         /* Close optional stream output instance */
@@ -1623,8 +1634,12 @@ static void ControlPause( input_thread_t *p_input, mtime_t i_control_date )
     if( p_input->p->b_can_pause )
     {
         if( p_input->p->input.p_access )
+        {
+            stream_AccessLock( p_input->p->input.p_stream );
             i_ret = access_Control( p_input->p->input.p_access,
                                      ACCESS_SET_PAUSE_STATE, true );
+            stream_AccessUnlock( p_input->p->input.p_stream );
+        }
         else
             i_ret = demux_Control( p_input->p->input.p_demux,
                                     DEMUX_SET_PAUSE_STATE, true );
@@ -1657,8 +1672,12 @@ static void ControlUnpause( input_thread_t *p_input, mtime_t i_control_date )
     if( p_input->p->b_can_pause )
     {
         if( p_input->p->input.p_access )
+        {
+            stream_AccessLock( p_input->p->input.p_stream );
             i_ret = access_Control( p_input->p->input.p_access,
                                      ACCESS_SET_PAUSE_STATE, false );
+            stream_AccessUnlock( p_input->p->input.p_stream );
+        }
         else
             i_ret = demux_Control( p_input->p->input.p_demux,
                                     DEMUX_SET_PAUSE_STATE, false );
@@ -1750,6 +1769,14 @@ static bool Control( input_thread_t *p_input,
             if( i_time < 0 )
                 i_time = 0;
 
+            /* Live streams can be seeked within the timeshift window */
+            if( !p_input->p->b_can_pace_control &&
+                !es_out_SetTime( p_input->p->p_es_out, i_time ) )
+            {
+                b_force_update = true;
+                break;
+            }
+
             /* Reset the decoders states and clock sync (before calling the demuxer */
             es_out_SetTime( p_input->p->p_es_out, -1 );
 
@@ -1955,6 +1982,7 @@ static bool Control( input_thread_t *p_input,
                 access_t *p_access = p_input->p->input.p_access;
                 int i_title;
 
+                stream_AccessLock( p_input->p->input.p_stream );
                 if( i_type == INPUT_CONTROL_SET_TITLE_PREV )
                     i_title = p_access->info.i_title - 1;
                 else if( i_type == INPUT_CONTROL_SET_TITLE_NEXT )
@@ -1970,6 +1998,7 @@ static bool Control( input_thread_t *p_input,
                                     ACCESS_SET_TITLE, i_title );
                     input_SendEventTitle( p_input, i_title );
                 }
+                stream_AccessUnlock( p_input->p->input.p_stream );
             }
             break;
         case INPUT_CONTROL_SET_SEEKPOINT:
@@ -2024,6 +2053,7 @@ static bool Control( input_thread_t *p_input,
                 int64_t i_input_time;
                 int64_t i_seekpoint_time;
 
+                stream_AccessLock( p_input->p->input.p_stream );
                 if( i_type == INPUT_CONTROL_SET_SEEKPOINT_PREV )
                 {
                     i_seekpoint = p_access->info.i_seekpoint;
@@ -2051,6 +2081,7 @@ static bool Control( input_thread_t *p_input,
                                     ACCESS_SET_SEEKPOINT, i_seekpoint );
                     input_SendEventSeekpoint( p_input, p_access->info.i_title, i_seekpoint );
                 }
+                stream_AccessUnlock( p_input->p->input.p_stream );
             }
             break;
 
@@ -2098,7 +2129,12 @@ static bool Control( input_thread_t *p_input,
                     p_meta = vlc_meta_New();
                     if( p_meta )
                     {
-                        access_Control( slave->p_access, ACCESS_GET_META, p_meta );
+                        if( slave->p_access )
+                        {
+                            stream_AccessLock( slave->p_stream );
+                            access_Control( slave->p_access, ACCESS_GET_META, p_meta );
+                            stream_AccessUnlock( slave->p_stream );
+                        }
                         demux_Control( slave->p_demux, DEMUX_GET_META, p_meta );
                         InputUpdateMeta( p_input, p_meta );
                     }
@@ -2450,6 +2486,9 @@ static int InputSourceInit( input_thread_t *p_input,
         bool b_can_seek;
         if( demux_Control( in->p_demux, DEMUX_CAN_SEEK, &b_can_seek ) )
             b_can_seek = false;
+        if( !in->b_can_pace_control &&
+            var_InheritInteger( p_input, "input-timeshift-duration" ) > 0 )
+            b_can_seek = true; /* within the timeshift window */
         var_SetBool( p_input, "can-seek", b_can_seek );
     }
     else
@@ -2493,6 +2532,9 @@ static int InputSourceInit( input_thread_t *p_input,
             var_SetBool( p_input, "can-rewind", !in->b_rescale_ts && !in->b_can_pace_control );
 
             access_Control( in->p_access, ACCESS_CAN_SEEK, &b_can_seek );
+            if( !in->b_can_pace_control &&
+                var_InheritInteger( p_input, "input-timeshift-duration" ) > 0 )
+                b_can_seek = true; /* within the timeshift window */
             var_SetBool( p_input, "can-seek", b_can_seek );
         }
 
@@ -2641,8 +2683,10 @@ static int InputSourceInit( input_thread_t *p_input,
         {
             /* GET_PTS_DELAY is mandatory for access_demux */
             assert( in->p_access );
+            stream_AccessLock( in->p_stream );
             access_Control( in->p_access,
                             ACCESS_GET_PTS_DELAY, &in->i_pts_delay );
+            stream_AccessUnlock( in->p_stream );
         }
         if( in->i_pts_delay > INPUT_PTS_DELAY_MAX )
             in->i_pts_delay = INPUT_PTS_DELAY_MAX;
@@ -2717,7 +2761,14 @@ static void InputSourceMeta( input_thread_t *p_input,
     bool has_meta;
 
     /* Read access meta */
-    has_meta = p_access && !access_Control( p_access, ACCESS_GET_META, p_meta );
+    if( p_access )
+    {
+        stream_AccessLock( p_source->p_stream );
+        has_meta = !access_Control( p_access, ACCESS_GET_META, p_meta );
+        stream_AccessUnlock( p_source->p_stream );
+    }
+    else
+        has_meta = false;
 
     /* Read demux meta */
     has_meta |= !demux_Control( p_demux, DEMUX_GET_META, p_meta );
@@ -147,6 +147,9 @@ struct input_thread_private_t
         counter_t *p_decoded_audio;
         counter_t *p_decoded_video;
         counter_t *p_decoded_sub;
+        counter_t *p_packetize_time;
+        counter_t *p_decode_time;
+        counter_t *p_display_time;
         counter_t *p_sout_sent_packets;
         counter_t *p_sout_sent_bytes;
         counter_t *p_sout_send_bitrate;
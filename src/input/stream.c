@@ -63,10 +63,16 @@
 #   define STREAM_CACHE_TRACK 1
     /* Max size of our cache 128Ko per track */
 #   define STREAM_CACHE_SIZE  (STREAM_CACHE_TRACK*1024*128)
+    /* Bounds of the size of a track, chosen from the access speed */
+#   define STREAM_CACHE_TRACK_MIN (1024*128)
+#   define STREAM_CACHE_TRACK_MAX (1024*128)
 #else
 #   define STREAM_CACHE_TRACK 3
     /* Max size of our cache 4Mo per track */
 #   define STREAM_CACHE_SIZE  (4*STREAM_CACHE_TRACK*1024*1024)
+    /* Bounds of the size of a track, chosen from the access speed */
+#   define STREAM_CACHE_TRACK_MIN (1024*1024)
+#   define STREAM_CACHE_TRACK_MAX (16*1024*1024)
 #endif
 
 /* How many data we try to prebuffer
@@ -89,11 +95,25 @@
  *
  *  TODO: - with access non seekable: use all space available for only one ring, but
  *          we have to support seekable/non-seekable switch on the fly.
- *        - compute a good value for i_read_size
  *        - ?
  */
 #define STREAM_READ_ATONCE 1024
-#define STREAM_CACHE_TRACK_SIZE (STREAM_CACHE_SIZE/STREAM_CACHE_TRACK)
+
+/* Adaptive sizes, for pf_read (method 2)
+ *  The read size and the size of the tracks follow the measured byte rate
+ *  and latency of the access:
+ *  - a read asks for STREAM_READ_DURATION worth of data,
+ *  - a track keeps STREAM_CACHE_DURATION worth of data for slow accesses,
+ *    and 16 reads for fast seeking (local) ones.
+ *  Accesses with a latency above STREAM_ASYNC_LATENCY are read from a
+ *  separate thread, up to STREAM_ASYNC_DURATION ahead, so that reading
+ *  from the cache does not wait for the network.
+ */
+#define STREAM_READ_MAX        (256*1024)
+#define STREAM_READ_DURATION   (CLOCK_FREQ/100)
+#define STREAM_CACHE_DURATION  (2*CLOCK_FREQ)
+#define STREAM_ASYNC_LATENCY   (CLOCK_FREQ/200)
+#define STREAM_ASYNC_DURATION  (CLOCK_FREQ)
 
 typedef struct
 {
@@ -149,13 +169,37 @@ struct stream_sys_t
 
         /* Global buffer */
         uint8_t *p_buffer;
+        unsigned i_tk_size;  /* Size of a track */
 
         /* */
         unsigned i_used; /* Used since last read */
         unsigned i_read_size;
+        uint64_t i_adapt;    /* Bytes read at the next size update */
 
     } stream;
 
+    /* Read ahead thread, for method 2 with high latency accesses */
+    struct
+    {
+        bool         b_enabled;
+        vlc_thread_t thread;
+        vlc_mutex_t  lock;   /* Also protects the measures in stat */
+        vlc_cond_t   wait;
+
+        block_t      *p_first;
+        block_t      **pp_last;
+        size_t       i_size;     /* Queued bytes */
+        size_t       i_max;      /* Read ahead depth */
+
+        bool         b_seek;     /* Cached ACCESS_CAN_SEEK */
+        uint64_t     i_access_size; /* Cached access info.i_size */
+        bool         b_update;   /* The access info.i_update is set */
+        bool         b_eof;
+        unsigned     i_paused;
+        bool         b_idle;     /* Not inside the access */
+        bool         b_exit;
+    } async;
+
     /* Peek temporary buffer */
     unsigned int i_peek;
     uint8_t *p_peek;
@@ -174,6 +218,10 @@ struct stream_sys_t
         unsigned i_seek_count;
         uint64_t i_seek_time;
 
+        /* Moving averages over the access reads */
+        uint64_t i_byterate;    /* bytes per second */
+        mtime_t  i_latency;     /* duration of a read */
+
     } stat;
 
     /* Streams list */
@@ -195,8 +243,16 @@ static int  AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read );
 static int  AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int i_read );
 static int  AStreamSeekStream( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferStream( stream_t *s );
+static void AStreamAdaptStream( stream_t *s );
 static int  AReadStream( stream_t *s, void *p_read, unsigned int i_read );
 
+/* Read ahead thread */
+static int  AsyncStart( stream_t *s );
+static void AsyncStop( stream_t *s );
+static void AsyncPause( stream_t *s );
+static void AsyncResume( stream_t *s, bool b_flush );
+static bool AStreamIsDead( stream_t *s );
+
 /* Common */
 static int AStreamControl( stream_t *s, int i_query, va_list );
 static void AStreamDestroy( stream_t *s );
@@ -315,6 +371,12 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
     p_sys->stat.i_read_count = 0;
     p_sys->stat.i_seek_count = 0;
     p_sys->stat.i_seek_time = 0;
+    p_sys->stat.i_byterate = 0;
+    p_sys->stat.i_latency = 0;
+
+    p_sys->async.b_enabled = false;
+    vlc_mutex_init( &p_sys->async.lock );
+    vlc_cond_init( &p_sys->async.wait );
 
     TAB_INIT( p_sys->i_list, p_sys->list );
     p_sys->i_list_index = 0;
@@ -403,14 +465,17 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         s->pf_read = AStreamReadStream;
         s->pf_peek = AStreamPeekStream;
 
-        /* Allocate/Setup our tracks */
+        /* Allocate/Setup our tracks, with the smallest size until the
+         * access was measured */
         p_sys->stream.i_offset = 0;
         p_sys->stream.i_tk     = 0;
-        p_sys->stream.p_buffer = malloc( STREAM_CACHE_SIZE );
+        p_sys->stream.i_tk_size = STREAM_CACHE_TRACK_MIN;
+        p_sys->stream.p_buffer = malloc( STREAM_CACHE_TRACK * STREAM_CACHE_TRACK_MIN );
         if( p_sys->stream.p_buffer == NULL )
             goto error;
         p_sys->stream.i_used   = 0;
         p_sys->stream.i_read_size = STREAM_READ_ATONCE;
+        p_sys->stream.i_adapt  = 0;
 #if STREAM_READ_ATONCE < 256
 #   error "Invalid STREAM_READ_ATONCE value"
 #endif
@@ -421,7 +486,7 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
             p_sys->stream.tk[i].i_start = p_sys->i_pos;
             p_sys->stream.tk[i].i_end   = p_sys->i_pos;
             p_sys->stream.tk[i].p_buffer=
-                &p_sys->stream.p_buffer[i * STREAM_CACHE_TRACK_SIZE];
+                &p_sys->stream.p_buffer[i * STREAM_CACHE_TRACK_MIN];
         }
 
         /* Do the prebuffering */
@@ -432,6 +497,8 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
             msg_Err( s, "cannot pre fill buffer" );
             goto error;
         }
+
+        AStreamAdaptStream( s );
     }
 
     return s;
@@ -448,6 +515,8 @@ error:
     while( p_sys->i_list > 0 )
         free( p_sys->list[--(p_sys->i_list)] );
     free( p_sys->list );
+    vlc_cond_destroy( &p_sys->async.wait );
+    vlc_mutex_destroy( &p_sys->async.lock );
     free( s->p_sys );
     stream_CommonDelete( s );
     return NULL;
@@ -460,6 +529,11 @@ static void AStreamDestroy( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
 
+    if( p_sys->async.b_enabled )
+        AsyncStop( s );
+    vlc_cond_destroy( &p_sys->async.wait );
+    vlc_mutex_destroy( &p_sys->async.lock );
+
     if( p_sys->method == STREAM_METHOD_BLOCK )
         block_ChainRelease( p_sys->block.p_first );
     else
@@ -544,6 +618,9 @@ static void AStreamControlUpdate( stream_t *s )
     stream_sys_t *p_sys = s->p_sys;
 
     p_sys->i_pos = p_sys->p_access->info.i_pos;
+    /* The read ahead thread is paused, its data are still to be read */
+    if( p_sys->async.b_enabled )
+        p_sys->i_pos -= p_sys->async.i_size;
 
     if( p_sys->i_list )
     {
@@ -579,17 +656,30 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
                     *pi_64 += s->p_sys->list[i]->i_size;
                 break;
             }
-            *pi_64 = p_access->info.i_size;
+            if( p_sys->async.b_enabled )
+            {
+                vlc_mutex_lock( &p_sys->async.lock );
+                *pi_64 = p_sys->async.i_access_size;
+                vlc_mutex_unlock( &p_sys->async.lock );
+            }
+            else
+                *pi_64 = p_access->info.i_size;
             break;
 
         case STREAM_CAN_SEEK:
             p_bool = (bool*)va_arg( args, bool * );
-            access_Control( p_access, ACCESS_CAN_SEEK, p_bool );
+            if( p_sys->async.b_enabled )
+                *p_bool = p_sys->async.b_seek;
+            else
+                access_Control( p_access, ACCESS_CAN_SEEK, p_bool );
             break;
 
         case STREAM_CAN_FASTSEEK:
             p_bool = (bool*)va_arg( args, bool * );
-            access_Control( p_access, ACCESS_CAN_FASTSEEK, p_bool );
+            if( p_sys->async.b_enabled )
+                *p_bool = p_sys->stat.b_fastseek;
+            else
+                access_Control( p_access, ACCESS_CAN_FASTSEEK, p_bool );
             break;
 
         case STREAM_GET_POSITION:
@@ -623,19 +713,46 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
                             "DON'T USE STREAM_CONTROL_ACCESS !!!" );
                 return VLC_EGENERIC;
             }
+            const bool b_reset = i_int == ACCESS_SET_TITLE ||
+                                 i_int == ACCESS_SET_SEEKPOINT;
+            AsyncPause( s );
             int i_ret = access_vaControl( p_access, i_int, args );
-            if( i_int == ACCESS_SET_TITLE || i_int == ACCESS_SET_SEEKPOINT )
+            AsyncResume( s, b_reset );
+            if( b_reset )
                 AStreamControlReset( s );
             return i_ret;
         }
 
         case STREAM_UPDATE_SIZE:
+            AsyncPause( s );
             AStreamControlUpdate( s );
+            AsyncResume( s, false );
             return VLC_SUCCESS;
 
         case STREAM_GET_CONTENT_TYPE:
-            return access_Control( p_access, ACCESS_GET_CONTENT_TYPE,
-                                    va_arg( args, char ** ) );
+        {
+            AsyncPause( s );
+            int i_ret = access_Control( p_access, ACCESS_GET_CONTENT_TYPE,
+                                        va_arg( args, char ** ) );
+            AsyncResume( s, false );
+            return i_ret;
+        }
+
+        case STREAM_GET_READ_RATE:
+            pi_64 = va_arg( args, uint64_t * );
+            vlc_mutex_lock( &p_sys->async.lock );
+            *pi_64 = p_sys->stat.i_byterate;
+            vlc_mutex_unlock( &p_sys->async.lock );
+            return *pi_64 > 0 ? VLC_SUCCESS : VLC_EGENERIC;
+
+        case STREAM_GET_READ_LATENCY:
+        {
+            mtime_t *pi_latency = va_arg( args, mtime_t * );
+            vlc_mutex_lock( &p_sys->async.lock );
+            *pi_latency = p_sys->stat.i_latency;
+            vlc_mutex_unlock( &p_sys->async.lock );
+            return p_sys->stat.i_read_count > 0 ? VLC_SUCCESS : VLC_EGENERIC;
+        }
         case STREAM_SET_RECORD_STATE:
         default:
             msg_Err( s, "invalid stream_vaControl query=0x%x", i_query );
@@ -662,7 +779,7 @@ static void AStreamPrebufferBlock( stream_t *s )
         bool b_eof;
         block_t *b;
 
-        if( s->b_die || p_sys->block.i_size > STREAM_CACHE_PREBUFFER_SIZE )
+        if( AStreamIsDead( s ) || p_sys->block.i_size > STREAM_CACHE_PREBUFFER_SIZE )
         {
             int64_t i_byterate;
 
@@ -1000,7 +1117,7 @@ static int AStreamRefillBlock( stream_t *s )
     {
         bool b_eof;
 
-        if( s->b_die )
+        if( AStreamIsDead( s ) )
             return VLC_EGENERIC;
 
         /* Fetch a block */
@@ -1072,8 +1189,8 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
 #endif
 
     /* Avoid problem, but that should *never* happen */
-    if( i_read > STREAM_CACHE_TRACK_SIZE / 2 )
-        i_read = STREAM_CACHE_TRACK_SIZE / 2;
+    if( i_read > p_sys->stream.i_tk_size / 2 )
+        i_read = p_sys->stream.i_tk_size / 2;
 
     while( tk->i_end < tk->i_start + p_sys->stream.i_offset + i_read )
     {
@@ -1092,8 +1209,9 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
 
 
     /* Now, direct pointer or a copy ? */
-    i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
-    if( i_off + i_read <= STREAM_CACHE_TRACK_SIZE )
+    const unsigned i_tk_size = p_sys->stream.i_tk_size;
+    i_off = (tk->i_start + p_sys->stream.i_offset) % i_tk_size;
+    if( i_off + i_read <= i_tk_size )
     {
         *pp_peek = &tk->p_buffer[i_off];
         return i_read;
@@ -1111,9 +1229,9 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
     }
 
     memcpy( p_sys->p_peek, &tk->p_buffer[i_off],
-            STREAM_CACHE_TRACK_SIZE - i_off );
-    memcpy( &p_sys->p_peek[STREAM_CACHE_TRACK_SIZE - i_off],
-            &tk->p_buffer[0], i_read - (STREAM_CACHE_TRACK_SIZE - i_off) );
+            i_tk_size - i_off );
+    memcpy( &p_sys->p_peek[i_tk_size - i_off],
+            &tk->p_buffer[0], i_read - (i_tk_size - i_off) );
 
     *pp_peek = p_sys->p_peek;
     return i_read;
@@ -1139,16 +1257,23 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
 #endif
 
     bool   b_aseek;
-    access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+    bool   b_afastseek;
+    if( p_sys->async.b_enabled )
+    {
+        b_aseek = p_sys->async.b_seek;
+        b_afastseek = p_sys->stat.b_fastseek;
+    }
+    else
+    {
+        access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+        access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_afastseek );
+    }
     if( !b_aseek && i_pos < p_current->i_start )
     {
         msg_Warn( s, "AStreamSeekStream: can't seek" );
         return VLC_EGENERIC;
     }
 
-    bool   b_afastseek;
-    access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_afastseek );
-
     /* FIXME compute seek cost (instead of static 'stupid' value) */
     uint64_t i_skip_threshold;
     if( b_aseek )
@@ -1227,7 +1352,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
             uint64_t i_skip = i_pos - tk->i_end;
             while( i_skip > 0 )
             {
-                const int i_read_max = __MIN( 10 * STREAM_READ_ATONCE, i_skip );
+                const int i_read_max = __MIN( 10 * p_sys->stream.i_read_size, i_skip );
                 if( AStreamReadNoSeekStream( s, NULL, i_read_max ) != i_read_max )
                     return VLC_EGENERIC;
                 i_skip -= i_read_max;
@@ -1257,8 +1382,8 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
      */
     if( tk->i_end < tk->i_start + p_sys->stream.i_offset + p_sys->stream.i_read_size )
     {
-        if( p_sys->stream.i_used < STREAM_READ_ATONCE / 2 )
-            p_sys->stream.i_used = STREAM_READ_ATONCE / 2;
+        if( p_sys->stream.i_used < p_sys->stream.i_read_size / 2 )
+            p_sys->stream.i_used = p_sys->stream.i_read_size / 2;
 
         if( AStreamRefillStream( s ) && i_pos == tk->i_end )
             return VLC_EGENERIC;
@@ -1286,10 +1411,10 @@ static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_re
 
     while( i_data < i_read )
     {
-        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
+        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % p_sys->stream.i_tk_size;
         unsigned int i_current =
             __MIN( tk->i_end - tk->i_start - p_sys->stream.i_offset,
-                   STREAM_CACHE_TRACK_SIZE - i_off );
+                   p_sys->stream.i_tk_size - i_off );
         int i_copy = __MIN( i_current, i_read - i_data );
 
         if( i_copy <= 0 ) break; /* EOF */
@@ -1313,8 +1438,8 @@ static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_re
         if( tk->i_end + i_data <= tk->i_start + p_sys->stream.i_offset + i_read )
         {
             const unsigned i_read_requested = VLC_CLIP( i_read - i_data,
-                                                    STREAM_READ_ATONCE / 2,
-                                                    STREAM_READ_ATONCE * 10 );
+                                                    p_sys->stream.i_read_size / 2,
+                                                    p_sys->stream.i_read_size * 10 );
 
             if( p_sys->stream.i_used < i_read_requested )
                 p_sys->stream.i_used = i_read_requested;
@@ -1336,9 +1461,14 @@ static int AStreamRefillStream( stream_t *s )
     stream_sys_t *p_sys = s->p_sys;
     stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
+    if( p_sys->stat.i_bytes >= p_sys->stream.i_adapt )
+        AStreamAdaptStream( s );
+
+    const unsigned i_tk_size = p_sys->stream.i_tk_size;
+
     /* We read but won't increase i_start after initial start + offset */
     int i_toread =
-        __MIN( p_sys->stream.i_used, STREAM_CACHE_TRACK_SIZE -
+        __MIN( p_sys->stream.i_used, i_tk_size -
                (tk->i_end - tk->i_start - p_sys->stream.i_offset) );
     bool b_read = false;
     int64_t i_start, i_stop;
@@ -1353,13 +1483,13 @@ static int AStreamRefillStream( stream_t *s )
     i_start = mdate();
     while( i_toread > 0 )
     {
-        int i_off = tk->i_end % STREAM_CACHE_TRACK_SIZE;
+        int i_off = tk->i_end % i_tk_size;
         int i_read;
 
-        if( s->b_die )
+        if( AStreamIsDead( s ) )
             return VLC_EGENERIC;
 
-        i_read = __MIN( i_toread, STREAM_CACHE_TRACK_SIZE - i_off );
+        i_read = __MIN( i_toread, (int)(i_tk_size - i_off) );
         i_read = AReadStream( s, &tk->p_buffer[i_off], i_read );
 
         /* msg_Dbg( s, "AStreamRefillStream: read=%d", i_read ); */
@@ -1378,10 +1508,10 @@ static int AStreamRefillStream( stream_t *s )
         /* Update end */
         tk->i_end += i_read;
 
-        /* Windows of STREAM_CACHE_TRACK_SIZE */
-        if( tk->i_start + STREAM_CACHE_TRACK_SIZE < tk->i_end )
+        /* Windows of i_tk_size */
+        if( tk->i_start + i_tk_size < tk->i_end )
         {
-            unsigned i_invalid = tk->i_end - tk->i_start - STREAM_CACHE_TRACK_SIZE;
+            unsigned i_invalid = tk->i_end - tk->i_start - i_tk_size;
 
             tk->i_start += i_invalid;
             p_sys->stream.i_offset -= i_invalid;
@@ -1417,7 +1547,7 @@ static void AStreamPrebufferStream( stream_t *s )
         int i_read;
         int i_buffered = tk->i_end - tk->i_start;
 
-        if( s->b_die || i_buffered >= STREAM_CACHE_PREBUFFER_SIZE )
+        if( AStreamIsDead( s ) || i_buffered >= STREAM_CACHE_PREBUFFER_SIZE )
         {
             int64_t i_byterate;
 
@@ -1436,9 +1566,10 @@ static void AStreamPrebufferStream( stream_t *s )
         }
 
         /* */
-        i_read = STREAM_CACHE_TRACK_SIZE - i_buffered;
+        const unsigned i_off = tk->i_end % p_sys->stream.i_tk_size;
+        i_read = p_sys->stream.i_tk_size - i_off;
         i_read = __MIN( (int)p_sys->stream.i_read_size, i_read );
-        i_read = AReadStream( s, &tk->p_buffer[i_buffered], i_read );
+        i_read = AReadStream( s, &tk->p_buffer[i_off], i_read );
         if( i_read <  0 )
             continue;
         else if( i_read == 0 )
@@ -1457,6 +1588,112 @@ static void AStreamPrebufferStream( stream_t *s )
     }
 }
 
+/* Reallocates the tracks, keeping as much of their data as possible */
+static int AStreamResizeStream( stream_t *s, unsigned i_size )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const unsigned i_old = p_sys->stream.i_tk_size;
+    stream_track_t *p_current = &p_sys->stream.tk[p_sys->stream.i_tk];
+
+    /* The data not read yet must fit */
+    if( p_current->i_end - p_current->i_start - p_sys->stream.i_offset > i_size )
+        return VLC_EGENERIC;
+
+    uint8_t *p_buffer = malloc( STREAM_CACHE_TRACK * i_size );
+    if( p_buffer == NULL )
+        return VLC_ENOMEM;
+
+    for( int i = 0; i < STREAM_CACHE_TRACK; i++ )
+    {
+        stream_track_t *tk = &p_sys->stream.tk[i];
+        uint8_t *p_dst = &p_buffer[i * i_size];
+        uint64_t i_start = tk->i_start;
+
+        if( tk->i_end - i_start > i_size )
+            i_start = tk->i_end - i_size;
+
+        for( uint64_t i_pos = i_start; i_pos < tk->i_end; )
+        {
+            const unsigned i_src = i_pos % i_old;
+            const unsigned i_dst = i_pos % i_size;
+            const unsigned i_copy = __MIN( tk->i_end - i_pos,
+                                    __MIN( i_old - i_src, i_size - i_dst ) );
+
+            memcpy( &p_dst[i_dst], &tk->p_buffer[i_src], i_copy );
+            i_pos += i_copy;
+        }
+
+        if( tk == p_current )
+            p_sys->stream.i_offset -= i_start - tk->i_start;
+        tk->i_start = i_start;
+        tk->p_buffer = p_dst;
+    }
+
+    free( p_sys->stream.p_buffer );
+    p_sys->stream.p_buffer = p_buffer;
+    p_sys->stream.i_tk_size = i_size;
+    return VLC_SUCCESS;
+}
+
+/* Sizes the reads, the tracks and the read ahead from the access speed */
+static void AStreamAdaptStream( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    const uint64_t i_byterate = p_sys->stat.i_byterate;
+    const mtime_t i_latency = p_sys->stat.i_latency;
+    vlc_mutex_unlock( &p_sys->async.lock );
+
+    if( i_byterate == 0 )
+    {
+        /* Nothing measured yet */
+        p_sys->stream.i_adapt = p_sys->stat.i_bytes + STREAM_CACHE_TRACK_MIN;
+        return;
+    }
+
+    const unsigned i_read_size =
+        VLC_CLIP( i_byterate * STREAM_READ_DURATION / CLOCK_FREQ,
+                  STREAM_READ_ATONCE, STREAM_READ_MAX );
+
+    /* Fast seeking accesses can refill a track at once, the others need
+     * to cover their reads for a while */
+    uint64_t i_tk_size;
+    if( p_sys->stat.b_fastseek )
+        i_tk_size = 16 * i_read_size;
+    else
+        i_tk_size = i_byterate * STREAM_CACHE_DURATION / CLOCK_FREQ;
+    i_tk_size = VLC_CLIP( i_tk_size, STREAM_CACHE_TRACK_MIN,
+                          STREAM_CACHE_TRACK_MAX );
+
+    /* Only reallocate when it is worth it */
+    if( i_tk_size >= 2 * p_sys->stream.i_tk_size ||
+        2 * i_tk_size <= p_sys->stream.i_tk_size )
+    {
+        if( AStreamResizeStream( s, i_tk_size ) == VLC_SUCCESS )
+            msg_Dbg( s, "using %u KiB tracks (%"PRIu64" KiB/s, %"PRId64
+                     " us latency)", p_sys->stream.i_tk_size / 1024,
+                     i_byterate / 1024, i_latency );
+    }
+    p_sys->stream.i_read_size = i_read_size;
+    p_sys->stream.i_adapt = p_sys->stat.i_bytes + p_sys->stream.i_tk_size;
+
+    /* Do not wait for slow accesses when reading from the cache */
+    if( !p_sys->async.b_enabled && !p_sys->stat.b_fastseek &&
+        i_latency >= STREAM_ASYNC_LATENCY )
+        AsyncStart( s );
+
+    if( p_sys->async.b_enabled )
+    {
+        vlc_mutex_lock( &p_sys->async.lock );
+        p_sys->async.i_max =
+            VLC_CLIP( i_byterate * STREAM_ASYNC_DURATION / CLOCK_FREQ,
+                      4 * i_read_size, p_sys->stream.i_tk_size / 2 );
+        vlc_cond_broadcast( &p_sys->async.wait );
+        vlc_mutex_unlock( &p_sys->async.lock );
+    }
+}
+
 /****************************************************************************
  * stream_ReadLine:
  ****************************************************************************/
@@ -1678,7 +1915,7 @@ error:
 /****************************************************************************
  * Access reading/seeking wrappers to handle concatenated streams.
  ****************************************************************************/
-static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
+static int AReadStreamList( stream_t *s, void *p_read, unsigned int i_read )
 {
     stream_sys_t *p_sys = s->p_sys;
     access_t *p_access = p_sys->p_access;
@@ -1689,8 +1926,6 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
     if( !p_sys->i_list )
     {
         i_read = p_access->pf_read( p_access, p_read, i_read );
-        if( p_access->b_die )
-            vlc_object_kill( s );
         if( p_input )
         {
             vlc_mutex_lock( &p_input->p->counters.counters_lock );
@@ -1706,8 +1941,6 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
 
     i_read = p_sys->p_list_access->pf_read( p_sys->p_list_access, p_read,
                                             i_read );
-    if( p_access->b_die )
-        vlc_object_kill( s );
 
     /* If we reached an EOF then switch to the next stream in the list */
     if( i_read == 0 && p_sys->i_list_index + 1 < p_sys->i_list )
@@ -1727,7 +1960,7 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
         p_sys->p_list_access = p_list_access;
 
         /* We have to read some data */
-        return AReadStream( s, p_read, i_read_orig );
+        return AReadStreamList( s, p_read, i_read_orig );
     }
 
     /* Update read bytes in input */
@@ -1743,6 +1976,75 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
     return i_read;
 }
 
+/* Reads from the access, and measures it */
+static int AReadStreamAccess( stream_t *s, void *p_read, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    const mtime_t i_start = mdate();
+    const int i_ret = AReadStreamList( s, p_read, i_read );
+    const mtime_t i_duration = __MAX( mdate() - i_start, 1 );
+
+    if( i_ret > 0 )
+    {
+        const uint64_t i_byterate = CLOCK_FREQ * i_ret / i_duration;
+
+        vlc_mutex_lock( &p_sys->async.lock );
+        if( p_sys->stat.i_byterate == 0 )
+        {
+            p_sys->stat.i_byterate = i_byterate;
+            p_sys->stat.i_latency = i_duration;
+        }
+        else
+        {
+            p_sys->stat.i_byterate = (7 * p_sys->stat.i_byterate + i_byterate) / 8;
+            p_sys->stat.i_latency = (7 * p_sys->stat.i_latency + i_duration) / 8;
+        }
+        vlc_mutex_unlock( &p_sys->async.lock );
+    }
+    return i_ret;
+}
+
+static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( !p_sys->async.b_enabled )
+        return AReadStreamAccess( s, p_read, i_read );
+
+    uint8_t *p_data = p_read;
+    unsigned int i_data = 0;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    while( p_sys->async.p_first == NULL && !p_sys->async.b_eof )
+        vlc_cond_wait( &p_sys->async.wait, &p_sys->async.lock );
+
+    /* Only return what was already read, as the access would */
+    while( i_data < i_read && p_sys->async.p_first != NULL )
+    {
+        block_t *p_block = p_sys->async.p_first;
+        const size_t i_copy = __MIN( i_read - i_data, p_block->i_buffer );
+
+        memcpy( &p_data[i_data], p_block->p_buffer, i_copy );
+        p_block->p_buffer += i_copy;
+        p_block->i_buffer -= i_copy;
+        p_sys->async.i_size -= i_copy;
+        i_data += i_copy;
+
+        if( p_block->i_buffer == 0 )
+        {
+            p_sys->async.p_first = p_block->p_next;
+            if( p_sys->async.p_first == NULL )
+                p_sys->async.pp_last = &p_sys->async.p_first;
+            block_Release( p_block );
+        }
+    }
+    vlc_cond_broadcast( &p_sys->async.wait );
+    vlc_mutex_unlock( &p_sys->async.lock );
+
+    return i_data;
+}
+
 static block_t *AReadBlock( stream_t *s, bool *pb_eof )
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -1755,25 +2057,27 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
     if( !p_sys->i_list )
     {
         p_block = p_access->pf_block( p_access );
-        if( p_access->b_die )
-            vlc_object_kill( s );
         if( pb_eof ) *pb_eof = p_access->info.b_eof;
         if( p_input && p_block && libvlc_stats (p_access) )
         {
+            /* The access may return several packets at once */
+            int i_packets;
+            size_t i_bytes;
+
+            block_ChainProperties( p_block, &i_packets, &i_bytes, NULL );
             vlc_mutex_lock( &p_input->p->counters.counters_lock );
             stats_UpdateInteger( s, p_input->p->counters.p_read_bytes,
-                                 p_block->i_buffer, &i_total );
+                                 i_bytes, &i_total );
             stats_UpdateFloat( s, p_input->p->counters.p_input_bitrate,
                               (float)i_total, NULL );
-            stats_UpdateInteger( s, p_input->p->counters.p_read_packets, 1, NULL );
+            stats_UpdateInteger( s, p_input->p->counters.p_read_packets,
+                                 i_packets, NULL );
             vlc_mutex_unlock( &p_input->p->counters.counters_lock );
         }
         return p_block;
     }
 
     p_block = p_sys->p_list_access->pf_block( p_sys->p_list_access );
-    if( p_access->b_die )
-        vlc_object_kill( s );
     b_eof = p_sys->p_list_access->info.b_eof;
     if( pb_eof ) *pb_eof = b_eof;
 
@@ -1801,20 +2105,24 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
     {
         if( p_input )
         {
+            int i_packets;
+            size_t i_bytes;
+
+            block_ChainProperties( p_block, &i_packets, &i_bytes, NULL );
             vlc_mutex_lock( &p_input->p->counters.counters_lock );
             stats_UpdateInteger( s, p_input->p->counters.p_read_bytes,
-                                 p_block->i_buffer, &i_total );
+                                 i_bytes, &i_total );
             stats_UpdateFloat( s, p_input->p->counters.p_input_bitrate,
                               (float)i_total, NULL );
             stats_UpdateInteger( s, p_input->p->counters.p_read_packets,
-                                 1 , NULL);
+                                 i_packets, NULL);
             vlc_mutex_unlock( &p_input->p->counters.counters_lock );
         }
     }
     return p_block;
 }
 
-static int ASeek( stream_t *s, uint64_t i_pos )
+static int ASeekList( stream_t *s, uint64_t i_pos )
 {
     stream_sys_t *p_sys = s->p_sys;
     access_t *p_access = p_sys->p_access;
@@ -1863,6 +2171,206 @@ static int ASeek( stream_t *s, uint64_t i_pos )
     return p_access->pf_seek( p_access, i_pos );
 }
 
+/* The stream cannot be read anymore once its access was killed */
+static bool AStreamIsDead( stream_t *s )
+{
+    return s->b_die || s->p_sys->p_access->b_die;
+}
+
+static int ASeek( stream_t *s, uint64_t i_pos )
+{
+    /* The data read ahead are not at the right position anymore */
+    AsyncPause( s );
+    const int i_ret = ASeekList( s, i_pos );
+    AsyncResume( s, true );
+    return i_ret;
+}
+
+
+/****************************************************************************
+ * Read ahead thread:
+ *  reads from the access into a queue of blocks, which AReadStream empties.
+ *  The access must only be used from this thread while it is not idle.
+ ****************************************************************************/
+static void *AsyncThread( void *data )
+{
+    stream_t *s = data;
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    for( ;; )
+    {
+        while( !p_sys->async.b_exit &&
+               ( p_sys->async.i_paused > 0 || p_sys->async.b_eof ||
+                 p_sys->async.i_size >= p_sys->async.i_max ) )
+        {
+            if( !p_sys->async.b_idle )
+            {
+                p_sys->async.b_idle = true;
+                vlc_cond_broadcast( &p_sys->async.wait );
+            }
+            vlc_cond_wait( &p_sys->async.wait, &p_sys->async.lock );
+        }
+        if( p_sys->async.b_exit )
+            break;
+
+        const size_t i_read = __MIN( p_sys->async.i_max - p_sys->async.i_size,
+                                     STREAM_READ_MAX );
+        p_sys->async.b_idle = false;
+        vlc_mutex_unlock( &p_sys->async.lock );
+
+        block_t *p_block = block_Alloc( i_read );
+        int i_ret = -1;
+        if( p_block != NULL )
+            i_ret = AReadStreamAccess( s, p_block->p_buffer, i_read );
+
+        vlc_mutex_lock( &p_sys->async.lock );
+        p_sys->async.i_access_size = p_sys->p_access->info.i_size;
+        if( p_sys->p_access->info.i_update )
+            p_sys->async.b_update = true;
+        if( i_ret > 0 )
+        {
+            p_block->i_buffer = i_ret;
+            *p_sys->async.pp_last = p_block;
+            p_sys->async.pp_last = &p_block->p_next;
+            p_sys->async.i_size += i_ret;
+        }
+        else
+        {
+            if( p_block != NULL )
+                block_Release( p_block );
+            if( i_ret == 0 || p_block == NULL || AStreamIsDead( s ) )
+                p_sys->async.b_eof = true;
+        }
+        vlc_cond_broadcast( &p_sys->async.wait );
+    }
+    p_sys->async.b_idle = true;
+    vlc_cond_broadcast( &p_sys->async.wait );
+    vlc_mutex_unlock( &p_sys->async.lock );
+    return NULL;
+}
+
+static int AsyncStart( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    access_Control( p_sys->p_access, ACCESS_CAN_SEEK, &p_sys->async.b_seek );
+    p_sys->async.p_first = NULL;
+    p_sys->async.pp_last = &p_sys->async.p_first;
+    p_sys->async.i_size = 0;
+    p_sys->async.i_max = 4 * p_sys->stream.i_read_size;
+    p_sys->async.i_access_size = p_sys->p_access->info.i_size;
+    p_sys->async.b_update = p_sys->p_access->info.i_update != 0;
+    p_sys->async.b_eof = false;
+    p_sys->async.i_paused = 0;
+    p_sys->async.b_idle = true;
+    p_sys->async.b_exit = false;
+
+    if( vlc_clone( &p_sys->async.thread, AsyncThread, s,
+                   VLC_THREAD_PRIORITY_INPUT ) )
+        return VLC_EGENERIC;
+
+    msg_Dbg( s, "reading ahead from a thread" );
+    p_sys->async.b_enabled = true;
+    return VLC_SUCCESS;
+}
+
+static void AsyncStop( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    p_sys->async.b_exit = true;
+    vlc_cond_broadcast( &p_sys->async.wait );
+    vlc_mutex_unlock( &p_sys->async.lock );
+
+    /* A read in progress completes first. When the input stops, the access
+     * was killed and returns early. */
+    vlc_join( p_sys->async.thread, NULL );
+
+    block_ChainRelease( p_sys->async.p_first );
+    p_sys->async.b_enabled = false;
+}
+
+/* Waits until the thread does not use the access anymore. Calls can be
+ * nested, each one must be matched by AsyncResume(). */
+static void AsyncPause( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( !p_sys->async.b_enabled )
+        return;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    p_sys->async.i_paused++;
+    vlc_cond_broadcast( &p_sys->async.wait );
+    while( !p_sys->async.b_idle )
+        vlc_cond_wait( &p_sys->async.wait, &p_sys->async.lock );
+    vlc_mutex_unlock( &p_sys->async.lock );
+}
+
+static void AsyncResume( stream_t *s, bool b_flush )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( !p_sys->async.b_enabled )
+        return;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    if( b_flush )
+    {
+        block_ChainRelease( p_sys->async.p_first );
+        p_sys->async.p_first = NULL;
+        p_sys->async.pp_last = &p_sys->async.p_first;
+        p_sys->async.i_size = 0;
+        p_sys->async.b_eof = false;
+    }
+    /* The access information may have been used meanwhile */
+    p_sys->async.i_access_size = p_sys->p_access->info.i_size;
+    p_sys->async.b_update = p_sys->p_access->info.i_update != 0;
+    assert( p_sys->async.i_paused > 0 );
+    p_sys->async.i_paused--;
+    vlc_cond_broadcast( &p_sys->async.wait );
+    vlc_mutex_unlock( &p_sys->async.lock );
+}
+
+/* The stream created by stream_AccessNew() at the bottom of a chain */
+static stream_t *AStreamFromChain( stream_t *s )
+{
+    while( s->p_source != NULL )
+        s = s->p_source;
+    return s->pf_control == AStreamControl ? s : NULL;
+}
+
+void stream_AccessLock( stream_t *s )
+{
+    s = AStreamFromChain( s );
+    if( s != NULL )
+        AsyncPause( s );
+}
+
+void stream_AccessUnlock( stream_t *s )
+{
+    s = AStreamFromChain( s );
+    if( s != NULL )
+        AsyncResume( s, false );
+}
+
+bool stream_AccessUpdated( stream_t *s )
+{
+    s = AStreamFromChain( s );
+    if( s == NULL )
+        return false;
+
+    stream_sys_t *p_sys = s->p_sys;
+    if( !p_sys->async.b_enabled )
+        return p_sys->p_access->info.i_update != 0;
+
+    vlc_mutex_lock( &p_sys->async.lock );
+    const bool b_update = p_sys->async.b_update;
+    vlc_mutex_unlock( &p_sys->async.lock );
+    return b_update;
+}
 
 /**
  * Try to read "i_read" bytes into a buffer pointed by "p_read".  If
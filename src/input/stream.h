@@ -52,6 +52,23 @@ void stream_CommonDelete( stream_t * );
  */
 stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list );
 
+/**
+ * These functions keep the read ahead thread of the stream chain from using
+ * its access, so that the access can be controlled and its information
+ * fields (info.i_update and friends) used from the calling thread.
+ *
+ * Calls can be nested. Each stream_AccessLock() must be matched by
+ * stream_AccessUnlock().
+ */
+void stream_AccessLock( stream_t * );
+void stream_AccessUnlock( stream_t * );
+
+/**
+ * This function tells whether the access of a stream chain has set
+ * info.i_update. It does not wait for the read ahead thread.
+ */
+bool stream_AccessUpdated( stream_t * );
+
 /**
  * This function creates a new stream_t filter.
  *
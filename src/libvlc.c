@@ -807,6 +807,12 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
         priv->p_memcpy_module = NULL;
     }
 
+    if( priv->p_filter_slices )
+    {
+        filter_SlicesDestroy( priv->p_filter_slices );
+        priv->p_filter_slices = NULL;
+    }
+
     /* Save the configuration */
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
@@ -815,6 +821,9 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     module_EndBank (true);
 
     vlc_DeinitActions( p_libvlc, priv->actions );
+
+    /* Free the blocks kept for recycling */
+    block_PoolCleanup( );
 }
 
 /**
@@ -46,6 +46,24 @@ void system_End       ( void );
 void vlc_CPU_init(void);
 void vlc_CPU_dump(vlc_object_t *);
 
+/*
+ * Video filter slice threads
+ */
+typedef struct filter_slices_t filter_slices_t;
+void filter_SlicesDestroy( filter_slices_t * );
+
+/*
+ * Block pool
+ */
+void block_PoolInit(void);
+void block_PoolCleanup(void);
+void block_PoolStats(uint64_t *hits, uint64_t *misses);
+
+/*
+ * Picture pool
+ */
+void picture_PoolStats(uint64_t *gets, uint64_t *starved, uint64_t *peak);
+
 /*
  * Threads subsystem
  */
@@ -183,6 +201,7 @@ typedef struct libvlc_priv_t
 
     /* Singleton objects */
     module_t          *p_memcpy_module;  ///< Fast memcpy plugin used
+    filter_slices_t   *p_filter_slices;  ///< Video filter worker threads
     playlist_t        *p_playlist; ///< the playlist singleton
     struct media_library_t *p_ml;    ///< the ML singleton
     vlc_mutex_t       ml_lock; ///< Mutex for ML creation
@@ -37,6 +37,8 @@
 #endif
 
 #include "vlc_block.h"
+#include <vlc_atomic.h>
+#include "libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -49,6 +51,7 @@ struct block_sys_t
 {
     block_t     self;
     size_t      i_allocated_buffer;
+    int         i_class; /**< pool size class, or -1 if not pooled */
     uint8_t     p_allocated_buffer[];
 };
 
@@ -76,9 +79,14 @@ void block_Init( block_t *restrict b, void *buf, size_t size )
 #endif
 }
 
+static bool BlockPoolPut( block_sys_t * );
+
 static void BlockRelease( block_t *p_block )
 {
-    free( p_block );
+    block_sys_t *p_sys = (block_sys_t *)p_block;
+
+    if( p_sys->i_class < 0 || !BlockPoolPut( p_sys ) )
+        free( p_sys );
 }
 
 static void BlockMetaCopy( block_t *restrict out, const block_t *in )
@@ -98,49 +106,336 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /* Maximum size of reserved footer before we release with realloc() */
 #define BLOCK_WASTE_SIZE   2048
 
+/**
+ * @section Block pool.
+ *
+ * Heap blocks are grouped in size classes, four per doubling of the payload
+ * size, so that the rounding wastes at most a fifth. Released blocks are
+ * kept in a per-thread cache and recycled by the next block_Alloc() of the
+ * same class on that thread, without going through the heap. When a cache
+ * overflows or runs dry, blocks are moved in batches to/from a small
+ * process-wide depot, so that blocks flowing from one thread to another
+ * (e.g. from the input thread to a decoder) get recycled too.
+ */
+/* Payload size of the smallest class (log2): 256 bytes */
+#define BLOCK_POOL_MIN_SHIFT 8
+/* Number of size classes per doubling of the payload size (log2) */
+#define BLOCK_POOL_STEP_SHIFT 2
+/* Number of size classes: 256 bytes to 32 kiB */
+#define BLOCK_POOL_CLASSES   ((7 << BLOCK_POOL_STEP_SHIFT) + 1)
+/* Maximum number of cached blocks per class and per thread */
+#define BLOCK_POOL_DEPTH     64
+/* Maximum number of cached payload bytes per class and per thread */
+#define BLOCK_POOL_BYTES     (256 << 10)
+/* Number of blocks moved between a thread cache and the depot at once */
+#define BLOCK_POOL_BATCH     16
+/* Depot capacity, relative to a thread cache capacity */
+#define BLOCK_POOL_DEPOT     4
+/* Number of cache operations between two statistics updates */
+#define BLOCK_POOL_STATS     256
+
+typedef struct
+{
+    block_t    *p_first;
+    unsigned    i_count;
+} block_pool_list_t;
+
+typedef struct
+{
+    block_pool_list_t classes[BLOCK_POOL_CLASSES];
+    unsigned          i_hits;
+    unsigned          i_misses;
+} block_cache_t;
+
+static vlc_threadvar_t pool_key;
+static bool pool_enabled = false;
+
+static vlc_mutex_t depot_lock = VLC_STATIC_MUTEX;
+static block_pool_list_t depot[BLOCK_POOL_CLASSES];
+
+static vlc_atomic_t pool_hits = VLC_ATOMIC_INIT(0);
+static vlc_atomic_t pool_misses = VLC_ATOMIC_INIT(0);
+
+/**
+ * Returns the payload size of a size class.
+ */
+static size_t BlockPoolSize( unsigned i_class )
+{
+    unsigned i_octave = i_class >> BLOCK_POOL_STEP_SHIFT;
+    unsigned i_step = i_class & ((1 << BLOCK_POOL_STEP_SHIFT) - 1);
+
+    return (size_t)((1 << BLOCK_POOL_STEP_SHIFT) + i_step)
+        << (BLOCK_POOL_MIN_SHIFT - BLOCK_POOL_STEP_SHIFT + i_octave);
+}
+
+/**
+ * Returns the size class for a given (aligned) payload size,
+ * or -1 if the payload is too large to be pooled.
+ */
+static int BlockPoolClass( size_t i_size )
+{
+    if( i_size <= BlockPoolSize( 0 ) )
+        return 0;
+    if( i_size > BlockPoolSize( BLOCK_POOL_CLASSES - 1 ) )
+        return -1;
+
+    /* Octave of the size, then number of steps of that octave to cover it */
+    unsigned i_log = 31 - clz32( i_size - 1 );
+    unsigned i_steps = ((i_size - 1) >> (i_log - BLOCK_POOL_STEP_SHIFT)) + 1;
+
+    return ((i_log - BLOCK_POOL_MIN_SHIFT) << BLOCK_POOL_STEP_SHIFT)
+         + i_steps - (1 << BLOCK_POOL_STEP_SHIFT);
+}
+
+static unsigned BlockPoolDepth( unsigned i_class )
+{
+    unsigned i_depth = BLOCK_POOL_BYTES / BlockPoolSize( i_class );
+    return __MIN( i_depth, BLOCK_POOL_DEPTH );
+}
+
+/**
+ * Moves up to n blocks from the head of one list to the head of another.
+ */
+static void BlockPoolMove( block_pool_list_t *dst, block_pool_list_t *src,
+                           unsigned n )
+{
+    if( n > src->i_count )
+        n = src->i_count;
+    if( n == 0 )
+        return;
+
+    block_t *p_first = src->p_first, *p_last = p_first;
+    for( unsigned i = 1; i < n; i++ )
+        p_last = p_last->p_next;
+
+    src->p_first = p_last->p_next;
+    src->i_count -= n;
+    p_last->p_next = dst->p_first;
+    dst->p_first = p_first;
+    dst->i_count += n;
+}
+
+static void BlockCacheFlushStats( block_cache_t *cache )
+{
+    vlc_atomic_add( &pool_hits, cache->i_hits );
+    vlc_atomic_add( &pool_misses, cache->i_misses );
+    cache->i_hits = cache->i_misses = 0;
+}
+
+/**
+ * Thread exit callback: hands the cached blocks over to the depot,
+ * and frees whatever does not fit there.
+ */
+static void BlockCacheDestroy( void *data )
+{
+    block_cache_t *cache = data;
+
+    vlc_mutex_lock( &depot_lock );
+    for( unsigned i = 0; i < BLOCK_POOL_CLASSES; i++ )
+    {
+        unsigned i_max = BLOCK_POOL_DEPOT * BlockPoolDepth( i );
+
+        if( depot[i].i_count < i_max )
+            BlockPoolMove( &depot[i], &cache->classes[i],
+                           i_max - depot[i].i_count );
+    }
+    vlc_mutex_unlock( &depot_lock );
+
+    for( unsigned i = 0; i < BLOCK_POOL_CLASSES; i++ )
+        for( block_t *b = cache->classes[i].p_first, *next; b != NULL; b = next )
+        {
+            next = b->p_next;
+            free( b );
+        }
+
+    BlockCacheFlushStats( cache );
+    free( cache );
+}
+
+/**
+ * Initializes the block pool. This is called once per process.
+ */
+void block_PoolInit( void )
+{
+    pool_enabled = !vlc_threadvar_create( &pool_key, BlockCacheDestroy );
+}
+
+/**
+ * Returns the block cache of the calling thread, or NULL on error.
+ */
+static block_cache_t *BlockCacheGet( void )
+{
+/* On Windows and OS/2,
+ * initialized from DllMain() and _DLL_InitTerm() respectively, instead */
+#if !defined(WIN32) && !defined(__OS2__)
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once( &once, block_PoolInit );
+#endif
+    if( unlikely(!pool_enabled) )
+        return NULL;
+
+    block_cache_t *cache = vlc_threadvar_get( pool_key );
+    if( unlikely(cache == NULL) )
+    {
+        cache = calloc( 1, sizeof( *cache ) );
+        if( cache == NULL )
+            return NULL;
+        if( vlc_threadvar_set( pool_key, cache ) )
+        {
+            free( cache );
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+/**
+ * Takes a block of the given size class from the pool.
+ * @return a recycled block, or NULL if none is available.
+ */
+static block_sys_t *BlockPoolGet( unsigned i_class )
+{
+    block_cache_t *cache = BlockCacheGet();
+    if( cache == NULL )
+        return NULL;
+
+    block_pool_list_t *list = &cache->classes[i_class];
+    if( list->p_first == NULL )
+    {   /* Refill from the depot */
+        vlc_mutex_lock( &depot_lock );
+        BlockPoolMove( list, &depot[i_class], BLOCK_POOL_BATCH );
+        vlc_mutex_unlock( &depot_lock );
+    }
+
+    block_t *b = list->p_first;
+    if( b != NULL )
+    {
+        list->p_first = b->p_next;
+        list->i_count--;
+        cache->i_hits++;
+    }
+    else
+        cache->i_misses++;
+
+    if( cache->i_hits + cache->i_misses >= BLOCK_POOL_STATS )
+        BlockCacheFlushStats( cache );
+    return (block_sys_t *)b;
+}
+
+/**
+ * Gives a block back to the pool.
+ * @return true if the block was cached, false if it must be freed.
+ */
+static bool BlockPoolPut( block_sys_t *p_sys )
+{
+    block_cache_t *cache = BlockCacheGet();
+    if( cache == NULL )
+        return false;
+
+    unsigned i_class = p_sys->i_class;
+    unsigned i_depth = BlockPoolDepth( i_class );
+    block_pool_list_t *list = &cache->classes[i_class];
+
+    if( list->i_count >= i_depth )
+    {   /* Spill to the depot */
+        unsigned i_max = BLOCK_POOL_DEPOT * i_depth;
+
+        vlc_mutex_lock( &depot_lock );
+        if( depot[i_class].i_count < i_max )
+            BlockPoolMove( &depot[i_class], list,
+                           __MIN( i_max - depot[i_class].i_count,
+                                  BLOCK_POOL_BATCH ) );
+        vlc_mutex_unlock( &depot_lock );
+
+        if( list->i_count >= i_depth )
+            return false;
+    }
+
+    p_sys->self.p_next = list->p_first;
+    list->p_first = &p_sys->self;
+    list->i_count++;
+    return true;
+}
+
+/**
+ * Frees the blocks of the depot and of the calling thread cache.
+ * The blocks cached by other threads are freed when they exit.
+ */
+void block_PoolCleanup( void )
+{
+    block_pool_list_t list = { NULL, 0 };
+
+    vlc_mutex_lock( &depot_lock );
+    for( unsigned i = 0; i < BLOCK_POOL_CLASSES; i++ )
+        BlockPoolMove( &list, &depot[i], depot[i].i_count );
+    vlc_mutex_unlock( &depot_lock );
+
+    block_cache_t *cache = pool_enabled ? vlc_threadvar_get( pool_key ) : NULL;
+    if( cache != NULL )
+    {
+        for( unsigned i = 0; i < BLOCK_POOL_CLASSES; i++ )
+            BlockPoolMove( &list, &cache->classes[i],
+                           cache->classes[i].i_count );
+        BlockCacheFlushStats( cache );
+    }
+
+    for( block_t *b = list.p_first, *next; b != NULL; b = next )
+    {
+        next = b->p_next;
+        free( b );
+    }
+}
+
+/**
+ * Retrieves the block pool statistics (process-wide).
+ * @param hits where to store the number of recycled block allocations
+ * @param misses where to store the number of heap block allocations
+ */
+void block_PoolStats( uint64_t *hits, uint64_t *misses )
+{
+    *hits = vlc_atomic_get( &pool_hits );
+    *misses = vlc_atomic_get( &pool_misses );
+}
+
 block_t *block_Alloc( size_t i_size )
 {
-    /* We do only one malloc
-     * TODO: bench if doing 2 malloc but keeping a pool of buffer is better
-     * 2 * BLOCK_PADDING -> pre + post padding
-     */
-    block_sys_t *p_sys;
+    /* 2 * BLOCK_PADDING -> pre + post padding
+     * Note: posix_memalign(,16,) is much slower than malloc() on glibc.
+     * -- Courmisch, September 2009, glibc 2.5 & 2.9 */
+    block_sys_t *p_sys = NULL;
     uint8_t *buf;
 #define ALIGN(x) (((x) + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1))
-#if 0 /*def HAVE_POSIX_MEMALIGN */
-    /* posix_memalign(,16,) is much slower than malloc() on glibc.
-     * -- Courmisch, September 2009, glibc 2.5 & 2.9 */
-    const size_t i_alloc = ALIGN(sizeof(*p_sys)) + (2 * BLOCK_PADDING)
-                         + ALIGN(i_size);
-    if( unlikely(i_alloc <= i_size) )
-        return NULL;
-    void *ptr;
-
-    if( posix_memalign( &ptr, BLOCK_ALIGN, i_alloc ) )
+    size_t i_reserve = ALIGN(i_size);
+    if( unlikely(i_reserve < i_size) )
         return NULL;
 
-    p_sys = ptr;
-    buf = p_sys->p_allocated_buffer + (-sizeof(*p_sys) & (BLOCK_ALIGN - 1));
+    int i_class = BlockPoolClass( i_reserve );
+    if( i_class >= 0 )
+    {
+        i_reserve = BlockPoolSize( i_class );
+        p_sys = BlockPoolGet( i_class );
+    }
 
-#else
     const size_t i_alloc = sizeof(*p_sys) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                         + ALIGN(i_size);
+                         + i_reserve;
     if( unlikely(i_alloc <= i_size) )
         return NULL;
 
-    p_sys = malloc( i_alloc );
     if( p_sys == NULL )
-        return NULL;
+    {
+        p_sys = malloc( i_alloc );
+        if( p_sys == NULL )
+            return NULL;
+    }
 
     buf = (void *)ALIGN((uintptr_t)p_sys->p_allocated_buffer);
-
-#endif
     buf += BLOCK_PADDING;
 
     block_Init( &p_sys->self, buf, i_size );
     p_sys->self.pf_release    = BlockRelease;
     /* Fill opaque data */
     p_sys->i_allocated_buffer = i_alloc - sizeof(*p_sys);
+    p_sys->i_class = i_class;
 
     return &p_sys->self;
 }
@@ -234,9 +529,12 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
         p_block = p_rea;
     }
     else
-    /* We have a very large reserved footer now? Release some of it.
+    /* We have a very large reserved footer now? Release some of it,
+     * unless a new block would come from the same pool size class anyway.
      * XXX it might not preserve the alignment of p_buffer */
-    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE )
+    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE
+     && (p_sys->i_class < 0
+      || p_sys->i_class != BlockPoolClass( ALIGN(requested) )) )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea )
@@ -501,14 +799,33 @@ struct block_fifo_t
     vlc_cond_t          wait;      /**< Wait for data */
     vlc_cond_t          wait_room; /**< Wait for queue depth to shrink */
 
-    block_t             *p_first;
+    block_t             *p_first;  /**< First block (or SPSC read cursor) */
     block_t             **pp_last;
-    size_t              i_depth;
-    size_t              i_size;
+    vlc_atomic_t        i_depth;
+    vlc_atomic_t        i_size;
     bool          b_force_wake;
+
+    /* Single producer, single consumer mode */
+    bool                b_spsc;
+    vlc_atomic_t        tail;      /**< Last queued block */
+    vlc_atomic_t        readers;   /**< Threads waiting for data */
+    vlc_atomic_t        writers;   /**< Threads waiting for room */
+    block_t             stub;      /**< Placeholder when the queue is empty */
 };
 
-block_fifo_t *block_FifoNew( void )
+/**
+ * Creates a block FIFO.
+ *
+ * With BLOCK_FIFO_SPSC, the FIFO is optimized for exactly one writing thread
+ * (block_FifoPut() and block_FifoPace()) and one reading thread
+ * (block_FifoGet(), block_FifoShow() and block_FifoEmpty()). Blocks are then
+ * queued and dequeued without taking the FIFO lock, which is only used to
+ * sleep when the queue is empty (or too deep for block_FifoPace()).
+ *
+ * @param i_flags zero or BLOCK_FIFO_SPSC
+ * @return a new FIFO, or NULL on memory error.
+ */
+block_fifo_t *block_FifoNewExt( int i_flags )
 {
     block_fifo_t *p_fifo = malloc( sizeof( block_fifo_t ) );
     if( !p_fifo )
@@ -517,14 +834,25 @@ block_fifo_t *block_FifoNew( void )
     vlc_mutex_init( &p_fifo->lock );
     vlc_cond_init( &p_fifo->wait );
     vlc_cond_init( &p_fifo->wait_room );
-    p_fifo->p_first = NULL;
+    p_fifo->b_spsc = (i_flags & BLOCK_FIFO_SPSC) != 0;
+    block_Init( &p_fifo->stub, NULL, 0 );
+    p_fifo->p_first = p_fifo->b_spsc ? &p_fifo->stub : NULL;
     p_fifo->pp_last = &p_fifo->p_first;
-    p_fifo->i_depth = p_fifo->i_size = 0;
+    vlc_atomic_set( &p_fifo->i_depth, 0 );
+    vlc_atomic_set( &p_fifo->i_size, 0 );
     p_fifo->b_force_wake = false;
+    vlc_atomic_set( &p_fifo->tail, (uintptr_t)&p_fifo->stub );
+    vlc_atomic_set( &p_fifo->readers, 0 );
+    vlc_atomic_set( &p_fifo->writers, 0 );
 
     return p_fifo;
 }
 
+block_fifo_t *block_FifoNew( void )
+{
+    return block_FifoNewExt( 0 );
+}
+
 void block_FifoRelease( block_fifo_t *p_fifo )
 {
     block_FifoEmpty( p_fifo );
@@ -534,15 +862,134 @@ void block_FifoRelease( block_fifo_t *p_fifo )
     free( p_fifo );
 }
 
+/*
+ * Lock-free SPSC queue: the blocks are linked through their p_next pointer,
+ * behind a stub block, so that the writer never touches a block that the
+ * reader may have dequeued already. Only the writer updates the tail, except
+ * when the reader dequeues the last block and requeues the stub instead, hence
+ * the atomic swap. The depth counter is updated after linking the blocks, and
+ * is used by the reader to know that blocks are available.
+ */
+static void FifoPush( block_fifo_t *p_fifo, block_t *p_first, block_t *p_last )
+{
+    p_last->p_next = NULL;
+    uintptr_t prev = vlc_atomic_swap( &p_fifo->tail, (uintptr_t)p_last );
+    block_t *p_prev = (block_t *)prev;
+    p_prev->p_next = p_first;
+}
+
+/**
+ * Dequeues one block, or returns NULL if the writer has not linked the
+ * next block yet.
+ */
+static block_t *FifoPop( block_fifo_t *p_fifo )
+{
+    block_t *p_head = p_fifo->p_first;
+    block_t *p_next = p_head->p_next;
+
+    if( p_head == &p_fifo->stub )
+    {
+        if( p_next == NULL )
+            return NULL;
+        p_fifo->p_first = p_head = p_next;
+        p_next = p_next->p_next;
+    }
+
+    if( p_next == NULL )
+    {   /* Last block: put the stub back behind it first */
+        uintptr_t tail = vlc_atomic_get( &p_fifo->tail );
+        if( p_head != (block_t *)tail )
+            return NULL;
+        FifoPush( p_fifo, &p_fifo->stub, &p_fifo->stub );
+        p_next = p_head->p_next;
+        if( p_next == NULL )
+            return NULL;
+    }
+
+    p_fifo->p_first = p_next;
+    p_head->p_next = NULL;
+    return p_head;
+}
+
+/**
+ * Dequeues one block when the depth counter is known to be positive.
+ */
+static block_t *FifoPopSPSC( block_fifo_t *p_fifo )
+{
+    block_t *b = FifoPop( p_fifo );
+
+    if( unlikely(b == NULL) )
+    {   /* The writer was preempted before linking its next block. As we are
+         * announced as a reader, it signals the condition once it is done. */
+        int canc = vlc_savecancel();
+
+        vlc_mutex_lock( &p_fifo->lock );
+        vlc_atomic_inc( &p_fifo->readers );
+        while( (b = FifoPop( p_fifo )) == NULL )
+            vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+        vlc_atomic_dec( &p_fifo->readers );
+        vlc_mutex_unlock( &p_fifo->lock );
+        vlc_restorecancel( canc );
+    }
+
+    vlc_atomic_sub( &p_fifo->i_size, b->i_buffer );
+    vlc_atomic_dec( &p_fifo->i_depth );
+
+    if( vlc_atomic_get( &p_fifo->writers ) )
+    {
+        vlc_mutex_lock( &p_fifo->lock );
+        vlc_cond_broadcast( &p_fifo->wait_room );
+        vlc_mutex_unlock( &p_fifo->lock );
+    }
+    return b;
+}
+
+static void FifoWaitCleanup( void *data )
+{
+    block_fifo_t *p_fifo = data;
+
+    vlc_atomic_dec( &p_fifo->readers );
+    vlc_mutex_unlock( &p_fifo->lock );
+}
+
+/**
+ * Waits for data in a SPSC FIFO.
+ * @return false if block_FifoWake() was called, true otherwise.
+ */
+static bool FifoWaitSPSC( block_fifo_t *p_fifo )
+{
+    bool b_data;
+
+    vlc_mutex_lock( &p_fifo->lock );
+    /* Announce ourselves before checking the depth, so that the writer cannot
+     * miss us (both atomic operations are full barriers). */
+    vlc_atomic_inc( &p_fifo->readers );
+    vlc_cleanup_push( FifoWaitCleanup, p_fifo );
+    while( !(b_data = vlc_atomic_get( &p_fifo->i_depth ) > 0)
+        && !p_fifo->b_force_wake )
+        vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+    p_fifo->b_force_wake = false;
+    vlc_cleanup_run();
+    return b_data;
+}
+
 void block_FifoEmpty( block_fifo_t *p_fifo )
 {
     block_t *block;
 
+    if( p_fifo->b_spsc )
+    {
+        while( vlc_atomic_get( &p_fifo->i_depth ) > 0 )
+            block_Release( FifoPopSPSC( p_fifo ) );
+        return;
+    }
+
     vlc_mutex_lock( &p_fifo->lock );
     block = p_fifo->p_first;
     if (block != NULL)
     {
-        p_fifo->i_depth = p_fifo->i_size = 0;
+        vlc_atomic_set( &p_fifo->i_depth, 0 );
+        vlc_atomic_set( &p_fifo->i_size, 0 );
         p_fifo->p_first = NULL;
         p_fifo->pp_last = &p_fifo->p_first;
     }
@@ -559,6 +1006,14 @@ void block_FifoEmpty( block_fifo_t *p_fifo )
     }
 }
 
+static void FifoPaceCleanup( void *data )
+{
+    block_fifo_t *p_fifo = data;
+
+    vlc_atomic_dec( &p_fifo->writers );
+    vlc_mutex_unlock( &p_fifo->lock );
+}
+
 /**
  * Wait until the FIFO gets below a certain size (if needed).
  *
@@ -580,14 +1035,18 @@ void block_FifoPace (block_fifo_t *fifo, size_t max_depth, size_t max_size)
 {
     vlc_testcancel ();
 
+    if (fifo->b_spsc
+     && vlc_atomic_get (&fifo->i_depth) <= max_depth
+     && vlc_atomic_get (&fifo->i_size) <= max_size)
+        return;
+
     vlc_mutex_lock (&fifo->lock);
-    while ((fifo->i_depth > max_depth) || (fifo->i_size > max_size))
-    {
-         mutex_cleanup_push (&fifo->lock);
+    vlc_atomic_inc (&fifo->writers);
+    vlc_cleanup_push (FifoPaceCleanup, fifo);
+    while ((vlc_atomic_get (&fifo->i_depth) > max_depth)
+        || (vlc_atomic_get (&fifo->i_size) > max_size))
          vlc_cond_wait (&fifo->wait_room, &fifo->lock);
-         vlc_cleanup_pop ();
-    }
-    vlc_mutex_unlock (&fifo->lock);
+    vlc_cleanup_run ();
 }
 
 /**
@@ -611,11 +1070,26 @@ size_t block_FifoPut( block_fifo_t *p_fifo, block_t *p_block )
             break;
     }
 
+    if( p_fifo->b_spsc )
+    {
+        FifoPush( p_fifo, p_block, p_last );
+        vlc_atomic_add( &p_fifo->i_size, i_size );
+        vlc_atomic_add( &p_fifo->i_depth, i_depth );
+        /* Wake the reader up only if it is (about to be) sleeping */
+        if( vlc_atomic_get( &p_fifo->readers ) )
+        {
+            vlc_mutex_lock( &p_fifo->lock );
+            vlc_cond_signal( &p_fifo->wait );
+            vlc_mutex_unlock( &p_fifo->lock );
+        }
+        return i_size;
+    }
+
     vlc_mutex_lock (&p_fifo->lock);
     *p_fifo->pp_last = p_block;
     p_fifo->pp_last = &p_last->p_next;
-    p_fifo->i_depth += i_depth;
-    p_fifo->i_size += i_size;
+    vlc_atomic_add( &p_fifo->i_depth, i_depth );
+    vlc_atomic_add( &p_fifo->i_size, i_size );
     /* We queued at least one block: wake up one read-waiting thread */
     vlc_cond_signal( &p_fifo->wait );
     vlc_mutex_unlock( &p_fifo->lock );
@@ -626,7 +1100,7 @@ size_t block_FifoPut( block_fifo_t *p_fifo, block_t *p_block )
 void block_FifoWake( block_fifo_t *p_fifo )
 {
     vlc_mutex_lock( &p_fifo->lock );
-    if( p_fifo->p_first == NULL )
+    if( vlc_atomic_get( &p_fifo->i_depth ) == 0 )
         p_fifo->b_force_wake = true;
     vlc_cond_broadcast( &p_fifo->wait );
     vlc_mutex_unlock( &p_fifo->lock );
@@ -644,6 +1118,14 @@ block_t *block_FifoGet( block_fifo_t *p_fifo )
 
     vlc_testcancel( );
 
+    if( p_fifo->b_spsc )
+    {
+        if( vlc_atomic_get( &p_fifo->i_depth ) == 0
+         && !FifoWaitSPSC( p_fifo ) )
+            return NULL; /* Forced wakeup */
+        return FifoPopSPSC( p_fifo );
+    }
+
     vlc_mutex_lock( &p_fifo->lock );
     mutex_cleanup_push( &p_fifo->lock );
 
@@ -664,8 +1146,8 @@ block_t *block_FifoGet( block_fifo_t *p_fifo )
     }
 
     p_fifo->p_first = b->p_next;
-    p_fifo->i_depth--;
-    p_fifo->i_size -= b->i_buffer;
+    vlc_atomic_dec( &p_fifo->i_depth );
+    vlc_atomic_sub( &p_fifo->i_size, b->i_buffer );
 
     if( p_fifo->p_first == NULL )
     {
@@ -697,6 +1179,20 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
 
     vlc_testcancel( );
 
+    if( p_fifo->b_spsc )
+    {
+        while( vlc_atomic_get( &p_fifo->i_depth ) == 0 )
+            FifoWaitSPSC( p_fifo );
+
+        b = p_fifo->p_first;
+        if( b == &p_fifo->stub )
+        {   /* The writer links the block before accounting for it */
+            p_fifo->p_first = b = b->p_next;
+            assert( b != NULL );
+        }
+        return b;
+    }
+
     vlc_mutex_lock( &p_fifo->lock );
     mutex_cleanup_push( &p_fifo->lock );
 
@@ -709,14 +1205,22 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
     return b;
 }
 
-/* FIXME: not thread-safe */
+/**
+ * Returns the total number of bytes queued in the FIFO.
+ * This can be called from any thread, but the value may be outdated
+ * by the time the function returns.
+ */
 size_t block_FifoSize( const block_fifo_t *p_fifo )
 {
-    return p_fifo->i_size;
+    return vlc_atomic_get( &p_fifo->i_size );
 }
 
-/* FIXME: not thread-safe */
+/**
+ * Returns the number of blocks queued in the FIFO.
+ * This can be called from any thread, but the value may be outdated
+ * by the time the function returns.
+ */
 size_t block_FifoCount( const block_fifo_t *p_fifo )
 {
-    return p_fifo->i_depth;
+    return vlc_atomic_get( &p_fifo->i_depth );
 }
@@ -111,6 +111,177 @@ void filter_DeleteBlend( filter_t *p_blend )
     vlc_object_release( p_blend );
 }
 
+/*****************************************************************************
+ * Slice threading
+ *****************************************************************************/
+struct filter_slices_t
+{
+    vlc_mutex_t    job_lock;    /* Only one job at a time */
+
+    vlc_mutex_t    lock;
+    vlc_cond_t     wait;        /* A job was posted, or exit */
+    vlc_cond_t     done;        /* All the slices of the job are done */
+    bool           b_exit;
+
+    unsigned       i_threads;
+    vlc_thread_t   *p_threads;
+
+    /* Current job */
+    filter_t       *p_filter;
+    filter_slice_t pf_slice;
+    void           *p_data;
+    unsigned       i_slices;
+    unsigned       i_next;      /* Next slice to process */
+    unsigned       i_pending;   /* Slices not processed yet */
+};
+
+static void *SlicesThread( void *data )
+{
+    filter_slices_t *p_slices = data;
+
+    vlc_mutex_lock( &p_slices->lock );
+    for( ;; )
+    {
+        while( !p_slices->b_exit && p_slices->i_next >= p_slices->i_slices )
+            vlc_cond_wait( &p_slices->wait, &p_slices->lock );
+        if( p_slices->b_exit )
+            break;
+
+        /* The job cannot change until all its slices are done */
+        filter_t *p_filter = p_slices->p_filter;
+        filter_slice_t pf_slice = p_slices->pf_slice;
+        void *p_data = p_slices->p_data;
+        const unsigned i_slices = p_slices->i_slices;
+        const unsigned i_slice = p_slices->i_next++;
+
+        vlc_mutex_unlock( &p_slices->lock );
+        pf_slice( p_filter, p_data, i_slice, i_slices );
+        vlc_mutex_lock( &p_slices->lock );
+
+        if( --p_slices->i_pending == 0 )
+            vlc_cond_signal( &p_slices->done );
+    }
+    vlc_mutex_unlock( &p_slices->lock );
+    return NULL;
+}
+
+static filter_slices_t *SlicesCreate( vlc_object_t *p_obj )
+{
+    int i_threads = var_InheritInteger( p_obj, "filter-threads" );
+    if( i_threads <= 0 )
+        i_threads = vlc_GetCPUCount();
+
+    /* The calling thread processes slices too */
+    i_threads--;
+    if( i_threads <= 0 )
+        return NULL;
+
+    filter_slices_t *p_slices = malloc( sizeof(*p_slices) );
+    if( !p_slices )
+        return NULL;
+    p_slices->p_threads = malloc( i_threads * sizeof(*p_slices->p_threads) );
+    if( !p_slices->p_threads )
+    {
+        free( p_slices );
+        return NULL;
+    }
+
+    vlc_mutex_init( &p_slices->job_lock );
+    vlc_mutex_init( &p_slices->lock );
+    vlc_cond_init( &p_slices->wait );
+    vlc_cond_init( &p_slices->done );
+    p_slices->b_exit    = false;
+    p_slices->i_slices  = 0;
+    p_slices->i_next    = 0;
+    p_slices->i_pending = 0;
+    p_slices->i_threads = 0;
+
+    for( int i = 0; i < i_threads; i++ )
+    {
+        if( vlc_clone( &p_slices->p_threads[i], SlicesThread, p_slices,
+                       VLC_THREAD_PRIORITY_OUTPUT ) )
+            break;
+        p_slices->i_threads++;
+    }
+    msg_Dbg( p_obj, "using %u video filter threads", p_slices->i_threads + 1 );
+    return p_slices;
+}
+
+void filter_SlicesDestroy( filter_slices_t *p_slices )
+{
+    vlc_mutex_lock( &p_slices->lock );
+    p_slices->b_exit = true;
+    vlc_cond_broadcast( &p_slices->wait );
+    vlc_mutex_unlock( &p_slices->lock );
+
+    for( unsigned i = 0; i < p_slices->i_threads; i++ )
+        vlc_join( p_slices->p_threads[i], NULL );
+
+    vlc_cond_destroy( &p_slices->done );
+    vlc_cond_destroy( &p_slices->wait );
+    vlc_mutex_destroy( &p_slices->lock );
+    vlc_mutex_destroy( &p_slices->job_lock );
+    free( p_slices->p_threads );
+    free( p_slices );
+}
+
+static filter_slices_t *SlicesGet( filter_t *p_filter )
+{
+    static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+    libvlc_priv_t *priv = libvlc_priv( p_filter->p_libvlc );
+
+    vlc_mutex_lock( &lock );
+    if( !priv->p_filter_slices )
+        priv->p_filter_slices = SlicesCreate( VLC_OBJECT(p_filter->p_libvlc) );
+    filter_slices_t *p_slices = priv->p_filter_slices;
+    vlc_mutex_unlock( &lock );
+
+    return p_slices;
+}
+
+void filter_Slice( filter_t *p_filter, filter_slice_t pf_slice, void *p_data )
+{
+    filter_slices_t *p_slices = SlicesGet( p_filter );
+
+    /* Without worker threads, or when they are busy with another filter,
+     * process the whole picture in this thread */
+    if( !p_slices || p_slices->i_threads == 0 ||
+        vlc_mutex_trylock( &p_slices->job_lock ) )
+    {
+        pf_slice( p_filter, p_data, 0, 1 );
+        return;
+    }
+
+    int canc = vlc_savecancel();
+    vlc_mutex_lock( &p_slices->lock );
+    p_slices->p_filter  = p_filter;
+    p_slices->pf_slice  = pf_slice;
+    p_slices->p_data    = p_data;
+    p_slices->i_slices  = p_slices->i_threads + 1;
+    p_slices->i_next    = 0;
+    p_slices->i_pending = p_slices->i_slices;
+    vlc_cond_broadcast( &p_slices->wait );
+
+    while( p_slices->i_next < p_slices->i_slices )
+    {
+        const unsigned i_slice = p_slices->i_next++;
+
+        vlc_mutex_unlock( &p_slices->lock );
+        pf_slice( p_filter, p_data, i_slice, p_slices->i_threads + 1 );
+        vlc_mutex_lock( &p_slices->lock );
+
+        p_slices->i_pending--;
+    }
+    while( p_slices->i_pending > 0 )
+        vlc_cond_wait( &p_slices->done, &p_slices->lock );
+
+    p_slices->i_slices = 0;
+    p_slices->i_next   = 0;
+    vlc_mutex_unlock( &p_slices->lock );
+    vlc_mutex_unlock( &p_slices->job_lock );
+    vlc_restorecancel( canc );
+}
+
 /* */
 #include <vlc_video_splitter.h>
 
@@ -33,6 +33,8 @@
 
 #include <vlc_common.h>
 #include <vlc_picture_pool.h>
+#include <vlc_atomic.h>
+#include "libvlc.h"
 
 /*****************************************************************************
  *
@@ -48,8 +50,36 @@ struct picture_release_sys_t {
 
     /* */
     int64_t tick;
+
+    /* Pool the picture is handed out by (or one of the OWNER_ values), and
+     * its index in the pool at the root (which all pools share) */
+    vlc_atomic_t   owner;
+    int            index;
 };
 
+/* A released picture goes back to the pool which handed it out, unless
+ * that pool is a reserved one being deleted, in which case the picture goes
+ * to the master pool. The owner field serializes that hand-over with
+ * Release(), which may run in another thread: both sides change the owner
+ * with a compare and swap, and the deletion waits while a release holds the
+ * transient state. The pictures of a pool which is not reserved never change
+ * hands, so their release skips that. */
+#define OWNER_FREE    ((uintptr_t)0) /* in the free list of its pool */
+#define OWNER_BUSY    ((uintptr_t)1) /* being pushed to that free list */
+
+/* The free pictures are kept in a lock-free LIFO list of indexes. The list
+ * head holds the index of the first free picture in its low bits, and the
+ * number of pictures pushed to the list in the others. The head cannot come
+ * back to a previous value without a push, so that counter is enough against
+ * ABA problems, and also tells how many pictures were released. */
+#define POOL_INDEX_BITS (16)
+#define POOL_INDEX_NONE ((1 << POOL_INDEX_BITS) - 1)
+#define POOL_PUSH_MASK  (UINTPTR_MAX >> POOL_INDEX_BITS)
+
+/* Number of picture_pool_Get calls between two updates of the process-wide
+ * statistics */
+#define POOL_STATS_BATCH (64)
+
 struct picture_pool_t {
     /* */
     picture_pool_t *master;
@@ -57,13 +87,125 @@ struct picture_pool_t {
     /* */
     int            picture_count;
     picture_t      **picture;
+
+    /* Indexed by the picture indexes of the pool at the root */
+    int            index_count;
+    picture_t      **index_picture;
     bool           *picture_reserved;
+
+    /* Free list */
+    vlc_atomic_t   free_head;
+    int            *free_next;
+
+    /* Statistics, only updated by picture_pool_Get and by the functions which
+     * cannot run concurrently with it */
+    uintptr_t      taken;   /* Pictures handed out */
+    uintptr_t      pushed;  /* Pushes to the free list which are not releases */
+    unsigned       peak;
+    unsigned       gets;
+    unsigned       starved;
 };
 
+/* Process-wide statistics */
+static vlc_atomic_t pool_gets = VLC_ATOMIC_INIT(0);
+static vlc_atomic_t pool_starved = VLC_ATOMIC_INIT(0);
+static vlc_atomic_t pool_peak = VLC_ATOMIC_INIT(0);
+
 static void Release(picture_t *);
 static int  Lock(picture_t *);
 static void Unlock(picture_t *);
 
+/* Takes the first free picture index, or returns -1. The number of pushes
+ * seen is stored in *pushes. */
+static int PopFree(picture_pool_t *pool, uintptr_t *pushes)
+{
+    /* A plain read is enough, the compare and swap checks it */
+    uintptr_t head = pool->free_head.u;
+
+    for (;;) {
+        int index = head & POOL_INDEX_NONE;
+        *pushes = head >> POOL_INDEX_BITS;
+        if (index == POOL_INDEX_NONE)
+            return -1;
+
+        uintptr_t next = (head & ~(uintptr_t)POOL_INDEX_NONE)
+                       | pool->free_next[index];
+        uintptr_t old = vlc_atomic_compare_swap(&pool->free_head, head, next);
+        if (old == head)
+            return index;
+        head = old;
+    }
+}
+
+static void PushFree(picture_pool_t *pool, int index)
+{
+    uintptr_t head = pool->free_head.u;
+
+    for (;;) {
+        uintptr_t pushes = (head >> POOL_INDEX_BITS) + 1;
+        pool->free_next[index] = head & POOL_INDEX_NONE;
+        uintptr_t old = vlc_atomic_compare_swap(&pool->free_head, head,
+                                        (pushes << POOL_INDEX_BITS) | index);
+        if (old == head)
+            return;
+        head = old;
+    }
+}
+
+/* Makes a picture handed out by a pool available again */
+static void PoolFree(picture_t *picture)
+{
+    picture_release_sys_t *release_sys = picture->p_release_sys;
+    uintptr_t owner = release_sys->owner.u;
+
+    picture->i_refcount = 0;
+    assert(owner != OWNER_FREE && owner != OWNER_BUSY);
+    if (((picture_pool_t *)owner)->master == NULL) {
+        PushFree((picture_pool_t *)owner, release_sys->index);
+        return;
+    }
+    for (;;) {
+        assert(owner != OWNER_FREE && owner != OWNER_BUSY);
+
+        uintptr_t old = vlc_atomic_compare_swap(&release_sys->owner, owner,
+                                                OWNER_BUSY);
+        if (old == owner)
+            break;
+        owner = old;
+    }
+    PushFree((picture_pool_t *)owner, release_sys->index);
+    /* Unless picture_pool_Get() handed it out again already */
+    vlc_atomic_compare_swap(&release_sys->owner, OWNER_BUSY, OWNER_FREE);
+}
+
+static void PoolStatsFlush(picture_pool_t *pool)
+{
+    if (pool->gets > 0)
+        vlc_atomic_add(&pool_gets, pool->gets);
+    if (pool->starved > 0)
+        vlc_atomic_add(&pool_starved, pool->starved);
+    pool->gets = pool->starved = 0;
+}
+
+/* Accounts for a picture handed out while the given number of pictures had
+ * been pushed to the free list */
+static void PoolStatsTake(picture_pool_t *pool, uintptr_t pushes)
+{
+    unsigned used = (++pool->taken - (pushes - pool->pushed)) & POOL_PUSH_MASK;
+
+    if (used > pool->peak) {
+        uintptr_t peak = vlc_atomic_get(&pool_peak);
+
+        pool->peak = used;
+        while (used > peak) {
+            uintptr_t old = vlc_atomic_compare_swap(&pool_peak, peak, used);
+            if (old == peak)
+                break;
+            peak = old;
+        }
+    }
+}
+
 static picture_pool_t *Create(picture_pool_t *master, int picture_count)
 {
     picture_pool_t *pool = calloc(1, sizeof(*pool));
@@ -73,14 +215,27 @@ static picture_pool_t *Create(picture_pool_t *master, int picture_count)
     pool->master = master;
     pool->tick = master ? master->tick : 1;
     pool->picture_count = picture_count;
+    pool->index_count = master ? master->index_count : picture_count;
     pool->picture = calloc(pool->picture_count, sizeof(*pool->picture));
-    pool->picture_reserved = calloc(pool->picture_count, sizeof(*pool->picture_reserved));
-    if (!pool->picture || !pool->picture_reserved) {
+    pool->picture_reserved = calloc(pool->index_count, sizeof(*pool->picture_reserved));
+    pool->free_next = calloc(pool->index_count, sizeof(*pool->free_next));
+    if (!pool->picture || !pool->picture_reserved || !pool->free_next) {
         free(pool->picture);
         free(pool->picture_reserved);
+        free(pool->free_next);
         free(pool);
         return NULL;
     }
+    pool->index_picture = master ? master->index_picture : pool->picture;
+
+    /* All the pictures of a new pool start free, in order. Reserved pools
+     * start empty, their pictures are added by picture_pool_Reserve(). */
+    assert(pool->index_count < POOL_INDEX_NONE);
+    if (master)
+        picture_count = 0;
+    for (int i = 0; i < picture_count; i++)
+        pool->free_next[i] = i + 1 < picture_count ? i + 1 : POOL_INDEX_NONE;
+    vlc_atomic_set(&pool->free_head, picture_count > 0 ? 0 : POOL_INDEX_NONE);
     return pool;
 }
 
@@ -105,6 +260,8 @@ picture_pool_t *picture_pool_NewExtended(const picture_pool_configuration_t *cfg
         release_sys->lock        = cfg->lock;
         release_sys->unlock      = cfg->unlock;
         release_sys->tick        = 0;
+        vlc_atomic_set(&release_sys->owner, OWNER_FREE);
+        release_sys->index       = i;
 
         /* */
         picture->i_refcount    = 0;
@@ -161,18 +318,30 @@ picture_pool_t *picture_pool_Reserve(picture_pool_t *master, int count)
         return NULL;
 
     int found = 0;
-    for (int i = 0; i < master->picture_count && found < count; i++) {
-        if (master->picture_reserved[i])
-            continue;
+    int first, *next = &first;
+    while (found < count) {
+        uintptr_t pushes;
+        int i = PopFree(master, &pushes);
+        if (i < 0)
+            break;
 
-        assert(master->picture[i]->i_refcount == 0);
+        picture_t *picture = pool->index_picture[i];
+        assert(picture->i_refcount == 0);
         master->picture_reserved[i] = true;
+        /* It is in no free list, no release can race with this */
+        picture->p_release_sys->owner.u = OWNER_FREE;
 
-        pool->picture[found]          = master->picture[i];
-        pool->picture_reserved[found] = false;
+        /* Append it to the free list of the new pool */
+        *next = i;
+        next = &pool->free_next[i];
+
+        pool->picture[found] = picture;
         found++;
     }
+    *next = POOL_INDEX_NONE;
+    vlc_atomic_set(&pool->free_head, first);
     if (found < count) {
+        pool->picture_count = found;
         picture_pool_Delete(pool);
         return NULL;
     }
@@ -181,12 +350,36 @@ picture_pool_t *picture_pool_Reserve(picture_pool_t *master, int count)
 
 void picture_pool_Delete(picture_pool_t *pool)
 {
+    PoolStatsFlush(pool);
     for (int i = 0; i < pool->picture_count; i++) {
         picture_t *picture = pool->picture[i];
         if (pool->master) {
-            for (int j = 0; j < pool->master->picture_count; j++) {
-                if (pool->master->picture[j] == picture)
-                    pool->master->picture_reserved[j] = false;
+            picture_pool_t *master = pool->master;
+            picture_release_sys_t *release_sys = picture->p_release_sys;
+            int index = release_sys->index;
+
+            master->picture_reserved[index] = false;
+            for (;;) {
+                uintptr_t owner = vlc_atomic_get(&release_sys->owner);
+
+                /* Wait for a concurrent release to this pool */
+                if (owner == OWNER_BUSY)
+                    continue;
+
+                if (owner == OWNER_FREE) {
+                    master->pushed++;
+                    PushFree(master, index);
+                    break;
+                }
+
+                /* Pictures still in use return to the master pool when
+                 * released */
+                assert(owner == (uintptr_t)pool);
+                if (vlc_atomic_compare_swap(&release_sys->owner, owner,
+                                            (uintptr_t)master) == owner) {
+                    master->taken++;
+                    break;
+                }
             }
         } else {
             picture_release_sys_t *release_sys = picture->p_release_sys;
@@ -204,6 +397,7 @@ void picture_pool_Delete(picture_pool_t *pool)
             free(release_sys);
         }
     }
+    free(pool->free_next);
     free(pool->picture_reserved);
     free(pool->picture);
     free(pool);
@@ -211,24 +405,48 @@ void picture_pool_Delete(picture_pool_t *pool)
 
 picture_t *picture_pool_Get(picture_pool_t *pool)
 {
-    for (int i = 0; i < pool->picture_count; i++) {
-        if (pool->picture_reserved[i])
-            continue;
+    picture_t *picture = NULL;
+    int busy = POOL_INDEX_NONE;
 
-        picture_t *picture = pool->picture[i];
-        if (picture->i_refcount > 0)
-            continue;
+    for (;;) {
+        uintptr_t pushes;
+        int i = PopFree(pool, &pushes);
+        if (i < 0)
+            break;
 
-        if (Lock(picture))
+        if (Lock(pool->index_picture[i])) {
+            /* Keep it aside until we are done */
+            pool->free_next[i] = busy;
+            busy = i;
             continue;
+        }
 
         /* */
+        picture = pool->index_picture[i];
         picture->p_next = NULL;
         picture->p_release_sys->tick = pool->tick++;
+        /* The picture is in no free list, no release can race with this
+         * (but the end of the one which freed it, which does not mind) */
+        picture->p_release_sys->owner.u = (uintptr_t)pool;
         picture_Hold(picture);
-        return picture;
+        PoolStatsTake(pool, pushes);
+        break;
     }
-    return NULL;
+
+    while (busy != POOL_INDEX_NONE) {
+        int next = pool->free_next[busy];
+        pool->pushed++;
+        PushFree(pool, busy);
+        busy = next;
+    }
+
+    if (picture)
+        pool->gets++;
+    else
+        pool->starved++;
+    if (pool->gets + pool->starved >= POOL_STATS_BATCH)
+        PoolStatsFlush(pool);
+    return picture;
 }
 
 void picture_pool_NonEmpty(picture_pool_t *pool, bool reset)
@@ -236,24 +454,23 @@ void picture_pool_NonEmpty(picture_pool_t *pool, bool reset)
     picture_t *old = NULL;
 
     for (int i = 0; i < pool->picture_count; i++) {
-        if (pool->picture_reserved[i])
+        picture_t *picture = pool->picture[i];
+        if (pool->picture_reserved[picture->p_release_sys->index])
             continue;
 
-        picture_t *picture = pool->picture[i];
-        if (reset) {
-            if (picture->i_refcount > 0)
-                Unlock(picture);
-            picture->i_refcount = 0;
-        } else if (picture->i_refcount == 0) {
-            return;
+        if (picture->i_refcount == 0) {
+            if (!reset)
+                return;
+        } else if (reset) {
+            Unlock(picture);
+            PoolFree(picture);
         } else if (!old || picture->p_release_sys->tick < old->p_release_sys->tick) {
             old = picture;
         }
     }
     if (!reset && old) {
-        if (old->i_refcount > 0)
-            Unlock(old);
-        old->i_refcount = 0;
+        Unlock(old);
+        PoolFree(old);
     }
 }
 int picture_pool_GetSize(picture_pool_t *pool)
@@ -261,6 +478,20 @@ int picture_pool_GetSize(picture_pool_t *pool)
     return pool->picture_count;
 }
 
+/**
+ * Retrieves the picture pool statistics (process-wide).
+ * @param gets where to store the number of pictures handed out
+ * @param starved where to store the number of requests with no free picture
+ * @param peak where to store the largest number of pictures simultaneously
+ * used from a single pool
+ */
+void picture_PoolStats(uint64_t *gets, uint64_t *starved, uint64_t *peak)
+{
+    *gets = vlc_atomic_get(&pool_gets);
+    *starved = vlc_atomic_get(&pool_starved);
+    *peak = vlc_atomic_get(&pool_peak);
+}
+
 static void Release(picture_t *picture)
 {
     assert(picture->i_refcount > 0);
@@ -268,6 +499,7 @@ static void Release(picture_t *picture)
     if (--picture->i_refcount > 0)
         return;
     Unlock(picture);
+    PoolFree(picture);
 }
 
 static int Lock(picture_t *picture)
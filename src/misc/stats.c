@@ -183,6 +183,12 @@ void stats_ComputeInputStats( input_thread_t *p_input, input_stats_t *p_stats )
                       &p_stats->i_decoded_video );
     stats_GetInteger( p_input, p_input->p->counters.p_decoded_audio,
                       &p_stats->i_decoded_audio );
+    stats_GetInteger( p_input, p_input->p->counters.p_packetize_time,
+                      &p_stats->i_packetize_time );
+    stats_GetInteger( p_input, p_input->p->counters.p_decode_time,
+                      &p_stats->i_decode_time );
+    stats_GetInteger( p_input, p_input->p->counters.p_display_time,
+                      &p_stats->i_display_time );
 
     /* Sout */
     if( p_input->p->counters.p_sout_send_bitrate )
@@ -207,6 +213,19 @@ void stats_ComputeInputStats( input_thread_t *p_input, input_stats_t *p_stats )
     stats_GetInteger( p_input, p_input->p->counters.p_lost_pictures,
                       &p_stats->i_lost_pictures );
 
+    /* Blocks */
+    uint64_t i_hits, i_misses;
+    block_PoolStats( &i_hits, &i_misses );
+    p_stats->i_block_pool_hits = i_hits;
+    p_stats->i_block_pool_misses = i_misses;
+
+    /* Picture pools */
+    uint64_t i_gets, i_starved, i_peak;
+    picture_PoolStats( &i_gets, &i_starved, &i_peak );
+    p_stats->i_picture_pool_gets = i_gets;
+    p_stats->i_picture_pool_starved = i_starved;
+    p_stats->i_picture_pool_peak = i_peak;
+
     vlc_mutex_unlock( &p_stats->lock );
     vlc_mutex_unlock( &p_input->p->counters.counters_lock );
 }
@@ -222,8 +241,12 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
-    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
-     = 0;
+    p_stats->i_packetize_time = p_stats->i_decode_time =
+    p_stats->i_display_time =
+    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate =
+    p_stats->i_block_pool_hits = p_stats->i_block_pool_misses =
+    p_stats->i_picture_pool_gets = p_stats->i_picture_pool_starved =
+    p_stats->i_picture_pool_peak = 0;
     vlc_mutex_unlock( &p_stats->lock );
 }
 
@@ -234,14 +257,21 @@ void stats_DumpInputStats( input_stats_t *p_stats  )
      * *1000 => bytes / millisecond => kbytes / seconds */
     fprintf( stderr, "Input : %"PRId64" (%"PRId64" bytes) - %f kB/s - "
                      "Demux : %"PRId64" (%"PRId64" bytes) - %f kB/s\n"
-                     " - Vout : %"PRId64"/%"PRId64" - Aout : %"PRId64"/%"PRId64" - Sout : %f\n",
+                     " - Vout : %"PRId64"/%"PRId64" - Aout : %"PRId64"/%"PRId64" - Sout : %f\n"
+                     " - Block pool (all inputs) : %"PRId64" hits / %"PRId64" misses\n"
+                     " - Picture pools : %"PRId64" gets / %"PRId64" starved"
+                     " - peak %"PRId64" in use\n",
                     p_stats->i_read_packets, p_stats->i_read_bytes,
                     p_stats->f_input_bitrate * 1000,
                     p_stats->i_demux_read_packets, p_stats->i_demux_read_bytes,
                     p_stats->f_demux_bitrate * 1000,
                     p_stats->i_displayed_pictures, p_stats->i_lost_pictures,
                     p_stats->i_played_abuffers, p_stats->i_lost_abuffers,
-                    p_stats->f_send_bitrate );
+                    p_stats->f_send_bitrate,
+                    p_stats->i_block_pool_hits, p_stats->i_block_pool_misses,
+                    p_stats->i_picture_pool_gets,
+                    p_stats->i_picture_pool_starved,
+                    p_stats->i_picture_pool_peak );
     vlc_mutex_unlock( &p_stats->lock );
 }
 
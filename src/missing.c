@@ -164,9 +164,15 @@ httpd_stream_t *httpd_StreamNew (httpd_host_t *host,
     assert (0);
 }
 
-int httpd_StreamSend (httpd_stream_t *stream, uint8_t *data, int count)
+int httpd_StreamSend (httpd_stream_t *stream, const block_t *block)
 {
-    (void) stream; (void) data; (void) count;
+    (void) stream; (void) block;
+    assert (0);
+}
+
+void httpd_StreamSetBufferSize (httpd_stream_t *stream, size_t size)
+{
+    (void) stream; (void) size;
     assert (0);
 }
 
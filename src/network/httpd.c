@@ -39,6 +39,9 @@
 #include <vlc_rand.h>
 #include <vlc_charset.h>
 #include <vlc_url.h>
+#include <vlc_atomic.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -52,6 +55,13 @@
 # include <poll.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
+
 #if defined( UNDER_CE )
 #   include <winsock.h>
 #elif defined( WIN32 )
@@ -68,6 +78,13 @@
 #endif
 
 static void httpd_ClientClean( httpd_client_t *cl );
+static void httpd_ClientDetach( httpd_client_t *cl );
+
+typedef struct httpd_stream_chunk_t httpd_stream_chunk_t;
+static void httpd_StreamChunkRelease( httpd_stream_chunk_t * );
+
+typedef struct httpd_worker_t httpd_worker_t;
+static void httpd_WorkerWake( httpd_client_t * );
 
 /* each host run in his own thread */
 struct httpd_host_t
@@ -82,9 +99,12 @@ struct httpd_host_t
     unsigned     nfd;
     unsigned     port;
 
-    vlc_thread_t thread;
+    /* worker threads, sharing the clients */
+    httpd_worker_t *worker;
+    unsigned     i_worker;
+    unsigned     i_next_worker; /* next worker to get a client */
+
     vlc_mutex_t lock;
-    vlc_cond_t  wait;
 
     /* all registered url (becarefull that 2 httpd_url_t could point at the same url)
      * This will slow down the url research but make my live easier
@@ -93,13 +113,39 @@ struct httpd_host_t
     int         i_url;
     httpd_url_t **url;
 
-    int            i_client;
-    httpd_client_t **client;
-
     /* TLS data */
     vlc_tls_creds_t *p_tls;
 };
 
+/* Each worker thread waits for the events of its own clients, so that the
+ * cost of a wake up does not depend on the total number of connections.
+ * The lock order is worker->lock, host->lock, stream lock, wake_lock. */
+struct httpd_worker_t
+{
+    httpd_host_t *host;
+    vlc_thread_t thread;
+    bool         b_listen;      /* accepts the new connections */
+#ifdef HAVE_SYS_EPOLL_H
+    int          epfd;
+#endif
+
+    vlc_mutex_t  lock;          /* only the worker frees its clients */
+    int            i_client;
+    httpd_client_t **client;
+    int            i_pending;   /* clients to run again (worker only) */
+    httpd_client_t **pending;
+    int            i_dead;      /* clients to remove (worker only) */
+    httpd_client_t **dead;
+
+    vlc_mutex_t  wake_lock;
+    int          wakefd[2];
+    bool           b_exit;      /* the thread shall stop */
+    int            i_incoming;  /* new clients */
+    httpd_client_t **incoming;
+    int            i_woken;     /* clients to run again */
+    httpd_client_t **woken;
+};
+
 
 struct httpd_url_t
 {
@@ -166,6 +212,18 @@ struct httpd_client_t
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
 
+    /* stream data (answer.i_body_offset is the position in the stream) */
+    httpd_stream_t       *p_stream;
+    httpd_stream_chunk_t *p_chunk; /* last chunk reached (referenced) */
+    bool                  b_waiting; /* waiting for stream data */
+
+    /* worker thread handling the client */
+    httpd_worker_t *worker;
+    bool b_readable; /* until recv() would block */
+    bool b_writable; /* until send() would block */
+    bool b_pending;
+    bool b_dead;
+
     /* TLS data */
     vlc_tls_t *p_tls;
 };
@@ -696,6 +754,22 @@ void httpd_RedirectDelete( httpd_redirect_t *rdir )
 /*****************************************************************************
  * High Level Funtions: httpd_stream_t
  *****************************************************************************/
+/* Chunk of stream data, shared by all the clients, which send it straight
+ * from there. Data can only be appended to the last chunk, so the bytes that
+ * the clients have seen never change. */
+struct httpd_stream_chunk_t
+{
+    httpd_stream_chunk_t *p_next; /* next (more recent) chunk */
+    vlc_atomic_t i_refs;
+    int64_t      i_pos;           /* absolute position of the first byte */
+    size_t       i_size;
+    size_t       i_alloc;
+    uint8_t      p_data[];
+};
+
+/* Minimum chunk allocation: small writes (e.g. TS packets) are gathered */
+#define HTTPD_STREAM_CHUNK 32768
+
 struct httpd_stream_t
 {
     vlc_mutex_t lock;
@@ -707,13 +781,37 @@ struct httpd_stream_t
     uint8_t *p_header;
     int     i_header;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* queue of the most recent chunks */
+    httpd_stream_chunk_t *p_first;  /* oldest chunk */
+    httpd_stream_chunk_t *p_last;   /* newest chunk */
+    httpd_stream_chunk_t *p_keyframe; /* a new connection will start with that */
+    size_t      i_buffer_size;      /* bytes to keep queued */
+    size_t      i_buffer;           /* bytes currently queued */
     int64_t     i_buffer_pos;       /* absolute position from begining */
-    int64_t     i_buffer_last_pos;  /* a new connection will start with that */
+
+    /* clients waiting for data */
+    int             i_waiter;
+    httpd_client_t **waiter;
 };
 
+static void httpd_StreamChunkRelease( httpd_stream_chunk_t *chunk )
+{
+    if( vlc_atomic_dec( &chunk->i_refs ) == 0 )
+        free( chunk );
+}
+
+/* Returns where new (or lagging) clients start: at the last random access
+ * point if there is one, so that they can decode at once. The stream lock
+ * must be held. */
+static int64_t httpd_StreamStart( const httpd_stream_t *stream )
+{
+    if( stream->p_keyframe != NULL )
+        return stream->p_keyframe->i_pos;
+    if( stream->p_last != NULL )
+        return stream->p_last->i_pos;
+    return stream->i_buffer_pos;
+}
+
 static int httpd_StreamCallBack( httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query )
@@ -727,56 +825,9 @@ static int httpd_StreamCallBack( httpd_callback_sys_t *p_sys,
 
     if( answer->i_body_offset > 0 )
     {
-        int64_t i_write;
-        int     i_pos;
-
-#if 0
-        fprintf( stderr, "httpd_StreamCallBack i_body_offset=%lld\n",
-                 answer->i_body_offset );
-#endif
-
-        if( answer->i_body_offset >= stream->i_buffer_pos )
-        {
-            /* fprintf( stderr, "httpd_StreamCallBack: no data\n" ); */
-            return VLC_EGENERIC;    /* wait, no data available */
-        }
-        if( answer->i_body_offset + stream->i_buffer_size <
-            stream->i_buffer_pos )
-        {
-            /* this client isn't fast enough */
-#if 0
-            fprintf( stderr, "fixing i_body_offset (old=%lld new=%lld)\n",
-                     answer->i_body_offset, stream->i_buffer_last_pos );
-#endif
-            answer->i_body_offset = stream->i_buffer_last_pos;
-        }
-
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        i_write = stream->i_buffer_pos - answer->i_body_offset;
-        if( i_write > HTTPD_CL_BUFSIZE )
-        {
-            i_write = HTTPD_CL_BUFSIZE;
-        }
-        else if( i_write <= 0 )
-        {
-            return VLC_EGENERIC;    /* wait, no data available */
-        }
-
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN( i_write, stream->i_buffer_size - i_pos );
-
-        /* using HTTPD_MSG_ANSWER -> data available */
-        answer->i_proto  = HTTPD_PROTO_HTTP;
-        answer->i_version= 0;
-        answer->i_type   = HTTPD_MSG_ANSWER;
-
-        answer->i_body = i_write;
-        answer->p_body = xmalloc( i_write );
-        memcpy( answer->p_body, &stream->p_buffer[i_pos], i_write );
-
-        answer->i_body_offset += i_write;
-
-        return VLC_SUCCESS;
+        /* Stream data is sent from the shared chunks by the host thread
+         * (see httpd_StreamClientSend()) */
+        return VLC_EGENERIC;
     }
     else
     {
@@ -797,7 +848,7 @@ static int httpd_StreamCallBack( httpd_callback_sys_t *p_sys,
                 answer->p_body = xmalloc( stream->i_header );
                 memcpy( answer->p_body, stream->p_header, stream->i_header );
             }
-            answer->i_body_offset = stream->i_buffer_last_pos;
+            answer->i_body_offset = httpd_StreamStart( stream );
             vlc_mutex_unlock( &stream->lock );
         }
         else
@@ -839,6 +890,10 @@ static int httpd_StreamCallBack( httpd_callback_sys_t *p_sys,
             httpd_MsgAdd( answer, "Content-type",  "%s", stream->psz_mime );
         }
         httpd_MsgAdd( answer, "Cache-Control", "%s", "no-cache" );
+
+        /* The client will now follow the stream data */
+        if( answer->i_body_offset > 0 )
+            cl->p_stream = stream;
         return VLC_SUCCESS;
     }
 }
@@ -868,12 +923,15 @@ httpd_stream_t *httpd_StreamNew( httpd_host_t *host,
     }
     stream->i_header = 0;
     stream->p_header = NULL;
+    stream->p_first = NULL;
+    stream->p_last = NULL;
+    stream->p_keyframe = NULL;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc( stream->i_buffer_size );
+    stream->i_buffer = 0;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
-    stream->i_buffer_last_pos = 1;
+    TAB_INIT( stream->i_waiter, stream->waiter );
 
     httpd_UrlCatch( stream->url, HTTPD_MSG_HEAD, httpd_StreamCallBack,
                     (httpd_callback_sys_t*)stream );
@@ -902,37 +960,82 @@ int httpd_StreamHeader( httpd_stream_t *stream, uint8_t *p_data, int i_data )
     return VLC_SUCCESS;
 }
 
-int httpd_StreamSend( httpd_stream_t *stream, uint8_t *p_data, int i_data )
+void httpd_StreamSetBufferSize( httpd_stream_t *stream, size_t i_size )
+{
+    vlc_mutex_lock( &stream->lock );
+    stream->i_buffer_size = i_size;
+    vlc_mutex_unlock( &stream->lock );
+}
+
+int httpd_StreamSend( httpd_stream_t *stream, const block_t *p_block )
 {
-    int i_count;
-    int i_pos;
+    httpd_stream_chunk_t *chunk;
+    size_t i_data;
+    bool b_keyframe;
 
-    if( i_data < 0 || p_data == NULL )
+    if( p_block == NULL || p_block->i_buffer == 0 )
     {
         return VLC_SUCCESS;
     }
-    vlc_mutex_lock( &stream->lock );
-
-    /* save this pointer (to be used by new connection) */
-    stream->i_buffer_last_pos = stream->i_buffer_pos;
+    i_data = p_block->i_buffer;
+    b_keyframe = ( p_block->i_flags & BLOCK_FLAG_TYPE_I ) != 0;
 
-    i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    i_count = i_data;
-    while( i_count > 0)
+    vlc_mutex_lock( &stream->lock );
+    chunk = stream->p_last;
+    if( chunk != NULL && !b_keyframe && chunk->i_alloc - chunk->i_size >= i_data )
     {
-        int i_copy;
-
-        i_copy = __MIN( i_count, stream->i_buffer_size - i_pos );
+        /* Append: the clients only send what was there when they looked */
+        memcpy( chunk->p_data + chunk->i_size, p_block->p_buffer, i_data );
+        chunk->i_size += i_data;
+    }
+    else
+    {
+        /* Random access points start a new chunk, for new clients */
+        size_t i_alloc = __MAX( i_data, HTTPD_STREAM_CHUNK );
 
-        /* Ok, we can't go past the end of our buffer */
-        memcpy( &stream->p_buffer[i_pos], p_data, i_copy );
+        chunk = malloc( sizeof( *chunk ) + i_alloc );
+        if( unlikely(chunk == NULL) )
+        {
+            vlc_mutex_unlock( &stream->lock );
+            return VLC_ENOMEM;
+        }
+        chunk->p_next = NULL;
+        vlc_atomic_set( &chunk->i_refs, 1 );
+        chunk->i_pos = stream->i_buffer_pos;
+        chunk->i_size = i_data;
+        chunk->i_alloc = i_alloc;
+        memcpy( chunk->p_data, p_block->p_buffer, i_data );
+
+        if( stream->p_last != NULL )
+            stream->p_last->p_next = chunk;
+        else
+            stream->p_first = chunk;
+        stream->p_last = chunk;
+        if( b_keyframe )
+            stream->p_keyframe = chunk;
+    }
+    stream->i_buffer += i_data;
+    stream->i_buffer_pos += i_data;
 
-        i_pos = ( i_pos + i_copy ) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+    /* Drop the oldest chunks (slow clients may still hold references) */
+    while( stream->i_buffer > stream->i_buffer_size
+        && stream->p_first != stream->p_last )
+    {
+        chunk = stream->p_first;
+        stream->p_first = chunk->p_next;
+        stream->i_buffer -= chunk->i_size;
+        if( stream->p_keyframe == chunk )
+            stream->p_keyframe = NULL;
+        httpd_StreamChunkRelease( chunk );
     }
 
-    stream->i_buffer_pos += i_data;
+    /* Wake up the clients waiting for data */
+    for( int i = 0; i < stream->i_waiter; i++ )
+    {
+        stream->waiter[i]->b_waiting = false;
+        httpd_WorkerWake( stream->waiter[i] );
+    }
+    TAB_CLEAN( stream->i_waiter, stream->waiter );
 
     vlc_mutex_unlock( &stream->lock );
     return VLC_SUCCESS;
@@ -944,14 +1047,23 @@ void httpd_StreamDelete( httpd_stream_t *stream )
     vlc_mutex_destroy( &stream->lock );
     free( stream->psz_mime );
     free( stream->p_header );
-    free( stream->p_buffer );
+    while( stream->p_first != NULL )
+    {
+        httpd_stream_chunk_t *chunk = stream->p_first;
+
+        stream->p_first = chunk->p_next;
+        httpd_StreamChunkRelease( chunk );
+    }
     free( stream );
 }
 
 /*****************************************************************************
  * Low level
  *****************************************************************************/
-static void* httpd_HostThread( void * );
+static int httpd_WorkerInit( httpd_host_t *, httpd_worker_t *, bool );
+static void httpd_WorkerClean( httpd_worker_t * );
+static void httpd_WorkerStop( httpd_worker_t * );
+static void* httpd_WorkerThread( void * );
 static httpd_host_t *httpd_HostCreate( vlc_object_t *, const char *,
                                        const char *, vlc_tls_creds_t * );
 
@@ -1084,8 +1196,9 @@ static httpd_host_t *httpd_HostCreate( vlc_object_t *p_this,
         goto error;
 
     vlc_mutex_init( &host->lock );
-    vlc_cond_init( &host->wait );
     host->i_ref = 1;
+    host->worker = NULL;
+    host->i_worker = 0;
 
     host->fds = net_ListenTCP( p_this, url.psz_host, port );
     if( host->fds == NULL )
@@ -1104,17 +1217,40 @@ static httpd_host_t *httpd_HostCreate( vlc_object_t *p_this,
     host->port     = port;
     host->i_url    = 0;
     host->url      = NULL;
-    host->i_client = 0;
-    host->client   = NULL;
     host->p_tls    = p_tls;
+    host->i_next_worker = 0;
 
-    /* create the thread */
-    if( vlc_clone( &host->thread, httpd_HostThread, host,
-                   VLC_THREAD_PRIORITY_LOW ) )
-    {
-        msg_Err( p_this, "cannot spawn http host thread" );
+    /* create the worker threads */
+    int i_worker = var_InheritInteger( p_this, "http-threads" );
+    if( i_worker <= 0 )
+        i_worker = vlc_GetCPUCount();
+
+    host->worker = malloc( i_worker * sizeof( *host->worker ) );
+    if( host->worker == NULL )
         goto error;
+    while( host->i_worker < (unsigned)i_worker )
+    {
+        if( httpd_WorkerInit( host, &host->worker[host->i_worker],
+                              host->i_worker == 0 ) )
+            goto error;
+        host->i_worker++;
+    }
+
+    for( unsigned i = 0; i < host->i_worker; i++ )
+    {
+        if( vlc_clone( &host->worker[i].thread, httpd_WorkerThread,
+                       &host->worker[i], VLC_THREAD_PRIORITY_LOW ) )
+        {
+            msg_Err( p_this, "cannot spawn http host thread" );
+            while( i > 0 )
+            {
+                httpd_WorkerStop( &host->worker[--i] );
+                vlc_join( host->worker[i].thread, NULL );
+            }
+            goto error;
+        }
     }
+    msg_Dbg( host, "using %u thread(s)", host->i_worker );
 
     /* now add it to httpd */
     TAB_APPEND( httpd.i_host, httpd.host, host );
@@ -1129,8 +1265,10 @@ error:
 
     if( host != NULL )
     {
+        for( unsigned i = 0; i < host->i_worker; i++ )
+            httpd_WorkerClean( &host->worker[i] );
+        free( host->worker );
         net_ListenClose( host->fds );
-        vlc_cond_destroy( &host->wait );
         vlc_mutex_destroy( &host->lock );
         vlc_object_release( host );
     }
@@ -1154,10 +1292,7 @@ void httpd_HostDelete( httpd_host_t *host )
     vlc_mutex_lock( &host->lock );
     host->i_ref--;
     if( host->i_ref == 0 )
-    {
-        vlc_cond_signal( &host->wait );
         delete = true;
-    }
     vlc_mutex_unlock( &host->lock );
     if( !delete )
     {
@@ -1168,8 +1303,10 @@ void httpd_HostDelete( httpd_host_t *host )
     }
     TAB_REMOVE( httpd.i_host, httpd.host, host );
 
-    vlc_object_kill( host );
-    vlc_join( host->thread, NULL );
+    for( unsigned i = 0; i < host->i_worker; i++ )
+        httpd_WorkerStop( &host->worker[i] );
+    for( unsigned i = 0; i < host->i_worker; i++ )
+        vlc_join( host->worker[i].thread, NULL );
 
     msg_Dbg( host, "HTTP host removed" );
 
@@ -1177,22 +1314,14 @@ void httpd_HostDelete( httpd_host_t *host )
     {
         msg_Err( host, "url still registered: %s", host->url[i]->psz_url );
     }
-    for( i = 0; i < host->i_client; i++ )
-    {
-        httpd_client_t *cl = host->client[i];
-        msg_Warn( host, "client still connected" );
-        httpd_ClientClean( cl );
-        TAB_REMOVE( host->i_client, host->client, cl );
-        free( cl );
-        i--;
-        /* TODO */
-    }
+    for( unsigned i = 0; i < host->i_worker; i++ )
+        httpd_WorkerClean( &host->worker[i] );
+    free( host->worker );
 
     if( host->p_tls != NULL)
         vlc_tls_ServerDelete( host->p_tls );
 
     net_ListenClose( host->fds );
-    vlc_cond_destroy( &host->wait );
     vlc_mutex_destroy( &host->lock );
     vlc_object_release( host );
     vlc_mutex_unlock( &httpd.mutex );
@@ -1238,7 +1367,6 @@ static httpd_url_t *httpd_UrlNewPrivate( httpd_host_t *host, const char *psz_url
     }
 
     TAB_APPEND( host->i_url, host->url, url );
-    vlc_cond_signal( &host->wait );
     vlc_mutex_unlock( &host->lock );
 
     return url;
@@ -1276,33 +1404,40 @@ int httpd_UrlCatch( httpd_url_t *url, int i_msg, httpd_callback_t cb,
 void httpd_UrlDelete( httpd_url_t *url )
 {
     httpd_host_t *host = url->host;
-    int          i;
+    unsigned     i;
 
     vlc_mutex_lock( &host->lock );
     TAB_REMOVE( host->i_url, host->url, url );
+    vlc_mutex_unlock( &host->lock );
 
-    vlc_mutex_destroy( &url->lock );
-    free( url->psz_url );
-    free( url->psz_user );
-    free( url->psz_password );
-    ACL_Destroy( url->p_acl );
-
-    for( i = 0; i < host->i_client; i++ )
+    /* The worker threads will free the clients */
+    for( i = 0; i < host->i_worker; i++ )
     {
-        httpd_client_t *client = host->client[i];
+        httpd_worker_t *worker = &host->worker[i];
 
-        if( client->url == url )
+        vlc_mutex_lock( &worker->lock );
+        for( int j = 0; j < worker->i_client; j++ )
         {
-            /* TODO complete it */
-            msg_Warn( host, "force closing connections" );
-            httpd_ClientClean( client );
-            TAB_REMOVE( host->i_client, host->client, client );
-            free( client );
-            i--;
+            httpd_client_t *client = worker->client[j];
+
+            if( client->url == url )
+            {
+                /* TODO complete it */
+                msg_Warn( host, "force closing connections" );
+                httpd_ClientDetach( client );
+                client->i_state = HTTPD_CLIENT_DEAD;
+                httpd_WorkerWake( client );
+            }
         }
+        vlc_mutex_unlock( &worker->lock );
     }
+
+    vlc_mutex_destroy( &url->lock );
+    free( url->psz_url );
+    free( url->psz_user );
+    free( url->psz_password );
+    ACL_Destroy( url->p_acl );
     free( url );
-    vlc_mutex_unlock( &host->lock );
 }
 
 static void httpd_MsgInit( httpd_message_t *msg )
@@ -1391,6 +1526,14 @@ static void httpd_ClientInit( httpd_client_t *cl, mtime_t now )
     cl->i_buffer = 0;
     cl->p_buffer = xmalloc( cl->i_buffer_size );
     cl->b_stream_mode = false;
+    cl->p_stream = NULL;
+    cl->p_chunk = NULL;
+    cl->b_waiting = false;
+    cl->worker = NULL;
+    cl->b_readable = false;
+    cl->b_writable = false;
+    cl->b_pending = false;
+    cl->b_dead = false;
 
     httpd_MsgInit( &cl->query );
     httpd_MsgInit( &cl->answer );
@@ -1406,8 +1549,30 @@ char* httpd_ServerIP( const httpd_client_t *cl, char *ip, int *port )
     return net_GetSockAddress( cl->fd, ip, port ) ? NULL : ip;
 }
 
+/* Detaches a client from its URL and stream */
+static void httpd_ClientDetach( httpd_client_t *cl )
+{
+    httpd_stream_t *stream = cl->p_stream;
+
+    if( stream != NULL )
+    {
+        vlc_mutex_lock( &stream->lock );
+        if( cl->b_waiting )
+            TAB_REMOVE( stream->i_waiter, stream->waiter, cl );
+        cl->b_waiting = false;
+        vlc_mutex_unlock( &stream->lock );
+        cl->p_stream = NULL;
+    }
+    if( cl->p_chunk != NULL )
+        httpd_StreamChunkRelease( cl->p_chunk );
+    cl->p_chunk = NULL;
+    cl->url = NULL;
+}
+
 static void httpd_ClientClean( httpd_client_t *cl )
 {
+    httpd_ClientDetach( cl );
+
     if( cl->fd >= 0 )
     {
         if( cl->p_tls != NULL )
@@ -1439,6 +1604,16 @@ static httpd_client_t *httpd_ClientNew( int fd, vlc_tls_t *p_tls, mtime_t now )
     return cl;
 }
 
+/* The worker threads run a client until its socket would block */
+static bool httpd_WouldBlock (void)
+{
+#if defined( WIN32 ) || defined( UNDER_CE )
+    return WSAGetLastError () == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
 static
 ssize_t httpd_NetRecv (httpd_client_t *cl, uint8_t *p, size_t i_len)
 {
@@ -1450,6 +1625,8 @@ ssize_t httpd_NetRecv (httpd_client_t *cl, uint8_t *p, size_t i_len)
         val = p_tls ? tls_Recv (p_tls, p, i_len)
                     : recv (cl->fd, p, i_len, 0);
     while (val == -1 && errno == EINTR);
+    if (val == -1 && httpd_WouldBlock ())
+        cl->b_readable = false;
     return val;
 }
 
@@ -1464,9 +1641,47 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
         val = p_tls ? tls_Send( p_tls, p, i_len )
                     : send (cl->fd, p, i_len, 0);
     while (val == -1 && errno == EINTR);
+    if (val == -1 && httpd_WouldBlock ())
+        cl->b_writable = false;
     return val;
 }
 
+/* Gather write: sends several buffers with a single system call if possible */
+static
+ssize_t httpd_NetSendv (httpd_client_t *cl, const struct iovec *iov, unsigned n)
+{
+    ssize_t val, total = 0;
+
+#if !defined( WIN32 ) && !defined( UNDER_CE )
+    if (cl->p_tls == NULL)
+    {
+        struct msghdr hdr;
+
+        memset (&hdr, 0, sizeof (hdr));
+        hdr.msg_iov = (struct iovec *)iov;
+        hdr.msg_iovlen = n;
+        do
+            val = sendmsg (cl->fd, &hdr, 0);
+        while (val == -1 && errno == EINTR);
+        if (val == -1 && httpd_WouldBlock ())
+            cl->b_writable = false;
+        return val;
+    }
+#endif
+
+    /* TLS (or no sendmsg()): one buffer at a time */
+    for (unsigned i = 0; i < n; i++)
+    {
+        val = httpd_NetSend (cl, iov[i].iov_base, iov[i].iov_len);
+        if (val < 0)
+            return (total > 0) ? total : val;
+        total += val;
+        if ((size_t)val < iov[i].iov_len)
+            break;
+    }
+    return total;
+}
+
 
 static const struct
 {
@@ -1895,6 +2110,115 @@ static void httpd_ClientRecv( httpd_client_t *cl )
 #endif
 }
 
+/* Maximum number of chunks sent at once to a stream client */
+#define HTTPD_STREAM_IOV 16
+
+/* Finds the chunk holding the next byte for a stream client, or NULL if
+ * there is no new data yet. The stream lock must be held. */
+static httpd_stream_chunk_t *httpd_StreamFind( httpd_stream_t *stream,
+                                               httpd_client_t *cl )
+{
+    httpd_stream_chunk_t *chunk = stream->p_first;
+    int64_t i_pos = cl->answer.i_body_offset;
+
+    if( chunk == NULL || i_pos >= stream->i_buffer_pos )
+        return NULL;
+
+    if( i_pos < chunk->i_pos )
+    {
+        /* this client isn't fast enough: skip to the most recent data */
+        cl->answer.i_body_offset = i_pos = httpd_StreamStart( stream );
+        chunk = stream->p_keyframe != NULL ? stream->p_keyframe
+                                           : stream->p_last;
+    }
+    else if( cl->p_chunk != NULL && cl->p_chunk->i_pos >= chunk->i_pos
+          && cl->p_chunk->i_pos <= i_pos )
+    {
+        /* the last chunk reached is still queued: resume from there */
+        chunk = cl->p_chunk;
+    }
+
+    while( chunk->i_pos + (int64_t)chunk->i_size <= i_pos )
+        chunk = chunk->p_next;
+    return chunk;
+}
+
+/* Checks if there is new data for a stream client, otherwise registers it
+ * to be woken up by httpd_StreamSend() */
+static bool httpd_StreamClientWait( httpd_client_t *cl )
+{
+    httpd_stream_t *stream = cl->p_stream;
+    bool b_ready;
+
+    vlc_mutex_lock( &stream->lock );
+    b_ready = cl->answer.i_body_offset < stream->i_buffer_pos;
+    if( !b_ready && !cl->b_waiting )
+    {
+        TAB_APPEND( stream->i_waiter, stream->waiter, cl );
+        cl->b_waiting = true;
+    }
+    vlc_mutex_unlock( &stream->lock );
+    return b_ready;
+}
+
+/* Sends the queued stream data straight from the shared chunks */
+static void httpd_StreamClientSend( httpd_client_t *cl )
+{
+    httpd_stream_t *stream = cl->p_stream;
+    httpd_stream_chunk_t *chunks[HTTPD_STREAM_IOV], *chunk;
+    struct iovec iov[HTTPD_STREAM_IOV];
+    unsigned i, n = 0;
+    size_t i_skip;
+    ssize_t i_len;
+
+    /* Take references so that the chunks can be sent without the lock */
+    vlc_mutex_lock( &stream->lock );
+    chunk = httpd_StreamFind( stream, cl );
+    i_skip = (chunk != NULL) ? cl->answer.i_body_offset - chunk->i_pos : 0;
+    for( ; chunk != NULL && n < HTTPD_STREAM_IOV; chunk = chunk->p_next )
+    {
+        vlc_atomic_inc( &chunk->i_refs );
+        chunks[n] = chunk;
+        iov[n].iov_base = chunk->p_data + i_skip;
+        iov[n].iov_len = chunk->i_size - i_skip;
+        i_skip = 0;
+        n++;
+    }
+    vlc_mutex_unlock( &stream->lock );
+
+    if( n == 0 )
+    {
+        /* nothing to send yet */
+        cl->i_state = HTTPD_CLIENT_WAITING;
+        return;
+    }
+
+    i_len = httpd_NetSendv( cl, iov, n );
+    if( i_len > 0 )
+        cl->answer.i_body_offset += i_len;
+    else
+#if defined( WIN32 ) || defined( UNDER_CE )
+    if( ( i_len < 0 && WSAGetLastError() != WSAEWOULDBLOCK ) || ( i_len == 0 ) )
+#else
+    if( ( i_len < 0 && errno != EAGAIN ) || ( i_len == 0 ) )
+#endif
+        cl->i_state = HTTPD_CLIENT_DEAD;
+
+    /* Keep a reference to the chunk reached, to resume from it */
+    if( cl->p_chunk != NULL )
+        httpd_StreamChunkRelease( cl->p_chunk );
+    for( i = 0; i < n - 1; i++ )
+    {
+        if( cl->answer.i_body_offset < chunks[i]->i_pos
+                                     + (int64_t)chunks[i]->i_size )
+            break;
+        httpd_StreamChunkRelease( chunks[i] );
+    }
+    cl->p_chunk = chunks[i];
+    while( ++i < n )
+        httpd_StreamChunkRelease( chunks[i] );
+}
+
 static void httpd_ClientSend( httpd_client_t *cl )
 {
     int i;
@@ -1940,6 +2264,13 @@ static void httpd_ClientSend( httpd_client_t *cl )
         fprintf( stderr, "%s",  cl->p_buffer );*/
     }
 
+    if( cl->i_buffer >= cl->i_buffer_size && cl->p_stream != NULL )
+    {
+        /* answer header and stream header were sent: follow the stream */
+        httpd_StreamClientSend( cl );
+        return;
+    }
+
     i_len = httpd_NetSend( cl, &cl->p_buffer[cl->i_buffer],
                            cl->i_buffer_size - cl->i_buffer );
     if( i_len >= 0 )
@@ -1948,7 +2279,8 @@ static void httpd_ClientSend( httpd_client_t *cl )
 
         if( cl->i_buffer >= cl->i_buffer_size )
         {
-            if( cl->answer.i_body == 0  && cl->answer.i_body_offset > 0 )
+            if( cl->answer.i_body == 0  && cl->answer.i_body_offset > 0
+             && cl->p_stream == NULL )
             {
                 /* catch more body data */
                 int     i_msg = cl->query.i_type;
@@ -1972,7 +2304,7 @@ static void httpd_ClientSend( httpd_client_t *cl )
                 cl->answer.i_body = 0;
                 cl->answer.p_body = NULL;
             }
-            else
+            else if( cl->p_stream == NULL )
             {
                 /* send finished */
                 cl->i_state = HTTPD_CLIENT_SEND_DONE;
@@ -2030,474 +2362,775 @@ static void httpd_ClientTlsHsOut( httpd_client_t *cl )
     }
 }
 
-static void* httpd_HostThread( void *data )
+/* Handles a complete request: looks the URL up and calls its callback.
+ * The host lock must be held. */
+static void httpd_ClientAnswer( httpd_host_t *host, httpd_client_t *cl )
 {
-    httpd_host_t *host = data;
-    counter_t *p_total_counter = stats_CounterCreate( host, VLC_VAR_INTEGER, STATS_COUNTER );
-    counter_t *p_active_counter = stats_CounterCreate( host, VLC_VAR_INTEGER, STATS_COUNTER );
-    int evfd = vlc_object_waitpipe( VLC_OBJECT( host ) );
+    httpd_message_t *answer = &cl->answer;
+    httpd_message_t *query  = &cl->query;
+    int i_msg = query->i_type;
 
-    for( ;; )
+    httpd_MsgInit( answer );
+
+    /* Handle what we received */
+    if( i_msg == HTTPD_MSG_ANSWER )
+    {
+        cl->url     = NULL;
+        cl->i_state = HTTPD_CLIENT_DEAD;
+    }
+    else if( i_msg == HTTPD_MSG_OPTIONS )
     {
-        struct pollfd ufd[host->nfd + host->i_client + 1];
-        unsigned nfd;
-        for( nfd = 0; nfd < host->nfd; nfd++ )
-        {
-            ufd[nfd].fd = host->fds[nfd];
-            ufd[nfd].events = POLLIN;
-            ufd[nfd].revents = 0;
-        }
 
-        /* add all socket that should be read/write and close dead connection */
-        vlc_mutex_lock( &host->lock );
-        while( host->i_url <= 0 && host->i_ref > 0 )
-            vlc_cond_wait( &host->wait, &host->lock );
+        answer->i_type   = HTTPD_MSG_ANSWER;
+        answer->i_proto  = query->i_proto;
+        answer->i_status = 200;
+        answer->i_body = 0;
+        answer->p_body = NULL;
 
-        mtime_t now = mdate();
-        bool b_low_delay = false;
+        httpd_MsgAdd( answer, "Server", "VLC/%s", VERSION );
+        httpd_MsgAdd( answer, "Content-Length", "0" );
 
-        for(int i_client = 0; i_client < host->i_client; i_client++ )
+        switch( query->i_proto )
         {
-            httpd_client_t *cl = host->client[i_client];
-            if( cl->i_ref < 0 || ( cl->i_ref == 0 &&
-                ( cl->i_state == HTTPD_CLIENT_DEAD ||
-                  ( cl->i_activity_timeout > 0 &&
-                    cl->i_activity_date+cl->i_activity_timeout < now) ) ) )
-            {
-                httpd_ClientClean( cl );
-                stats_UpdateInteger( host, p_active_counter, -1, NULL );
-                TAB_REMOVE( host->i_client, host->client, cl );
-                free( cl );
-                i_client--;
-                continue;
-            }
-
-            struct pollfd *pufd = ufd + nfd;
-            assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
-
-            pufd->fd = cl->fd;
-            pufd->events = pufd->revents = 0;
+            case HTTPD_PROTO_HTTP:
+                answer->i_version = 1;
+                httpd_MsgAdd( answer, "Allow",
+                              "GET,HEAD,POST,OPTIONS" );
+                break;
 
-            if( ( cl->i_state == HTTPD_CLIENT_RECEIVING )
-                  || ( cl->i_state == HTTPD_CLIENT_TLS_HS_IN ) )
-            {
-                pufd->events = POLLIN;
-            }
-            else if( ( cl->i_state == HTTPD_CLIENT_SENDING )
-                  || ( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT ) )
+            case HTTPD_PROTO_RTSP:
             {
-                pufd->events = POLLOUT;
+                const char *p;
+                answer->i_version = 0;
+
+                p = httpd_MsgGet( query, "Cseq" );
+                if( p != NULL )
+                    httpd_MsgAdd( answer, "Cseq", "%s", p );
+                p = httpd_MsgGet( query, "Timestamp" );
+                if( p != NULL )
+                    httpd_MsgAdd( answer, "Timestamp", "%s", p );
+
+                p = httpd_MsgGet( query, "Require" );
+                if( p != NULL )
+                {
+                    answer->i_status = 551;
+                    httpd_MsgAdd( query, "Unsupported", "%s", p );
+                }
+
+                httpd_MsgAdd( answer, "Public", "DESCRIBE,SETUP,"
+                              "TEARDOWN,PLAY,PAUSE,GET_PARAMETER" );
+                break;
             }
-            else if( cl->i_state == HTTPD_CLIENT_RECEIVE_DONE )
-            {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
-                int i_msg = query->i_type;
+        }
+
+        cl->i_buffer = -1;  /* Force the creation of the answer in
+                             * httpd_ClientSend */
+        cl->i_state = HTTPD_CLIENT_SENDING;
+    }
+    else if( i_msg == HTTPD_MSG_NONE )
+    {
+        if( query->i_proto == HTTPD_PROTO_NONE )
+        {
+            cl->url = NULL;
+            cl->i_state = HTTPD_CLIENT_DEAD;
+        }
+        else
+        {
+            char *p;
 
-                httpd_MsgInit( answer );
+            /* unimplemented */
+            answer->i_proto  = query->i_proto ;
+            answer->i_type   = HTTPD_MSG_ANSWER;
+            answer->i_version= 0;
+            answer->i_status = 501;
 
-                /* Handle what we received */
-                if( i_msg == HTTPD_MSG_ANSWER )
-                {
-                    cl->url     = NULL;
-                    cl->i_state = HTTPD_CLIENT_DEAD;
-                }
-                else if( i_msg == HTTPD_MSG_OPTIONS )
-                {
+            answer->i_body = httpd_HtmlError (&p, 501, NULL);
+            answer->p_body = (uint8_t *)p;
+            httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
 
-                    answer->i_type   = HTTPD_MSG_ANSWER;
-                    answer->i_proto  = query->i_proto;
-                    answer->i_status = 200;
-                    answer->i_body = 0;
-                    answer->p_body = NULL;
+            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+            cl->i_state = HTTPD_CLIENT_SENDING;
+        }
+    }
+    else
+    {
+        bool b_auth_failed = false;
+        bool b_hosts_failed = false;
 
-                    httpd_MsgAdd( answer, "Server", "VLC/%s", VERSION );
-                    httpd_MsgAdd( answer, "Content-Length", "0" );
+        /* Search the url and trigger callbacks */
+        for(int i = 0; i < host->i_url; i++ )
+        {
+            httpd_url_t *url = host->url[i];
 
-                    switch( query->i_proto )
+            if( !strcmp( url->psz_url, query->psz_url ) )
+            {
+                if( url->catch[i_msg].cb )
+                {
+                    if( answer && ( url->p_acl != NULL ) )
                     {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd( answer, "Allow",
-                                          "GET,HEAD,POST,OPTIONS" );
-                            break;
+                        char ip[NI_MAXNUMERICHOST];
 
-                        case HTTPD_PROTO_RTSP:
+                        if( ( httpd_ClientIP( cl, ip, NULL ) == NULL )
+                         || ACL_Check( url->p_acl, ip ) )
                         {
-                            const char *p;
-                            answer->i_version = 0;
-
-                            p = httpd_MsgGet( query, "Cseq" );
-                            if( p != NULL )
-                                httpd_MsgAdd( answer, "Cseq", "%s", p );
-                            p = httpd_MsgGet( query, "Timestamp" );
-                            if( p != NULL )
-                                httpd_MsgAdd( answer, "Timestamp", "%s", p );
-
-                            p = httpd_MsgGet( query, "Require" );
-                            if( p != NULL )
-                            {
-                                answer->i_status = 551;
-                                httpd_MsgAdd( query, "Unsupported", "%s", p );
-                            }
-
-                            httpd_MsgAdd( answer, "Public", "DESCRIBE,SETUP,"
-                                          "TEARDOWN,PLAY,PAUSE,GET_PARAMETER" );
+                            b_hosts_failed = true;
                             break;
                         }
                     }
 
-                    cl->i_buffer = -1;  /* Force the creation of the answer in
-                                         * httpd_ClientSend */
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
-                else if( i_msg == HTTPD_MSG_NONE )
-                {
-                    if( query->i_proto == HTTPD_PROTO_NONE )
-                    {
-                        cl->url = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    }
-                    else
+                    if( answer && ( *url->psz_user || *url->psz_password ) )
                     {
-                        char *p;
+                        /* create the headers */
+                        const char *b64 = httpd_MsgGet( query, "Authorization" ); /* BASIC id */
+                        char *user = NULL, *pass = NULL;
 
-                        /* unimplemented */
-                        answer->i_proto  = query->i_proto ;
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_version= 0;
-                        answer->i_status = 501;
+                        if( b64 != NULL
+                         && !strncasecmp( b64, "BASIC", 5 ) )
+                        {
+                            b64 += 5;
+                            while( *b64 == ' ' )
+                                b64++;
+
+                            user = vlc_b64_decode( b64 );
+                            if (user != NULL)
+                            {
+                                pass = strchr (user, ':');
+                                if (pass != NULL)
+                                    *pass++ = '\0';
+                            }
+                        }
 
-                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                        answer->p_body = (uint8_t *)p;
-                        httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
+                        if ((user == NULL) || (pass == NULL)
+                         || strcmp (user, url->psz_user)
+                         || strcmp (pass, url->psz_password))
+                        {
+                            httpd_MsgAdd( answer,
+                                          "WWW-Authenticate",
+                                          "Basic realm=\"VLC stream\"" );
+                            /* We fail for all url */
+                            b_auth_failed = true;
+                            free( user );
+                            break;
+                        }
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
+                        free( user );
                     }
-                }
-                else
-                {
-                    bool b_auth_failed = false;
-                    bool b_hosts_failed = false;
 
-                    /* Search the url and trigger callbacks */
-                    for(int i = 0; i < host->i_url; i++ )
+                    if( !url->catch[i_msg].cb( url->catch[i_msg].p_sys, cl, answer, query ) )
                     {
-                        httpd_url_t *url = host->url[i];
+                        if( answer->i_proto == HTTPD_PROTO_NONE )
+                        {
+                            /* Raw answer from a CGI */
+                            cl->i_buffer = cl->i_buffer_size;
+                        }
+                        else
+                            cl->i_buffer = -1;
 
-                        if( !strcmp( url->psz_url, query->psz_url ) )
+                        /* only one url can answer */
+                        answer = NULL;
+                        if( cl->url == NULL )
                         {
-                            if( url->catch[i_msg].cb )
-                            {
-                                if( answer && ( url->p_acl != NULL ) )
-                                {
-                                    char ip[NI_MAXNUMERICHOST];
-
-                                    if( ( httpd_ClientIP( cl, ip, NULL ) == NULL )
-                                     || ACL_Check( url->p_acl, ip ) )
-                                    {
-                                        b_hosts_failed = true;
-                                        break;
-                                    }
-                                }
-
-                                if( answer && ( *url->psz_user || *url->psz_password ) )
-                                {
-                                    /* create the headers */
-                                    const char *b64 = httpd_MsgGet( query, "Authorization" ); /* BASIC id */
-                                    char *user = NULL, *pass = NULL;
-
-                                    if( b64 != NULL
-                                     && !strncasecmp( b64, "BASIC", 5 ) )
-                                    {
-                                        b64 += 5;
-                                        while( *b64 == ' ' )
-                                            b64++;
-
-                                        user = vlc_b64_decode( b64 );
-                                        if (user != NULL)
-                                        {
-                                            pass = strchr (user, ':');
-                                            if (pass != NULL)
-                                                *pass++ = '\0';
-                                        }
-                                    }
-
-                                    if ((user == NULL) || (pass == NULL)
-                                     || strcmp (user, url->psz_user)
-                                     || strcmp (pass, url->psz_password))
-                                    {
-                                        httpd_MsgAdd( answer,
-                                                      "WWW-Authenticate",
-                                                      "Basic realm=\"VLC stream\"" );
-                                        /* We fail for all url */
-                                        b_auth_failed = true;
-                                        free( user );
-                                        break;
-                                    }
-
-                                    free( user );
-                                }
-
-                                if( !url->catch[i_msg].cb( url->catch[i_msg].p_sys, cl, answer, query ) )
-                                {
-                                    if( answer->i_proto == HTTPD_PROTO_NONE )
-                                    {
-                                        /* Raw answer from a CGI */
-                                        cl->i_buffer = cl->i_buffer_size;
-                                    }
-                                    else
-                                        cl->i_buffer = -1;
-
-                                    /* only one url can answer */
-                                    answer = NULL;
-                                    if( cl->url == NULL )
-                                    {
-                                        cl->url = url;
-                                    }
-                                }
-                            }
+                            cl->url = url;
                         }
                     }
+                }
+            }
+        }
 
-                    if( answer )
-                    {
-                        char *p;
+        if( answer )
+        {
+            char *p;
 
-                        answer->i_proto  = query->i_proto;
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_version= 0;
+            answer->i_proto  = query->i_proto;
+            answer->i_type   = HTTPD_MSG_ANSWER;
+            answer->i_version= 0;
 
-                        if( b_hosts_failed )
-                        {
-                            answer->i_status = 403;
-                        }
-                        else if( b_auth_failed )
-                        {
-                            answer->i_status = 401;
-                        }
-                        else
-                        {
-                            /* no url registered */
-                            answer->i_status = 404;
-                        }
+            if( b_hosts_failed )
+            {
+                answer->i_status = 403;
+            }
+            else if( b_auth_failed )
+            {
+                answer->i_status = 401;
+            }
+            else
+            {
+                /* no url registered */
+                answer->i_status = 404;
+            }
 
-                        answer->i_body = httpd_HtmlError (&p,
-                                                          answer->i_status,
-                                                          query->psz_url);
-                        answer->p_body = (uint8_t *)p;
+            answer->i_body = httpd_HtmlError (&p,
+                                              answer->i_status,
+                                              query->psz_url);
+            answer->p_body = (uint8_t *)p;
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                        httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
-                        httpd_MsgAdd( answer, "Content-Type", "%s", "text/html" );
-                    }
+            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+            httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
+            httpd_MsgAdd( answer, "Content-Type", "%s", "text/html" );
+        }
 
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
-            }
-            else if( cl->i_state == HTTPD_CLIENT_SEND_DONE )
-            {
-                if( !cl->b_stream_mode || cl->answer.i_body_offset == 0 )
-                {
-                    const char *psz_connection = httpd_MsgGet( &cl->answer, "Connection" );
-                    const char *psz_query = httpd_MsgGet( &cl->query, "Connection" );
-                    bool b_connection = false;
-                    bool b_keepalive = false;
-                    bool b_query = false;
-
-                    cl->url = NULL;
-                    if( psz_connection )
-                    {
-                        b_connection = ( strcasecmp( psz_connection, "Close" ) == 0 );
-                        b_keepalive = ( strcasecmp( psz_connection, "Keep-Alive" ) == 0 );
-                    }
+        cl->i_state = HTTPD_CLIENT_SENDING;
+    }
+}
 
-                    if( psz_query )
-                    {
-                        b_query = ( strcasecmp( psz_query, "Close" ) == 0 );
-                    }
+/* Handles the end of an answer (keeps the connection alive or closes it) */
+static void httpd_ClientDone( httpd_client_t *cl )
+{
+    if( !cl->b_stream_mode || cl->answer.i_body_offset == 0 )
+    {
+        const char *psz_connection = httpd_MsgGet( &cl->answer, "Connection" );
+        const char *psz_query = httpd_MsgGet( &cl->query, "Connection" );
+        bool b_connection = false;
+        bool b_keepalive = false;
+        bool b_query = false;
+
+        cl->url = NULL;
+        if( psz_connection )
+        {
+            b_connection = ( strcasecmp( psz_connection, "Close" ) == 0 );
+            b_keepalive = ( strcasecmp( psz_connection, "Keep-Alive" ) == 0 );
+        }
 
-                    if( ( ( cl->query.i_proto == HTTPD_PROTO_HTTP ) &&
-                          ( ( cl->query.i_version == 0 && b_keepalive ) ||
-                            ( cl->query.i_version == 1 && !b_connection ) ) ) ||
-                        ( ( cl->query.i_proto == HTTPD_PROTO_RTSP ) &&
-                          !b_query && !b_connection ) )
-                    {
-                        httpd_MsgClean( &cl->query );
-                        httpd_MsgInit( &cl->query );
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free( cl->p_buffer );
-                        cl->p_buffer = xmalloc( cl->i_buffer_size );
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    }
-                    else
-                    {
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    }
-                    httpd_MsgClean( &cl->answer );
-                }
+        if( psz_query )
+        {
+            b_query = ( strcasecmp( psz_query, "Close" ) == 0 );
+        }
+
+        if( ( ( cl->query.i_proto == HTTPD_PROTO_HTTP ) &&
+              ( ( cl->query.i_version == 0 && b_keepalive ) ||
+                ( cl->query.i_version == 1 && !b_connection ) ) ) ||
+            ( ( cl->query.i_proto == HTTPD_PROTO_RTSP ) &&
+              !b_query && !b_connection ) )
+        {
+            httpd_MsgClean( &cl->query );
+            httpd_MsgInit( &cl->query );
+
+            cl->i_buffer = 0;
+            cl->i_buffer_size = 1000;
+            free( cl->p_buffer );
+            cl->p_buffer = xmalloc( cl->i_buffer_size );
+            cl->i_state = HTTPD_CLIENT_RECEIVING;
+        }
+        else
+        {
+            cl->i_state = HTTPD_CLIENT_DEAD;
+        }
+        httpd_MsgClean( &cl->answer );
+    }
+    else
+    {
+        int64_t i_offset = cl->answer.i_body_offset;
+        httpd_MsgClean( &cl->answer );
+
+        cl->answer.i_body_offset = i_offset;
+        free( cl->p_buffer );
+        cl->p_buffer = NULL;
+        cl->i_buffer = 0;
+        cl->i_buffer_size = 0;
+
+        cl->i_state = HTTPD_CLIENT_WAITING;
+    }
+}
+
+/* Asks the callback for more body data. The host lock must be held. */
+static void httpd_ClientPoll( httpd_client_t *cl )
+{
+    int64_t i_offset = cl->answer.i_body_offset;
+    int     i_msg = cl->query.i_type;
+
+    httpd_MsgInit( &cl->answer );
+    cl->answer.i_body_offset = i_offset;
+
+    cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
+                              &cl->answer, &cl->query );
+    if( cl->answer.i_type != HTTPD_MSG_NONE )
+    {
+        /* we have new data, so re-enter send mode */
+        cl->i_buffer      = 0;
+        cl->p_buffer      = cl->answer.p_body;
+        cl->i_buffer_size = cl->answer.i_body;
+        cl->answer.p_body = NULL;
+        cl->answer.i_body = 0;
+        cl->i_state = HTTPD_CLIENT_SENDING;
+    }
+}
+
+/*****************************************************************************
+ * Worker threads
+ *****************************************************************************/
+#define HTTPD_WORKER_EVENTS 64 /* events handled per wake up */
+#define HTTPD_CLIENT_STEPS  16 /* steps run per client before yielding */
+
+typedef struct
+{
+    void *p_data; /* worker (wake up), listening socket or client */
+    bool  b_in;
+    bool  b_out;
+} httpd_event_t;
+
+static void httpd_WorkerSignal( httpd_worker_t *worker )
+{
+    int canc = vlc_savecancel();
+    ssize_t val;
+
+    do
+        val = write( worker->wakefd[1], &(uint64_t){ 1 }, sizeof (uint64_t) );
+    while( val == -1 && errno == EINTR );
+    /* EAGAIN: the descriptor is full, so the worker will wake up anyway */
+    if( val == -1 && errno != EAGAIN )
+        msg_Err( worker->host, "cannot wake worker up: %m" );
+    vlc_restorecancel( canc );
+}
+
+/* Asks a worker thread to exit */
+static void httpd_WorkerStop( httpd_worker_t *worker )
+{
+    vlc_mutex_lock( &worker->wake_lock );
+    worker->b_exit = true;
+    httpd_WorkerSignal( worker );
+    vlc_mutex_unlock( &worker->wake_lock );
+}
+
+/* Hands a new client over to a worker */
+static void httpd_WorkerAdd( httpd_worker_t *worker, httpd_client_t *cl )
+{
+    cl->worker = worker;
+
+    vlc_mutex_lock( &worker->wake_lock );
+    TAB_APPEND( worker->i_incoming, worker->incoming, cl );
+    if( worker->i_incoming + worker->i_woken == 1 )
+        httpd_WorkerSignal( worker );
+    vlc_mutex_unlock( &worker->wake_lock );
+}
+
+/* Gets a client to run again from its worker (e.g. new stream data) */
+static void httpd_WorkerWake( httpd_client_t *cl )
+{
+    httpd_worker_t *worker = cl->worker;
+
+    vlc_mutex_lock( &worker->wake_lock );
+    TAB_APPEND( worker->i_woken, worker->woken, cl );
+    if( worker->i_incoming + worker->i_woken == 1 )
+        httpd_WorkerSignal( worker );
+    vlc_mutex_unlock( &worker->wake_lock );
+}
+
+static void httpd_WorkerDefer( httpd_worker_t *worker, httpd_client_t *cl )
+{
+    if( !cl->b_pending )
+    {
+        TAB_APPEND( worker->i_pending, worker->pending, cl );
+        cl->b_pending = true;
+    }
+}
+
+/* Runs the state machine of a client until it would block.
+ * The worker lock must be held. */
+static void httpd_ClientRun( httpd_worker_t *worker, httpd_client_t *cl,
+                             mtime_t now )
+{
+    httpd_host_t *host = worker->host;
+
+    for( unsigned i = 0; i < HTTPD_CLIENT_STEPS; i++ )
+    {
+        switch( cl->i_state )
+        {
+            case HTTPD_CLIENT_RECEIVING:
+                if( !cl->b_readable )
+                    return;
+                cl->i_activity_date = now;
+                httpd_ClientRecv( cl );
+                break;
+
+            case HTTPD_CLIENT_RECEIVE_DONE:
+                vlc_mutex_lock( &host->lock );
+                httpd_ClientAnswer( host, cl );
+                vlc_mutex_unlock( &host->lock );
+                break;
+
+            case HTTPD_CLIENT_SENDING:
+                if( !cl->b_writable )
+                    return;
+                cl->i_activity_date = now;
+                if( cl->p_stream != NULL )
+                    httpd_ClientSend( cl ); /* no callback involved */
                 else
                 {
-                    int64_t i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean( &cl->answer );
+                    vlc_mutex_lock( &host->lock );
+                    httpd_ClientSend( cl );
+                    vlc_mutex_unlock( &host->lock );
+                }
+                break;
 
-                    cl->answer.i_body_offset = i_offset;
-                    free( cl->p_buffer );
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+            case HTTPD_CLIENT_SEND_DONE:
+                httpd_ClientDone( cl );
+                break;
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
+            case HTTPD_CLIENT_WAITING:
+                if( cl->p_stream != NULL )
+                {
+                    /* httpd_StreamSend() wakes the client up */
+                    if( !httpd_StreamClientWait( cl ) )
+                        return;
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
                 }
-            }
-            else if( cl->i_state == HTTPD_CLIENT_WAITING )
-            {
-                int64_t i_offset = cl->answer.i_body_offset;
-                int     i_msg = cl->query.i_type;
 
-                httpd_MsgInit( &cl->answer );
-                cl->answer.i_body_offset = i_offset;
+                vlc_mutex_lock( &host->lock );
+                httpd_ClientPoll( cl );
+                vlc_mutex_unlock( &host->lock );
+                if( cl->i_state == HTTPD_CLIENT_WAITING )
+                {
+                    /* ask again a bit later */
+                    httpd_WorkerDefer( worker, cl );
+                    return;
+                }
+                break;
 
-                cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
-                                          &cl->answer, &cl->query );
-                if( cl->answer.i_type != HTTPD_MSG_NONE )
+            case HTTPD_CLIENT_TLS_HS_IN:
+                if( !cl->b_readable )
+                    return;
+                httpd_ClientTlsHsIn( cl );
+                if( cl->i_state == HTTPD_CLIENT_TLS_HS_IN )
+                    cl->b_readable = false;
+                break;
+
+            case HTTPD_CLIENT_TLS_HS_OUT:
+                if( !cl->b_writable )
+                    return;
+                httpd_ClientTlsHsOut( cl );
+                if( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT )
+                    cl->b_writable = false;
+                break;
+
+            case HTTPD_CLIENT_DEAD:
+                if( !cl->b_dead )
                 {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    TAB_APPEND( worker->i_dead, worker->dead, cl );
+                    cl->b_dead = true;
                 }
-            }
+                return;
+        }
+    }
 
-            if (pufd->events != 0)
-                nfd++;
-            else
-                b_low_delay = true;
+    /* not done yet: let the other clients run first */
+    httpd_WorkerDefer( worker, cl );
+}
+
+/* Removes a client. The worker lock must be held. */
+static void httpd_WorkerRemove( httpd_worker_t *worker, httpd_client_t *cl )
+{
+#ifdef HAVE_SYS_EPOLL_H
+    epoll_ctl( worker->epfd, EPOLL_CTL_DEL, cl->fd, NULL );
+#endif
+    vlc_mutex_lock( &worker->wake_lock );
+    TAB_REMOVE( worker->i_woken, worker->woken, cl );
+    vlc_mutex_unlock( &worker->wake_lock );
+    if( cl->b_pending )
+        TAB_REMOVE( worker->i_pending, worker->pending, cl );
+
+    httpd_ClientClean( cl );
+    TAB_REMOVE( worker->i_client, worker->client, cl );
+    free( cl );
+}
+
+/* Handles the new and the woken up clients, returns true to exit */
+static bool httpd_WorkerWakeUp( httpd_worker_t *worker, mtime_t now,
+                                counter_t *p_active_counter )
+{
+    httpd_client_t **incoming, **woken;
+    int i_incoming, i_woken;
+    uint64_t dummy[16];
+    ssize_t val;
+    bool b_exit;
+
+    do
+        val = read( worker->wakefd[0], dummy, sizeof (dummy) );
+    while( val == -1 && errno == EINTR );
+    /* EAGAIN: already cleared, the lists are checked anyway */
+    if( val == -1 && errno != EAGAIN )
+        msg_Err( worker->host, "cannot clear worker wake up: %m" );
+
+    vlc_mutex_lock( &worker->wake_lock );
+    b_exit = worker->b_exit;
+    i_incoming = worker->i_incoming;
+    incoming = worker->incoming;
+    i_woken = worker->i_woken;
+    woken = worker->woken;
+    TAB_INIT( worker->i_incoming, worker->incoming );
+    TAB_INIT( worker->i_woken, worker->woken );
+    vlc_mutex_unlock( &worker->wake_lock );
+
+    for( int i = 0; i < i_incoming; i++ )
+    {
+        httpd_client_t *cl = incoming[i];
+#ifdef HAVE_SYS_EPOLL_H
+        /* Edge-triggered: the client runs until its socket would block */
+        struct epoll_event ev = {
+            .events = EPOLLIN | EPOLLOUT | EPOLLET,
+            .data = { .ptr = cl },
+        };
+
+        if( epoll_ctl( worker->epfd, EPOLL_CTL_ADD, cl->fd, &ev ) )
+        {
+            msg_Err( worker->host, "cannot poll client socket: %m" );
+            cl->i_state = HTTPD_CLIENT_DEAD;
         }
-        vlc_mutex_unlock( &host->lock );
+#endif
+        TAB_APPEND( worker->i_client, worker->client, cl );
+        stats_UpdateInteger( worker->host, p_active_counter, 1, NULL );
+        httpd_ClientRun( worker, cl, now );
+    }
+    free( incoming );
 
-        ufd[nfd].fd = evfd;
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
-        nfd++;
+    for( int i = 0; i < i_woken; i++ )
+        httpd_ClientRun( worker, woken[i], now );
+    free( woken );
+    return b_exit;
+}
 
-        /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
-        switch( poll( ufd, nfd, b_low_delay ? 20 : -1) )
+#ifdef HAVE_SYS_EPOLL_H
+static int httpd_WorkerWait( httpd_worker_t *worker, httpd_event_t *ev,
+                             int i_max, int i_timeout )
+{
+    struct epoll_event evs[i_max];
+    int val = epoll_wait( worker->epfd, evs, i_max, i_timeout );
+
+    for( int i = 0; i < val; i++ )
+    {
+        ev[i].p_data = evs[i].data.ptr;
+        ev[i].b_in = evs[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP);
+        ev[i].b_out = evs[i].events & (EPOLLOUT|EPOLLERR|EPOLLHUP);
+    }
+    return val;
+}
+#else
+static int httpd_WorkerWait( httpd_worker_t *worker, httpd_event_t *ev,
+                             int i_max, int i_timeout )
+{
+    httpd_host_t *host = worker->host;
+    unsigned nfd = 0;
+    int val;
+
+    vlc_mutex_lock( &worker->lock );
+    struct pollfd ufd[1 + host->nfd + worker->i_client];
+    void *data[sizeof (ufd) / sizeof (ufd[0])];
+
+    ufd[nfd].fd = worker->wakefd[0];
+    ufd[nfd].events = POLLIN;
+    data[nfd++] = worker;
+    if( worker->b_listen )
+        for( unsigned i = 0; i < host->nfd; i++ )
         {
-            case -1:
-                if (errno != EINTR)
-                {
-                    /* Kernel on low memory or a bug: pace */
-                    msg_Err( host, "polling error: %m" );
-                    msleep( 100000 );
-                }
-            case 0:
-                continue;
+            ufd[nfd].fd = host->fds[i];
+            ufd[nfd].events = POLLIN;
+            data[nfd++] = &host->fds[i];
         }
 
-        if( ufd[nfd - 1].revents )
-            break;
+    /* only wait for what the clients are blocked on */
+    for( int i = 0; i < worker->i_client; i++ )
+    {
+        httpd_client_t *cl = worker->client[i];
+        short events = 0;
 
-        /* Handle client sockets */
-        vlc_mutex_lock( &host->lock );
-        now = mdate();
-        nfd = host->nfd;
-        for( int i_client = 0; i_client < host->i_client; i_client++ )
+        if( ( cl->i_state == HTTPD_CLIENT_RECEIVING
+           || cl->i_state == HTTPD_CLIENT_TLS_HS_IN ) && !cl->b_readable )
+            events = POLLIN;
+        else
+        if( ( cl->i_state == HTTPD_CLIENT_SENDING
+           || cl->i_state == HTTPD_CLIENT_TLS_HS_OUT ) && !cl->b_writable )
+            events = POLLOUT;
+
+        if( events != 0 )
         {
-            httpd_client_t *cl = host->client[i_client];
-            const struct pollfd *pufd = &ufd[nfd];
+            ufd[nfd].fd = cl->fd;
+            ufd[nfd].events = events;
+            data[nfd++] = cl;
+        }
+    }
+    vlc_mutex_unlock( &worker->lock );
 
-            assert( pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])] );
+    val = poll( ufd, nfd, i_timeout );
+    if( val <= 0 )
+        return val;
 
-            if( cl->fd != pufd->fd )
-                continue; // we were not waiting for this client
-            ++nfd;
-            if( pufd->revents == 0 )
-                continue; // no event received
+    /* the events left over are reported again next time */
+    val = 0;
+    for( unsigned i = 0; i < nfd && val < i_max; i++ )
+    {
+        if( ufd[i].revents == 0 )
+            continue;
+        ev[val].p_data = data[i];
+        ev[val].b_in = ufd[i].revents & (POLLIN|POLLERR|POLLHUP);
+        ev[val].b_out = ufd[i].revents & (POLLOUT|POLLERR|POLLHUP);
+        val++;
+    }
+    return val;
+}
+#endif
 
-            cl->i_activity_date = now;
+/* Accepts a new connection and hands it over to a worker */
+static void httpd_HostAccept( httpd_host_t *host, int fd, mtime_t now,
+                              counter_t *p_total_counter )
+{
+    httpd_client_t *cl;
+    int i_state = -1;
 
-            if( cl->i_state == HTTPD_CLIENT_RECEIVING )
-            {
-                httpd_ClientRecv( cl );
-            }
-            else if( cl->i_state == HTTPD_CLIENT_SENDING )
-            {
-                httpd_ClientSend( cl );
-            }
-            else if( cl->i_state == HTTPD_CLIENT_TLS_HS_IN )
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+                &(int){ 1 }, sizeof(int));
+
+    vlc_tls_t *p_tls;
+
+    if( host->p_tls != NULL )
+    {
+        p_tls = vlc_tls_ServerSessionCreate( host->p_tls, fd );
+        switch( vlc_tls_ServerSessionHandshake( p_tls ) )
+        {
+            case -1:
+                msg_Err( host, "Rejecting TLS connection" );
+                /* p_tls is destroyed implicitly */
+                net_Close( fd );
+                return;
+
+            case 1: /* missing input - most likely */
+                i_state = HTTPD_CLIENT_TLS_HS_IN;
+                break;
+
+            case 2: /* missing output */
+                i_state = HTTPD_CLIENT_TLS_HS_OUT;
+                break;
+        }
+    }
+    else
+        p_tls = NULL;
+
+    cl = httpd_ClientNew( fd, p_tls, now );
+    if( unlikely(cl == NULL) )
+    {
+        if( p_tls != NULL )
+            vlc_tls_ServerSessionDelete( p_tls );
+        net_Close( fd );
+        return;
+    }
+    if( i_state != -1 )
+        cl->i_state = i_state; // override state for TLS
+
+    stats_UpdateInteger( host, p_total_counter, 1, NULL );
+    httpd_WorkerAdd( &host->worker[host->i_next_worker++ % host->i_worker],
+                     cl );
+}
+
+static void* httpd_WorkerThread( void *data )
+{
+    httpd_worker_t *worker = data;
+    httpd_host_t *host = worker->host;
+    counter_t *p_total_counter = stats_CounterCreate( host, VLC_VAR_INTEGER, STATS_COUNTER );
+    counter_t *p_active_counter = stats_CounterCreate( host, VLC_VAR_INTEGER, STATS_COUNTER );
+    httpd_event_t ev[HTTPD_WORKER_EVENTS];
+    mtime_t i_sweep = mdate() + CLOCK_FREQ;
+    bool b_die = false;
+
+    while( !b_die )
+    {
+        int i_timeout = -1;
+
+        /* Only the worker thread changes its pending and client lists */
+        for( int i = 0; i < worker->i_pending; i++ )
+        {
+            if( worker->pending[i]->i_state != HTTPD_CLIENT_WAITING )
             {
-                httpd_ClientTlsHsIn( cl );
+                i_timeout = 0;
+                break;
             }
-            else if( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT )
+            /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
+            i_timeout = 20;
+        }
+        if( worker->i_client > 0 )
+        {
+            /* check the clients activity once per second */
+            mtime_t i_delay = (i_sweep - mdate()) / 1000 + 1;
+
+            if( i_delay < 0 )
+                i_delay = 0;
+            if( i_timeout < 0 || i_delay < i_timeout )
+                i_timeout = i_delay;
+        }
+
+        int val = httpd_WorkerWait( worker, ev, HTTPD_WORKER_EVENTS,
+                                    i_timeout );
+        if( val == -1 )
+        {
+            if (errno != EINTR)
             {
-                httpd_ClientTlsHsOut( cl );
+                /* Kernel on low memory or a bug: pace */
+                msg_Err( host, "polling error: %m" );
+                msleep( 100000 );
             }
+            continue;
         }
-        vlc_mutex_unlock( &host->lock );
 
-        /* Handle server sockets (accept new connections) */
-        for( nfd = 0; nfd < host->nfd; nfd++ )
-        {
-            httpd_client_t *cl;
-            int i_state = -1;
-            int fd = ufd[nfd].fd;
+        vlc_mutex_lock( &worker->lock );
+        mtime_t now = mdate();
 
-            assert (fd == host->fds[nfd]);
+        httpd_client_t **pending = worker->pending;
+        int i_pending = worker->i_pending;
 
-            if( ufd[nfd].revents == 0 )
-                continue;
+        TAB_INIT( worker->i_pending, worker->pending );
+        for( int i = 0; i < i_pending; i++ )
+            pending[i]->b_pending = false;
 
-            /* */
-            fd = vlc_accept (fd, NULL, NULL, true);
-            if (fd == -1)
-                continue;
-            setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                        &(int){ 1 }, sizeof(int));
+        for( int i = 0; i < val; i++ )
+        {
+            void *p = ev[i].p_data;
 
-            vlc_tls_t *p_tls;
+            if( p == worker )
+                b_die = httpd_WorkerWakeUp( worker, now, p_active_counter );
+            else if( (int *)p >= host->fds && (int *)p < host->fds + host->nfd )
+                httpd_HostAccept( host, *(int *)p, now, p_total_counter );
+            else
+            {
+                httpd_client_t *cl = p;
 
-            if( host->p_tls != NULL )
+                if( ev[i].b_in )
+                    cl->b_readable = true;
+                if( ev[i].b_out )
+                    cl->b_writable = true;
+                httpd_ClientRun( worker, cl, now );
+            }
+        }
+
+        for( int i = 0; i < i_pending; i++ )
+            httpd_ClientRun( worker, pending[i], now );
+        free( pending );
+
+        if( now >= i_sweep )
+        {
+            /* close the inactive connections */
+            for( int i = 0; i < worker->i_client; i++ )
             {
-                p_tls = vlc_tls_ServerSessionCreate( host->p_tls, fd );
-                switch( vlc_tls_ServerSessionHandshake( p_tls ) )
+                httpd_client_t *cl = worker->client[i];
+
+                if( cl->i_ref < 0 || ( cl->i_ref == 0 &&
+                    cl->i_activity_timeout > 0 &&
+                    cl->i_activity_date+cl->i_activity_timeout < now ) )
                 {
-                    case -1:
-                        msg_Err( host, "Rejecting TLS connection" );
-                        /* p_tls is destroyed implicitly */
-                        net_Close( fd );
-                        fd = -1;
-                        p_tls = NULL;
-                        continue;
-
-                    case 1: /* missing input - most likely */
-                        i_state = HTTPD_CLIENT_TLS_HS_IN;
-                        break;
-
-                    case 2: /* missing output */
-                        i_state = HTTPD_CLIENT_TLS_HS_OUT;
-                        break;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    httpd_ClientRun( worker, cl, now );
                 }
             }
-            else
-                p_tls = NULL;
-
-            stats_UpdateInteger( host, p_total_counter, 1, NULL );
-            stats_UpdateInteger( host, p_active_counter, 1, NULL );
-            cl = httpd_ClientNew( fd, p_tls, now );
-            vlc_mutex_lock( &host->lock );
-            TAB_APPEND( host->i_client, host->client, cl );
-            vlc_mutex_unlock( &host->lock );
-            if( i_state != -1 )
-                cl->i_state = i_state; // override state for TLS
+            i_sweep = now + CLOCK_FREQ;
         }
 
+        for( int i = 0; i < worker->i_dead; i++ )
+        {
+            httpd_WorkerRemove( worker, worker->dead[i] );
+            stats_UpdateInteger( host, p_active_counter, -1, NULL );
+        }
+        TAB_CLEAN( worker->i_dead, worker->dead );
+        vlc_mutex_unlock( &worker->lock );
     }
 
     if( p_total_counter )
@@ -2506,3 +3139,98 @@ static void* httpd_HostThread( void *data )
         stats_CounterClean( p_active_counter );
     return NULL;
 }
+
+static int httpd_WorkerInit( httpd_host_t *host, httpd_worker_t *worker,
+                             bool b_listen )
+{
+    worker->host = host;
+    worker->b_listen = b_listen;
+    worker->wakefd[0] = worker->wakefd[1] = -1;
+#ifdef HAVE_SYS_EPOLL_H
+    worker->epfd = -1;
+#endif
+    vlc_mutex_init( &worker->lock );
+    TAB_INIT( worker->i_client, worker->client );
+    TAB_INIT( worker->i_pending, worker->pending );
+    TAB_INIT( worker->i_dead, worker->dead );
+    vlc_mutex_init( &worker->wake_lock );
+    TAB_INIT( worker->i_incoming, worker->incoming );
+    TAB_INIT( worker->i_woken, worker->woken );
+    worker->b_exit = false;
+
+#if defined (HAVE_SYS_EVENTFD_H)
+    worker->wakefd[0] = worker->wakefd[1] = eventfd( 0, EFD_CLOEXEC );
+    if( worker->wakefd[0] == -1 )
+#endif
+    {
+        if( vlc_pipe( worker->wakefd ) )
+        {
+            worker->wakefd[0] = worker->wakefd[1] = -1;
+            goto error;
+        }
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+    worker->epfd = epoll_create1( EPOLL_CLOEXEC );
+    if( worker->epfd == -1 )
+        goto error;
+
+    /* level-triggered: wake up (and exit) and new connections */
+    struct epoll_event ev = { .events = EPOLLIN, .data = { .ptr = worker } };
+    if( epoll_ctl( worker->epfd, EPOLL_CTL_ADD, worker->wakefd[0], &ev ) )
+        goto error;
+    for( unsigned i = 0; b_listen && i < host->nfd; i++ )
+    {
+        ev.data.ptr = &host->fds[i];
+        if( epoll_ctl( worker->epfd, EPOLL_CTL_ADD, host->fds[i], &ev ) )
+            goto error;
+    }
+#endif
+    return 0;
+
+error:
+    msg_Err( host, "cannot create worker: %m" );
+#ifdef HAVE_SYS_EPOLL_H
+    if( worker->epfd != -1 )
+        close( worker->epfd );
+#endif
+    if( worker->wakefd[0] != -1 )
+    {
+        if( worker->wakefd[1] != worker->wakefd[0] )
+            close( worker->wakefd[1] );
+        close( worker->wakefd[0] );
+    }
+    vlc_mutex_destroy( &worker->wake_lock );
+    vlc_mutex_destroy( &worker->lock );
+    return -1;
+}
+
+/* Releases a worker and its remaining clients (the thread must be joined) */
+static void httpd_WorkerClean( httpd_worker_t *worker )
+{
+    httpd_host_t *host = worker->host;
+
+    while( worker->i_client > 0 )
+    {
+        msg_Warn( host, "client still connected" );
+        httpd_WorkerRemove( worker, worker->client[0] );
+    }
+    for( int i = 0; i < worker->i_incoming; i++ )
+    {
+        httpd_ClientClean( worker->incoming[i] );
+        free( worker->incoming[i] );
+    }
+    TAB_CLEAN( worker->i_incoming, worker->incoming );
+    TAB_CLEAN( worker->i_woken, worker->woken );
+    TAB_CLEAN( worker->i_pending, worker->pending );
+    TAB_CLEAN( worker->i_dead, worker->dead );
+
+#ifdef HAVE_SYS_EPOLL_H
+    close( worker->epfd );
+#endif
+    if( worker->wakefd[1] != worker->wakefd[0] )
+        close( worker->wakefd[1] );
+    close( worker->wakefd[0] );
+    vlc_mutex_destroy( &worker->wake_lock );
+    vlc_mutex_destroy( &worker->lock );
+}
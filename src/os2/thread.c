@@ -144,6 +144,7 @@ unsigned long _System _DLL_InitTerm(unsigned long hmod, unsigned long flag)
             vlc_rwlock_init (&config_lock);
             vlc_rwlock_init (&msg_lock);
             vlc_CPU_init ();
+            block_PoolInit ();
 
             return 1;
 
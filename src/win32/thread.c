@@ -81,6 +81,7 @@ BOOL WINAPI DllMain (HINSTANCE hinstDll, DWORD fdwReason, LPVOID lpvReserved)
             vlc_rwlock_init (&config_lock);
             vlc_rwlock_init (&msg_lock);
             vlc_CPU_init ();
+            block_PoolInit ();
             break;
 
         case DLL_PROCESS_DETACH:
@@ -0,0 +1,353 @@
+/*****************************************************************************
+ * dash_abr.cpp: offline simulation of the DASH adaptation logics
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Replays a bandwidth trace against a representation ladder, without any
+ * network, and reports the average quality, the number of switches and the
+ * stall time of each logic.
+ *
+ * Without arguments, runs a few synthetic traces and checks the results.
+ * Otherwise:
+ *   test_modules_stream_filter_dash_abr <trace> <bitrates> [segment] [count]
+ * where <trace> has one "<seconds> <bits per second>" pair per line (looped
+ * as needed), <bitrates> lists the representation bandwidths of the MPD
+ * separated by commas, and [segment] is the segment duration in seconds.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "adaptationlogic/BufferBasedRateSelector.h"
+
+using dash::logic::BufferBasedRateSelector;
+
+/* Same buffer limits as the prefetcher defaults */
+#define MAX_BUFFER  30.
+#define START_LEVEL 2. /* seconds buffered before playback starts */
+
+struct trace_t
+{
+    std::vector<double> durations;
+    std::vector<long>   rates;
+};
+
+struct result_t
+{
+    double  avg_bitrate;
+    int     switches;
+    double  stall;
+    double  startup;
+    size_t  last_level;
+};
+
+/* Logic under test: returns a ladder index from the buffer level */
+class Policy
+{
+    public:
+        virtual ~Policy() {}
+        virtual size_t  select      (double buffer) = 0;
+        virtual void    sample      (long bits, double seconds) = 0;
+};
+
+/* The buffer and throughput based logic */
+class BufferPolicy : public Policy
+{
+    public:
+        BufferPolicy(const std::vector<long>& ladder)
+        {
+            selector.setBitrates(ladder);
+        }
+        size_t select(double buffer)
+        {
+            selector.setBufferLevel(buffer);
+            return selector.select();
+        }
+        void sample(long bits, double seconds)
+        {
+            selector.addThroughputSample((long)(bits / seconds), seconds);
+        }
+    private:
+        BufferBasedRateSelector selector;
+};
+
+/* What RateBasedAdaptationLogic and BasicCMManager do: the best level
+ * below the average throughput of the session */
+class RatePolicy : public Policy
+{
+    public:
+        RatePolicy(const std::vector<long>& ladder) : ladder(ladder), bits(0), time(0)
+        {
+            std::sort(this->ladder.begin(), this->ladder.end());
+        }
+        size_t select(double)
+        {
+            if(time <= 0)
+                return 0;
+            long avg = (long)(bits / time);
+            size_t level = 0;
+            while(level + 1 < ladder.size() && ladder[level + 1] < avg)
+                level++;
+            return level;
+        }
+        void sample(long b, double seconds)
+        {
+            bits += b;
+            time += seconds;
+        }
+    private:
+        std::vector<long>   ladder;
+        double              bits;
+        double              time;
+};
+
+/* Time needed to download the given amount of bits from the given time */
+static double download_time(const trace_t& trace, double start, double bits)
+{
+    double period = 0;
+    for(size_t i = 0; i < trace.durations.size(); i++)
+        period += trace.durations[i];
+
+    double t = start;
+    double offset = start - period * (long)(start / period);
+    size_t i = 0;
+
+    while(offset >= trace.durations[i])
+    {
+        offset -= trace.durations[i];
+        i = (i + 1) % trace.durations.size();
+    }
+
+    for(;;)
+    {
+        double left = trace.durations[i] - offset;
+        double capacity = left * trace.rates[i];
+
+        if(capacity >= bits)
+            return t + bits / trace.rates[i] - start;
+
+        bits -= capacity;
+        t += left;
+        offset = 0;
+        i = (i + 1) % trace.durations.size();
+    }
+}
+
+static result_t simulate(Policy& policy, const std::vector<long>& unsorted,
+                         const trace_t& trace, double segment, unsigned count)
+{
+    std::vector<long> ladder(unsorted);
+    std::sort(ladder.begin(), ladder.end());
+
+    result_t res;
+    double  t = 0, buffer = 0, sum = 0;
+    bool    playing = false;
+    size_t  previous = 0;
+
+    res.switches = 0;
+    res.stall = 0;
+    res.startup = 0;
+
+    for(unsigned n = 0; n < count; n++)
+    {
+        /* Wait for room in the buffer */
+        if(buffer + segment > MAX_BUFFER)
+        {
+            double wait = buffer + segment - MAX_BUFFER;
+            t += wait;
+            buffer -= wait;
+        }
+
+        size_t level = policy.select(buffer);
+        assert(level < ladder.size());
+        if(n > 0 && level != previous)
+            res.switches++;
+        previous = level;
+
+        double bits = (double)ladder[level] * segment;
+        double dt = download_time(trace, t, bits);
+
+        if(playing)
+        {
+            if(buffer >= dt)
+                buffer -= dt;
+            else
+            {
+                res.stall += dt - buffer;
+                buffer = 0;
+            }
+        }
+        t += dt;
+        buffer += segment;
+        sum += ladder[level];
+        policy.sample((long)bits, dt);
+
+        if(!playing && buffer >= START_LEVEL)
+        {
+            playing = true;
+            res.startup = t;
+        }
+    }
+
+    res.avg_bitrate = sum / count;
+    res.last_level = previous;
+    return res;
+}
+
+static void print(const char *name, const result_t& res)
+{
+    printf("  %-8s avg %8.0f bps, %3d switches, %6.2f s stalled, "
+           "start after %5.2f s\n", name, res.avg_bitrate, res.switches,
+           res.stall, res.startup);
+}
+
+static std::vector<long> parse_ladder(const char *str)
+{
+    std::vector<long> ladder;
+    while(*str)
+    {
+        char *end;
+        long rate = strtol(str, &end, 10);
+        if(end == str)
+            break;
+        if(rate > 0)
+            ladder.push_back(rate);
+        str = end + strspn(end, ", ");
+    }
+    return ladder;
+}
+
+static trace_t make_trace(const long *rates, const double *durations, size_t n)
+{
+    trace_t trace;
+    trace.rates.assign(rates, rates + n);
+    trace.durations.assign(durations, durations + n);
+    return trace;
+}
+
+static void test_constant(const std::vector<long>& ladder)
+{
+    static const long rates[] = { 5000000 };
+    static const double durations[] = { 10 };
+    trace_t trace = make_trace(rates, durations, 1);
+
+    BufferPolicy policy(ladder);
+    result_t res = simulate(policy, ladder, trace, 2, 150);
+    printf("constant 5 Mbit/s:\n");
+    print("buffer", res);
+
+    assert(res.stall == 0);
+    assert(res.last_level == ladder.size() - 1);
+    /* Only climbing up the ladder */
+    assert(res.switches <= (int)ladder.size() - 1);
+}
+
+static void test_oscillating(const std::vector<long>& ladder)
+{
+    static const long rates[] = { 4000000, 800000 };
+    static const double durations[] = { 6, 6 };
+    trace_t trace = make_trace(rates, durations, 2);
+
+    BufferPolicy buffer(ladder);
+    RatePolicy rate(ladder);
+    result_t a = simulate(buffer, ladder, trace, 2, 150);
+    result_t b = simulate(rate, ladder, trace, 2, 150);
+    printf("4 Mbit/s and 800 kbit/s alternating every 6 s:\n");
+    print("buffer", a);
+    print("rate", b);
+
+    assert(a.stall == 0 && a.stall <= b.stall);
+    assert(a.switches <= 10);
+
+    /* Deterministic */
+    BufferPolicy again(ladder);
+    result_t c = simulate(again, ladder, trace, 2, 150);
+    assert(c.avg_bitrate == a.avg_bitrate && c.switches == a.switches);
+}
+
+static void test_drop(const std::vector<long>& ladder)
+{
+    static const long rates[] = { 5000000, 500000 };
+    static const double durations[] = { 60, 1000 };
+    trace_t trace = make_trace(rates, durations, 2);
+
+    BufferPolicy policy(ladder);
+    result_t res = simulate(policy, ladder, trace, 2, 150);
+    printf("5 Mbit/s then 500 kbit/s:\n");
+    print("buffer", res);
+
+    /* The buffer absorbs the drop while going down the ladder */
+    assert(res.stall < 4);
+    assert(res.last_level == 0);
+}
+
+static int replay(const char *path, const char *bitrates, double segment,
+                  unsigned count)
+{
+    FILE *file = fopen(path, "r");
+    if(file == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+
+    trace_t trace;
+    double duration, rate;
+    while(fscanf(file, "%lf %lf", &duration, &rate) == 2)
+        if(duration > 0 && rate > 0)
+        {
+            trace.durations.push_back(duration);
+            trace.rates.push_back((long)rate);
+        }
+    fclose(file);
+
+    std::vector<long> ladder = parse_ladder(bitrates);
+    if(trace.durations.empty() || ladder.empty() || segment <= 0)
+    {
+        fprintf(stderr, "invalid trace or bitrates\n");
+        return 1;
+    }
+
+    BufferPolicy buffer(ladder);
+    RatePolicy rate_policy(ladder);
+    printf("%s, %u segments of %.1f s:\n", path, count, segment);
+    print("buffer", simulate(buffer, ladder, trace, segment, count));
+    print("rate", simulate(rate_policy, ladder, trace, segment, count));
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc >= 3)
+        return replay(argv[1], argv[2], argc > 3 ? atof(argv[3]) : 2,
+                      argc > 4 ? atoi(argv[4]) : 300);
+
+    std::vector<long> ladder = parse_ladder("350000,700000,1500000,3000000");
+
+    test_constant(ladder);
+    test_oscillating(ladder);
+    test_drop(ladder);
+    return 0;
+}
@@ -0,0 +1,242 @@
+/*****************************************************************************
+ * hqdn3d.c: test and benchmark of the hqdn3d denoiser implementations
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Denoises synthetic frames with the reference deNoise() and with the line
+ * based implementation for each instruction set supported by the CPU, and
+ * checks that the outputs are identical.
+ *
+ * Without arguments, runs the checks on a few sizes and strengths.
+ * Otherwise:
+ *   test_modules_video_filter_hqdn3d <width> <height> [frames]
+ * only times each implementation on frames of the given size.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#include "hqdn3d.h"
+
+struct impl
+{
+    const char *psz_name;
+    const struct hqdn3d_dsp *p_dsp; /* NULL for the reference */
+    uint32_t i_cpu;
+};
+
+static const struct impl impls[] = {
+    { "reference", NULL, 0 },
+    { "c", &hqdn3d_dsp_c, 0 },
+#if defined(CAN_COMPILE_SSE2) && defined(__x86_64__)
+    { "sse2", &hqdn3d_dsp_sse2, CPU_CAPABILITY_SSE2 },
+# ifdef CAN_COMPILE_SSSE3
+    { "ssse3", &hqdn3d_dsp_ssse3, CPU_CAPABILITY_SSSE3 },
+# endif
+#endif
+};
+
+#define IMPLS (sizeof (impls) / sizeof (impls[0]))
+
+static bool impl_Supported( const struct impl *p_impl )
+{
+    return (vlc_CPU() & p_impl->i_cpu) == p_impl->i_cpu;
+}
+
+/* Gradient with moving edges and noise, so that every branch of the low-pass
+ * and both signs of the differences are covered */
+static void FillFrame( uint8_t *p_frame, int i_width, int i_height,
+                       int i_pitch, int i_frame, uint32_t *pi_seed )
+{
+    for( int y = 0; y < i_height; y++ )
+        for( int x = 0; x < i_width; x++ )
+        {
+            *pi_seed = *pi_seed * 1103515245 + 12345;
+            int i_noise = (int)((*pi_seed >> 16) & 31) - 16;
+            int i_value = (x + 2 * y + 3 * i_frame) & 0xff;
+            if( ((x + i_frame) / 8 + y / 8) & 1 )
+                i_value = 255 - i_value;
+            p_frame[y * i_pitch + x] = VLC_CLIP( i_value + i_noise, 0, 255 );
+        }
+}
+
+typedef struct
+{
+    int i_width, i_height, i_pitch;
+    struct vf_priv_s *p_cfg;
+    uint8_t *p_dst;
+} state_t;
+
+static void StateInit( state_t *p_state, int i_width, int i_height,
+                       double f_spat, double f_temp )
+{
+    p_state->i_width = i_width;
+    p_state->i_height = i_height;
+    p_state->i_pitch = (i_width + 31) & ~31;
+    p_state->p_cfg = calloc( 1, sizeof(*p_state->p_cfg) );
+    p_state->p_dst = malloc( p_state->i_pitch * i_height );
+    assert( p_state->p_cfg && p_state->p_dst );
+
+    struct vf_priv_s *p_cfg = p_state->p_cfg;
+    p_cfg->Line = malloc( i_width * sizeof(*p_cfg->Line) );
+    p_cfg->Horiz = malloc( HQDN3D_LINES * i_width * sizeof(*p_cfg->Horiz) );
+    assert( p_cfg->Line && p_cfg->Horiz );
+    PrecalcCoefs( p_cfg->Coefs[0], f_spat );
+    PrecalcCoefs( p_cfg->Coefs[1], f_temp );
+}
+
+static void StateClean( state_t *p_state )
+{
+    free( p_state->p_cfg->Frame[0] );
+    free( p_state->p_cfg->Horiz );
+    free( p_state->p_cfg->Line );
+    free( p_state->p_cfg );
+    free( p_state->p_dst );
+}
+
+static void Denoise( const struct impl *p_impl, state_t *p_state,
+                     uint8_t *p_src )
+{
+    struct vf_priv_s *p_cfg = p_state->p_cfg;
+
+    if( p_impl->p_dsp == NULL )
+        deNoise( p_src, p_state->p_dst, p_cfg->Line, &p_cfg->Frame[0],
+                 p_state->i_width, p_state->i_height,
+                 p_state->i_pitch, p_state->i_pitch,
+                 p_cfg->Coefs[0], p_cfg->Coefs[0], p_cfg->Coefs[1] );
+    else
+        deNoiseLines( p_src, p_state->p_dst, p_cfg->Line, p_cfg->Horiz,
+                      &p_cfg->Frame[0], p_state->i_width, p_state->i_height,
+                      p_state->i_pitch, p_state->i_pitch,
+                      p_cfg->Coefs[0], p_cfg->Coefs[0], p_cfg->Coefs[1],
+                      p_impl->p_dsp );
+}
+
+static void test_Exact( int i_width, int i_height, double f_spat,
+                        double f_temp )
+{
+    state_t states[IMPLS];
+    const int i_pitch = (i_width + 31) & ~31;
+    uint8_t *p_src = malloc( i_pitch * i_height );
+    uint32_t i_seed = 1;
+
+    assert( p_src );
+    printf( "%dx%d, spatial %.1f, temporal %.1f\n",
+            i_width, i_height, f_spat, f_temp );
+
+    for( unsigned i = 0; i < IMPLS; i++ )
+        StateInit( &states[i], i_width, i_height, f_spat, f_temp );
+
+    for( int i_frame = 0; i_frame < 5; i_frame++ )
+    {
+        FillFrame( p_src, i_width, i_height, i_pitch, i_frame, &i_seed );
+
+        for( unsigned i = 0; i < IMPLS; i++ )
+        {
+            if( !impl_Supported( &impls[i] ) )
+                continue;
+            Denoise( &impls[i], &states[i], p_src );
+            if( i == 0 )
+                continue;
+
+            for( int y = 0; y < i_height; y++ )
+                if( memcmp( &states[i].p_dst[y * i_pitch],
+                            &states[0].p_dst[y * i_pitch], i_width ) )
+                {
+                    fprintf( stderr, "%s: frame %d line %d differs\n",
+                             impls[i].psz_name, i_frame, y );
+                    abort();
+                }
+            assert( !memcmp( states[i].p_cfg->Frame[0],
+                             states[0].p_cfg->Frame[0],
+                             i_width * i_height * sizeof(unsigned short) ) );
+        }
+    }
+
+    for( unsigned i = 0; i < IMPLS; i++ )
+        StateClean( &states[i] );
+    free( p_src );
+}
+
+static void bench( int i_width, int i_height, int i_frames )
+{
+    const int i_pitch = (i_width + 31) & ~31;
+    uint8_t *p_src = malloc( i_pitch * i_height );
+    uint32_t i_seed = 1;
+
+    assert( p_src );
+    FillFrame( p_src, i_width, i_height, i_pitch, 0, &i_seed );
+
+    for( unsigned i = 0; i < IMPLS; i++ )
+    {
+        state_t state;
+
+        if( !impl_Supported( &impls[i] ) )
+            continue;
+
+        StateInit( &state, i_width, i_height, PARAM1_DEFAULT,
+                   PARAM3_DEFAULT );
+        Denoise( &impls[i], &state, p_src ); /* warm up */
+
+        mtime_t i_start = mdate();
+        for( int i_frame = 0; i_frame < i_frames; i_frame++ )
+            Denoise( &impls[i], &state, p_src );
+        mtime_t i_duration = mdate() - i_start;
+
+        printf( "%-10s %8.3f ms/plane\n", impls[i].psz_name,
+                i_duration / 1000. / i_frames );
+        StateClean( &state );
+    }
+    free( p_src );
+}
+
+int main( int argc, char **argv )
+{
+    if( argc >= 3 )
+    {
+        bench( atoi( argv[1] ), atoi( argv[2] ),
+               argc >= 4 ? atoi( argv[3] ) : 100 );
+        return 0;
+    }
+
+    static const int sizes[][2] = {
+        { 1, 1 }, { 3, 2 }, { 17, 5 }, { 64, 64 }, { 190, 33 }, { 720, 576 },
+    };
+    static const double strengths[][2] = {
+        { PARAM1_DEFAULT, PARAM3_DEFAULT }, { 0., PARAM3_DEFAULT },
+        { PARAM1_DEFAULT, 0. }, { 0., 0. }, { 254., 254. },
+    };
+
+    for( unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++ )
+        for( unsigned j = 0; j < sizeof(strengths) / sizeof(strengths[0]); j++ )
+            test_Exact( sizes[i][0], sizes[i][1],
+                        strengths[j][0], strengths[j][1] );
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*****************************************************************************
+ * block.c: test for data blocks
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+static const size_t block_sizes[] = {
+    0, 1, 15, 16, 188, 1316, 1500, 2048, 4000, 32768, 32769, 1 << 20
+};
+
+#define BLOCK_SIZES (sizeof (block_sizes) / sizeof (block_sizes[0]))
+
+static void test_block_alignment( const block_t *b )
+{
+    assert( ((uintptr_t)b->p_buffer & 15) == 0 );
+}
+
+static void test_block_Alloc( void )
+{
+    /* Allocate and release several times, so that recycled blocks get used */
+    for( int round = 0; round < 3; round++ )
+    {
+        block_t *blocks[BLOCK_SIZES];
+
+        for( size_t i = 0; i < BLOCK_SIZES; i++ )
+        {
+            blocks[i] = block_Alloc( block_sizes[i] );
+            assert( blocks[i] != NULL );
+            assert( blocks[i]->i_buffer == block_sizes[i] );
+            assert( blocks[i]->p_next == NULL );
+            assert( blocks[i]->i_flags == 0 );
+            assert( blocks[i]->i_pts == VLC_TS_INVALID );
+            test_block_alignment( blocks[i] );
+            memset( blocks[i]->p_buffer, round, blocks[i]->i_buffer );
+            blocks[i]->i_flags = BLOCK_FLAG_CORRUPTED;
+        }
+
+        for( size_t i = 0; i < BLOCK_SIZES; i++ )
+            block_Release( blocks[i] );
+    }
+}
+
+static void test_block_Realloc( void )
+{
+    for( size_t i = 0; i < BLOCK_SIZES; i++ )
+    {
+        block_t *b = block_Alloc( block_sizes[i] );
+        assert( b != NULL );
+        memset( b->p_buffer, 'x', b->i_buffer );
+
+        /* Grow the header and the body */
+        b = block_Realloc( b, 32, block_sizes[i] + 4096 );
+        assert( b != NULL );
+        assert( b->i_buffer == block_sizes[i] + 4096 + 32 );
+        for( size_t j = 0; j < block_sizes[i]; j++ )
+            assert( b->p_buffer[32 + j] == 'x' );
+
+        /* Shrink it back (the body size counts from the former start) */
+        b = block_Realloc( b, -32, 32 + block_sizes[i] );
+        if( block_sizes[i] == 0 )
+        {
+            assert( b == NULL );
+            continue;
+        }
+        assert( b != NULL );
+        assert( b->i_buffer == block_sizes[i] );
+        for( size_t j = 0; j < block_sizes[i]; j++ )
+            assert( b->p_buffer[j] == 'x' );
+        block_Release( b );
+    }
+}
+
+static void test_block_fifo( int flags )
+{
+    block_fifo_t *fifo = block_FifoNewExt( flags );
+    assert( fifo != NULL );
+
+    for( size_t i = 0; i < BLOCK_SIZES; i++ )
+        block_FifoPut( fifo, block_Alloc( block_sizes[i] ) );
+
+    size_t total = 0;
+    for( size_t i = 0; i < BLOCK_SIZES; i++ )
+        total += block_sizes[i];
+    assert( block_FifoCount( fifo ) == BLOCK_SIZES );
+    assert( block_FifoSize( fifo ) == total );
+    assert( block_FifoShow( fifo )->i_buffer == block_sizes[0] );
+
+    for( size_t i = 0; i < BLOCK_SIZES; i++ )
+    {
+        block_t *b = block_FifoGet( fifo );
+        assert( b != NULL );
+        assert( b->i_buffer == block_sizes[i] );
+        block_Release( b );
+    }
+    assert( block_FifoCount( fifo ) == 0 );
+    assert( block_FifoSize( fifo ) == 0 );
+
+    block_FifoWake( fifo );
+    assert( block_FifoGet( fifo ) == NULL );
+
+    block_FifoPut( fifo, block_Alloc( 188 ) );
+    block_FifoRelease( fifo );
+}
+
+#define FIFO_BLOCKS 100000
+
+static void *test_block_fifo_writer( void *data )
+{
+    block_fifo_t *fifo = data;
+
+    for( unsigned i = 0; i < FIFO_BLOCKS; i++ )
+    {
+        block_t *b = block_Alloc( 1 + (i % 2000) );
+        assert( b != NULL );
+        b->i_dts = i;
+        block_FifoPut( fifo, b );
+        if( (i % 1000) == 0 )
+            block_FifoPace( fifo, 100, SIZE_MAX );
+    }
+    return NULL;
+}
+
+static void test_block_fifo_threads( int flags )
+{
+    block_fifo_t *fifo = block_FifoNewExt( flags );
+    vlc_thread_t th;
+
+    assert( fifo != NULL );
+    assert( vlc_clone( &th, test_block_fifo_writer, fifo,
+                       VLC_THREAD_PRIORITY_LOW ) == 0 );
+
+    for( unsigned i = 0; i < FIFO_BLOCKS; i++ )
+    {
+        block_t *b = block_FifoGet( fifo );
+        assert( b != NULL );
+        assert( b->i_dts == (mtime_t)i );
+        assert( b->i_buffer == 1 + (i % 2000) );
+        block_Release( b );
+    }
+
+    vlc_join( th, NULL );
+    assert( block_FifoCount( fifo ) == 0 );
+    assert( block_FifoSize( fifo ) == 0 );
+    block_FifoRelease( fifo );
+}
+
+int main( void )
+{
+    log( "Testing block_Alloc()\n" );
+    test_block_Alloc();
+    log( "Testing block_Realloc()\n" );
+    test_block_Realloc();
+    log( "Testing block FIFOs\n" );
+    test_block_fifo( 0 );
+    test_block_fifo_threads( 0 );
+    log( "Testing single producer, single consumer block FIFOs\n" );
+    test_block_fifo( BLOCK_FIFO_SPSC );
+    test_block_fifo_threads( BLOCK_FIFO_SPSC );
+
+    return 0;
+}
@@ -0,0 +1,301 @@
+/*****************************************************************************
+ * picture_pool.c: test for picture pools
+ *****************************************************************************
+ * Copyright (C) 2012 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_picture_pool.h>
+
+#define PICTURES 24
+
+static video_format_t fmt;
+
+static void test_pool_Get( void )
+{
+    picture_pool_t *pool = picture_pool_NewFromFormat( &fmt, PICTURES );
+    picture_t *pics[PICTURES];
+
+    assert( pool != NULL );
+    assert( picture_pool_GetSize( pool ) == PICTURES );
+
+    for( int round = 0; round < 3; round++ )
+    {
+        for( int i = 0; i < PICTURES; i++ )
+        {
+            pics[i] = picture_pool_Get( pool );
+            assert( pics[i] != NULL );
+            assert( pics[i]->i_refcount == 1 );
+            for( int j = 0; j < i; j++ )
+                assert( pics[i] != pics[j] );
+        }
+        assert( picture_pool_Get( pool ) == NULL );
+
+        /* A released picture is handed out again */
+        picture_Hold( pics[3] );
+        picture_Release( pics[3] );
+        assert( picture_pool_Get( pool ) == NULL );
+        picture_Release( pics[3] );
+        assert( picture_pool_Get( pool ) == pics[3] );
+
+        for( int i = 0; i < PICTURES; i++ )
+            picture_Release( pics[i] );
+    }
+
+    /* Force the oldest picture to be reused */
+    for( int i = 0; i < PICTURES; i++ )
+        pics[i] = picture_pool_Get( pool );
+    picture_pool_NonEmpty( pool, false );
+    picture_t *pic = picture_pool_Get( pool );
+    assert( pic == pics[0] );
+    assert( picture_pool_Get( pool ) == NULL );
+
+    /* Free everything */
+    picture_pool_NonEmpty( pool, true );
+    for( int i = 0; i < PICTURES; i++ )
+        assert( picture_pool_Get( pool ) != NULL );
+    picture_pool_NonEmpty( pool, true );
+
+    picture_pool_Delete( pool );
+}
+
+static void test_pool_Reserve( void )
+{
+    picture_pool_t *pool = picture_pool_NewFromFormat( &fmt, PICTURES );
+    assert( pool != NULL );
+
+    assert( picture_pool_Reserve( pool, PICTURES + 1 ) == NULL );
+
+    picture_pool_t *reserve = picture_pool_Reserve( pool, PICTURES / 2 );
+    assert( reserve != NULL );
+    assert( picture_pool_GetSize( reserve ) == PICTURES / 2 );
+
+    picture_t *pics[PICTURES];
+    for( int i = 0; i < PICTURES / 2; i++ )
+        assert( (pics[i] = picture_pool_Get( pool )) != NULL );
+    assert( picture_pool_Get( pool ) == NULL );
+
+    for( int i = PICTURES / 2; i < PICTURES; i++ )
+    {
+        pics[i] = picture_pool_Get( reserve );
+        assert( pics[i] != NULL );
+        for( int j = 0; j < PICTURES / 2; j++ )
+            assert( pics[i] != pics[j] );
+    }
+    assert( picture_pool_Get( reserve ) == NULL );
+
+    /* A reserved picture still in use returns to the master pool when
+     * released */
+    for( int i = PICTURES / 2 + 1; i < PICTURES; i++ )
+        picture_Release( pics[i] );
+    picture_pool_Delete( reserve );
+    for( int i = PICTURES / 2 + 1; i < PICTURES; i++ )
+        assert( picture_pool_Get( pool ) != NULL );
+    assert( picture_pool_Get( pool ) == NULL );
+    picture_Release( pics[PICTURES / 2] );
+    assert( picture_pool_Get( pool ) == pics[PICTURES / 2] );
+
+    picture_pool_NonEmpty( pool, true );
+    picture_pool_Delete( pool );
+}
+
+static int locked;
+
+static int Lock( picture_t *pic )
+{
+    /* Only the even pictures can be locked */
+    if( pic->p[0].p_pixels[0] & 1 )
+        return VLC_EGENERIC;
+    locked++;
+    return VLC_SUCCESS;
+}
+
+static void Unlock( picture_t *pic )
+{
+    (void) pic;
+    locked--;
+}
+
+static void test_pool_Lock( void )
+{
+    picture_t *pics[PICTURES];
+
+    for( int i = 0; i < PICTURES; i++ )
+    {
+        pics[i] = picture_NewFromFormat( &fmt );
+        assert( pics[i] != NULL );
+        pics[i]->p[0].p_pixels[0] = i;
+    }
+
+    picture_pool_configuration_t cfg;
+    memset( &cfg, 0, sizeof(cfg) );
+    cfg.picture_count = PICTURES;
+    cfg.picture       = pics;
+    cfg.lock          = Lock;
+    cfg.unlock        = Unlock;
+
+    picture_pool_t *pool = picture_pool_NewExtended( &cfg );
+    assert( pool != NULL );
+
+    for( int round = 0; round < 2; round++ )
+    {
+        picture_t *got[PICTURES / 2];
+        for( int i = 0; i < PICTURES / 2; i++ )
+        {
+            got[i] = picture_pool_Get( pool );
+            assert( got[i] != NULL );
+            assert( !(got[i]->p[0].p_pixels[0] & 1) );
+        }
+        assert( picture_pool_Get( pool ) == NULL );
+        assert( locked == PICTURES / 2 );
+
+        for( int i = 0; i < PICTURES / 2; i++ )
+            picture_Release( got[i] );
+        assert( locked == 0 );
+    }
+
+    picture_pool_Delete( pool );
+}
+
+/* One thread takes the pictures, the other one releases them */
+static void *thread_Release( void *data )
+{
+    block_fifo_t *fifo = data;
+
+    for( ;; )
+    {
+        block_t *block = block_FifoGet( fifo );
+        picture_t *pic;
+
+        memcpy( &pic, block->p_buffer, sizeof(pic) );
+        block_Release( block );
+        if( pic == NULL )
+            break;
+        picture_Release( pic );
+    }
+    return NULL;
+}
+
+static void test_pool_threads( void )
+{
+    picture_pool_t *pool = picture_pool_NewFromFormat( &fmt, PICTURES );
+    block_fifo_t *fifo = block_FifoNew();
+    vlc_thread_t th;
+
+    assert( pool != NULL && fifo != NULL );
+    assert( !vlc_clone( &th, thread_Release, fifo,
+                        VLC_THREAD_PRIORITY_LOW ) );
+
+    for( int i = 0; i < 100000; )
+    {
+        picture_t *pic = picture_pool_Get( pool );
+        if( pic == NULL )
+            continue;
+
+        block_t *block = block_Alloc( sizeof(pic) );
+        assert( block != NULL );
+        memcpy( block->p_buffer, &pic, sizeof(pic) );
+        block_FifoPut( fifo, block );
+        i++;
+    }
+
+    picture_t *pic = NULL;
+    block_t *block = block_Alloc( sizeof(pic) );
+    assert( block != NULL );
+    memcpy( block->p_buffer, &pic, sizeof(pic) );
+    block_FifoPut( fifo, block );
+    vlc_join( th, NULL );
+
+    /* Everything came back */
+    for( int i = 0; i < PICTURES; i++ )
+        assert( picture_pool_Get( pool ) != NULL );
+    assert( picture_pool_Get( pool ) == NULL );
+    picture_pool_NonEmpty( pool, true );
+
+    picture_pool_Delete( pool );
+    block_FifoRelease( fifo );
+}
+
+/* A reserved pool is deleted while its pictures are being released */
+static void test_pool_Reserve_threads( void )
+{
+    picture_pool_t *pool = picture_pool_NewFromFormat( &fmt, PICTURES );
+    block_fifo_t *fifo = block_FifoNew();
+    vlc_thread_t th;
+
+    assert( pool != NULL && fifo != NULL );
+    assert( !vlc_clone( &th, thread_Release, fifo,
+                        VLC_THREAD_PRIORITY_LOW ) );
+
+    for( int round = 0; round < 10000; round++ )
+    {
+        picture_pool_t *reserve = picture_pool_Reserve( pool, PICTURES );
+        assert( reserve != NULL );
+
+        for( int i = 0; i < PICTURES; i++ )
+        {
+            picture_t *pic = picture_pool_Get( reserve );
+            assert( pic != NULL );
+
+            block_t *block = block_Alloc( sizeof(pic) );
+            assert( block != NULL );
+            memcpy( block->p_buffer, &pic, sizeof(pic) );
+            block_FifoPut( fifo, block );
+        }
+        picture_pool_Delete( reserve );
+
+        /* Every picture comes back to the master pool */
+        for( int i = 0; i < PICTURES; )
+            if( picture_pool_Get( pool ) != NULL )
+                i++;
+        picture_pool_NonEmpty( pool, true );
+    }
+
+    picture_t *pic = NULL;
+    block_t *block = block_Alloc( sizeof(pic) );
+    assert( block != NULL );
+    memcpy( block->p_buffer, &pic, sizeof(pic) );
+    block_FifoPut( fifo, block );
+    vlc_join( th, NULL );
+
+    picture_pool_Delete( pool );
+    block_FifoRelease( fifo );
+}
+
+int main( void )
+{
+    video_format_Setup( &fmt, VLC_CODEC_I420, 64, 48, 1, 1 );
+
+    log( "Testing picture_pool_Get()\n" );
+    test_pool_Get();
+    log( "Testing picture_pool_Reserve()\n" );
+    test_pool_Reserve();
+    log( "Testing picture pool locking\n" );
+    test_pool_Lock();
+    log( "Testing picture pool across threads\n" );
+    test_pool_threads();
+    log( "Testing reserved picture pool deletion across threads\n" );
+    test_pool_Reserve_threads();
+
+    return 0;
+}